@@ -2371,8 +2371,9 @@ find-file-noselect-1
       (kill-local-variable 'cursor-type)
       (let ((inhibit-read-only t))
 	(erase-buffer))
-      (and (not rawfile)
-	   (set-buffer-multibyte t))
+      ;; Make a buffer for a literal file unibyte right away, so that
+      ;; its text can be inserted as it is.
+      (set-buffer-multibyte (not rawfile))
       (if rawfile
 	  (condition-case ()
 	      (let ((inhibit-read-only t))
@@ -2420,7 +2421,11 @@ find-file-noselect-1
 	    (set-buffer-multibyte nil)
 	    (setq buffer-file-coding-system 'no-conversion)
 	    (set-buffer-major-mode buf)
-	    (setq-local find-file-literally t))
+	    (setq-local find-file-literally t)
+	    ;; A file that is mapped into memory is best only viewed,
+	    ;; since changing it reads it all.
+	    (when (buffer-text-mapped-p)
+	      (setq buffer-read-only t)))
 	(after-find-file error (not nowarn)))
       (current-buffer))))
 
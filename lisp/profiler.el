@@ -161,7 +161,8 @@ profiler-fixup-log
                                 (:constructor profiler-make-profile))
   (tag 'profiler-profile)
   (version profiler-version)
-  ;; - `type' has a value indicating the kind of profile (`memory' or `cpu').
+  ;; - `type' has a value indicating the kind of profile (`memory', `cpu',
+  ;;   or `allocation' or `survival' for the allocation profiler).
   ;; - `log' indicates the profile log.
   ;; - `timestamp' has a value giving the time when the profile was obtained.
   ;; - `diff-p' indicates if this profile represents a diff between two profiles.
@@ -206,15 +207,21 @@ profiler-read-profile
 
 (defun profiler-running-p (&optional mode)
   "Return non-nil if the profiler is running.
-Optional argument MODE means only check for the specified mode (cpu or mem)."
+Optional argument MODE means only check for the specified mode (cpu,
+mem or alloc)."
   (cond ((eq mode 'cpu) (and (fboundp 'profiler-cpu-running-p)
                              (profiler-cpu-running-p)))
         ((eq mode 'mem) (profiler-memory-running-p))
+        ((eq mode 'alloc) (and (fboundp 'profiler-allocation-running-p)
+                               (profiler-allocation-running-p)))
         (t (or (profiler-running-p 'cpu)
-               (profiler-running-p 'mem)))))
+               (profiler-running-p 'mem)
+               (profiler-running-p 'alloc)))))
 
 (defvar profiler-cpu-log nil)
 (defvar profiler-memory-log nil)
+(defvar profiler-allocation-log nil
+  "Log of the allocation profiler, of the form (ALLOCATED . SURVIVED).")
 
 (defun profiler-cpu-profile ()
   "Return CPU profile."
@@ -230,6 +237,20 @@ profiler-memory-profile
    :timestamp (current-time)
    :log profiler-memory-log))
 
+(defun profiler-allocation-profile ()
+  "Return profile of the bytes allocated."
+  (profiler-make-profile
+   :type 'allocation
+   :timestamp (current-time)
+   :log (car profiler-allocation-log)))
+
+(defun profiler-survival-profile ()
+  "Return profile of the bytes surviving garbage collection."
+  (profiler-make-profile
+   :type 'survival
+   :timestamp (current-time)
+   :log (cdr profiler-allocation-log)))
+
 
 ;;; Calltrees
 
@@ -504,7 +525,8 @@ profiler-report-line-format
 	(count-percent (profiler-calltree-count-percent tree)))
     (profiler-format (cl-ecase (profiler-profile-type profiler-report-profile)
 		       (cpu profiler-report-cpu-line-format)
-		       (memory profiler-report-memory-line-format))
+		       ((memory allocation survival)
+			profiler-report-memory-line-format))
 		     name-part
 		     (if diff-p
 			 (list (if (> count 0)
@@ -593,7 +615,9 @@ profiler-report-mode-map
 
 (defun profiler-report-make-buffer-name (profile)
   (format "*%s-Profiler-Report %s*"
-          (cl-ecase (profiler-profile-type profile) (cpu 'CPU) (memory 'Memory))
+          (cl-ecase (profiler-profile-type profile)
+            (cpu 'CPU) (memory 'Memory)
+            (allocation 'Allocation) (survival 'Survival))
           (format-time-string "%Y-%m-%d %T" (profiler-profile-timestamp profile))))
 
 (defun profiler-report-setup-buffer-1 (profile)
@@ -736,7 +760,7 @@ profiler-report-render-calltree-1
 	     (profiler-report-header-line-format
 	      profiler-report-cpu-line-format
 	      "Function" (list "CPU samples" "%")))
-	    (memory
+	    ((memory allocation survival)
 	     (profiler-report-header-line-format
 	      profiler-report-memory-line-format
 	      "Function" (list "Bytes" "%")))))
@@ -811,13 +835,19 @@ profiler-report-write-profile
 ;;;###autoload
 (defun profiler-start (mode)
   "Start/restart profilers.
-MODE can be one of `cpu', `mem', or `cpu+mem'.
-If MODE is `cpu' or `cpu+mem', time-based profiler will be started.
-Also, if MODE is `mem' or `cpu+mem', then memory profiler will be started."
+MODE can be one of `cpu', `mem', `cpu+mem', `alloc' or `cpu+alloc'.
+If MODE is `cpu', `cpu+mem' or `cpu+alloc', time-based profiler will
+be started.  Also, if MODE is `mem' or `cpu+mem', then memory profiler
+will be started, and if MODE is `alloc' or `cpu+alloc', the allocation
+profiler, which records the bytes of Lisp objects allocated and how
+many of them survive garbage collection, will be started."
   (interactive
    (list (if (not (fboundp 'profiler-cpu-start)) 'mem
            (intern (completing-read "Mode (default cpu): "
-                                    '("cpu" "mem" "cpu+mem")
+                                    (if (fboundp 'profiler-allocation-start)
+                                        '("cpu" "mem" "cpu+mem"
+                                          "alloc" "cpu+alloc")
+                                      '("cpu" "mem" "cpu+mem"))
                                     nil t nil nil "cpu")))))
   (cl-ecase mode
     (cpu
@@ -829,7 +859,19 @@ profiler-start
     (cpu+mem
      (profiler-cpu-start profiler-sampling-interval)
      (profiler-memory-start)
-     (message "CPU and memory profiler started"))))
+     (message "CPU and memory profiler started"))
+    (alloc
+     (profiler-allocation-start)
+     (message "Allocation profiler started"))
+    (cpu+alloc
+     (profiler-cpu-start profiler-sampling-interval)
+     (profiler-allocation-start)
+     (message "CPU and allocation profiler started"))))
+
+(defun profiler--allocation-log ()
+  "Fetch the log of the allocation profiler, if it is running."
+  (when (profiler-running-p 'alloc)
+    (setq profiler-allocation-log (profiler-allocation-log))))
 
 (defun profiler-stop ()
   "Stop started profilers.  Profiler logs will be kept."
@@ -839,11 +881,16 @@ profiler-stop
     (setq profiler-cpu-log (profiler-cpu-log)))
   (when (profiler-memory-running-p)
     (setq profiler-memory-log (profiler-memory-log)))
+  (profiler--allocation-log)
   (let ((cpu (when (fboundp 'profiler-cpu-stop) (profiler-cpu-stop)))
-        (mem (profiler-memory-stop)))
+        (mem (profiler-memory-stop))
+        (alloc (when (fboundp 'profiler-allocation-stop)
+                 (profiler-allocation-stop))))
     (message "%s profiler stopped"
              (cond ((and mem cpu) "CPU and memory")
+                   ((and alloc cpu) "CPU and allocation")
                    (mem "Memory")
+                   (alloc "Allocation")
                    (cpu "CPU")
                    (t "No")))))
 
@@ -854,8 +901,11 @@ profiler-reset
     (profiler-cpu-stop))
   (when (profiler-memory-running-p)
     (profiler-memory-stop))
+  (when (profiler-running-p 'alloc)
+    (profiler-allocation-stop))
   (setq profiler-cpu-log nil
-        profiler-memory-log nil))
+        profiler-memory-log nil
+        profiler-allocation-log nil))
 
 (defun profiler-report-cpu ()
   (when profiler-cpu-log
@@ -865,6 +915,11 @@ profiler-report-memory
   (when profiler-memory-log
     (profiler-report-profile-other-window (profiler-memory-profile))))
 
+(defun profiler-report-allocation ()
+  (when profiler-allocation-log
+    (profiler-report-profile-other-window (profiler-survival-profile))
+    (profiler-report-profile-other-window (profiler-allocation-profile))))
+
 (defun profiler-report ()
   "Report profiling results."
   (interactive)
@@ -872,10 +927,13 @@ profiler-report
     (setq profiler-cpu-log (profiler-cpu-log)))
   (when (profiler-memory-running-p)
     (setq profiler-memory-log (profiler-memory-log)))
-  (if (and (not profiler-cpu-log) (not profiler-memory-log))
+  (profiler--allocation-log)
+  (if (and (not profiler-cpu-log) (not profiler-memory-log)
+           (not profiler-allocation-log))
       (user-error "No profiler run recorded")
     (profiler-report-cpu)
-    (profiler-report-memory)))
+    (profiler-report-memory)
+    (profiler-report-allocation)))
 
 ;;;###autoload
 (defun profiler-find-profile (filename)
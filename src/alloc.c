@@ -234,6 +234,62 @@ #define GC_DEFAULT_THRESHOLD (100000 * word_size)
 
 EMACS_INT gc_relative_threshold;
 
+/* Duration in seconds of the most recent garbage collection.  This
+   is the estimate of the next pause used by `gc-pause-budget'.  */
+
+static double gc_last_pause;
+
+/* The phase of garbage collection in progress, when it began, and the
+   time spent so far in each phase of the current collection.  The
+   profiler's signal handler reads gc_current_phase.  */
+
+enum gc_phase gc_current_phase;
+static struct timespec gc_phase_start;
+static double gc_phase_time[GC_PHASE_COUNT];
+
+/* Types of objects whose reclaimed bytes `gc-statistics' reports.  */
+
+enum gc_type
+  {
+    GC_TYPE_CONSES,
+    GC_TYPE_FLOATS,
+    GC_TYPE_SYMBOLS,
+    GC_TYPE_STRINGS,
+    GC_TYPE_VECTORS,
+    GC_TYPE_INTERVALS,
+    GC_TYPE_MISCS,
+    GC_TYPE_COUNT
+  };
+
+/* Bytes of each type allocated in total, and live, as of the end of
+   the last GC.  */
+
+static EMACS_INT gc_last_consed_bytes[GC_TYPE_COUNT];
+static EMACS_INT gc_last_live_bytes[GC_TYPE_COUNT];
+
+/* A record of one garbage collection, for `gc-statistics'.  */
+
+struct gc_record
+{
+  /* When the collection finished, and how long it took.  */
+  struct timespec end;
+  double elapsed;
+
+  /* Seconds spent in each phase.  */
+  double phase_time[GC_PHASE_COUNT];
+
+  /* Approximate bytes reclaimed for each type of object.  */
+  EMACS_INT reclaimed[GC_TYPE_COUNT];
+};
+
+/* Ring buffer of the most recent collections.  gc_records_count is
+   the total number of collections recorded, so the most recent one is
+   at index (gc_records_count - 1) % GC_RECORDS_MAX.  */
+
+enum { GC_RECORDS_MAX = 64 };
+static struct gc_record gc_records[GC_RECORDS_MAX];
+static EMACS_INT gc_records_count;
+
 /* Minimum number of bytes of consing since GC before next GC,
    when memory is full.  */
 
@@ -249,6 +305,13 @@ #define GC_DEFAULT_THRESHOLD (100000 * word_size)
 static EMACS_INT total_free_conses, total_free_markers, total_free_symbols;
 static EMACS_INT total_free_floats, total_floats;
 
+/* Number of conses, floats and small strings allocated since the
+   previous GC that the last GC found live, and that it reclaimed.  */
+
+static EMACS_INT total_young_conses, total_young_free_conses;
+static EMACS_INT total_young_floats, total_young_free_floats;
+static EMACS_INT total_young_strings, total_young_free_strings;
+
 /* Points to memory space allocated as "spare", to be freed if we run
    out of memory.  We keep one large block, four cons-blocks, and
    two string blocks.  */
@@ -356,6 +419,7 @@ no_sanitize_memcpy (void *dest, void const *src, size_t size)
 
 static void mark_terminals (void);
 static void gc_sweep (void);
+static void gc_enter_phase (enum gc_phase);
 static Lisp_Object make_pure_vector (ptrdiff_t);
 static void mark_buffer (struct buffer *);
 
@@ -401,68 +465,67 @@ #define DEADP(x) EQ (x, Vdead)
 
 #endif /* GC_MALLOC_CHECK */
 
-/* A node in the red-black tree describing allocated memory containing
-   Lisp data.  Each such block is recorded with its start and end
-   address when it is allocated, and removed from the tree when it
-   is freed.
-
-   A red-black tree is a balanced binary tree with the following
-   properties:
+/* A node describing a block of allocated memory containing Lisp
+   data.  Each such block is recorded with its start and end address
+   when it is allocated, and forgotten when it is freed.
 
-   1. Every node is either red or black.
-   2. Every leaf is black.
-   3. If a node is red, then both of its children are black.
-   4. Every simple path from a node to a descendant leaf contains
-   the same number of black nodes.
-   5. The root is always black.
+   To find the node of the block containing a given address quickly,
+   the nodes are indexed by the memory pages they overlap: each node
+   has one mem_page entry per page, and these entries are kept in a
+   hash table keyed by page number.  A lookup hashes the page number
+   of the address and checks the few nodes overlapping that page, so
+   it takes constant time no matter how many blocks there are.  This
+   matters because the conservative stack scan does one lookup for
+   every word on the C stack.  */
 
-   When nodes are inserted into the tree, or deleted from the tree,
-   the tree is "fixed" so that these properties are always true.
+/* Log base 2 of the size of a page in the mem_page index.  */
 
-   A red-black tree with N internal nodes has height at most 2
-   log(N+1).  Searches, insertions and deletions are done in O(log N).
-   Please see a text book about data structures for a detailed
-   description of red-black trees.  Any book worth its salt should
-   describe them.  */
+enum { MEM_PAGE_BITS = 12 };
 
-struct mem_node
+struct mem_page
 {
-  /* Children of this node.  These pointers are never NULL.  When there
-     is no child, the value is MEM_NIL, which points to a dummy node.  */
-  struct mem_node *left, *right;
+  /* Next entry in the same hash bucket.  */
+  struct mem_page *next;
+
+  /* Page number, i.e., address shifted right by MEM_PAGE_BITS.  */
+  uintptr_t page;
 
-  /* The parent of this node.  In the root node, this is NULL.  */
-  struct mem_node *parent;
+  /* Node whose block overlaps the page.  */
+  struct mem_node *node;
+};
 
+struct mem_node
+{
   /* Start and end of allocated region.  */
   void *start, *end;
 
-  /* Node color.  */
-  enum {MEM_BLACK, MEM_RED} color;
-
   /* Memory type.  */
   enum mem_type type;
+
+  /* Number of pages the region overlaps, and the index entries for
+     them.  */
+  ptrdiff_t npages;
+  struct mem_page pages[FLEXIBLE_ARRAY_MEMBER];
 };
 
-/* Root of the tree describing allocated Lisp memory.  */
+/* Hash table of mem_page entries, its number of buckets (a power of
+   2), and the number of entries in it.  */
 
-static struct mem_node *mem_root;
+static struct mem_page **mem_page_table;
+static ptrdiff_t mem_page_table_size;
+static ptrdiff_t mem_page_count;
 
 /* Lowest and highest known address in the heap.  */
 
 static void *min_heap_address, *max_heap_address;
 
-/* Sentinel node of the tree.  */
+/* Node returned by mem_find when no block contains the address.  */
 
 static struct mem_node mem_z;
 #define MEM_NIL &mem_z
 
 static struct mem_node *mem_insert (void *, void *, enum mem_type);
-static void mem_insert_fixup (struct mem_node *);
-static void mem_rotate_left (struct mem_node *);
-static void mem_rotate_right (struct mem_node *);
 static void mem_delete (struct mem_node *);
-static void mem_delete_fixup (struct mem_node *);
 static struct mem_node *mem_find (void *);
 
 #ifndef DEADP
@@ -832,6 +895,15 @@ #define MALLOC_PROBE(size)			\
       malloc_probe (size);			\
   } while (0)
 
+/* Sample the allocation of SIZE bytes for OBJECT, or for INTERVAL if
+   that is not null, whose type is the symbol TYPE.  */
+
+#define ALLOCATION_PROBE(type, object, interval, size)		\
+  do {								\
+    if (profiler_allocation_running)				\
+      allocation_probe (type, object, interval, size);		\
+  } while (0)
+
 static void *lmalloc (size_t) ATTRIBUTE_MALLOC_SIZE ((1));
 static void *lrealloc (void *, size_t);
 
@@ -1546,6 +1618,7 @@ make_interval (void)
   total_free_intervals--;
   RESET_INTERVAL (val);
   val->gcmarkbit = 0;
+  ALLOCATION_PROBE (Qinterval, Qnil, val, sizeof (struct interval));
   return val;
 }
 
@@ -1706,6 +1779,14 @@ #define STRING_BLOCK_SIZE \
 
 static struct sblock *oldest_sblock, *current_sblock;
 
+/* The sblock and the position within it where string data allocated
+   since the last GC begins.  Data of small strings allocated since
+   then is at or after this position in the sblock chain.  A null
+   YOUNG_SBLOCK means all of the chain is young.  */
+
+static struct sblock *young_sblock;
+static sdata *young_sdata;
+
 /* List of sblocks for large strings.  */
 
 static struct sblock *large_sblocks;
@@ -2065,6 +2146,8 @@ allocate_string_data (struct Lisp_String *s,
     }
 
   consing_since_gc += needed;
+  ALLOCATION_PROBE (Qstring, make_lisp_ptr (s, Lisp_String), NULL,
+		    needed + (old_data ? 0 : sizeof *s));
 }
 
 
@@ -2162,6 +2245,7 @@ sweep_strings (void)
 
   string_blocks = live_blocks;
   free_large_strings ();
+  gc_enter_phase (GC_PHASE_COMPACT_STRINGS);
   compact_small_strings ();
 
   check_string_free_list ();
@@ -2207,6 +2291,11 @@ compact_small_strings (void)
       sdata *tb_end = (sdata *) ((char *) tb + SBLOCK_SIZE);
       sdata *to = tb->data;
 
+      /* Whether FROM is at or after YOUNG_SDATA.  */
+      bool young = !young_sblock;
+
+      total_young_strings = total_young_free_strings = 0;
+
       /* Step through the blocks from the oldest to the youngest.  We
 	 expect that old blocks will stabilize over time, so that less
 	 copying will happen this way.  */
@@ -2218,6 +2307,9 @@ compact_small_strings (void)
 
 	  for (sdata *from = b->data; from < end; )
 	    {
+	      if (b == young_sblock && from == young_sdata)
+		young = true;
+
 	      /* Compute the next FROM here because copying below may
 		 overwrite data we need to compute it.  */
 	      ptrdiff_t nbytes;
@@ -2244,6 +2336,14 @@ compact_small_strings (void)
 		emacs_abort ();
 #endif
 
+	      if (young)
+		{
+		  if (s)
+		    total_young_strings++;
+		  else
+		    total_young_free_strings++;
+		}
+
 	      /* Non-NULL S means it's alive.  Copy its data.  */
 	      if (s)
 		{
@@ -2272,6 +2372,8 @@ compact_small_strings (void)
 		}
 	      from = from_end;
 	    }
+	  if (b == young_sblock)
+	    young = true;
 	  b = b->next;
 	}
       while (b);
@@ -2287,9 +2389,10 @@ compact_small_strings (void)
 
       tb->next_free = to;
       tb->next = NULL;
+      young_sdata = to;
     }
 
-  current_sblock = tb;
+  current_sblock = young_sblock = tb;
 }
 
 void
@@ -2579,8 +2682,10 @@ make_formatted_string (char *buf, const char *format, ...)
 #define FLOAT_BLOCK_SIZE					\
   (((BLOCK_BYTES - sizeof (struct float_block *)		\
      /* The compiler might add padding at the end.  */		\
-     - (sizeof (struct Lisp_Float) - sizeof (bits_word))) * CHAR_BIT) \
-   / (sizeof (struct Lisp_Float) * CHAR_BIT + 1))
+     - (sizeof (struct Lisp_Float) - sizeof (bits_word))	\
+     /* Room for rounding up the second bit vector.  */		\
+     - sizeof (bits_word)) * CHAR_BIT)				\
+   / (sizeof (struct Lisp_Float) * CHAR_BIT + 2))
 
 #define GETMARKBIT(block,n)				\
   (((block)->gcmarkbits[(n) / BITS_PER_BITS_WORD]	\
@@ -2595,6 +2700,19 @@ #define UNSETMARKBIT(block,n)				\
   ((block)->gcmarkbits[(n) / BITS_PER_BITS_WORD]	\
    &= ~((bits_word) 1 << ((n) % BITS_PER_BITS_WORD)))
 
+/* Float and cons blocks also have a bit per object that says whether
+   it was allocated since the last GC.  The sweep uses these bits to
+   count how many young objects survive, and then clears them.  */
+
+#define GETYOUNGBIT(block,n)				\
+  (((block)->youngbits[(n) / BITS_PER_BITS_WORD]	\
+    >> ((n) % BITS_PER_BITS_WORD))			\
+   & 1)
+
+#define SETYOUNGBIT(block,n)				\
+  ((block)->youngbits[(n) / BITS_PER_BITS_WORD]	\
+   |= (bits_word) 1 << ((n) % BITS_PER_BITS_WORD))
+
 #define FLOAT_BLOCK(fptr) \
   ((struct float_block *) (((uintptr_t) (fptr)) & ~(BLOCK_ALIGN - 1)))
 
@@ -2606,8 +2724,10 @@ #define FLOAT_INDEX(fptr) \
   /* Place `floats' at the beginning, to ease up FLOAT_INDEX's job.  */
   struct Lisp_Float floats[FLOAT_BLOCK_SIZE];
   bits_word gcmarkbits[1 + FLOAT_BLOCK_SIZE / BITS_PER_BITS_WORD];
+  bits_word youngbits[1 + FLOAT_BLOCK_SIZE / BITS_PER_BITS_WORD];
   struct float_block *next;
 };
+verify (sizeof (struct float_block) <= BLOCK_BYTES);
 
 #define FLOAT_MARKED_P(fptr) \
   GETMARKBIT (FLOAT_BLOCK (fptr), FLOAT_INDEX ((fptr)))
@@ -2618,6 +2738,12 @@ #define FLOAT_MARK(fptr) \
 #define FLOAT_UNMARK(fptr) \
   UNSETMARKBIT (FLOAT_BLOCK (fptr), FLOAT_INDEX ((fptr)))
 
+#define FLOAT_YOUNG_P(fptr) \
+  GETYOUNGBIT (FLOAT_BLOCK (fptr), FLOAT_INDEX ((fptr)))
+
+#define FLOAT_SET_YOUNG(fptr) \
+  SETYOUNGBIT (FLOAT_BLOCK (fptr), FLOAT_INDEX ((fptr)))
+
 /* Current float_block.  */
 
 static struct float_block *float_block;
@@ -2654,6 +2780,7 @@ make_float (double float_value)
 	    = lisp_align_malloc (sizeof *new, MEM_TYPE_FLOAT);
 	  new->next = float_block;
 	  memset (new->gcmarkbits, 0, sizeof new->gcmarkbits);
+	  memset (new->youngbits, 0, sizeof new->youngbits);
 	  float_block = new;
 	  float_block_index = 0;
 	  total_free_floats += FLOAT_BLOCK_SIZE;
@@ -2666,9 +2793,11 @@ make_float (double float_value)
 
   XFLOAT_INIT (val, float_value);
   eassert (!FLOAT_MARKED_P (XFLOAT (val)));
+  FLOAT_SET_YOUNG (XFLOAT (val));
   consing_since_gc += sizeof (struct Lisp_Float);
   floats_consed++;
   total_free_floats--;
+  ALLOCATION_PROBE (Qfloat, val, NULL, sizeof (struct Lisp_Float));
   return val;
 }
 
@@ -2686,8 +2815,10 @@ make_float (double float_value)
 #define CONS_BLOCK_SIZE						\
   (((BLOCK_BYTES - sizeof (struct cons_block *)			\
      /* The compiler might add padding at the end.  */		\
-     - (sizeof (struct Lisp_Cons) - sizeof (bits_word))) * CHAR_BIT)	\
-   / (sizeof (struct Lisp_Cons) * CHAR_BIT + 1))
+     - (sizeof (struct Lisp_Cons) - sizeof (bits_word))		\
+     /* Room for rounding up the second bit vector.  */		\
+     - sizeof (bits_word)) * CHAR_BIT)				\
+   / (sizeof (struct Lisp_Cons) * CHAR_BIT + 2))
 
 #define CONS_BLOCK(fptr) \
   ((struct cons_block *) ((uintptr_t) (fptr) & ~(BLOCK_ALIGN - 1)))
@@ -2700,8 +2831,10 @@ #define CONS_INDEX(fptr) \
   /* Place `conses' at the beginning, to ease up CONS_INDEX's job.  */
   struct Lisp_Cons conses[CONS_BLOCK_SIZE];
   bits_word gcmarkbits[1 + CONS_BLOCK_SIZE / BITS_PER_BITS_WORD];
+  bits_word youngbits[1 + CONS_BLOCK_SIZE / BITS_PER_BITS_WORD];
   struct cons_block *next;
 };
+verify (sizeof (struct cons_block) <= BLOCK_BYTES);
 
 #define CONS_MARKED_P(fptr) \
   GETMARKBIT (CONS_BLOCK (fptr), CONS_INDEX ((fptr)))
@@ -2712,6 +2845,12 @@ #define CONS_MARK(fptr) \
 #define CONS_UNMARK(fptr) \
   UNSETMARKBIT (CONS_BLOCK (fptr), CONS_INDEX ((fptr)))
 
+#define CONS_YOUNG_P(fptr) \
+  GETYOUNGBIT (CONS_BLOCK (fptr), CONS_INDEX ((fptr)))
+
+#define CONS_SET_YOUNG(fptr) \
+  SETYOUNGBIT (CONS_BLOCK (fptr), CONS_INDEX ((fptr)))
+
 /* Current cons_block.  */
 
 static struct cons_block *cons_block;
@@ -2758,6 +2897,7 @@ DEFUN ("cons", Fcons, Scons, 2, 2, 0,
 	  struct cons_block *new
 	    = lisp_align_malloc (sizeof *new, MEM_TYPE_CONS);
 	  memset (new->gcmarkbits, 0, sizeof new->gcmarkbits);
+	  memset (new->youngbits, 0, sizeof new->youngbits);
 	  new->next = cons_block;
 	  cons_block = new;
 	  cons_block_index = 0;
@@ -2772,9 +2912,11 @@ DEFUN ("cons", Fcons, Scons, 2, 2, 0,
   XSETCAR (val, car);
   XSETCDR (val, cdr);
   eassert (!CONS_MARKED_P (XCONS (val)));
+  CONS_SET_YOUNG (XCONS (val));
   consing_since_gc += sizeof (struct Lisp_Cons);
   total_free_conses--;
   cons_cells_consed++;
+  ALLOCATION_PROBE (Qcons, val, NULL, sizeof (struct Lisp_Cons));
   return val;
 }
 
@@ -3360,7 +3502,11 @@ allocate_vector (EMACS_INT len)
     memory_full (SIZE_MAX);
   v = allocate_vectorlike (len);
   if (len)
-    v->header.size = len;
+    {
+      v->header.size = len;
+      ALLOCATION_PROBE (Qvector, make_lisp_ptr (v, Lisp_Vectorlike), NULL,
+			header_size + len * word_size);
+    }
   return v;
 }
 
@@ -3382,6 +3528,12 @@ allocate_pseudovector (int memlen, int lisplen,
   /* Only the first LISPLEN slots will be traced normally by the GC.  */
   memclear (v->contents, zerolen * word_size);
   XSETPVECTYPESIZE (v, tag, lisplen, memlen - lisplen);
+  if (profiler_allocation_running)
+    {
+      Lisp_Object obj = make_lisp_ptr (v, Lisp_Vectorlike);
+      allocation_probe (Ftype_of (obj), obj, NULL,
+			header_size + memlen * word_size);
+    }
   return v;
 }
 
@@ -3395,6 +3547,8 @@ allocate_buffer (void)
   b->next = all_buffers;
   all_buffers = b;
   /* Note that the rest fields of B are not initialized.  */
+  ALLOCATION_PROBE (Qbuffer, make_lisp_ptr (b, Lisp_Vectorlike), NULL,
+		    sizeof *b);
   return b;
 }
 
@@ -3411,6 +3565,8 @@ allocate_record (EMACS_INT count)
   struct Lisp_Vector *p = allocate_vectorlike (count);
   p->header.size = count;
   XSETPVECTYPE (p, PVEC_RECORD);
+  ALLOCATION_PROBE (Qrecord, make_lisp_ptr (p, Lisp_Vectorlike), NULL,
+		    header_size + count * word_size);
   return p;
 }
 
@@ -3701,6 +3857,8 @@ allocate_misc (enum Lisp_Misc_Type type)
   misc_objects_consed++;
   XMISCANY (val)->type = type;
   XMISCANY (val)->gcmarkbit = 0;
+  if (profiler_allocation_running)
+    allocation_probe (Ftype_of (val), val, NULL, sizeof (union Lisp_Misc));
   return val;
 }
 
@@ -3821,18 +3979,21 @@ free_save_value (Lisp_Object save)
   free_misc (save);
 }
 
-/* Return a Lisp_Misc_Overlay object with specified START, END and PLIST.  */
+/* Return a Lisp_Misc_Overlay object with specified PLIST, not in any
+   buffer.  FRONT_ADVANCE and REAR_ADVANCE are the insertion types of
+   its start and end.  */
 
 Lisp_Object
-build_overlay (Lisp_Object start, Lisp_Object end, Lisp_Object plist)
+build_overlay (bool front_advance, bool rear_advance, Lisp_Object plist)
 {
   register Lisp_Object overlay;
+  struct itree_node *node = xmalloc (sizeof *node);
 
   overlay = allocate_misc (Lisp_Misc_Overlay);
-  OVERLAY_START (overlay) = start;
-  OVERLAY_END (overlay) = end;
+  itree_node_init (node, front_advance, rear_advance, overlay);
+  XOVERLAY (overlay)->interval = node;
+  XOVERLAY (overlay)->buffer = NULL;
   set_overlay_plist (overlay, plist);
-  XOVERLAY (overlay)->next = NULL;
   return overlay;
 }
 
@@ -4165,390 +4326,176 @@ refill_memory_reserve (void)
 
 /* Conservative C stack marking requires a method to identify possibly
    live Lisp objects given a pointer value.  We do this by keeping
-   track of blocks of Lisp data that are allocated in a red-black tree
-   (see also the comment of mem_node which is the type of nodes in
-   that tree).  Function lisp_malloc adds information for an allocated
-   block to the red-black tree with calls to mem_insert, and function
-   lisp_free removes it with mem_delete.  Functions live_string_p etc
-   call mem_find to lookup information about a given pointer in the
-   tree, and use that to determine if the pointer points to a Lisp
-   object or not.  */
+   track of blocks of Lisp data that are allocated in a table indexed
+   by memory page (see also the comment of mem_node).  Function
+   lisp_malloc adds information for an allocated block to the table
+   with calls to mem_insert, and function lisp_free removes it with
+   mem_delete.  Functions live_string_p etc call mem_find to lookup
+   information about a given pointer in the table, and use that to
+   determine if the pointer points to a Lisp object or not.  */
 
 /* Initialize this part of alloc.c.  */
 
 static void
 mem_init (void)
 {
-  mem_z.left = mem_z.right = MEM_NIL;
-  mem_z.parent = NULL;
-  mem_z.color = MEM_BLACK;
   mem_z.start = mem_z.end = NULL;
-  mem_root = MEM_NIL;
+  mem_page_table = NULL;
+  mem_page_table_size = mem_page_count = 0;
+}
+
+
+/* Return the bucket of the mem_page hash table for page number PAGE.  */
+
+static ptrdiff_t
+mem_page_bucket (uintptr_t page)
+{
+  /* Multiplicative hashing; the high bits of the product are the
+     well-mixed ones.  */
+  uint_fast64_t h = page * (uint_fast64_t) 0x9e3779b97f4a7c15;
+  return (h >> 32) & (mem_page_table_size - 1);
+}
+
+
+/* Make the mem_page hash table big enough for NPAGES more entries.  */
+
+static void
+mem_page_table_reserve (ptrdiff_t npages)
+{
+  ptrdiff_t old_size = mem_page_table_size;
+  ptrdiff_t size = old_size ? old_size : 1024;
+
+  while (size < mem_page_count + npages)
+    size *= 2;
+  if (size == old_size)
+    return;
+
+  struct mem_page **old_table = mem_page_table;
+  size_t nbytes = size * sizeof *mem_page_table;
+#ifdef GC_MALLOC_CHECK
+  mem_page_table = malloc (nbytes);
+  if (mem_page_table == NULL)
+    emacs_abort ();
+  memset (mem_page_table, 0, nbytes);
+#else
+  mem_page_table = xzalloc (nbytes);
+#endif
+  mem_page_table_size = size;
+
+  for (ptrdiff_t i = 0; i < old_size; i++)
+    for (struct mem_page *p = old_table[i], *next; p; p = next)
+      {
+	ptrdiff_t bucket = mem_page_bucket (p->page);
+	next = p->next;
+	p->next = mem_page_table[bucket];
+	mem_page_table[bucket] = p;
+      }
+
+#ifdef GC_MALLOC_CHECK
+  free (old_table);
+#else
+  xfree (old_table);
+#endif
 }
 
 
 /* Value is a pointer to the mem_node containing START.  Value is
-   MEM_NIL if there is no node in the tree containing START.  */
+   MEM_NIL if there is no node in the table containing START.  */
 
 static struct mem_node *
 mem_find (void *start)
 {
-  struct mem_node *p;
-
-  if (start < min_heap_address || start > max_heap_address)
+  if (start < min_heap_address || start > max_heap_address
+      || !mem_page_table)
     return MEM_NIL;
 
-  /* Make the search always successful to speed up the loop below.  */
-  mem_z.start = start;
-  mem_z.end = (char *) start + 1;
-
-  p = mem_root;
-  while (start < p->start || start >= p->end)
-    p = start < p->start ? p->left : p->right;
-  return p;
+  uintptr_t page = (uintptr_t) start >> MEM_PAGE_BITS;
+  for (struct mem_page *p = mem_page_table[mem_page_bucket (page)];
+       p; p = p->next)
+    if (p->page == page
+	&& p->node->start <= start && start < p->node->end)
+      return p->node;
+  return MEM_NIL;
 }
 
 
-/* Insert a new node into the tree for a block of memory with start
+/* Insert a new node into the table for a block of memory with start
    address START, end address END, and type TYPE.  Value is a
    pointer to the node that was inserted.  */
 
 static struct mem_node *
 mem_insert (void *start, void *end, enum mem_type type)
 {
-  struct mem_node *c, *parent, *x;
+  struct mem_node *x;
+  uintptr_t first_page = (uintptr_t) start >> MEM_PAGE_BITS;
+  uintptr_t last_page = ((uintptr_t) end - 1) >> MEM_PAGE_BITS;
+  ptrdiff_t npages = last_page - first_page + 1;
 
   if (min_heap_address == NULL || start < min_heap_address)
     min_heap_address = start;
   if (max_heap_address == NULL || end > max_heap_address)
     max_heap_address = end;
 
-  /* See where in the tree a node for START belongs.  In this
-     particular application, it shouldn't happen that a node is already
-     present.  For debugging purposes, let's check that.  */
-  c = mem_root;
-  parent = NULL;
-
-  while (c != MEM_NIL)
-    {
-      parent = c;
-      c = start < c->start ? c->left : c->right;
-    }
+  mem_page_table_reserve (npages);
 
   /* Create a new node.  */
+  size_t nbytes = FLEXSIZEOF (struct mem_node, pages,
+			      npages * sizeof x->pages[0]);
 #ifdef GC_MALLOC_CHECK
-  x = malloc (sizeof *x);
+  x = malloc (nbytes);
   if (x == NULL)
     emacs_abort ();
 #else
-  x = xmalloc (sizeof *x);
+  x = xmalloc (nbytes);
 #endif
   x->start = start;
   x->end = end;
   x->type = type;
-  x->parent = parent;
-  x->left = x->right = MEM_NIL;
-  x->color = MEM_RED;
+  x->npages = npages;
 
-  /* Insert it as child of PARENT or install it as root.  */
-  if (parent)
+  /* Enter it into the table once for each page it overlaps.  */
+  for (ptrdiff_t i = 0; i < npages; i++)
     {
-      if (start < parent->start)
-	parent->left = x;
-      else
-	parent->right = x;
+      struct mem_page *p = &x->pages[i];
+      ptrdiff_t bucket = mem_page_bucket (first_page + i);
+      p->page = first_page + i;
+      p->node = x;
+      p->next = mem_page_table[bucket];
+      mem_page_table[bucket] = p;
     }
-  else
-    mem_root = x;
-
-  /* Re-establish red-black tree properties.  */
-  mem_insert_fixup (x);
+  mem_page_count += npages;
 
   return x;
 }
 
 
-/* Re-establish the red-black properties of the tree, and thereby
-   balance the tree, after node X has been inserted; X is always red.  */
-
-static void
-mem_insert_fixup (struct mem_node *x)
-{
-  while (x != mem_root && x->parent->color == MEM_RED)
-    {
-      /* X is red and its parent is red.  This is a violation of
-	 red-black tree property #3.  */
-
-      if (x->parent == x->parent->parent->left)
-	{
-	  /* We're on the left side of our grandparent, and Y is our
-	     "uncle".  */
-	  struct mem_node *y = x->parent->parent->right;
-
-	  if (y->color == MEM_RED)
-	    {
-	      /* Uncle and parent are red but should be black because
-		 X is red.  Change the colors accordingly and proceed
-		 with the grandparent.  */
-	      x->parent->color = MEM_BLACK;
-	      y->color = MEM_BLACK;
-	      x->parent->parent->color = MEM_RED;
-	      x = x->parent->parent;
-            }
-	  else
-	    {
-	      /* Parent and uncle have different colors; parent is
-		 red, uncle is black.  */
-	      if (x == x->parent->right)
-		{
-		  x = x->parent;
-		  mem_rotate_left (x);
-                }
-
-	      x->parent->color = MEM_BLACK;
-	      x->parent->parent->color = MEM_RED;
-	      mem_rotate_right (x->parent->parent);
-            }
-        }
-      else
-	{
-	  /* This is the symmetrical case of above.  */
-	  struct mem_node *y = x->parent->parent->left;
-
-	  if (y->color == MEM_RED)
-	    {
-	      x->parent->color = MEM_BLACK;
-	      y->color = MEM_BLACK;
-	      x->parent->parent->color = MEM_RED;
-	      x = x->parent->parent;
-            }
-	  else
-	    {
-	      if (x == x->parent->left)
-		{
-		  x = x->parent;
-		  mem_rotate_right (x);
-		}
-
-	      x->parent->color = MEM_BLACK;
-	      x->parent->parent->color = MEM_RED;
-	      mem_rotate_left (x->parent->parent);
-            }
-        }
-    }
-
-  /* The root may have been changed to red due to the algorithm.  Set
-     it to black so that property #5 is satisfied.  */
-  mem_root->color = MEM_BLACK;
-}
-
-
-/*   (x)                   (y)
-     / \                   / \
-    a   (y)      ===>    (x)  c
-        / \              / \
-       b   c            a   b  */
-
-static void
-mem_rotate_left (struct mem_node *x)
-{
-  struct mem_node *y;
-
-  /* Turn y's left sub-tree into x's right sub-tree.  */
-  y = x->right;
-  x->right = y->left;
-  if (y->left != MEM_NIL)
-    y->left->parent = x;
-
-  /* Y's parent was x's parent.  */
-  if (y != MEM_NIL)
-    y->parent = x->parent;
-
-  /* Get the parent to point to y instead of x.  */
-  if (x->parent)
-    {
-      if (x == x->parent->left)
-	x->parent->left = y;
-      else
-	x->parent->right = y;
-    }
-  else
-    mem_root = y;
-
-  /* Put x on y's left.  */
-  y->left = x;
-  if (x != MEM_NIL)
-    x->parent = y;
-}
-
-
-/*     (x)                (Y)
-       / \                / \
-     (y)  c      ===>    a  (x)
-     / \                    / \
-    a   b                  b   c  */
-
-static void
-mem_rotate_right (struct mem_node *x)
-{
-  struct mem_node *y = x->left;
-
-  x->left = y->right;
-  if (y->right != MEM_NIL)
-    y->right->parent = x;
-
-  if (y != MEM_NIL)
-    y->parent = x->parent;
-  if (x->parent)
-    {
-      if (x == x->parent->right)
-	x->parent->right = y;
-      else
-	x->parent->left = y;
-    }
-  else
-    mem_root = y;
-
-  y->right = x;
-  if (x != MEM_NIL)
-    x->parent = y;
-}
-
-
-/* Delete node Z from the tree.  If Z is null or MEM_NIL, do nothing.  */
+/* Delete node Z from the table.  If Z is null or MEM_NIL, do
+   nothing.  */
 
 static void
 mem_delete (struct mem_node *z)
 {
-  struct mem_node *x, *y;
-
   if (!z || z == MEM_NIL)
     return;
 
-  if (z->left == MEM_NIL || z->right == MEM_NIL)
-    y = z;
-  else
-    {
-      y = z->right;
-      while (y->left != MEM_NIL)
-	y = y->left;
-    }
-
-  if (y->left != MEM_NIL)
-    x = y->left;
-  else
-    x = y->right;
-
-  x->parent = y->parent;
-  if (y->parent)
-    {
-      if (y == y->parent->left)
-	y->parent->left = x;
-      else
-	y->parent->right = x;
-    }
-  else
-    mem_root = x;
-
-  if (y != z)
+  for (ptrdiff_t i = 0; i < z->npages; i++)
     {
-      z->start = y->start;
-      z->end = y->end;
-      z->type = y->type;
+      struct mem_page *p = &z->pages[i];
+      struct mem_page **prev = &mem_page_table[mem_page_bucket (p->page)];
+      while (*prev != p)
+	prev = &(*prev)->next;
+      *prev = p->next;
     }
-
-  if (y->color == MEM_BLACK)
-    mem_delete_fixup (x);
+  mem_page_count -= z->npages;
 
 #ifdef GC_MALLOC_CHECK
-  free (y);
+  free (z);
 #else
-  xfree (y);
+  xfree (z);
 #endif
 }
 
 
-/* Re-establish the red-black properties of the tree, after a
-   deletion.  */
-
-static void
-mem_delete_fixup (struct mem_node *x)
-{
-  while (x != mem_root && x->color == MEM_BLACK)
-    {
-      if (x == x->parent->left)
-	{
-	  struct mem_node *w = x->parent->right;
-
-	  if (w->color == MEM_RED)
-	    {
-	      w->color = MEM_BLACK;
-	      x->parent->color = MEM_RED;
-	      mem_rotate_left (x->parent);
-	      w = x->parent->right;
-            }
-
-	  if (w->left->color == MEM_BLACK && w->right->color == MEM_BLACK)
-	    {
-	      w->color = MEM_RED;
-	      x = x->parent;
-            }
-	  else
-	    {
-	      if (w->right->color == MEM_BLACK)
-		{
-		  w->left->color = MEM_BLACK;
-		  w->color = MEM_RED;
-		  mem_rotate_right (w);
-		  w = x->parent->right;
-                }
-	      w->color = x->parent->color;
-	      x->parent->color = MEM_BLACK;
-	      w->right->color = MEM_BLACK;
-	      mem_rotate_left (x->parent);
-	      x = mem_root;
-            }
-        }
-      else
-	{
-	  struct mem_node *w = x->parent->left;
-
-	  if (w->color == MEM_RED)
-	    {
-	      w->color = MEM_BLACK;
-	      x->parent->color = MEM_RED;
-	      mem_rotate_right (x->parent);
-	      w = x->parent->left;
-            }
-
-	  if (w->right->color == MEM_BLACK && w->left->color == MEM_BLACK)
-	    {
-	      w->color = MEM_RED;
-	      x = x->parent;
-            }
-	  else
-	    {
-	      if (w->left->color == MEM_BLACK)
-		{
-		  w->right->color = MEM_BLACK;
-		  w->color = MEM_RED;
-		  mem_rotate_left (w);
-		  w = x->parent->left;
-                }
-
-	      w->color = x->parent->color;
-	      x->parent->color = MEM_BLACK;
-	      w->left->color = MEM_BLACK;
-	      mem_rotate_right (x->parent);
-	      x = mem_root;
-            }
-        }
-    }
-
-  x->color = MEM_BLACK;
-}
-
-
 /* Value is non-zero if P is a pointer to a live Lisp string on
    the heap.  M is a pointer to the mem_block for P.  */
 
@@ -5825,6 +5772,106 @@ mark_pinned_symbols (void)
     }
 }
 
+/* Switch the current GC phase to PHASE, charging the time since the
+   last switch to the phase being left.  */
+
+static void
+gc_enter_phase (enum gc_phase phase)
+{
+  struct timespec now = current_timespec ();
+  gc_phase_time[gc_current_phase]
+    += timespectod (timespec_sub (now, gc_phase_start));
+  gc_phase_start = now;
+  gc_current_phase = phase;
+}
+
+/* Store into BYTES the number of bytes allocated so far for each type
+   of object.  */
+
+static void
+gc_consed_bytes (EMACS_INT bytes[GC_TYPE_COUNT])
+{
+  bytes[GC_TYPE_CONSES] = cons_cells_consed * sizeof (struct Lisp_Cons);
+  bytes[GC_TYPE_FLOATS] = floats_consed * sizeof (struct Lisp_Float);
+  bytes[GC_TYPE_SYMBOLS] = symbols_consed * sizeof (struct Lisp_Symbol);
+  bytes[GC_TYPE_STRINGS] = (strings_consed * sizeof (struct Lisp_String)
+			    + string_chars_consed);
+  bytes[GC_TYPE_VECTORS] = vector_cells_consed * word_size;
+  bytes[GC_TYPE_INTERVALS] = intervals_consed * sizeof (struct interval);
+  bytes[GC_TYPE_MISCS] = misc_objects_consed * sizeof (union Lisp_Misc);
+}
+
+/* Store into BYTES the number of live bytes of each type of object,
+   as counted by the last sweep.  */
+
+static void
+gc_live_bytes (EMACS_INT bytes[GC_TYPE_COUNT])
+{
+  bytes[GC_TYPE_CONSES] = total_conses * sizeof (struct Lisp_Cons);
+  bytes[GC_TYPE_FLOATS] = total_floats * sizeof (struct Lisp_Float);
+  bytes[GC_TYPE_SYMBOLS] = total_symbols * sizeof (struct Lisp_Symbol);
+  bytes[GC_TYPE_STRINGS] = (total_strings * sizeof (struct Lisp_String)
+			    + total_string_bytes);
+  bytes[GC_TYPE_VECTORS] = total_vector_slots * word_size;
+  bytes[GC_TYPE_INTERVALS] = total_intervals * sizeof (struct interval);
+  bytes[GC_TYPE_MISCS] = total_markers * sizeof (union Lisp_Misc);
+}
+
+/* Add a record of the collection that began at START to the ring of
+   recent collections.  What was reclaimed is estimated as what was
+   live after the last collection plus what has been allocated since,
+   minus what is live now.  */
+
+static void
+gc_record_statistics (struct timespec start)
+{
+  struct gc_record *r = &gc_records[gc_records_count++ % GC_RECORDS_MAX];
+  EMACS_INT consed[GC_TYPE_COUNT], live[GC_TYPE_COUNT];
+  int i;
+
+  r->end = current_timespec ();
+  r->elapsed = timespectod (timespec_sub (r->end, start));
+  memcpy (r->phase_time, gc_phase_time, sizeof r->phase_time);
+
+  gc_consed_bytes (consed);
+  gc_live_bytes (live);
+  for (i = 0; i < GC_TYPE_COUNT; i++)
+    {
+      EMACS_INT reclaimed = (gc_last_live_bytes[i]
+			     + (consed[i] - gc_last_consed_bytes[i])
+			     - live[i]);
+      r->reclaimed[i] = max (reclaimed, 0);
+    }
+  memcpy (gc_last_consed_bytes, consed, sizeof consed);
+  memcpy (gc_last_live_bytes, live, sizeof live);
+}
+
+/* Return the symbol naming PHASE.  */
+
+Lisp_Object
+gc_phase_symbol (enum gc_phase phase)
+{
+  switch (phase)
+    {
+    case GC_PHASE_MARK: return Qgc_mark;
+    case GC_PHASE_MARK_STACK: return Qgc_mark_stack;
+    case GC_PHASE_FONT_CACHES: return Qgc_font_caches;
+    case GC_PHASE_UNDO_LISTS: return Qgc_undo_lists;
+    case GC_PHASE_FINALIZERS: return Qgc_finalizers;
+    case GC_PHASE_WEAK_TABLES: return Qgc_weak_tables;
+    case GC_PHASE_SWEEP_STRINGS: return Qgc_sweep_strings;
+    case GC_PHASE_COMPACT_STRINGS: return Qgc_compact_strings;
+    case GC_PHASE_SWEEP_CONSES_AND_FLOATS:
+      return Qgc_sweep_conses_and_floats;
+    case GC_PHASE_SWEEP_INTERVALS: return Qgc_sweep_intervals;
+    case GC_PHASE_SWEEP_SYMBOLS: return Qgc_sweep_symbols;
+    case GC_PHASE_SWEEP_MISCS: return Qgc_sweep_miscs;
+    case GC_PHASE_SWEEP_BUFFERS: return Qgc_sweep_buffers;
+    case GC_PHASE_SWEEP_VECTORS: return Qgc_sweep_vectors;
+    default: return Qgc_other;
+    }
+}
+
 /* Subroutine of Fgarbage_collect that does most of the work.  It is a
    separate function so that we could limit mark_stack in searching
    the stack frames below this function, thus avoiding the rare cases
@@ -5863,6 +5910,8 @@ garbage_collect_1 (void *end)
     tot_before = total_bytes_of_live_objects ();
 
   start = current_timespec ();
+  gc_phase_start = start;
+  memset (gc_phase_time, 0, sizeof gc_phase_time);
 
   /* In case user calls debug_print during GC,
      don't let that cause a recursive GC.  */
@@ -5915,6 +5964,7 @@ garbage_collect_1 (void *end)
   shrink_regexp_cache ();
 
   gc_in_progress = 1;
+  gc_enter_phase (GC_PHASE_MARK);
 
   /* Mark all the special slots that serve as the roots of accessibility.  */
 
@@ -5931,7 +5981,10 @@ garbage_collect_1 (void *end)
   mark_pinned_symbols ();
   mark_terminals ();
   mark_kboards ();
+  mark_regexp_cache ();
+  gc_enter_phase (GC_PHASE_MARK_STACK);
   mark_threads ();
+  gc_enter_phase (GC_PHASE_MARK);
 
 #ifdef USE_GTK
   xg_mark_data ();
@@ -5949,8 +6002,10 @@ garbage_collect_1 (void *end)
      undo lists, and finalizers.  The first two are compacted by
      removing an items which aren't reachable otherwise.  */
 
+  gc_enter_phase (GC_PHASE_FONT_CACHES);
   compact_font_caches ();
 
+  gc_enter_phase (GC_PHASE_UNDO_LISTS);
   FOR_EACH_BUFFER (nextb)
     {
       if (!EQ (BVAR (nextb, undo_list), Qt))
@@ -5967,6 +6022,7 @@ garbage_collect_1 (void *end)
      unreachable except for references from their associated functions
      and from other finalizers.  */
 
+  gc_enter_phase (GC_PHASE_FINALIZERS);
   queue_doomed_finalizers (&doomed_finalizers, &finalizers);
   mark_finalizer_list (&doomed_finalizers);
 
@@ -5982,6 +6038,11 @@ garbage_collect_1 (void *end)
 
   unblock_input ();
 
+  /* Record the phases now, since the finalizers and `post-gc-hook'
+     run below may themselves collect garbage.  */
+  gc_record_statistics (start);
+  allocation_record_survivors ();
+
   consing_since_gc = 0;
   if (gc_cons_threshold < GC_DEFAULT_THRESHOLD / 10)
     gc_cons_threshold = GC_DEFAULT_THRESHOLD / 10;
@@ -6012,18 +6073,22 @@ garbage_collect_1 (void *end)
   unbind_to (count, Qnil);
 
   Lisp_Object total[] = {
-    list4 (Qconses, make_number (sizeof (struct Lisp_Cons)),
-	   bounded_number (total_conses),
-	   bounded_number (total_free_conses)),
+    list (Qconses, make_number (sizeof (struct Lisp_Cons)),
+	  bounded_number (total_conses),
+	  bounded_number (total_free_conses),
+	  bounded_number (total_young_conses),
+	  bounded_number (total_young_free_conses)),
     list4 (Qsymbols, make_number (sizeof (struct Lisp_Symbol)),
 	   bounded_number (total_symbols),
 	   bounded_number (total_free_symbols)),
     list4 (Qmiscs, make_number (sizeof (union Lisp_Misc)),
 	   bounded_number (total_markers),
 	   bounded_number (total_free_markers)),
-    list4 (Qstrings, make_number (sizeof (struct Lisp_String)),
-	   bounded_number (total_strings),
-	   bounded_number (total_free_strings)),
+    list (Qstrings, make_number (sizeof (struct Lisp_String)),
+	  bounded_number (total_strings),
+	  bounded_number (total_free_strings),
+	  bounded_number (total_young_strings),
+	  bounded_number (total_young_free_strings)),
     list3 (Qstring_bytes, make_number (1),
 	   bounded_number (total_string_bytes)),
     list3 (Qvectors,
@@ -6032,9 +6097,11 @@ garbage_collect_1 (void *end)
     list4 (Qvector_slots, make_number (word_size),
 	   bounded_number (total_vector_slots),
 	   bounded_number (total_free_vector_slots)),
-    list4 (Qfloats, make_number (sizeof (struct Lisp_Float)),
-	   bounded_number (total_floats),
-	   bounded_number (total_free_floats)),
+    list (Qfloats, make_number (sizeof (struct Lisp_Float)),
+	  bounded_number (total_floats),
+	  bounded_number (total_free_floats),
+	  bounded_number (total_young_floats),
+	  bounded_number (total_young_free_floats)),
     list4 (Qintervals, make_number (sizeof (struct interval)),
 	   bounded_number (total_intervals),
 	   bounded_number (total_free_intervals)),
@@ -6060,12 +6127,9 @@ garbage_collect_1 (void *end)
     }
 
   /* Accumulate statistics.  */
+  gc_last_pause = timespectod (timespec_sub (current_timespec (), start));
   if (FLOATP (Vgc_elapsed))
-    {
-      struct timespec since_start = timespec_sub (current_timespec (), start);
-      Vgc_elapsed = make_float (XFLOAT_DATA (Vgc_elapsed)
-				+ timespectod (since_start));
-    }
+    Vgc_elapsed = make_float (XFLOAT_DATA (Vgc_elapsed) + gc_last_pause);
 
   gcs_done++;
 
@@ -6082,6 +6146,24 @@ garbage_collect_1 (void *end)
   return retval;
 }
 
+/* Return true if Emacs, being idle, should collect garbage now.
+   This is so when `gc-pause-budget' is a number, the last collection
+   took longer than that, and at least a quarter of the consing
+   allowed between collections has already been done.  Collecting at
+   this point keeps the next automatic collection, and its pause, from
+   landing in the middle of a command.  */
+
+bool
+gc_idle_collection_due_p (void)
+{
+  if (! NUMBERP (Vgc_pause_budget) || gc_in_progress
+      || gc_last_pause <= XFLOATINT (Vgc_pause_budget))
+    return false;
+
+  EMACS_INT threshold = max (gc_cons_threshold, gc_relative_threshold);
+  return consing_since_gc >= threshold / 4;
+}
+
 DEFUN ("garbage-collect", Fgarbage_collect, Sgarbage_collect, 0, 0, "",
        doc: /* Reclaim storage for Lisp objects no longer needed.
 Garbage collection happens automatically if you cons more than
@@ -6094,6 +6176,11 @@ DEFUN ("garbage-collect", Fgarbage_collect, Sgarbage_collect, 0, 0, "",
 - FREE is the number of those objects that are not live but that Emacs
   keeps around for future allocations (maybe because it does not know how
   to return them to the OS).
+The entries for conses, floats and strings have two more elements,
+YOUNG-USED and YOUNG-FREED: the number of objects of that kind
+allocated since the previous garbage collection that were found live,
+and that were reclaimed.  For strings, only strings of at most 1024
+bytes are counted there.
 However, if there was overflow in pure space, `garbage-collect'
 returns nil, because real GC can't be done.
 See Info node `(elisp)Garbage Collection'.  */)
@@ -6104,6 +6191,52 @@ DEFUN ("garbage-collect", Fgarbage_collect, Sgarbage_collect, 0, 0, "",
   return garbage_collect_1 (end);
 }
 
+DEFUN ("gc-statistics", Fgc_statistics, Sgc_statistics, 0, 0, 0,
+       doc: /* Return statistics about the most recent garbage collections.
+The value is a list with an element for each of the last 64 collections,
+most recent first.  Each element has the form
+  (TIME ELAPSED PHASES RECLAIMED)
+where TIME is when the collection finished, as a Lisp timestamp, and
+ELAPSED is its duration in seconds, not counting finalizers and
+`post-gc-hook'.  PHASES is an alist of (PHASE . SECONDS) giving the time
+spent in each phase of the collection, such as `gc-mark' or
+`gc-sweep-strings'; `gc-other' is time not covered by any other phase.
+RECLAIMED is an alist of (TYPE . BYTES) giving the approximate number
+of bytes freed for each type of object, such as `conses' or `strings'.  */)
+  (void)
+{
+  Lisp_Object result = Qnil;
+  EMACS_INT n = min (gc_records_count, GC_RECORDS_MAX);
+
+  /* Walk the ring oldest first, so that consing the result puts the
+     most recent collection first.  */
+  for (EMACS_INT i = gc_records_count - n; i < gc_records_count; i++)
+    {
+      struct gc_record *r = &gc_records[i % GC_RECORDS_MAX];
+      Lisp_Object phases = Qnil;
+      for (int phase = GC_PHASE_COUNT - 1; 0 <= phase; phase--)
+	phases = Fcons (Fcons (gc_phase_symbol (phase),
+			       make_float (r->phase_time[phase])),
+			phases);
+      Lisp_Object reclaimed
+	= list (Fcons (Qconses, bounded_number (r->reclaimed[GC_TYPE_CONSES])),
+		Fcons (Qfloats, bounded_number (r->reclaimed[GC_TYPE_FLOATS])),
+		Fcons (Qsymbols,
+		       bounded_number (r->reclaimed[GC_TYPE_SYMBOLS])),
+		Fcons (Qstrings,
+		       bounded_number (r->reclaimed[GC_TYPE_STRINGS])),
+		Fcons (Qvectors,
+		       bounded_number (r->reclaimed[GC_TYPE_VECTORS])),
+		Fcons (Qintervals,
+		       bounded_number (r->reclaimed[GC_TYPE_INTERVALS])),
+		Fcons (Qmiscs, bounded_number (r->reclaimed[GC_TYPE_MISCS])));
+      result = Fcons (list4 (make_lisp_time (r->end), make_float (r->elapsed),
+			     phases, reclaimed),
+		      result);
+    }
+  return result;
+}
+
 /* Mark Lisp objects in glyph matrix MATRIX.  Currently the
    only interesting objects referenced from glyphs are strings.  */
 
@@ -6205,21 +6338,30 @@ mark_compiled (struct Lisp_Vector *ptr)
   return size > COMPILED_CONSTANTS ? ptr->contents[COMPILED_CONSTANTS] : Qnil;
 }
 
-/* Mark the chain of overlays starting at PTR.  */
+/* Mark the overlay PTR.  */
 
 static void
 mark_overlay (struct Lisp_Overlay *ptr)
 {
-  for (; ptr && !ptr->gcmarkbit; ptr = ptr->next)
+  if (!ptr->gcmarkbit)
     {
       ptr->gcmarkbit = 1;
-      /* These two are always markers and can be marked fast.  */
-      XMARKER (ptr->start)->gcmarkbit = 1;
-      XMARKER (ptr->end)->gcmarkbit = 1;
       mark_object (ptr->plist);
     }
 }
 
+/* Mark the overlays in the subtree of NODE.  */
+
+static void
+mark_overlays (struct itree_node *node)
+{
+  for (; node; node = node->right)
+    {
+      mark_overlay (XOVERLAY (node->data));
+      mark_overlays (node->left);
+    }
+}
+
 /* Mark Lisp_Objects and special pointers in BUFFER.  */
 
 static void
@@ -6236,8 +6378,8 @@ mark_buffer (struct buffer *buffer)
      a special way just before the sweep phase, and after stripping
      some of its elements that are not needed any more.  */
 
-  mark_overlay (buffer->overlays_before);
-  mark_overlay (buffer->overlays_after);
+  if (buffer->overlays)
+    mark_overlays (buffer->overlays->root);
 
   /* If this is an indirect buffer, mark its base buffer.  */
   if (buffer->base_buffer && !VECTOR_MARKED_P (buffer->base_buffer))
@@ -6754,22 +6896,185 @@ survives_gc_p (Lisp_Object obj)
 
 
 
-NO_INLINE /* For better stack traces */
+/* Cons and float blocks are swept in parallel.  The lists of blocks
+   are cut into ranges, and each range is swept by the main thread or
+   by one of `gc-sweep-threads' helper threads, building a free list
+   of its own.  Sweeping a range touches nothing but the blocks in it,
+   so this is safe; blocks that become empty are not freed by the
+   helpers, though, since lisp_align_free is not thread-safe, but
+   handed back to the main thread, which also splices the free lists
+   and block lists of the ranges together.
+
+   A serial sweep keeps an empty block as long as it has seen at most
+   one block's worth of free objects before it.  A range cannot know
+   how many free objects the ranges before it have, so it frees an
+   empty block only if its own count already exceeds the bound, and
+   leaves the decision about the first two others, the only ones that
+   can be kept, to the main thread.  */
+
+/* Maximum number of ranges per object type.  */
+enum { SWEEP_TASKS_MAX = 64 };
+
+/* Minimum number of blocks in a range.  Smaller ranges are not worth
+   the synchronization.  */
+enum { SWEEP_TASK_MIN_BLOCKS = 64 };
+
+struct sweep_task
+{
+  /* Function that sweeps this range.  */
+  void (*sweep) (struct sweep_task *);
+
+  /* First block of the range.  The NEXT pointer of its last block is
+     null.  */
+  void *blocks;
+
+  /* Number of objects allocated from the first block.  */
+  int lim;
+
+  /* Blocks still in use after the sweep, in order, and the last one.  */
+  void *live, *live_tail;
+
+  /* Blocks that the main thread should free.  */
+  void *dead;
+
+  /* Empty blocks still in LIVE whose objects are not on FREE_LIST,
+     which the main thread keeps or frees, and the number of free
+     objects in the range before each of them.  */
+  void *maybe_dead[2];
+  EMACS_INT maybe_dead_free[2];
+  int nmaybe_dead;
+
+  /* Free list of the range, and its last element.  */
+  void *free_list, *free_tail;
+
+  EMACS_INT num_used, num_free, young_used, young_free;
+};
+
+/* State shared with the helper threads, protected by SWEEP_MUTEX.
+   The helpers take tasks from SWEEP_TASKS until SWEEP_NEXT_TASK
+   reaches SWEEP_NTASKS; SWEEP_PENDING counts tasks not yet done.  */
+
+static sys_mutex_t sweep_mutex;
+static sys_cond_t sweep_work_cond, sweep_done_cond;
+static struct sweep_task *sweep_tasks;
+static int sweep_ntasks, sweep_next_task, sweep_pending;
+
+/* Number of helper threads running, and whether starting one failed.  */
+static int sweep_helpers;
+static bool sweep_helpers_failed;
+
+/* Run the tasks given to the helpers until there are none left.
+   SWEEP_MUTEX must be locked.  */
+
 static void
-sweep_conses (void)
+run_pending_sweep_tasks (void)
 {
-  struct cons_block *cblk;
-  struct cons_block **cprev = &cons_block;
-  int lim = cons_block_index;
-  EMACS_INT num_free = 0, num_used = 0;
+  while (sweep_next_task < sweep_ntasks)
+    {
+      struct sweep_task *t = &sweep_tasks[sweep_next_task++];
+      sys_mutex_unlock (&sweep_mutex);
+      t->sweep (t);
+      sys_mutex_lock (&sweep_mutex);
+      if (--sweep_pending == 0)
+	sys_cond_signal (&sweep_done_cond);
+    }
+}
 
-  cons_free_list = 0;
+static void *
+sweep_helper (void *arg)
+{
+  sys_thread_set_name ("emacs-gc-sweep");
+  sys_mutex_lock (&sweep_mutex);
+  while (true)
+    {
+      while (sweep_next_task == sweep_ntasks)
+	sys_cond_wait (&sweep_work_cond, &sweep_mutex);
+      run_pending_sweep_tasks ();
+    }
+  return NULL;
+}
+
+/* Run the NTASKS tasks in TASKS, using helper threads if there are
+   several tasks and `gc-sweep-threads' asks for helpers.  */
 
-  for (cblk = cons_block; cblk; cblk = *cprev)
+static void
+run_sweep_tasks (struct sweep_task *tasks, int ntasks)
+{
+  int nhelpers = clip_to_bounds (0, gc_sweep_threads, SWEEP_TASKS_MAX - 1);
+
+  if (initialized && ntasks > 1 && !sweep_helpers_failed)
+    {
+      if (sweep_helpers == 0 && 0 < nhelpers)
+	{
+	  sys_mutex_init (&sweep_mutex);
+	  sys_cond_init (&sweep_work_cond);
+	  sys_cond_init (&sweep_done_cond);
+	}
+      while (sweep_helpers < nhelpers)
+	{
+	  sys_thread_t thread;
+	  if (!sys_thread_create (&thread, sweep_helper, NULL))
+	    {
+	      sweep_helpers_failed = true;
+	      break;
+	    }
+	  sweep_helpers++;
+	}
+    }
+
+  if (ntasks <= 1 || sweep_helpers == 0 || nhelpers == 0)
+    {
+      for (int i = 0; i < ntasks; i++)
+	tasks[i].sweep (&tasks[i]);
+      return;
+    }
+
+  sys_mutex_lock (&sweep_mutex);
+  sweep_tasks = tasks;
+  sweep_ntasks = ntasks;
+  sweep_next_task = 0;
+  sweep_pending = ntasks;
+  sys_cond_broadcast (&sweep_work_cond);
+  run_pending_sweep_tasks ();
+  while (sweep_pending != 0)
+    sys_cond_wait (&sweep_done_cond, &sweep_mutex);
+  sweep_tasks = NULL;
+  sweep_ntasks = sweep_next_task = 0;
+  sys_mutex_unlock (&sweep_mutex);
+}
+
+/* Return the number of ranges into which to cut a list of NBLOCKS
+   blocks.  */
+
+static int
+sweep_task_count (ptrdiff_t nblocks)
+{
+  ptrdiff_t nthreads = 1 + clip_to_bounds (0, gc_sweep_threads,
+					   SWEEP_TASKS_MAX - 1);
+  return clip_to_bounds (1, min (nthreads,
+				 nblocks / SWEEP_TASK_MIN_BLOCKS),
+			 SWEEP_TASKS_MAX);
+}
+
+/* Sweep the range of cons blocks described by T.  */
+
+static void
+sweep_cons_range (struct sweep_task *t)
+{
+  struct cons_block *cblk, *next;
+  struct cons_block *live = NULL, *live_tail = NULL, *dead = NULL;
+  struct Lisp_Cons *free_list = NULL, *free_tail = NULL;
+  int lim = t->lim;
+  EMACS_INT num_free = 0, num_used = 0;
+  EMACS_INT young_free = 0, young_used = 0;
+
+  t->nmaybe_dead = 0;
+  for (cblk = t->blocks; cblk; cblk = next)
     {
       int i = 0;
       int this_free = 0;
       int ilim = (lim + BITS_PER_BITS_WORD - 1) / BITS_PER_BITS_WORD;
+      struct Lisp_Cons *free_list_before = free_list;
 
       /* Scan the mark bits an int at a time.  */
       for (i = 0; i < ilim; i++)
@@ -6779,6 +7084,9 @@ sweep_conses (void)
               /* Fast path - all cons cells for this int are marked.  */
               cblk->gcmarkbits[i] = 0;
               num_used += BITS_PER_BITS_WORD;
+              for (bits_word young = cblk->youngbits[i]; young;
+                   young &= young - 1)
+                young_used++;
             }
           else
             {
@@ -6796,87 +7104,396 @@ sweep_conses (void)
                 {
                   if (!CONS_MARKED_P (&cblk->conses[pos]))
                     {
+                      young_free += CONS_YOUNG_P (&cblk->conses[pos]);
                       this_free++;
-                      cblk->conses[pos].u.chain = cons_free_list;
-                      cons_free_list = &cblk->conses[pos];
-                      cons_free_list->car = Vdead;
+                      if (!free_list)
+                        free_tail = &cblk->conses[pos];
+                      cblk->conses[pos].u.chain = free_list;
+                      free_list = &cblk->conses[pos];
+                      free_list->car = Vdead;
                     }
                   else
                     {
+                      young_used += CONS_YOUNG_P (&cblk->conses[pos]);
                       num_used++;
                       CONS_UNMARK (&cblk->conses[pos]);
                     }
                 }
             }
+          cblk->youngbits[i] = 0;
         }
 
+      next = cblk->next;
       lim = CONS_BLOCK_SIZE;
       /* If this block contains only free conses and we have already
          seen more than two blocks worth of free conses then deallocate
-         this block.  */
-      if (this_free == CONS_BLOCK_SIZE && num_free > CONS_BLOCK_SIZE)
+         this block.  Otherwise, whether to keep it depends on the
+         ranges before this one; see merge_cons_ranges.  */
+      if (this_free == CONS_BLOCK_SIZE)
         {
-          *cprev = cblk->next;
           /* Unhook from the free list.  */
-          cons_free_list = cblk->conses[0].u.chain;
-          lisp_align_free (cblk);
+          free_list = free_list_before;
+          if (!free_list)
+            free_tail = NULL;
+        }
+      if (this_free == CONS_BLOCK_SIZE
+          && (num_free > CONS_BLOCK_SIZE
+              || t->nmaybe_dead == ARRAYELTS (t->maybe_dead)))
+        {
+          cblk->next = dead;
+          dead = cblk;
         }
       else
         {
-          num_free += this_free;
-          cprev = &cblk->next;
+          if (this_free == CONS_BLOCK_SIZE)
+            {
+              t->maybe_dead[t->nmaybe_dead] = cblk;
+              t->maybe_dead_free[t->nmaybe_dead++] = num_free;
+            }
+          else
+            num_free += this_free;
+          cblk->next = NULL;
+          if (live_tail)
+            live_tail->next = cblk;
+          else
+            live = cblk;
+          live_tail = cblk;
         }
     }
+
+  t->live = live;
+  t->live_tail = live_tail;
+  t->dead = dead;
+  t->free_list = free_list;
+  t->free_tail = free_tail;
+  t->num_used = num_used;
+  t->num_free = num_free;
+  t->young_used = young_used;
+  t->young_free = young_free;
+}
+
+/* Cut the cons blocks into ranges, and describe them in TASKS.
+   Return the number of ranges.  */
+
+static int
+split_cons_blocks (struct sweep_task *tasks)
+{
+  ptrdiff_t nblocks = 0;
+  for (struct cons_block *cblk = cons_block; cblk; cblk = cblk->next)
+    nblocks++;
+
+  int ntasks = sweep_task_count (nblocks);
+  ptrdiff_t per_task = (nblocks + ntasks - 1) / ntasks;
+  struct cons_block *cblk = cons_block;
+
+  for (int i = 0; i < ntasks; i++)
+    {
+      tasks[i].sweep = sweep_cons_range;
+      tasks[i].blocks = cblk;
+      tasks[i].lim = i == 0 ? cons_block_index : CONS_BLOCK_SIZE;
+      for (ptrdiff_t n = 1; cblk && n < per_task; n++)
+	cblk = cblk->next;
+      if (cblk)
+	{
+	  struct cons_block *next = cblk->next;
+	  cblk->next = NULL;
+	  cblk = next;
+	}
+    }
+
+  return ntasks;
+}
+
+/* Put the cons blocks and free lists of the NTASKS ranges swept by
+   TASKS back together.  */
+
+static void
+merge_cons_ranges (struct sweep_task *tasks, int ntasks)
+{
+  struct cons_block **cprev = &cons_block;
+  struct Lisp_Cons **fprev = &cons_free_list;
+  EMACS_INT num_free = 0, num_used = 0;
+  EMACS_INT young_free = 0, young_used = 0;
+
+  for (int i = 0; i < ntasks; i++)
+    {
+      struct sweep_task *t = &tasks[i];
+      struct cons_block *dead = t->dead;
+      EMACS_INT kept = 0;
+
+      /* Keep the empty blocks that a serial sweep would keep, and
+         put their conses on the free list, in front of those of the
+         range; a serial sweep has seen NUM_FREE free conses before
+         the range.  */
+      for (int j = 0; j < t->nmaybe_dead; j++)
+	{
+	  struct cons_block *blk = t->maybe_dead[j];
+	  if (num_free + t->maybe_dead_free[j] + kept <= CONS_BLOCK_SIZE)
+	    {
+	      /* The conses were put on the free list in order, each
+		 in front of the previous one.  */
+	      *fprev = &blk->conses[CONS_BLOCK_SIZE - 1];
+	      fprev = &blk->conses[0].u.chain;
+	      kept += CONS_BLOCK_SIZE;
+	    }
+	  else
+	    {
+	      struct cons_block *prev_blk = NULL, *b;
+	      for (b = t->live; b != blk; b = b->next)
+		prev_blk = b;
+	      if (prev_blk)
+		prev_blk->next = blk->next;
+	      else
+		t->live = blk->next;
+	      if (t->live_tail == blk)
+		t->live_tail = prev_blk;
+	      blk->next = dead;
+	      dead = blk;
+	    }
+	}
+      num_free += kept;
+
+      if (t->live)
+	{
+	  *cprev = t->live;
+	  cprev = &((struct cons_block *) t->live_tail)->next;
+	}
+      if (t->free_list)
+	{
+	  *fprev = t->free_list;
+	  fprev = &((struct Lisp_Cons *) t->free_tail)->u.chain;
+	}
+      while (dead)
+	{
+	  struct cons_block *next = dead->next;
+	  lisp_align_free (dead);
+	  dead = next;
+	}
+      num_used += t->num_used;
+      num_free += t->num_free;
+      young_used += t->young_used;
+      young_free += t->young_free;
+    }
+  *cprev = NULL;
+  *fprev = NULL;
+
   total_conses = num_used;
   total_free_conses = num_free;
+  total_young_conses = young_used;
+  total_young_free_conses = young_free;
 }
 
-NO_INLINE /* For better stack traces */
+/* Sweep the range of float blocks described by T.  */
+
 static void
-sweep_floats (void)
+sweep_float_range (struct sweep_task *t)
 {
-  register struct float_block *fblk;
-  struct float_block **fprev = &float_block;
-  register int lim = float_block_index;
+  struct float_block *fblk, *next;
+  struct float_block *live = NULL, *live_tail = NULL, *dead = NULL;
+  struct Lisp_Float *free_list = NULL, *free_tail = NULL;
+  int lim = t->lim;
   EMACS_INT num_free = 0, num_used = 0;
+  EMACS_INT young_free = 0, young_used = 0;
 
-  float_free_list = 0;
-
-  for (fblk = float_block; fblk; fblk = *fprev)
+  t->nmaybe_dead = 0;
+  for (fblk = t->blocks; fblk; fblk = next)
     {
-      register int i;
+      int i;
       int this_free = 0;
+      struct Lisp_Float *free_list_before = free_list;
+
       for (i = 0; i < lim; i++)
         if (!FLOAT_MARKED_P (&fblk->floats[i]))
           {
+            young_free += FLOAT_YOUNG_P (&fblk->floats[i]);
             this_free++;
-            fblk->floats[i].u.chain = float_free_list;
-            float_free_list = &fblk->floats[i];
+            if (!free_list)
+              free_tail = &fblk->floats[i];
+            fblk->floats[i].u.chain = free_list;
+            free_list = &fblk->floats[i];
           }
         else
           {
+            young_used += FLOAT_YOUNG_P (&fblk->floats[i]);
             num_used++;
             FLOAT_UNMARK (&fblk->floats[i]);
           }
+      memset (fblk->youngbits, 0, sizeof fblk->youngbits);
+
+      next = fblk->next;
       lim = FLOAT_BLOCK_SIZE;
       /* If this block contains only free floats and we have already
          seen more than two blocks worth of free floats then deallocate
-         this block.  */
-      if (this_free == FLOAT_BLOCK_SIZE && num_free > FLOAT_BLOCK_SIZE)
+         this block.  Otherwise, whether to keep it depends on the
+         ranges before this one; see merge_float_ranges.  */
+      if (this_free == FLOAT_BLOCK_SIZE)
         {
-          *fprev = fblk->next;
           /* Unhook from the free list.  */
-          float_free_list = fblk->floats[0].u.chain;
-          lisp_align_free (fblk);
+          free_list = free_list_before;
+          if (!free_list)
+            free_tail = NULL;
+        }
+      if (this_free == FLOAT_BLOCK_SIZE
+          && (num_free > FLOAT_BLOCK_SIZE
+              || t->nmaybe_dead == ARRAYELTS (t->maybe_dead)))
+        {
+          fblk->next = dead;
+          dead = fblk;
         }
       else
         {
-          num_free += this_free;
-          fprev = &fblk->next;
+          if (this_free == FLOAT_BLOCK_SIZE)
+            {
+              t->maybe_dead[t->nmaybe_dead] = fblk;
+              t->maybe_dead_free[t->nmaybe_dead++] = num_free;
+            }
+          else
+            num_free += this_free;
+          fblk->next = NULL;
+          if (live_tail)
+            live_tail->next = fblk;
+          else
+            live = fblk;
+          live_tail = fblk;
         }
     }
+
+  t->live = live;
+  t->live_tail = live_tail;
+  t->dead = dead;
+  t->free_list = free_list;
+  t->free_tail = free_tail;
+  t->num_used = num_used;
+  t->num_free = num_free;
+  t->young_used = young_used;
+  t->young_free = young_free;
+}
+
+/* Cut the float blocks into ranges, and describe them in TASKS.
+   Return the number of ranges.  */
+
+static int
+split_float_blocks (struct sweep_task *tasks)
+{
+  ptrdiff_t nblocks = 0;
+  for (struct float_block *fblk = float_block; fblk; fblk = fblk->next)
+    nblocks++;
+
+  int ntasks = sweep_task_count (nblocks);
+  ptrdiff_t per_task = (nblocks + ntasks - 1) / ntasks;
+  struct float_block *fblk = float_block;
+
+  for (int i = 0; i < ntasks; i++)
+    {
+      tasks[i].sweep = sweep_float_range;
+      tasks[i].blocks = fblk;
+      tasks[i].lim = i == 0 ? float_block_index : FLOAT_BLOCK_SIZE;
+      for (ptrdiff_t n = 1; fblk && n < per_task; n++)
+	fblk = fblk->next;
+      if (fblk)
+	{
+	  struct float_block *next = fblk->next;
+	  fblk->next = NULL;
+	  fblk = next;
+	}
+    }
+
+  return ntasks;
+}
+
+/* Put the float blocks and free lists of the NTASKS ranges swept by
+   TASKS back together.  */
+
+static void
+merge_float_ranges (struct sweep_task *tasks, int ntasks)
+{
+  struct float_block **fbprev = &float_block;
+  struct Lisp_Float **fprev = &float_free_list;
+  EMACS_INT num_free = 0, num_used = 0;
+  EMACS_INT young_free = 0, young_used = 0;
+
+  for (int i = 0; i < ntasks; i++)
+    {
+      struct sweep_task *t = &tasks[i];
+      struct float_block *dead = t->dead;
+      EMACS_INT kept = 0;
+
+      /* Keep the empty blocks that a serial sweep would keep, and
+         put their floats on the free list, in front of those of the
+         range; a serial sweep has seen NUM_FREE free floats before
+         the range.  */
+      for (int j = 0; j < t->nmaybe_dead; j++)
+	{
+	  struct float_block *blk = t->maybe_dead[j];
+	  if (num_free + t->maybe_dead_free[j] + kept <= FLOAT_BLOCK_SIZE)
+	    {
+	      /* The floats were put on the free list in order, each
+		 in front of the previous one.  */
+	      *fprev = &blk->floats[FLOAT_BLOCK_SIZE - 1];
+	      fprev = &blk->floats[0].u.chain;
+	      kept += FLOAT_BLOCK_SIZE;
+	    }
+	  else
+	    {
+	      struct float_block *prev_blk = NULL, *b;
+	      for (b = t->live; b != blk; b = b->next)
+		prev_blk = b;
+	      if (prev_blk)
+		prev_blk->next = blk->next;
+	      else
+		t->live = blk->next;
+	      if (t->live_tail == blk)
+		t->live_tail = prev_blk;
+	      blk->next = dead;
+	      dead = blk;
+	    }
+	}
+      num_free += kept;
+
+      if (t->live)
+	{
+	  *fbprev = t->live;
+	  fbprev = &((struct float_block *) t->live_tail)->next;
+	}
+      if (t->free_list)
+	{
+	  *fprev = t->free_list;
+	  fprev = &((struct Lisp_Float *) t->free_tail)->u.chain;
+	}
+      while (dead)
+	{
+	  struct float_block *next = dead->next;
+	  lisp_align_free (dead);
+	  dead = next;
+	}
+      num_used += t->num_used;
+      num_free += t->num_free;
+      young_used += t->young_used;
+      young_free += t->young_free;
+    }
+  *fbprev = NULL;
+  *fprev = NULL;
+
   total_floats = num_used;
   total_free_floats = num_free;
+  total_young_floats = young_used;
+  total_young_free_floats = young_free;
+}
+
+/* Sweep the cons and float blocks.  */
+
+NO_INLINE /* For better stack traces */
+static void
+sweep_conses_and_floats (void)
+{
+  struct sweep_task tasks[2 * SWEEP_TASKS_MAX];
+  int nconses = split_cons_blocks (tasks);
+  int nfloats = split_float_blocks (tasks + nconses);
+
+  run_sweep_tasks (tasks, nconses + nfloats);
+
+  merge_cons_ranges (tasks, nconses);
+  merge_float_ranges (tasks + nconses, nfloats);
 }
 
 NO_INLINE /* For better stack traces */
@@ -7018,6 +7635,8 @@ sweep_misc (void)
                 unchain_marker (&mblk->markers[i].m.u_marker);
               else if (mblk->markers[i].m.u_any.type == Lisp_Misc_Finalizer)
                 unchain_finalizer (&mblk->markers[i].m.u_finalizer);
+              else if (mblk->markers[i].m.u_any.type == Lisp_Misc_Overlay)
+                xfree (mblk->markers[i].m.u_overlay.interval);
 #ifdef HAVE_MODULES
 	      else if (mblk->markers[i].m.u_any.type == Lisp_Misc_User_Ptr)
 		{
@@ -7091,18 +7710,33 @@ gc_sweep (void)
 {
   /* Remove or mark entries in weak hash tables.
      This must be done before any object is unmarked.  */
+  gc_enter_phase (GC_PHASE_WEAK_TABLES);
   sweep_weak_hash_tables ();
 
+  /* Likewise for noting which objects sampled by the allocation
+     profiler survive.  */
+  allocation_check_survivors ();
+
+  /* And for strings in the cache of string positions.  */
+  sweep_string_char_byte_cache ();
+
+  gc_enter_phase (GC_PHASE_SWEEP_STRINGS);
   sweep_strings ();
   check_string_bytes (!noninteractive);
-  sweep_conses ();
-  sweep_floats ();
+  gc_enter_phase (GC_PHASE_SWEEP_CONSES_AND_FLOATS);
+  sweep_conses_and_floats ();
+  gc_enter_phase (GC_PHASE_SWEEP_INTERVALS);
   sweep_intervals ();
+  gc_enter_phase (GC_PHASE_SWEEP_SYMBOLS);
   sweep_symbols ();
+  gc_enter_phase (GC_PHASE_SWEEP_MISCS);
   sweep_misc ();
+  gc_enter_phase (GC_PHASE_SWEEP_BUFFERS);
   sweep_buffers ();
+  gc_enter_phase (GC_PHASE_SWEEP_VECTORS);
   sweep_vectors ();
   check_string_bytes (!noninteractive);
+  gc_enter_phase (GC_PHASE_NONE);
 }
 
 DEFUN ("memory-info", Fmemory_info, Smemory_info, 0, 0, 0,
@@ -7435,6 +8069,23 @@ syms_of_alloc (void)
 If this portion is smaller than `gc-cons-threshold', this is ignored.  */);
   Vgc_cons_percentage = make_float (0.1);
 
+  DEFVAR_LISP ("gc-pause-budget", Vgc_pause_budget,
+	       doc: /* Longest garbage collection pause, in seconds, to allow while typing.
+If nil, garbage collection happens only when `gc-cons-threshold' or
+`gc-cons-percentage' says it must.  If a number, and the previous
+collection took longer than this many seconds, Emacs collects garbage
+ahead of time whenever it has been idle for a second with at least a
+quarter of `gc-cons-threshold' already consed, so that the collection
+does not interrupt a later command.  */);
+  Vgc_pause_budget = Qnil;
+
+  DEFVAR_INT ("gc-sweep-threads", gc_sweep_threads,
+	      doc: /* Number of helper threads to use for freeing garbage.
+When a garbage collection finds many blocks of conses and floats, it
+splits them into ranges that this many threads sweep in parallel with
+the main thread.  Zero means to do all the work in the main thread.  */);
+  gc_sweep_threads = 0;
+
   DEFVAR_INT ("pure-bytes-used", pure_bytes_used,
 	      doc: /* Number of bytes of shareable Lisp data allocated so far.  */);
 
@@ -7499,11 +8150,27 @@ syms_of_alloc (void)
   DEFSYM (Qvectors, "vectors");
   DEFSYM (Qfloats, "floats");
   DEFSYM (Qintervals, "intervals");
+  DEFSYM (Qinterval, "interval");
   DEFSYM (Qbuffers, "buffers");
   DEFSYM (Qstring_bytes, "string-bytes");
   DEFSYM (Qvector_slots, "vector-slots");
   DEFSYM (Qheap, "heap");
   DEFSYM (QAutomatic_GC, "Automatic GC");
+  DEFSYM (Qgc_other, "gc-other");
+  DEFSYM (Qgc_mark, "gc-mark");
+  DEFSYM (Qgc_mark_stack, "gc-mark-stack");
+  DEFSYM (Qgc_font_caches, "gc-font-caches");
+  DEFSYM (Qgc_undo_lists, "gc-undo-lists");
+  DEFSYM (Qgc_finalizers, "gc-finalizers");
+  DEFSYM (Qgc_weak_tables, "gc-weak-tables");
+  DEFSYM (Qgc_sweep_strings, "gc-sweep-strings");
+  DEFSYM (Qgc_compact_strings, "gc-compact-strings");
+  DEFSYM (Qgc_sweep_conses_and_floats, "gc-sweep-conses-and-floats");
+  DEFSYM (Qgc_sweep_intervals, "gc-sweep-intervals");
+  DEFSYM (Qgc_sweep_symbols, "gc-sweep-symbols");
+  DEFSYM (Qgc_sweep_miscs, "gc-sweep-miscs");
+  DEFSYM (Qgc_sweep_buffers, "gc-sweep-buffers");
+  DEFSYM (Qgc_sweep_vectors, "gc-sweep-vectors");
 
   DEFSYM (Qgc_cons_threshold, "gc-cons-threshold");
   DEFSYM (Qchar_table_extra_slots, "char-table-extra-slots");
@@ -7530,6 +8197,7 @@ syms_of_alloc (void)
   defsubr (&Smake_finalizer);
   defsubr (&Spurecopy);
   defsubr (&Sgarbage_collect);
+  defsubr (&Sgc_statistics);
   defsubr (&Smemory_limit);
   defsubr (&Smemory_info);
   defsubr (&Smemory_use_counts);
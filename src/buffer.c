@@ -28,6 +28,14 @@ Copyright (C) 1985-1989, 1993-1995, 1997-2020 Free Software Foundation,
 #include <stdlib.h>
 #include <unistd.h>
 
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+/* Old versions of macOS only define MAP_ANON, not MAP_ANONYMOUS.  */
+# if !defined MAP_ANONYMOUS && defined MAP_ANON
+#  define MAP_ANONYMOUS MAP_ANON
+# endif
+#endif
+
 #include <verify.h>
 
 #include "lisp.h"
@@ -116,7 +124,7 @@ #define OVERLAY_COUNT_MAX						\
 
 static void alloc_buffer_text (struct buffer *, ptrdiff_t);
 static void free_buffer_text (struct buffer *b);
-static struct Lisp_Overlay * copy_overlays (struct buffer *, struct Lisp_Overlay *);
+static void copy_overlays (struct buffer *, struct buffer *);
 static void modify_overlay (struct buffer *, ptrdiff_t, ptrdiff_t);
 static Lisp_Object buffer_lisp_local_variables (struct buffer *, bool);
 static Lisp_Object buffer_local_variables_1 (struct buffer *buf, int offset, Lisp_Object sym);
@@ -578,6 +586,9 @@ DEFUN ("get-buffer-create", Fget_buffer_create, Sget_buffer_create, 1, 1, 0,
   BUF_SAVE_MODIFF (b) = 1;
   BUF_COMPACT (b) = 1;
   set_buffer_intervals (b, NULL);
+  b->text->charpos_index = NULL;
+  b->text->line_index = NULL;
+  b->text->mapped_size = 0;
   BUF_UNCHANGED_MODIFIED (b) = 1;
   BUF_OVERLAY_UNCHANGED_MODIFIED (b) = 1;
   BUF_END_UNCHANGED (b) = 0;
@@ -626,51 +637,99 @@ DEFUN ("get-buffer-create", Fget_buffer_create, Sget_buffer_create, 1, 1, 0,
 }
 
 
-/* Return a list of overlays which is a copy of the overlay list
-   LIST, but for buffer B.  */
+/* Add OV, which must not be in any buffer, to the overlays of B as
+   running from BEGIN to END.  */
+
+static void
+add_buffer_overlay (struct buffer *b, struct Lisp_Overlay *ov,
+		    ptrdiff_t begin, ptrdiff_t end)
+{
+  eassert (!ov->buffer);
+  if (!b->overlays)
+    {
+      b->overlays = xmalloc (sizeof *b->overlays);
+      itree_init (b->overlays);
+    }
+  itree_insert (b->overlays, ov->interval, begin, end);
+  ov->buffer = b;
+}
+
+/* Remove OV from the overlays of its buffer.  */
 
-static struct Lisp_Overlay *
-copy_overlays (struct buffer *b, struct Lisp_Overlay *list)
+static void
+remove_buffer_overlay (struct Lisp_Overlay *ov)
 {
-  struct Lisp_Overlay *result = NULL, *tail = NULL;
+  eassert (ov->buffer && ov->buffer->overlays);
+  itree_remove (ov->buffer->overlays, ov->interval);
+  ov->buffer = NULL;
+}
 
-  for (; list; list = list->next)
+/* Mark the overlays in the subtree of NODE as not being in any buffer,
+   and unlink their nodes from each other.  */
+
+static void
+drop_overlay_nodes (struct itree_node *node)
+{
+  while (node)
     {
-      Lisp_Object overlay, start, end;
-      struct Lisp_Marker *m;
-
-      eassert (MARKERP (list->start));
-      m = XMARKER (list->start);
-      start = build_marker (b, m->charpos, m->bytepos);
-      XMARKER (start)->insertion_type = m->insertion_type;
-
-      eassert (MARKERP (list->end));
-      m = XMARKER (list->end);
-      end = build_marker (b, m->charpos, m->bytepos);
-      XMARKER (end)->insertion_type = m->insertion_type;
-
-      overlay = build_overlay (start, end, Fcopy_sequence (list->plist));
-      if (tail)
-	tail = tail->next = XOVERLAY (overlay);
-      else
-	result = tail = XOVERLAY (overlay);
+      struct itree_node *right = node->right;
+
+      drop_overlay_nodes (node->left);
+      XOVERLAY (node->data)->buffer = NULL;
+      node->parent = node->left = node->right = NULL;
+      node = right;
     }
+}
 
-  return result;
+/* Detach all the overlays of B, without redisplaying them, and free
+   its tree of overlays.  */
+
+static void
+free_buffer_overlays (struct buffer *b)
+{
+  if (b->overlays)
+    {
+      drop_overlay_nodes (b->overlays->root);
+      xfree (b->overlays);
+      b->overlays = NULL;
+    }
 }
 
-/* Set an appropriate overlay of B.  */
+/* Record that the overlays in the tree of B belong to B.  */
 
 static void
-set_buffer_overlays_before (struct buffer *b, struct Lisp_Overlay *o)
+set_overlays_buffer (struct buffer *b)
 {
-  b->overlays_before = o;
+  struct itree_iterator it;
+  struct itree_node *node;
+
+  if (!b->overlays)
+    return;
+
+  itree_iterator_start (&it, b->overlays, PTRDIFF_MIN, PTRDIFF_MAX);
+  while ((node = itree_iterator_next (&it)))
+    XOVERLAY (node->data)->buffer = b;
 }
 
+/* Give buffer TO a copy of each overlay of buffer FROM.  */
+
 static void
-set_buffer_overlays_after (struct buffer *b, struct Lisp_Overlay *o)
+copy_overlays (struct buffer *from, struct buffer *to)
 {
-  b->overlays_after = o;
+  struct itree_iterator it;
+  struct itree_node *node;
+
+  if (!from->overlays)
+    return;
+
+  itree_iterator_start (&it, from->overlays, PTRDIFF_MIN, PTRDIFF_MAX);
+  while ((node = itree_iterator_next (&it)))
+    {
+      Lisp_Object overlay
+	= build_overlay (node->front_advance, node->rear_advance,
+			 Fcopy_sequence (OVERLAY_PLIST (node->data)));
+      add_buffer_overlay (to, XOVERLAY (overlay), node->begin, node->end);
+    }
 }
 
 bool
@@ -713,8 +772,7 @@ clone_per_buffer_values (struct buffer *from, struct buffer *to)
 
   memcpy (to->local_flags, from->local_flags, sizeof to->local_flags);
 
-  set_buffer_overlays_before (to, copy_overlays (to, from->overlays_before));
-  set_buffer_overlays_after (to, copy_overlays (to, from->overlays_after));
+  copy_overlays (from, to);
 
   /* Get (a copy of) the alist of Lisp-level local variables of FROM
      and install that in TO.  */
@@ -901,44 +959,29 @@ DEFUN ("make-indirect-buffer", Fmake_indirect_buffer, Smake_indirect_buffer,
   return buf;
 }
 
-/* Mark OV as no longer associated with B.  */
+/* Remove OV from B, which is its buffer, and redisplay the text it
+   covered.  */
 
 static void
 drop_overlay (struct buffer *b, struct Lisp_Overlay *ov)
 {
-  eassert (b == XBUFFER (Fmarker_buffer (ov->start)));
-  modify_overlay (b, marker_position (ov->start),
-		  marker_position (ov->end));
-  unchain_marker (XMARKER (ov->start));
-  unchain_marker (XMARKER (ov->end));
-
+  eassert (b == ov->buffer);
+  modify_overlay (b, itree_node_begin (ov->interval),
+		  itree_node_end (ov->interval));
+  remove_buffer_overlay (ov);
 }
 
-/* Delete all overlays of B and reset its overlay lists.  */
+/* Delete all overlays of B and free its tree of overlays.  */
 
 void
 delete_all_overlays (struct buffer *b)
 {
-  struct Lisp_Overlay *ov, *next;
-
-  /* FIXME: Since each drop_overlay will scan BUF_MARKERS to unlink its
-     markers, we have an unneeded O(N^2) behavior here.  */
-  for (ov = b->overlays_before; ov; ov = next)
-    {
-      drop_overlay (b, ov);
-      next = ov->next;
-      ov->next = NULL;
-    }
-
-  for (ov = b->overlays_after; ov; ov = next)
-    {
-      drop_overlay (b, ov);
-      next = ov->next;
-      ov->next = NULL;
-    }
+  if (!b->overlays)
+    return;
 
-  set_buffer_overlays_before (b, NULL);
-  set_buffer_overlays_after (b, NULL);
+  if (b->overlays->root)
+    modify_overlay (b, BUF_BEG (b), BUF_Z (b));
+  free_buffer_overlays (b);
 }
 
 /* Reinitialize everything about a buffer except its name and contents
@@ -966,9 +1009,7 @@ reset_buffer (register struct buffer *b)
   b->auto_save_failure_time = 0;
   bset_auto_save_file_name (b, Qnil);
   bset_read_only (b, Qnil);
-  set_buffer_overlays_before (b, NULL);
-  set_buffer_overlays_after (b, NULL);
-  b->overlay_center = BEG;
+  b->overlays = NULL;
   bset_mark_active (b, Qnil);
   bset_point_before_scroll (b, Qnil);
   bset_file_format (b, Qnil);
@@ -1492,6 +1533,18 @@ DEFUN ("buffer-chars-modified-tick", Fbuffer_chars_modified_tick,
 {
   return modiff_to_integer (BUF_CHARS_MODIFF (decode_buffer (buffer)));
 }
+
+DEFUN ("buffer-text-mapped-p", Fbuffer_text_mapped_p,
+       Sbuffer_text_mapped_p, 0, 1, 0,
+       doc: /* Return non-nil if the text of BUFFER is mapped from a file.
+This is the case after `insert-file-contents' mapped a file into the
+empty buffer, as `large-file-mapping-threshold' allows, until the text
+is first changed.  No argument or nil as argument means use current
+buffer as BUFFER.  */)
+  (Lisp_Object buffer)
+{
+  return decode_buffer (buffer)->text->mapped_size ? Qt : Qnil;
+}
 
 DEFUN ("rename-buffer", Frename_buffer, Srename_buffer, 1, 2,
        "(list (read-string \"Rename buffer (to new name): \" \
@@ -1931,8 +1984,7 @@ DEFUN ("kill-buffer", Fkill_buffer, Skill_buffer, 0, 1, "bKill buffer: ",
     }
   /* Since we've unlinked the markers, the overlays can't be here any more
      either.  */
-  b->overlays_before = NULL;
-  b->overlays_after = NULL;
+  free_buffer_overlays (b);
 
   /* Reset the local variables, so that this buffer's local values
      won't be protected from GC.  They would be protected
@@ -2409,9 +2461,7 @@ #define swapfield_(field, type) \
   swapfield (bidi_paragraph_cache, struct region_cache *);
   current_buffer->prevent_redisplay_optimizations_p = 1;
   other_buffer->prevent_redisplay_optimizations_p = 1;
-  swapfield (overlays_before, struct Lisp_Overlay *);
-  swapfield (overlays_after, struct Lisp_Overlay *);
-  swapfield (overlay_center, ptrdiff_t);
+  swapfield (overlays, struct itree_tree *);
   swapfield_ (undo_list, Lisp_Object);
   swapfield_ (mark, Lisp_Object);
   swapfield_ (enable_multibyte_characters, Lisp_Object);
@@ -2454,6 +2504,9 @@ #define swapfield_(field, type) \
 	   BUF_MARKERS(buf) should either be for `buf' or dead.  */
 	eassert (!m->buffer);
   }
+  /* The overlays were swapped along with the text.  */
+  set_overlays_buffer (current_buffer);
+  set_overlays_buffer (other_buffer);
   { /* Some of the C code expects that both window markers of a
        live window points to that window's buffer.  So since we
        just swapped the markers between the two buffers, we need
@@ -2501,6 +2554,39 @@ #define swapfield_(field, type) \
   return Qnil;
 }
 
+/* Helpers for Fset_buffer_multibyte, to convert the overlay positions
+   of the current buffer.  */
+
+static ptrdiff_t
+char_to_byte_position (ptrdiff_t pos)
+{
+  return CHAR_TO_BYTE (pos);
+}
+
+static ptrdiff_t
+byte_to_char_position (ptrdiff_t pos)
+{
+  return BYTE_TO_CHAR (advance_to_char_boundary (pos));
+}
+
+/* Apply FN to the overlay positions of the current buffer and of the
+   buffers that share its text.  */
+
+static void
+map_overlay_positions (ptrdiff_t (*fn) (ptrdiff_t))
+{
+  Lisp_Object tail, other;
+
+  if (current_buffer->overlays)
+    itree_map_positions (current_buffer->overlays, fn);
+
+  if (current_buffer->indirections > 0)
+    FOR_EACH_LIVE_BUFFER (tail, other)
+      if (XBUFFER (other)->base_buffer == current_buffer
+	  && XBUFFER (other)->overlays)
+	itree_map_positions (XBUFFER (other)->overlays, fn);
+}
+
 DEFUN ("set-buffer-multibyte", Fset_buffer_multibyte, Sset_buffer_multibyte,
        1, 1, 0,
        doc: /* Set the multibyte flag of the current buffer to FLAG.
@@ -2534,6 +2620,7 @@ DEFUN ("set-buffer-multibyte", Fset_buffer_multibyte, Sset_buffer_multibyte,
 
   /* If the cached position is for this buffer, clear it out.  */
   clear_charpos_cache (current_buffer);
+  clear_line_index (current_buffer);
 
   if (NILP (flag))
     begv = BEGV_BYTE, zv = ZV_BYTE;
@@ -2552,6 +2639,7 @@ DEFUN ("set-buffer-multibyte", Fset_buffer_multibyte, Sset_buffer_multibyte,
 
       /* Do this first, so it can use CHAR_TO_BYTE
 	 to calculate the old correspondences.  */
+      map_overlay_positions (char_to_byte_position);
       set_intervals_multibyte (0);
 
       bset_enable_multibyte_characters (current_buffer, Qnil);
@@ -2739,6 +2827,8 @@ DEFUN ("set-buffer-multibyte", Fset_buffer_multibyte, Sset_buffer_multibyte,
 
       BUF_MARKERS (current_buffer) = markers;
 
+      map_overlay_positions (byte_to_char_position);
+
       /* Do this last, so it can calculate the new correspondences
 	 between chars and bytes.  */
       /* FIXME: Is it worth the trouble, really?  Couldn't we just throw
@@ -2828,11 +2918,10 @@ DEFUN ("kill-all-local-variables", Fkill_all_local_variables,
 /* Find all the overlays in the current buffer that contain position POS.
    Return the number found, and store them in a vector in *VEC_PTR.
    Store in *LEN_PTR the size allocated for the vector.
-   Store in *NEXT_PTR the next position after POS where an overlay starts,
-     or ZV if there are no more overlays between POS and ZV.
-   Store in *PREV_PTR the previous position before POS where an overlay ends,
-     or where an overlay starts which ends at or after POS;
-     or BEGV if there are no such overlays from BEGV to POS.
+   Store in *NEXT_PTR the next position after POS where an overlay starts
+     or ends, or ZV if there are no more overlay boundaries before ZV.
+   Store in *PREV_PTR the previous position before POS where an overlay
+     starts or ends, or BEGV if there are no such positions after BEGV.
    NEXT_PTR and/or PREV_PTR may be 0, meaning don't store that info.
 
    *VEC_PTR and *LEN_PTR should contain a valid vector and size
@@ -2843,9 +2932,9 @@ DEFUN ("kill-all-local-variables", Fkill_all_local_variables,
    and store only as many overlays as will fit.
    But still return the total number of overlays.
 
-   If CHANGE_REQ, any position written into *PREV_PTR or
-   *NEXT_PTR is guaranteed to be not equal to POS, unless it is the
-   default (BEGV or ZV).  */
+   The positions written into *PREV_PTR or *NEXT_PTR are never equal
+   to POS, unless they are the default (BEGV or ZV); CHANGE_REQ, which
+   used to ask for that, is accepted for compatibility.  */
 
 ptrdiff_t
 overlays_at (EMACS_INT pos, bool extend, Lisp_Object **vec_ptr,
@@ -2855,32 +2944,20 @@ overlays_at (EMACS_INT pos, bool extend, Lisp_Object **vec_ptr,
   ptrdiff_t idx = 0;
   ptrdiff_t len = *len_ptr;
   Lisp_Object *vec = *vec_ptr;
-  ptrdiff_t next = ZV;
-  ptrdiff_t prev = BEGV;
+  struct itree_tree *tree = current_buffer->overlays;
   bool inhibit_storing = 0;
 
-  for (struct Lisp_Overlay *tail = current_buffer->overlays_before;
-       tail; tail = tail->next)
+  if (tree)
     {
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-      Lisp_Object start = OVERLAY_START (overlay);
-      Lisp_Object end = OVERLAY_END (overlay);
-      ptrdiff_t endpos = OVERLAY_POSITION (end);
-      if (endpos < pos)
-	{
-	  if (prev < endpos)
-	    prev = endpos;
-	  break;
-	}
-      ptrdiff_t startpos = OVERLAY_POSITION (start);
-      /* This one ends at or after POS
-	 so its start counts for PREV_PTR if it's before POS.  */
-      if (prev < startpos && startpos < pos)
-	prev = startpos;
-      if (endpos == pos)
-	continue;
-      if (startpos <= pos)
+      struct itree_iterator it;
+      struct itree_node *node;
+
+      itree_iterator_start (&it, tree, pos, pos);
+      while ((node = itree_iterator_next (&it)))
 	{
+	  /* Overlays ending at POS don't contain the character there.  */
+	  if (node->end == pos)
+	    continue;
 	  if (idx == len)
 	    {
 	      /* The supplied vector is full.
@@ -2897,75 +2974,26 @@ overlays_at (EMACS_INT pos, bool extend, Lisp_Object **vec_ptr,
 	    }
 
 	  if (!inhibit_storing)
-	    vec[idx] = overlay;
+	    vec[idx] = node->data;
 	  /* Keep counting overlays even if we can't return them all.  */
 	  idx++;
 	}
-      else if (startpos < next)
-	next = startpos;
-    }
-
-  for (struct Lisp_Overlay *tail = current_buffer->overlays_after;
-       tail; tail = tail->next)
-    {
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-      Lisp_Object start = OVERLAY_START (overlay);
-      Lisp_Object end = OVERLAY_END (overlay);
-      ptrdiff_t startpos = OVERLAY_POSITION (start);
-      if (pos < startpos)
-	{
-	  if (startpos < next)
-	    next = startpos;
-	  break;
-	}
-      ptrdiff_t endpos = OVERLAY_POSITION (end);
-      if (pos < endpos)
-	{
-	  if (idx == len)
-	    {
-	      if (extend)
-		{
-		  vec = xpalloc (vec, len_ptr, 1, OVERLAY_COUNT_MAX,
-				 sizeof *vec);
-		  *vec_ptr = vec;
-		  len = *len_ptr;
-		}
-	      else
-		inhibit_storing = 1;
-	    }
-
-	  if (!inhibit_storing)
-	    vec[idx] = overlay;
-	  idx++;
-
-	  if (startpos < pos && startpos > prev)
-	    prev = startpos;
-	}
-      else if (endpos < pos && endpos > prev)
-	prev = endpos;
-      else if (endpos == pos && startpos > prev
-	       && (!change_req || startpos < pos))
-	prev = startpos;
     }
 
   if (next_ptr)
-    *next_ptr = next;
+    *next_ptr = tree ? min (ZV, itree_next_boundary (tree, pos, ZV)) : ZV;
   if (prev_ptr)
-    *prev_ptr = prev;
+    *prev_ptr = (tree ? max (BEGV, itree_previous_boundary (tree, pos, BEGV))
+		 : BEGV);
   return idx;
 }
-
+
 /* Find all the overlays in the current buffer that overlap the range
    BEG-END, or are empty at BEG, or are empty at END provided END
    denotes the position at the end of the current buffer.
 
    Return the number found, and store them in a vector in *VEC_PTR.
    Store in *LEN_PTR the size allocated for the vector.
-   Store in *NEXT_PTR the next position after POS where an overlay starts,
-     or ZV if there are no more overlays.
-   Store in *PREV_PTR the previous position before POS where an overlay ends,
-     or BEGV if there are no previous overlays.
-   NEXT_PTR and/or PREV_PTR may be 0, meaning don't store that info.
 
    *VEC_PTR and *LEN_PTR should contain a valid vector and size
    when this function is called.
@@ -2977,31 +3005,25 @@ overlays_at (EMACS_INT pos, bool extend, Lisp_Object **vec_ptr,
 
 static ptrdiff_t
 overlays_in (EMACS_INT beg, EMACS_INT end, bool extend,
-	     Lisp_Object **vec_ptr, ptrdiff_t *len_ptr,
-	     ptrdiff_t *next_ptr, ptrdiff_t *prev_ptr)
+	     Lisp_Object **vec_ptr, ptrdiff_t *len_ptr)
 {
   ptrdiff_t idx = 0;
   ptrdiff_t len = *len_ptr;
   Lisp_Object *vec = *vec_ptr;
-  ptrdiff_t next = ZV;
-  ptrdiff_t prev = BEGV;
+  struct itree_iterator it;
+  struct itree_node *node;
   bool inhibit_storing = 0;
   bool end_is_Z = end == Z;
 
-  for (struct Lisp_Overlay *tail = current_buffer->overlays_before;
-       tail; tail = tail->next)
+  if (!current_buffer->overlays)
+    return 0;
+
+  itree_iterator_start (&it, current_buffer->overlays, beg, end);
+  while ((node = itree_iterator_next (&it)))
     {
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-      Lisp_Object ostart = OVERLAY_START (overlay);
-      Lisp_Object oend = OVERLAY_END (overlay);
-      ptrdiff_t endpos = OVERLAY_POSITION (oend);
-      if (endpos < beg)
-	{
-	  if (prev < endpos)
-	    prev = endpos;
-	  break;
-	}
-      ptrdiff_t startpos = OVERLAY_POSITION (ostart);
+      ptrdiff_t startpos = node->begin;
+      ptrdiff_t endpos = node->end;
+
       /* Count an interval if it overlaps the range, is empty at the
 	 start of the range, or is empty at END provided END denotes the
 	 end of the buffer.  */
@@ -3025,60 +3047,12 @@ overlays_in (EMACS_INT beg, EMACS_INT end, bool extend,
 	    }
 
 	  if (!inhibit_storing)
-	    vec[idx] = overlay;
+	    vec[idx] = node->data;
 	  /* Keep counting overlays even if we can't return them all.  */
 	  idx++;
 	}
-      else if (startpos < next)
-	next = startpos;
     }
 
-  for (struct Lisp_Overlay *tail = current_buffer->overlays_after;
-       tail; tail = tail->next)
-    {
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-      Lisp_Object ostart = OVERLAY_START (overlay);
-      Lisp_Object oend = OVERLAY_END (overlay);
-      ptrdiff_t startpos = OVERLAY_POSITION (ostart);
-      if (end < startpos)
-	{
-	  if (startpos < next)
-	    next = startpos;
-	  break;
-	}
-      ptrdiff_t endpos = OVERLAY_POSITION (oend);
-      /* Count an interval if it overlaps the range, is empty at the
-	 start of the range, or is empty at END provided END denotes the
-	 end of the buffer.  */
-      if ((beg < endpos && startpos < end)
-	  || (startpos == endpos
-	      && (beg == endpos || (end_is_Z && endpos == end))))
-	{
-	  if (idx == len)
-	    {
-	      if (extend)
-		{
-		  vec = xpalloc (vec, len_ptr, 1, OVERLAY_COUNT_MAX,
-				 sizeof *vec);
-		  *vec_ptr = vec;
-		  len = *len_ptr;
-		}
-	      else
-		inhibit_storing = 1;
-	    }
-
-	  if (!inhibit_storing)
-	    vec[idx] = overlay;
-	  idx++;
-	}
-      else if (endpos < beg && endpos > prev)
-	prev = endpos;
-    }
-
-  if (next_ptr)
-    *next_ptr = next;
-  if (prev_ptr)
-    *prev_ptr = prev;
   return idx;
 }
 
@@ -3089,8 +3063,8 @@ overlays_in (EMACS_INT beg, EMACS_INT end, bool extend,
 bool
 mouse_face_overlay_overlaps (Lisp_Object overlay)
 {
-  ptrdiff_t start = OVERLAY_POSITION (OVERLAY_START (overlay));
-  ptrdiff_t end = OVERLAY_POSITION (OVERLAY_END (overlay));
+  ptrdiff_t start = OVERLAY_START (overlay);
+  ptrdiff_t end = OVERLAY_END (overlay);
   ptrdiff_t n, i, size;
   Lisp_Object *v, tem;
   Lisp_Object vbuf[10];
@@ -3098,11 +3072,11 @@ mouse_face_overlay_overlaps (Lisp_Object overlay)
 
   size = ARRAYELTS (vbuf);
   v = vbuf;
-  n = overlays_in (start, end, 0, &v, &size, NULL, NULL);
+  n = overlays_in (start, end, 0, &v, &size);
   if (n > size)
     {
       SAFE_NALLOCA (v, 1, n);
-      overlays_in (start, end, 0, &v, &n, NULL, NULL);
+      overlays_in (start, end, 0, &v, &n);
     }
 
   for (i = 0; i < n; ++i)
@@ -3127,11 +3101,11 @@ disable_line_numbers_overlay_at_eob (void)
 
   size = ARRAYELTS (vbuf);
   v = vbuf;
-  n = overlays_in (ZV, ZV, 0, &v, &size, NULL, NULL);
+  n = overlays_in (ZV, ZV, 0, &v, &size);
   if (n > size)
     {
       SAFE_NALLOCA (v, 1, n);
-      overlays_in (ZV, ZV, 0, &v, &n, NULL, NULL);
+      overlays_in (ZV, ZV, 0, &v, &n);
     }
 
   for (i = 0; i < n; ++i)
@@ -3148,34 +3122,19 @@ disable_line_numbers_overlay_at_eob (void)
 bool
 overlay_touches_p (ptrdiff_t pos)
 {
-  for (struct Lisp_Overlay *tail = current_buffer->overlays_before;
-       tail; tail = tail->next)
-    {
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-      eassert (OVERLAYP (overlay));
+  struct itree_iterator it;
+  struct itree_node *node;
 
-      ptrdiff_t endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
-      if (endpos < pos)
-	break;
-      if (endpos == pos || OVERLAY_POSITION (OVERLAY_START (overlay)) == pos)
-	return 1;
-    }
-
-  for (struct Lisp_Overlay *tail = current_buffer->overlays_after;
-       tail; tail = tail->next)
-    {
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-      eassert (OVERLAYP (overlay));
+  if (!current_buffer->overlays)
+    return 0;
 
-      ptrdiff_t startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
-      if (pos < startpos)
-	break;
-      if (startpos == pos || OVERLAY_POSITION (OVERLAY_END (overlay)) == pos)
-	return 1;
-    }
+  itree_iterator_start (&it, current_buffer->overlays, pos, pos);
+  while ((node = itree_iterator_next (&it)))
+    if (node->begin == pos || node->end == pos)
+      return 1;
   return 0;
 }
-
+
 struct sortvec
 {
   Lisp_Object overlay;
@@ -3234,8 +3193,8 @@ sort_overlays (Lisp_Object *overlay_vec, ptrdiff_t noverlays, struct window *w)
 
       overlay = overlay_vec[i];
       if (OVERLAYP (overlay)
-	  && OVERLAY_POSITION (OVERLAY_START (overlay)) > 0
-	  && OVERLAY_POSITION (OVERLAY_END (overlay)) > 0)
+	  && OVERLAY_START (overlay) > 0
+	  && OVERLAY_END (overlay) > 0)
 	{
 	  /* If we're interested in a specific window, then ignore
 	     overlays that are limited to some other window.  */
@@ -3250,8 +3209,8 @@ sort_overlays (Lisp_Object *overlay_vec, ptrdiff_t noverlays, struct window *w)
 
 	  /* This overlay is good and counts: put it into sortvec.  */
 	  sortvec[j].overlay = overlay;
-	  sortvec[j].beg = OVERLAY_POSITION (OVERLAY_START (overlay));
-	  sortvec[j].end = OVERLAY_POSITION (OVERLAY_END (overlay));
+	  sortvec[j].beg = OVERLAY_START (overlay);
+	  sortvec[j].end = OVERLAY_END (overlay);
 	  tem = Foverlay_get (overlay, Qpriority);
 	  if (NILP (tem))
 	    {
@@ -3387,65 +3346,41 @@ overlay_strings (ptrdiff_t pos, struct window *w, unsigned char **pstr)
 
   overlay_heads.used = overlay_heads.bytes = 0;
   overlay_tails.used = overlay_tails.bytes = 0;
-  for (struct Lisp_Overlay *ov = current_buffer->overlays_before;
-       ov; ov = ov->next)
-    {
-      Lisp_Object overlay = make_lisp_ptr (ov, Lisp_Vectorlike);
-      eassert (OVERLAYP (overlay));
 
-      ptrdiff_t startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
-      ptrdiff_t endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
-      if (endpos < pos)
-	break;
-      if (endpos != pos && startpos != pos)
-	continue;
-      Lisp_Object window = Foverlay_get (overlay, Qwindow);
-      if (WINDOWP (window) && XWINDOW (window) != w)
-	continue;
-      Lisp_Object str;
-      if (startpos == pos
-	  && (str = Foverlay_get (overlay, Qbefore_string), STRINGP (str)))
-	record_overlay_string (&overlay_heads, str,
-			       (startpos == endpos
-				? Foverlay_get (overlay, Qafter_string)
-				: Qnil),
-			       Foverlay_get (overlay, Qpriority),
-			       endpos - startpos);
-      else if (endpos == pos
-	  && (str = Foverlay_get (overlay, Qafter_string), STRINGP (str)))
-	record_overlay_string (&overlay_tails, str, Qnil,
-			       Foverlay_get (overlay, Qpriority),
-			       endpos - startpos);
-    }
-  for (struct Lisp_Overlay *ov = current_buffer->overlays_after;
-       ov; ov = ov->next)
+  if (current_buffer->overlays)
     {
-      Lisp_Object overlay = make_lisp_ptr (ov, Lisp_Vectorlike);
-      eassert (OVERLAYP (overlay));
+      struct itree_iterator it;
+      struct itree_node *node;
 
-      ptrdiff_t startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
-      ptrdiff_t endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
-      if (startpos > pos)
-	break;
-      if (endpos != pos && startpos != pos)
-	continue;
-      Lisp_Object window = Foverlay_get (overlay, Qwindow);
-      if (WINDOWP (window) && XWINDOW (window) != w)
-	continue;
-      Lisp_Object str;
-      if (startpos == pos
-	  && (str = Foverlay_get (overlay, Qbefore_string), STRINGP (str)))
-	record_overlay_string (&overlay_heads, str,
-			       (startpos == endpos
-				? Foverlay_get (overlay, Qafter_string)
-				: Qnil),
-			       Foverlay_get (overlay, Qpriority),
-			       endpos - startpos);
-      else if (endpos == pos
-	       && (str = Foverlay_get (overlay, Qafter_string), STRINGP (str)))
-	record_overlay_string (&overlay_tails, str, Qnil,
-			       Foverlay_get (overlay, Qpriority),
-			       endpos - startpos);
+      itree_iterator_start (&it, current_buffer->overlays, pos, pos);
+      while ((node = itree_iterator_next (&it)))
+	{
+	  Lisp_Object overlay = node->data;
+	  eassert (OVERLAYP (overlay));
+
+	  ptrdiff_t startpos = node->begin;
+	  ptrdiff_t endpos = node->end;
+	  if (endpos != pos && startpos != pos)
+	    continue;
+	  Lisp_Object window = Foverlay_get (overlay, Qwindow);
+	  if (WINDOWP (window) && XWINDOW (window) != w)
+	    continue;
+	  Lisp_Object str;
+	  if (startpos == pos
+	      && (str = Foverlay_get (overlay, Qbefore_string), STRINGP (str)))
+	    record_overlay_string (&overlay_heads, str,
+				   (startpos == endpos
+				    ? Foverlay_get (overlay, Qafter_string)
+				    : Qnil),
+				   Foverlay_get (overlay, Qpriority),
+				   endpos - startpos);
+	  else if (endpos == pos
+		   && (str = Foverlay_get (overlay, Qafter_string),
+		       STRINGP (str)))
+	    record_overlay_string (&overlay_tails, str, Qnil,
+				   Foverlay_get (overlay, Qpriority),
+				   endpos - startpos);
+	}
     }
   if (overlay_tails.used > 1)
     qsort (overlay_tails.buf, overlay_tails.used, sizeof (struct sortstr),
@@ -3502,382 +3437,146 @@ overlay_strings (ptrdiff_t pos, struct window *w, unsigned char **pstr)
   return 0;
 }
 
-/* Shift overlays in BUF's overlay lists, to center the lists at POS.  */
+/* Adjust the overlays of the current buffer, and of the other buffers
+   sharing its text, for the insertion of LENGTH characters at POS.
+   BEFORE_MARKERS means the insertion moves all the overlay ends at
+   POS, as it does with markers.  */
 
 void
-recenter_overlay_lists (struct buffer *buf, ptrdiff_t pos)
+adjust_overlays_for_insert (ptrdiff_t pos, ptrdiff_t length,
+			    bool before_markers)
 {
-  struct Lisp_Overlay *prev, *next;
-
-  /* See if anything in overlays_before should move to overlays_after.  */
-
-  /* We don't strictly need prev in this loop; it should always be nil.
-     But we use it for symmetry and in case that should cease to be true
-     with some future change.  */
-  prev = NULL;
-  for (struct Lisp_Overlay *tail = buf->overlays_before;
-       tail; prev = tail, tail = next)
-    {
-      next = tail->next;
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-      eassert (OVERLAYP (overlay));
-
-      Lisp_Object beg = OVERLAY_START (overlay);
-      Lisp_Object end = OVERLAY_END (overlay);
-
-      if (OVERLAY_POSITION (end) > pos)
-	{
-	  /* OVERLAY needs to be moved.  */
-	  ptrdiff_t where = OVERLAY_POSITION (beg);
-	  struct Lisp_Overlay *other, *other_prev;
+  struct buffer *base = (current_buffer->base_buffer
+			 ? current_buffer->base_buffer : current_buffer);
 
-	  /* Splice the cons cell TAIL out of overlays_before.  */
-	  if (prev)
-	    prev->next = next;
-	  else
-	    set_buffer_overlays_before (buf, next);
-
-	  /* Search thru overlays_after for where to put it.  */
-	  other_prev = NULL;
-	  for (other = buf->overlays_after; other;
-	       other_prev = other, other = other->next)
-	    {
-	      Lisp_Object otheroverlay = make_lisp_ptr (other, Lisp_Vectorlike);
-	      eassert (OVERLAYP (otheroverlay));
-
-	      Lisp_Object otherbeg = OVERLAY_START (otheroverlay);
-	      if (OVERLAY_POSITION (otherbeg) >= where)
-		break;
-	    }
-
-	  /* Add TAIL to overlays_after before OTHER.  */
-	  tail->next = other;
-	  if (other_prev)
-	    other_prev->next = tail;
-	  else
-	    set_buffer_overlays_after (buf, tail);
-	  tail = prev;
-	}
-      else
-	/* We've reached the things that should stay in overlays_before.
-	   All the rest of overlays_before must end even earlier,
-	   so stop now.  */
-	break;
-    }
-
-  /* See if anything in overlays_after should be in overlays_before.  */
-  prev = NULL;
-  for (struct Lisp_Overlay *tail = buf->overlays_after;
-       tail; prev = tail, tail = next)
+  if (base->overlays)
+    itree_insert_gap (base->overlays, pos, length, before_markers);
+  if (base->indirections > 0)
     {
-      next = tail->next;
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-      eassert (OVERLAYP (overlay));
-
-      Lisp_Object beg = OVERLAY_START (overlay);
-      Lisp_Object end = OVERLAY_END (overlay);
-
-      /* Stop looking, when we know that nothing further
-	 can possibly end before POS.  */
-      if (OVERLAY_POSITION (beg) > pos)
-	break;
+      Lisp_Object tail, other;
 
-      if (OVERLAY_POSITION (end) <= pos)
+      FOR_EACH_LIVE_BUFFER (tail, other)
 	{
-	  /* OVERLAY needs to be moved.  */
-	  ptrdiff_t where = OVERLAY_POSITION (end);
-	  struct Lisp_Overlay *other, *other_prev;
-
-	  /* Splice the cons cell TAIL out of overlays_after.  */
-	  if (prev)
-	    prev->next = next;
-	  else
-	    set_buffer_overlays_after (buf, next);
-
-	  /* Search thru overlays_before for where to put it.  */
-	  other_prev = NULL;
-	  for (other = buf->overlays_before; other;
-	       other_prev = other, other = other->next)
-	    {
-	      Lisp_Object otheroverlay = make_lisp_ptr (other, Lisp_Vectorlike);
-	      eassert (OVERLAYP (otheroverlay));
-
-	      Lisp_Object otherend = OVERLAY_END (otheroverlay);
-	      if (OVERLAY_POSITION (otherend) <= where)
-		break;
-	    }
-
-	  /* Add TAIL to overlays_before before OTHER.  */
-	  tail->next = other;
-	  if (other_prev)
-	    other_prev->next = tail;
-	  else
-	    set_buffer_overlays_before (buf, tail);
-	  tail = prev;
+	  struct buffer *o = XBUFFER (other);
+	  if (o->base_buffer == base && o->overlays)
+	    itree_insert_gap (o->overlays, pos, length, before_markers);
 	}
     }
-
-  buf->overlay_center = pos;
 }
 
-void
-adjust_overlays_for_insert (ptrdiff_t pos, ptrdiff_t length)
-{
-  /* After an insertion, the lists are still sorted properly,
-     but we may need to update the value of the overlay center.  */
-  if (current_buffer->overlay_center >= pos)
-    current_buffer->overlay_center += length;
-}
+/* Adjust the overlays of the current buffer, and of the other buffers
+   sharing its text, for the deletion of LENGTH characters at POS.  */
 
 void
 adjust_overlays_for_delete (ptrdiff_t pos, ptrdiff_t length)
 {
-  if (current_buffer->overlay_center < pos)
-    /* The deletion was to our right.  No change needed; the before- and
-       after-lists are still consistent.  */
-    ;
-  else if (current_buffer->overlay_center - pos > length)
-    /* The deletion was to our left.  We need to adjust the center value
-       to account for the change in position, but the lists are consistent
-       given the new value.  */
-    current_buffer->overlay_center -= length;
-  else
-    /* We're right in the middle.  There might be things on the after-list
-       that now belong on the before-list.  Recentering will move them,
-       and also update the center point.  */
-    recenter_overlay_lists (current_buffer, pos);
-}
-
-/* Fix up overlays that were garbled as a result of permuting markers
-   in the range START through END.  Any overlay with at least one
-   endpoint in this range will need to be unlinked from the overlay
-   list and reinserted in its proper place.
-   Such an overlay might even have negative size at this point.
-   If so, we'll make the overlay empty. */
-void
-fix_start_end_in_overlays (register ptrdiff_t start, register ptrdiff_t end)
-{
-  struct Lisp_Overlay *before_list UNINIT;
-  struct Lisp_Overlay *after_list UNINIT;
-  /* These are either nil, indicating that before_list or after_list
-     should be assigned, or the cons cell the cdr of which should be
-     assigned.  */
-  struct Lisp_Overlay *beforep = NULL, *afterp = NULL;
-  /* 'Parent', likewise, indicates a cons cell or
-     current_buffer->overlays_before or overlays_after, depending
-     which loop we're in.  */
-  struct Lisp_Overlay *parent;
-
-  /* This algorithm shifts links around instead of consing and GCing.
-     The loop invariant is that before_list (resp. after_list) is a
-     well-formed list except that its last element, the CDR of beforep
-     (resp. afterp) if beforep (afterp) isn't nil or before_list
-     (after_list) if it is, is still uninitialized.  So it's not a bug
-     that before_list isn't initialized, although it may look
-     strange.  */
-  parent = NULL;
-  for (struct Lisp_Overlay *tail = current_buffer->overlays_before;
-       tail; tail = tail->next)
-    {
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-
-      ptrdiff_t endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
-      ptrdiff_t startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
+  struct buffer *base = (current_buffer->base_buffer
+			 ? current_buffer->base_buffer : current_buffer);
 
-      /* If the overlay is backwards, make it empty.  */
-      if (endpos < startpos)
-	{
-	  startpos = endpos;
-	  Fset_marker (OVERLAY_START (overlay), make_fixnum (startpos),
-		       Qnil);
-	}
-
-      if (endpos < start)
-	break;
+  if (base->overlays)
+    itree_delete_gap (base->overlays, pos, length);
+  if (base->indirections > 0)
+    {
+      Lisp_Object tail, other;
 
-      if (endpos < end
-	  || (startpos >= start && startpos < end))
+      FOR_EACH_LIVE_BUFFER (tail, other)
 	{
-	  /* Add it to the end of the wrong list.  Later on,
-	     recenter_overlay_lists will move it to the right place.  */
-	  if (endpos < current_buffer->overlay_center)
-	    {
-	      if (!afterp)
-		after_list = tail;
-	      else
-		afterp->next = tail;
-	      afterp = tail;
-	    }
-	  else
-	    {
-	      if (!beforep)
-		before_list = tail;
-	      else
-		beforep->next = tail;
-	      beforep = tail;
-	    }
-	  if (!parent)
-	    set_buffer_overlays_before (current_buffer, tail->next);
-	  else
-	    parent->next = tail->next;
+	  struct buffer *o = XBUFFER (other);
+	  if (o->base_buffer == base && o->overlays)
+	    itree_delete_gap (o->overlays, pos, length);
 	}
-      else
-	parent = tail;
     }
-  parent = NULL;
-  for (struct Lisp_Overlay *tail = current_buffer->overlays_after;
-       tail; tail = tail->next)
-    {
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
+}
 
-      ptrdiff_t startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
-      ptrdiff_t endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
+/* Return where the text at POS goes when the text from START1 to END1
+   is swapped with the text from START2 to END2.  */
 
-      /* If the overlay is backwards, make it empty.  */
-      if (endpos < startpos)
-	{
-	  startpos = endpos;
-	  Fset_marker (OVERLAY_START (overlay), make_fixnum (startpos),
-		       Qnil);
-	}
+static ptrdiff_t
+transpose_position (ptrdiff_t pos, ptrdiff_t start1, ptrdiff_t end1,
+		    ptrdiff_t start2, ptrdiff_t end2)
+{
+  if (pos < start1 || pos >= end2)
+    return pos;
+  else if (pos < end1)
+    return pos + (end2 - end1);
+  else if (pos < start2)
+    return pos + (end2 - start2) - (end1 - start1);
+  else
+    return pos - (start2 - start1);
+}
 
-      if (startpos >= end)
-	break;
+/* Do the work of transpose_overlays for the overlays of B.  */
 
-      if (startpos >= start
-	  || (endpos >= start && endpos < end))
-	{
-	  if (endpos < current_buffer->overlay_center)
-	    {
-	      if (!afterp)
-		after_list = tail;
-	      else
-		afterp->next = tail;
-	      afterp = tail;
-	    }
-	  else
-	    {
-	      if (!beforep)
-		before_list = tail;
-	      else
-		beforep->next = tail;
-	      beforep = tail;
-	    }
-	  if (!parent)
-	    set_buffer_overlays_after (current_buffer, tail->next);
-	  else
-	    parent->next = tail->next;
-	}
-      else
-	parent = tail;
-    }
+static void
+transpose_buffer_overlays (struct buffer *b, ptrdiff_t start1, ptrdiff_t end1,
+			   ptrdiff_t start2, ptrdiff_t end2)
+{
+  struct moved_overlay
+  {
+    struct itree_node *node;
+    ptrdiff_t begin, end;
+  } *moved = NULL;
+  ptrdiff_t nmoved = 0, size = 0;
+  struct itree_iterator it;
+  struct itree_node *node;
+
+  /* Moving the overlays can change their order, so take them out of
+     the tree first.  */
+  itree_iterator_start (&it, b->overlays, start1, end2);
+  while ((node = itree_iterator_next (&it)))
+    if ((start1 <= node->begin && node->begin < end2)
+	|| (start1 <= node->end && node->end < end2))
+      {
+	if (nmoved == size)
+	  moved = xpalloc (moved, &size, 1, -1, sizeof *moved);
+	moved[nmoved].node = node;
+	moved[nmoved].begin = node->begin;
+	moved[nmoved].end = node->end;
+	nmoved++;
+      }
 
-  /* Splice the constructed (wrong) lists into the buffer's lists,
-     and let the recenter function make it sane again.  */
-  if (beforep)
+  for (ptrdiff_t i = 0; i < nmoved; i++)
+    itree_remove (b->overlays, moved[i].node);
+  for (ptrdiff_t i = 0; i < nmoved; i++)
     {
-      beforep->next = current_buffer->overlays_before;
-      set_buffer_overlays_before (current_buffer, before_list);
-    }
+      ptrdiff_t begin = transpose_position (moved[i].begin,
+					    start1, end1, start2, end2);
+      ptrdiff_t end = transpose_position (moved[i].end,
+					  start1, end1, start2, end2);
 
-  if (afterp)
-    {
-      afterp->next = current_buffer->overlays_after;
-      set_buffer_overlays_after (current_buffer, after_list);
+      /* If the overlay is backwards, make it empty.  */
+      itree_insert (b->overlays, moved[i].node, min (begin, end), end);
     }
-  recenter_overlay_lists (current_buffer, current_buffer->overlay_center);
+  xfree (moved);
 }
 
-/* We have two types of overlay: the one whose ending marker is
-   after-insertion-marker (this is the usual case) and the one whose
-   ending marker is before-insertion-marker.  When `overlays_before'
-   contains overlays of the latter type and the former type in this
-   order and both overlays end at inserting position, inserting a text
-   increases only the ending marker of the latter type, which results
-   in incorrect ordering of `overlays_before'.
-
-   This function fixes ordering of overlays in the slot
-   `overlays_before' of the buffer *BP.  Before the insertion, `point'
-   was at PREV, and now is at POS.  */
+/* Move the overlays of the current buffer, and of the other buffers
+   sharing its text, that start or end between START1 and END2, as
+   `transpose-regions' moves markers when it swaps the text from START1
+   to END1 with the text from START2 to END2.  */
 
 void
-fix_overlays_before (struct buffer *bp, ptrdiff_t prev, ptrdiff_t pos)
+transpose_overlays (ptrdiff_t start1, ptrdiff_t end1,
+		    ptrdiff_t start2, ptrdiff_t end2)
 {
-  /* If parent is nil, replace overlays_before; otherwise, parent->next.  */
-  struct Lisp_Overlay *tail = bp->overlays_before, *parent = NULL, *right_pair;
-  Lisp_Object tem;
-  ptrdiff_t end UNINIT;
-
-  /* After the insertion, the several overlays may be in incorrect
-     order.  The possibility is that, in the list `overlays_before',
-     an overlay which ends at POS appears after an overlay which ends
-     at PREV.  Since POS is greater than PREV, we must fix the
-     ordering of these overlays, by moving overlays ends at POS before
-     the overlays ends at PREV.  */
-
-  /* At first, find a place where disordered overlays should be linked
-     in.  It is where an overlay which end before POS exists. (i.e. an
-     overlay whose ending marker is after-insertion-marker if disorder
-     exists).  */
-  while (tail
-	 && (tem = make_lisp_ptr (tail, Lisp_Vectorlike),
-	     (end = OVERLAY_POSITION (OVERLAY_END (tem))) >= pos))
-    {
-      parent = tail;
-      tail = tail->next;
-    }
-
-  /* If we don't find such an overlay,
-     or the found one ends before PREV,
-     or the found one is the last one in the list,
-     we don't have to fix anything.  */
-  if (!tail || end < prev || !tail->next)
-    return;
-
-  right_pair = parent;
-  parent = tail;
-  tail = tail->next;
+  struct buffer *base = (current_buffer->base_buffer
+			 ? current_buffer->base_buffer : current_buffer);
 
-  /* Now, end position of overlays in the list TAIL should be before
-     or equal to PREV.  In the loop, an overlay which ends at POS is
-     moved ahead to the place indicated by the CDR of RIGHT_PAIR.  If
-     we found an overlay which ends before PREV, the remaining
-     overlays are in correct order.  */
-  while (tail)
+  if (base->overlays)
+    transpose_buffer_overlays (base, start1, end1, start2, end2);
+  if (base->indirections > 0)
     {
-      tem = make_lisp_ptr (tail, Lisp_Vectorlike);
-      end = OVERLAY_POSITION (OVERLAY_END (tem));
-
-      if (end == pos)
-	{			/* This overlay is disordered. */
-	  struct Lisp_Overlay *found = tail;
-
-	  /* Unlink the found overlay.  */
-	  tail = found->next;
-	  parent->next = tail;
-	  /* Move an overlay at RIGHT_PLACE to the next of the found one,
-	     and link it into the right place.  */
-	  if (!right_pair)
-	    {
-	      found->next = bp->overlays_before;
-	      set_buffer_overlays_before (bp, found);
-	    }
-	  else
-	    {
-	      found->next = right_pair->next;
-	      right_pair->next = found;
-	    }
-	}
-      else if (end == prev)
+      Lisp_Object tail, other;
+
+      FOR_EACH_LIVE_BUFFER (tail, other)
 	{
-	  parent = tail;
-	  tail = tail->next;
+	  struct buffer *o = XBUFFER (other);
+	  if (o->base_buffer == base && o->overlays)
+	    transpose_buffer_overlays (o, start1, end1, start2, end2);
 	}
-      else			/* No more disordered overlay. */
-	break;
     }
 }
-
+
 DEFUN ("overlayp", Foverlayp, Soverlayp, 1, 1, 0,
        doc: /* Return t if OBJECT is an overlay.  */)
   (Lisp_Object object)
@@ -3900,12 +3599,17 @@ DEFUN ("make-overlay", Fmake_overlay, Smake_overlay, 2, 5, 0,
 {
   Lisp_Object overlay;
   struct buffer *b;
+  ptrdiff_t obeg, oend;
 
   if (NILP (buffer))
     XSETBUFFER (buffer, current_buffer);
   else
     CHECK_BUFFER (buffer);
 
+  b = XBUFFER (buffer);
+  if (! BUFFER_LIVE_P (b))
+    error ("Attempt to create an overlay in a dead buffer");
+
   if (MARKERP (beg) && !EQ (Fmarker_buffer (beg), buffer))
     signal_error ("Marker points into wrong buffer", beg);
   if (MARKERP (end) && !EQ (Fmarker_buffer (end), buffer))
@@ -3920,41 +3624,20 @@ DEFUN ("make-overlay", Fmake_overlay, Smake_overlay, 2, 5, 0,
       temp = beg; beg = end; end = temp;
     }
 
-  b = XBUFFER (buffer);
-
-  beg = Fset_marker (Fmake_marker (), beg, buffer);
-  end = Fset_marker (Fmake_marker (), end, buffer);
-
-  if (!NILP (front_advance))
-    XMARKER (beg)->insertion_type = 1;
-  if (!NILP (rear_advance))
-    XMARKER (end)->insertion_type = 1;
-
-  overlay = build_overlay (beg, end, Qnil);
+  /* Clip the positions as markers would be.  */
+  obeg = clip_to_bounds (BUF_BEG (b), XFIXNUM (beg), BUF_Z (b));
+  oend = clip_to_bounds (obeg, XFIXNUM (end), BUF_Z (b));
 
-  /* Put the new overlay on the wrong list.  */
-  end = OVERLAY_END (overlay);
-  if (OVERLAY_POSITION (end) < b->overlay_center)
-    {
-      eassert (b->overlays_after || (XOVERLAY (overlay)->next == NULL));
-      XOVERLAY (overlay)->next = b->overlays_after;
-      set_buffer_overlays_after (b, XOVERLAY (overlay));
-    }
-  else
-    {
-      eassert (b->overlays_before || (XOVERLAY (overlay)->next == NULL));
-      XOVERLAY (overlay)->next = b->overlays_before;
-      set_buffer_overlays_before (b, XOVERLAY (overlay));
-    }
-  /* This puts it in the right list, and in the right order.  */
-  recenter_overlay_lists (b, b->overlay_center);
+  overlay = build_overlay (! NILP (front_advance), ! NILP (rear_advance),
+			   Qnil);
+  add_buffer_overlay (b, XOVERLAY (overlay), obeg, oend);
 
   /* We don't need to redisplay the region covered by the overlay, because
      the overlay has no properties at the moment.  */
 
   return overlay;
 }
-
+
 /* Mark a section of BUF as needing redisplay because of overlays changes.  */
 
 static void
@@ -3974,35 +3657,6 @@ modify_overlay (struct buffer *buf, ptrdiff_t start, ptrdiff_t end)
   modiff_incr (&BUF_OVERLAY_MODIFF (buf));
 }
 
-/* Remove OVERLAY from LIST.  */
-
-static struct Lisp_Overlay *
-unchain_overlay (struct Lisp_Overlay *list, struct Lisp_Overlay *overlay)
-{
-  register struct Lisp_Overlay *tail, **prev = &list;
-
-  for (tail = list; tail; prev = &tail->next, tail = *prev)
-    if (tail == overlay)
-      {
-	*prev = overlay->next;
-	overlay->next = NULL;
-	break;
-      }
-  return list;
-}
-
-/* Remove OVERLAY from both overlay lists of B.  */
-
-static void
-unchain_both (struct buffer *b, Lisp_Object overlay)
-{
-  struct Lisp_Overlay *ov = XOVERLAY (overlay);
-
-  set_buffer_overlays_before (b, unchain_overlay (b->overlays_before, ov));
-  set_buffer_overlays_after (b, unchain_overlay (b->overlays_after, ov));
-  eassert (XOVERLAY (overlay)->next == NULL);
-}
-
 DEFUN ("move-overlay", Fmove_overlay, Smove_overlay, 3, 4, 0,
        doc: /* Set the endpoints of OVERLAY to BEG and END in BUFFER.
 If BUFFER is omitted, leave OVERLAY in the same buffer it inhabits now.
@@ -4018,7 +3672,7 @@ DEFUN ("move-overlay", Fmove_overlay, Smove_overlay, 3, 4, 0,
 
   CHECK_OVERLAY (overlay);
   if (NILP (buffer))
-    buffer = Fmarker_buffer (OVERLAY_START (overlay));
+    buffer = Foverlay_buffer (overlay);
   if (NILP (buffer))
     XSETBUFFER (buffer, current_buffer);
   CHECK_BUFFER (buffer);
@@ -4042,35 +3696,22 @@ DEFUN ("move-overlay", Fmove_overlay, Smove_overlay, 3, 4, 0,
 
   specbind (Qinhibit_quit, Qt);
 
-  obuffer = Fmarker_buffer (OVERLAY_START (overlay));
+  obuffer = Foverlay_buffer (overlay);
   b = XBUFFER (buffer);
 
   if (!NILP (obuffer))
     {
       ob = XBUFFER (obuffer);
 
-      o_beg = OVERLAY_POSITION (OVERLAY_START (overlay));
-      o_end = OVERLAY_POSITION (OVERLAY_END (overlay));
+      o_beg = OVERLAY_START (overlay);
+      o_end = OVERLAY_END (overlay);
 
-      unchain_both (ob, overlay);
+      remove_buffer_overlay (XOVERLAY (overlay));
     }
-  else
-    /* An overlay not associated with any buffer will normally have its
-       `next' field set to NULL, but not always: when killing a buffer,
-       we just set its overlays_after and overlays_before to NULL without
-       manually setting each overlay's `next' field to NULL.
-       Let's correct it here, to simplify subsequent assertions.
-       FIXME: Maybe the better fix is to change `kill-buffer'!?  */
-    XOVERLAY (overlay)->next = NULL;
-
-  eassert (XOVERLAY (overlay)->next == NULL);
-
-  /* Set the overlay boundaries, which may clip them.  */
-  Fset_marker (OVERLAY_START (overlay), beg, buffer);
-  Fset_marker (OVERLAY_END (overlay), end, buffer);
 
-  n_beg = marker_position (OVERLAY_START (overlay));
-  n_end = marker_position (OVERLAY_END (overlay));
+  /* Set the overlay boundaries, clipping them as markers would be.  */
+  n_beg = clip_to_bounds (BUF_BEG (b), XFIXNUM (beg), BUF_Z (b));
+  n_end = clip_to_bounds (n_beg, XFIXNUM (end), BUF_Z (b));
 
   /* If the overlay has changed buffers, do a thorough redisplay.  */
   if (!EQ (buffer, obuffer))
@@ -4093,36 +3734,12 @@ DEFUN ("move-overlay", Fmove_overlay, Smove_overlay, 3, 4, 0,
 	modify_overlay (b, min (o_beg, n_beg), max (o_end, n_end));
     }
 
-  eassert (XOVERLAY (overlay)->next == NULL);
-
   /* Delete the overlay if it is empty after clipping and has the
      evaporate property.  */
   if (n_beg == n_end && !NILP (Foverlay_get (overlay, Qevaporate)))
-    { /* We used to call `Fdelete_overlay' here, but it causes problems:
-         - At this stage, `overlay' is not included in its buffer's lists
-           of overlays (the data-structure is in an inconsistent state),
-           contrary to `Fdelete_overlay's assumptions.
-         - Most of the work done by Fdelete_overlay has already been done
-           here for other reasons.  */
-      drop_overlay (XBUFFER (buffer), XOVERLAY (overlay));
-      return unbind_to (count, overlay);
-    }
-
-  /* Put the overlay into the new buffer's overlay lists, first on the
-     wrong list.  */
-  if (n_end < b->overlay_center)
-    {
-      XOVERLAY (overlay)->next = b->overlays_after;
-      set_buffer_overlays_after (b, XOVERLAY (overlay));
-    }
-  else
-    {
-      XOVERLAY (overlay)->next = b->overlays_before;
-      set_buffer_overlays_before (b, XOVERLAY (overlay));
-    }
+    return unbind_to (count, overlay);
 
-  /* This puts it in the right list, and in the right order.  */
-  recenter_overlay_lists (b, b->overlay_center);
+  add_buffer_overlay (b, XOVERLAY (overlay), n_beg, n_end);
 
   return unbind_to (count, overlay);
 }
@@ -4137,14 +3754,13 @@ DEFUN ("delete-overlay", Fdelete_overlay, Sdelete_overlay, 1, 1, 0,
 
   CHECK_OVERLAY (overlay);
 
-  buffer = Fmarker_buffer (OVERLAY_START (overlay));
+  buffer = Foverlay_buffer (overlay);
   if (NILP (buffer))
     return Qnil;
 
   b = XBUFFER (buffer);
   specbind (Qinhibit_quit, Qt);
 
-  unchain_both (b, overlay);
   drop_overlay (b, XOVERLAY (overlay));
 
   /* When deleting an overlay with before or after strings, turn off
@@ -4176,8 +3792,10 @@ DEFUN ("overlay-start", Foverlay_start, Soverlay_start, 1, 1, 0,
   (Lisp_Object overlay)
 {
   CHECK_OVERLAY (overlay);
+  if (! OVERLAY_BUFFER (overlay))
+    return Qnil;
 
-  return (Fmarker_position (OVERLAY_START (overlay)));
+  return make_fixnum (OVERLAY_START (overlay));
 }
 
 DEFUN ("overlay-end", Foverlay_end, Soverlay_end, 1, 1, 0,
@@ -4185,8 +3803,10 @@ DEFUN ("overlay-end", Foverlay_end, Soverlay_end, 1, 1, 0,
   (Lisp_Object overlay)
 {
   CHECK_OVERLAY (overlay);
+  if (! OVERLAY_BUFFER (overlay))
+    return Qnil;
 
-  return (Fmarker_position (OVERLAY_END (overlay)));
+  return make_fixnum (OVERLAY_END (overlay));
 }
 
 DEFUN ("overlay-buffer", Foverlay_buffer, Soverlay_buffer, 1, 1, 0,
@@ -4194,9 +3814,14 @@ DEFUN ("overlay-buffer", Foverlay_buffer, Soverlay_buffer, 1, 1, 0,
 Return nil if OVERLAY has been deleted.  */)
   (Lisp_Object overlay)
 {
+  Lisp_Object buffer;
+
   CHECK_OVERLAY (overlay);
+  if (! OVERLAY_BUFFER (overlay))
+    return Qnil;
 
-  return Fmarker_buffer (OVERLAY_START (overlay));
+  XSETBUFFER (buffer, OVERLAY_BUFFER (overlay));
+  return buffer;
 }
 
 DEFUN ("overlay-properties", Foverlay_properties, Soverlay_properties, 1, 1, 0,
@@ -4275,8 +3900,7 @@ DEFUN ("overlays-in", Foverlays_in, Soverlays_in, 2, 2, 0,
 
   /* Put all the overlays we want in a vector in overlay_vec.
      Store the length in len.  */
-  noverlays = overlays_in (XFIXNUM (beg), XFIXNUM (end), 1, &overlay_vec, &len,
-			   NULL, NULL);
+  noverlays = overlays_in (XFIXNUM (beg), XFIXNUM (end), 1, &overlay_vec, &len);
 
   /* Make a list of them all.  */
   result = Flist (noverlays, overlay_vec);
@@ -4292,39 +3916,13 @@ DEFUN ("next-overlay-change", Fnext_overlay_change, Snext_overlay_change,
 the value is (point-max).  */)
   (Lisp_Object pos)
 {
-  ptrdiff_t i, len, noverlays;
-  ptrdiff_t endpos;
-  Lisp_Object *overlay_vec;
-
   CHECK_FIXNUM_COERCE_MARKER (pos);
 
   if (!buffer_has_overlays ())
     return make_fixnum (ZV);
 
-  len = 10;
-  overlay_vec = xmalloc (len * sizeof *overlay_vec);
-
-  /* Put all the overlays we want in a vector in overlay_vec.
-     Store the length in len.
-     endpos gets the position where the next overlay starts.  */
-  noverlays = overlays_at (XFIXNUM (pos), 1, &overlay_vec, &len,
-			   &endpos, 0, 1);
-
-  /* If any of these overlays ends before endpos,
-     use its ending point instead.  */
-  for (i = 0; i < noverlays; i++)
-    {
-      Lisp_Object oend;
-      ptrdiff_t oendpos;
-
-      oend = OVERLAY_END (overlay_vec[i]);
-      oendpos = OVERLAY_POSITION (oend);
-      if (oendpos < endpos)
-	endpos = oendpos;
-    }
-
-  xfree (overlay_vec);
-  return make_fixnum (endpos);
+  return make_fixnum (min (ZV, itree_next_boundary (current_buffer->overlays,
+						    XFIXNUM (pos), ZV)));
 }
 
 DEFUN ("previous-overlay-change", Fprevious_overlay_change,
@@ -4334,70 +3932,54 @@ DEFUN ("previous-overlay-change", Fprevious_overlay_change,
 the value is (point-min).  */)
   (Lisp_Object pos)
 {
-  ptrdiff_t prevpos;
-  Lisp_Object *overlay_vec;
-  ptrdiff_t len;
-
   CHECK_FIXNUM_COERCE_MARKER (pos);
 
   if (!buffer_has_overlays ())
     return make_fixnum (BEGV);
 
-  /* At beginning of buffer, we know the answer;
-     avoid bug subtracting 1 below.  */
-  if (XFIXNUM (pos) == BEGV)
-    return pos;
-
-  len = 10;
-  overlay_vec = xmalloc (len * sizeof *overlay_vec);
-
-  /* Put all the overlays we want in a vector in overlay_vec.
-     Store the length in len.
-     prevpos gets the position of the previous change.  */
-  overlays_at (XFIXNUM (pos), 1, &overlay_vec, &len,
-	       0, &prevpos, 1);
-
-  xfree (overlay_vec);
-  return make_fixnum (prevpos);
+  return make_fixnum (max (BEGV,
+			   itree_previous_boundary (current_buffer->overlays,
+						    XFIXNUM (pos), BEGV)));
 }
-
+
 /* These functions are for debugging overlays.  */
 
 DEFUN ("overlay-lists", Foverlay_lists, Soverlay_lists, 0, 0, 0,
-       doc: /* Return a pair of lists giving all the overlays of the current buffer.
-The car has all the overlays before the overlay center;
-the cdr has all the overlays after the overlay center.
-Recentering overlays moves overlays between these lists.
-The lists you get are copies, so that changing them has no effect.
+       doc: /* Return a list giving all the overlays of the current buffer.
+
+For backward compatibility, the value is actually a list that
+holds another list; the overlays are in the inner list.
+The list you get is a copy, so that changing it has no effect.
 However, the overlays you get are the real objects that the buffer uses.  */)
   (void)
 {
-  Lisp_Object before = Qnil, after = Qnil;
+  Lisp_Object overlays = Qnil;
+
+  if (current_buffer->overlays)
+    {
+      struct itree_iterator it;
+      struct itree_node *node;
 
-  for (struct Lisp_Overlay *ol = current_buffer->overlays_before;
-       ol; ol = ol->next)
-    before = Fcons (make_lisp_ptr (ol, Lisp_Vectorlike), before);
-  for (struct Lisp_Overlay *ol = current_buffer->overlays_after;
-       ol; ol = ol->next)
-    after = Fcons (make_lisp_ptr (ol, Lisp_Vectorlike), after);
+      itree_iterator_start (&it, current_buffer->overlays,
+			    PTRDIFF_MIN, PTRDIFF_MAX);
+      while ((node = itree_iterator_next (&it)))
+	overlays = Fcons (node->data, overlays);
+    }
 
-  return Fcons (Fnreverse (before), Fnreverse (after));
+  return Fcons (Fnreverse (overlays), Qnil);
 }
 
 DEFUN ("overlay-recenter", Foverlay_recenter, Soverlay_recenter, 1, 1, 0,
        doc: /* Recenter the overlays of the current buffer around position POS.
-That makes overlay lookup faster for positions near POS (but perhaps slower
-for positions far away from POS).  */)
+This used to make overlay lookup faster for positions near POS; the
+overlays are now kept in a tree, and this function does nothing.  */)
   (Lisp_Object pos)
 {
-  ptrdiff_t p;
   CHECK_FIXNUM_COERCE_MARKER (pos);
-
-  p = clip_to_bounds (PTRDIFF_MIN, XFIXNUM (pos), PTRDIFF_MAX);
-  recenter_overlay_lists (current_buffer, p);
+  /* Noop */
   return Qnil;
 }
-
+
 DEFUN ("overlay-get", Foverlay_get, Soverlay_get, 2, 2, 0,
        doc: /* Get the property of overlay OVERLAY with property name PROP.  */)
   (Lisp_Object overlay, Lisp_Object prop)
@@ -4416,7 +3998,7 @@ DEFUN ("overlay-put", Foverlay_put, Soverlay_put, 3, 3, 0,
 
   CHECK_OVERLAY (overlay);
 
-  buffer = Fmarker_buffer (OVERLAY_START (overlay));
+  buffer = Foverlay_buffer (overlay);
 
   for (tail = XOVERLAY (overlay)->plist;
        CONSP (tail) && CONSP (XCDR (tail));
@@ -4436,11 +4018,9 @@ DEFUN ("overlay-put", Foverlay_put, Soverlay_put, 3, 3, 0,
     {
       if (changed)
 	modify_overlay (XBUFFER (buffer),
-			marker_position (OVERLAY_START (overlay)),
-			marker_position (OVERLAY_END   (overlay)));
+			OVERLAY_START (overlay), OVERLAY_END (overlay));
       if (EQ (prop, Qevaporate) && ! NILP (value)
-	  && (OVERLAY_POSITION (OVERLAY_START (overlay))
-	      == OVERLAY_POSITION (OVERLAY_END (overlay))))
+	  && OVERLAY_START (overlay) == OVERLAY_END (overlay))
 	Fdelete_overlay (overlay);
     }
 
@@ -4514,58 +4094,21 @@ report_overlay_modification (Lisp_Object start, Lisp_Object end, bool after,
       /* We are being called before a change.
 	 Scan the overlays to find the functions to call.  */
       last_overlay_modification_hooks_used = 0;
-      for (struct Lisp_Overlay *tail = current_buffer->overlays_before;
-	   tail; tail = tail->next)
-	{
-	  ptrdiff_t startpos, endpos;
-	  Lisp_Object ostart, oend;
 
-	  Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
+      if (! current_buffer->overlays)
+	return;
 
-	  ostart = OVERLAY_START (overlay);
-	  oend = OVERLAY_END (overlay);
-	  endpos = OVERLAY_POSITION (oend);
-	  if (XFIXNAT (start) > endpos)
-	    break;
-	  startpos = OVERLAY_POSITION (ostart);
-	  if (insertion && (XFIXNAT (start) == startpos
-			    || XFIXNAT (end) == startpos))
-	    {
-	      Lisp_Object prop = Foverlay_get (overlay, Qinsert_in_front_hooks);
-	      if (!NILP (prop))
-		add_overlay_mod_hooklist (prop, overlay);
-	    }
-	  if (insertion && (XFIXNAT (start) == endpos
-			    || XFIXNAT (end) == endpos))
-	    {
-	      Lisp_Object prop = Foverlay_get (overlay, Qinsert_behind_hooks);
-	      if (!NILP (prop))
-		add_overlay_mod_hooklist (prop, overlay);
-	    }
-	  /* Test for intersecting intervals.  This does the right thing
-	     for both insertion and deletion.  */
-	  if (XFIXNAT (end) > startpos && XFIXNAT (start) < endpos)
-	    {
-	      Lisp_Object prop = Foverlay_get (overlay, Qmodification_hooks);
-	      if (!NILP (prop))
-		add_overlay_mod_hooklist (prop, overlay);
-	    }
-	}
+      struct itree_iterator it;
+      struct itree_node *node;
 
-      for (struct Lisp_Overlay *tail = current_buffer->overlays_after;
-	   tail; tail = tail->next)
+      itree_iterator_start (&it, current_buffer->overlays,
+			    XFIXNAT (start), XFIXNAT (end));
+      while ((node = itree_iterator_next (&it)))
 	{
-	  ptrdiff_t startpos, endpos;
-	  Lisp_Object ostart, oend;
-
-	  Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
+	  Lisp_Object overlay = node->data;
+	  ptrdiff_t startpos = node->begin;
+	  ptrdiff_t endpos = node->end;
 
-	  ostart = OVERLAY_START (overlay);
-	  oend = OVERLAY_END (overlay);
-	  startpos = OVERLAY_POSITION (ostart);
-	  endpos = OVERLAY_POSITION (oend);
-	  if (XFIXNAT (end) < startpos)
-	    break;
 	  if (insertion && (XFIXNAT (start) == startpos
 			    || XFIXNAT (end) == startpos))
 	    {
@@ -4613,7 +4156,7 @@ report_overlay_modification (Lisp_Object start, Lisp_Object end, bool after,
 	   (which makes its markers' buffers be nil), or that (due to
 	   some bug) it belongs to a different buffer.  Only run this
 	   hook if the overlay belongs to the current buffer.  */
-	if (XMARKER (OVERLAY_START (overlay_i))->buffer == current_buffer)
+	if (OVERLAY_BUFFER (overlay_i) == current_buffer)
 	  call_overlay_mod_hooks (prop_i, overlay_i, after, arg1, arg2, arg3);
       }
 
@@ -4641,30 +4184,18 @@ call_overlay_mod_hooks (Lisp_Object list, Lisp_Object overlay, bool after,
 evaporate_overlays (ptrdiff_t pos)
 {
   Lisp_Object hit_list = Qnil;
-  if (pos <= current_buffer->overlay_center)
-    for (struct Lisp_Overlay *tail = current_buffer->overlays_before;
-	 tail; tail = tail->next)
-      {
-	Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-	ptrdiff_t endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
-	if (endpos < pos)
-	  break;
-	if (endpos == pos && OVERLAY_POSITION (OVERLAY_START (overlay)) == pos
-	    && ! NILP (Foverlay_get (overlay, Qevaporate)))
-	  hit_list = Fcons (overlay, hit_list);
-      }
-  else
-    for (struct Lisp_Overlay *tail = current_buffer->overlays_after;
-	 tail; tail = tail->next)
-      {
-	Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-	ptrdiff_t startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
-	if (startpos > pos)
-	  break;
-	if (startpos == pos && OVERLAY_POSITION (OVERLAY_END (overlay)) == pos
-	    && ! NILP (Foverlay_get (overlay, Qevaporate)))
-	  hit_list = Fcons (overlay, hit_list);
-      }
+
+  if (! current_buffer->overlays)
+    return;
+
+  struct itree_iterator it;
+  struct itree_node *node;
+
+  itree_iterator_start (&it, current_buffer->overlays, pos, pos);
+  while ((node = itree_iterator_next (&it)))
+    if (node->begin == pos && node->end == pos
+	&& ! NILP (Foverlay_get (node->data, Qevaporate)))
+      hit_list = Fcons (node->data, hit_list);
   for (; CONSP (hit_list); hit_list = XCDR (hit_list))
     Fdelete_overlay (XCAR (hit_list));
 }
@@ -5058,6 +4589,191 @@ alloc_buffer_text (struct buffer *b, ptrdiff_t nbytes)
   unblock_input ();
 }
 
+/* The start of each buffer text that is mapped from a file, and how
+   many of its bytes still come from the file.  A mapped file can be
+   truncated by other programs, and using its pages past the new end
+   of the file then raises SIGBUS; this list lets the handler of that
+   signal find the text without looking at buffers.  */
+
+struct mapped_text
+{
+  unsigned char *beg;
+  ptrdiff_t nbytes;
+
+  /* True if the file was found to be truncated, and this has not been
+     reported yet.  */
+  bool truncated;
+
+  struct mapped_text *next;
+};
+
+static struct mapped_text *mapped_texts;
+
+/* True if some mapped file was found to be truncated, and this has not
+   been reported yet; see report_mapped_text_truncation.  */
+
+bool volatile mapped_text_truncated;
+
+/* Unmap the SIZE bytes at BEG, which map_buffer_text mapped.  */
+
+static void
+unmap_buffer_text (unsigned char *beg, ptrdiff_t size)
+{
+#if defined HAVE_MMAP && defined MAP_ANONYMOUS && !defined WINDOWSNT
+  struct mapped_text **prev = &mapped_texts;
+
+  while ((*prev)->beg != beg)
+    prev = &(*prev)->next;
+  struct mapped_text *m = *prev;
+  *prev = m->next;
+  xfree (m);
+  munmap (beg, size);
+#else
+  emacs_abort ();
+#endif
+}
+
+/* Replace the storage of the text of B, which must be empty, with a
+   private memory mapping of the first NBYTES bytes of the file open
+   on descriptor FD, followed by the rest of the gap.  The file's bytes
+   are then at the start of the gap, where the caller can make them
+   part of the buffer as if it had read them there.  Pages of the file
+   are read only when the text is used, and copied only when it is
+   changed.  Return true if successful, or false if the file cannot be
+   mapped, in which case B is unchanged.  */
+
+bool
+map_buffer_text (struct buffer *b, int fd, ptrdiff_t nbytes)
+{
+#if defined HAVE_MMAP && defined MAP_ANONYMOUS && !defined WINDOWSNT
+  ptrdiff_t pagesize = getpagesize ();
+  ptrdiff_t gap_size, size;
+  struct stat st;
+  void *p;
+
+  eassert (BUF_BEG_BYTE (b) == BUF_Z_BYTE (b) && b->text == &b->own_text);
+  if (INT_ADD_WRAPV (nbytes, GAP_BYTES_DFL, &gap_size)
+      || INT_ADD_WRAPV (gap_size, pagesize, &size)
+      || fstat (fd, &st) != 0)
+    return false;
+  size -= size % pagesize;
+
+  block_input ();
+  /* Reserve room for the whole text and gap, then map the file over
+     the start of it.  */
+  p = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+	    -1, 0);
+  if (p == MAP_FAILED)
+    {
+      unblock_input ();
+      return false;
+    }
+  if (0 < nbytes
+      && mmap (p, nbytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+	       fd, 0) == MAP_FAILED)
+    {
+      munmap (p, size);
+      unblock_input ();
+      return false;
+    }
+
+  struct mapped_text *m = xmalloc (sizeof *m);
+  m->beg = p;
+  m->nbytes = nbytes;
+  m->truncated = false;
+  m->next = mapped_texts;
+  mapped_texts = m;
+  unblock_input ();
+
+  free_buffer_text (b);
+  BUF_BEG_ADDR (b) = p;
+  BUF_GAP_SIZE (b) = gap_size;
+  b->text->mapped_size = size;
+  b->text->mapped_dev = st.st_dev;
+  b->text->mapped_ino = st.st_ino;
+  return true;
+#else
+  return false;
+#endif
+}
+
+/* Handle a SIGBUS at address ADDR.  If ADDR is in text mapped from a
+   file, the file was truncated and ADDR is past its new end.  Replace
+   the rest of the text that was mapped from the file with zeros, so
+   that the access can be retried, and arrange for maybe_quit to
+   report the truncation.  Return true if that was done.
+
+   This runs in a signal handler.  mmap is not async-signal-safe by
+   POSIX, but it is a plain system call where MAP_ANONYMOUS exists.  */
+
+bool
+handle_mapped_text_fault (void *addr)
+{
+#if defined HAVE_MMAP && defined MAP_ANONYMOUS && !defined WINDOWSNT
+  unsigned char *a = addr;
+
+  for (struct mapped_text *m = mapped_texts; m; m = m->next)
+    if (m->beg <= a && a < m->beg + m->nbytes)
+      {
+	ptrdiff_t pagesize = getpagesize ();
+	ptrdiff_t start = (a - m->beg) / pagesize * pagesize;
+
+	if (mmap (m->beg + start, m->nbytes - start, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0)
+	    == MAP_FAILED)
+	  return false;
+	m->nbytes = start;
+	m->truncated = true;
+	mapped_text_truncated = true;
+	return true;
+      }
+#endif
+  return false;
+}
+
+/* Signal an error about a buffer whose file was truncated while its
+   text was mapped, as handle_mapped_text_fault found.  Called from
+   maybe_quit, where it is safe to signal.  */
+
+void
+report_mapped_text_truncation (void)
+{
+  Lisp_Object tail, buf;
+
+  mapped_text_truncated = false;
+  FOR_EACH_LIVE_BUFFER (tail, buf)
+    {
+      struct buffer *b = XBUFFER (buf);
+      if (b->text->mapped_size)
+	for (struct mapped_text *m = mapped_texts; m; m = m->next)
+	  if (m->beg == BUF_BEG_ADDR (b) && m->truncated)
+	    {
+	      m->truncated = false;
+	      error ("Text of buffer %s was lost: its file was truncated",
+		     SDATA (BVAR (b, name)));
+	    }
+    }
+}
+
+/* The file with device DEV and inode number INO is about to be
+   written.  Copy the text of any buffer that is mapped from it to
+   memory of its own, so that the text does not change with the file,
+   or vanish if it is truncated.  */
+
+void
+copy_mapped_file_text (dev_t dev, ino_t ino)
+{
+  Lisp_Object tail, buf;
+
+  FOR_EACH_LIVE_BUFFER (tail, buf)
+    {
+      struct buffer *b = XBUFFER (buf);
+      if (b->text->mapped_size
+	  && b->text->mapped_dev == dev && b->text->mapped_ino == ino)
+	enlarge_buffer_text (b, 0);
+    }
+}
+
 /* Enlarge buffer B's text buffer by DELTA bytes.  DELTA < 0 means
    shrink it.  */
 
@@ -5071,7 +4787,8 @@ enlarge_buffer_text (struct buffer *b, ptrdiff_t delta)
     BUF_Z_BYTE (b) - BUF_BEG_BYTE (b) + BUF_GAP_SIZE (b) + 1;
   ptrdiff_t new_nbytes = old_nbytes + delta;
 
-  if (pdumper_object_p (old_beg))
+  /* Text that is dumped or mapped from a file must be copied.  */
+  if (pdumper_object_p (old_beg) || b->text->mapped_size)
     b->text->beg = NULL;
   else
     old_beg = NULL;
@@ -5095,6 +4812,12 @@ enlarge_buffer_text (struct buffer *b, ptrdiff_t delta)
   if (old_beg)
     memcpy (p, old_beg, min (old_nbytes, new_nbytes));
 
+  if (b->text->mapped_size)
+    {
+      unmap_buffer_text (old_beg, b->text->mapped_size);
+      b->text->mapped_size = 0;
+    }
+
   BUF_BEG_ADDR (b) = p;
   unblock_input ();
 }
@@ -5105,9 +4828,17 @@ enlarge_buffer_text (struct buffer *b, ptrdiff_t delta)
 static void
 free_buffer_text (struct buffer *b)
 {
+  clear_charpos_cache (b);
+  clear_line_index (b);
+
   block_input ();
 
-  if (!pdumper_object_p (b->text->beg))
+  if (b->text->mapped_size)
+    {
+      unmap_buffer_text (b->text->beg, b->text->mapped_size);
+      b->text->mapped_size = 0;
+    }
+  else if (!pdumper_object_p (b->text->beg))
     {
 #if defined USE_MMAP_FOR_BUFFERS
       mmap_free ((void **) &b->text->beg);
@@ -5289,9 +5020,7 @@ init_buffer_once (void)
   bset_mark_active (&buffer_defaults, Qnil);
   bset_file_format (&buffer_defaults, Qnil);
   bset_auto_save_file_format (&buffer_defaults, Qt);
-  set_buffer_overlays_before (&buffer_defaults, NULL);
-  set_buffer_overlays_after (&buffer_defaults, NULL);
-  buffer_defaults.overlay_center = BEG;
+  buffer_defaults.overlays = NULL;
 
   XSETFASTINT (BVAR (&buffer_defaults, tab_width), 8);
   bset_truncate_lines (&buffer_defaults, Qnil);
@@ -6340,6 +6069,7 @@ Functions (implicitly) running this hook are `get-buffer-create',
   defsubr (&Sset_buffer_modified_p);
   defsubr (&Sbuffer_modified_tick);
   defsubr (&Sbuffer_chars_modified_tick);
+  defsubr (&Sbuffer_text_mapped_p);
   defsubr (&Srename_buffer);
   defsubr (&Sother_buffer);
   defsubr (&Sbuffer_enable_undo);
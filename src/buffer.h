@@ -26,6 +26,7 @@ #define EMACS_BUFFER_H
 
 #include "character.h"
 #include "lisp.h"
+#include "itree.h"
 
 INLINE_HEADER_BEGIN
 
@@ -157,6 +158,8 @@ #define END_UNCHANGED BUF_END_UNCHANGED (current_buffer)
 				 ptrdiff_t, ptrdiff_t);
 extern void set_point_from_marker (Lisp_Object);
 extern void enlarge_buffer_text (struct buffer *, ptrdiff_t);
+extern bool map_buffer_text (struct buffer *, int, ptrdiff_t);
+extern void copy_mapped_file_text (dev_t, ino_t);
 
 INLINE void
 SET_PT (ptrdiff_t position)
@@ -271,6 +274,24 @@ #define FETCH_BYTE(n) *(BYTE_POS_ADDR ((n)))
        to move a marker within a buffer.  */
     struct Lisp_Marker *markers;
 
+    /* Checkpoints for converting between character and byte positions
+       in this text, or NULL; see marker.c.  */
+    struct charpos_index *charpos_index;
+
+    /* Checkpoints for counting the lines of this text, or NULL; see
+       search.c.  */
+    struct line_index *line_index;
+
+    /* If nonzero, BEG is the start of a memory mapping of this many
+       bytes, which begins with the bytes of a file; see
+       map_buffer_text.  */
+    ptrdiff_t mapped_size;
+
+    /* The device and inode number of the file that is mapped, if
+       MAPPED_SIZE is nonzero.  */
+    dev_t mapped_dev;
+    ino_t mapped_ino;
+
     /* Usually false.  Temporarily true in decode_coding_gap to
        prevent Fgarbage_collect from shrinking the gap and losing
        not-yet-decoded bytes.  */
@@ -673,16 +694,9 @@ #define BVAR(buf, field) ((buf)->field ## _)
      defined.  */
   bool_bf inhibit_buffer_hooks : 1;
 
-  /* List of overlays that end at or before the current center,
-     in order of end-position.  */
-  struct Lisp_Overlay *overlays_before;
-
-  /* List of overlays that end after  the current center,
-     in order of start-position.  */
-  struct Lisp_Overlay *overlays_after;
-
-  /* Position where the overlay lists are centered.  */
-  ptrdiff_t overlay_center;
+  /* The overlays of this buffer, in an interval tree ordered by
+     their start; null if the buffer has never had any.  */
+  struct itree_tree *overlays;
 
   /* Changes in the buffer are recorded here for undo, and t means
      don't record anything.  This information belongs to the base
@@ -1147,7 +1161,6 @@ #define CHECK_FIXNUM_COERCE_MARKER(x) ((x) = make_fixnum (fix_position (x)))
 extern ptrdiff_t overlays_at (EMACS_INT, bool, Lisp_Object **,
 			      ptrdiff_t *, ptrdiff_t *, ptrdiff_t *, bool);
 extern ptrdiff_t sort_overlays (Lisp_Object *, ptrdiff_t, struct window *);
-extern void recenter_overlay_lists (struct buffer *, ptrdiff_t);
 extern ptrdiff_t overlay_strings (ptrdiff_t, struct window *, unsigned char **);
 extern void validate_region (Lisp_Object *, Lisp_Object *);
 extern void set_buffer_internal_1 (struct buffer *);
@@ -1155,7 +1168,6 @@ #define CHECK_FIXNUM_COERCE_MARKER(x) ((x) = make_fixnum (fix_position (x)))
 extern void set_buffer_temp (struct buffer *);
 extern Lisp_Object buffer_local_value (Lisp_Object, Lisp_Object);
 extern void record_buffer (Lisp_Object);
-extern void fix_overlays_before (struct buffer *, ptrdiff_t, ptrdiff_t);
 extern void mmap_set_vars (bool);
 extern void restore_buffer (Lisp_Object);
 extern void set_buffer_if_live (Lisp_Object);
@@ -1245,7 +1257,7 @@ set_buffer_intervals (struct buffer *b, INTERVAL i)
 INLINE bool
 buffer_has_overlays (void)
 {
-  return current_buffer->overlays_before || current_buffer->overlays_after;
+  return current_buffer->overlays && current_buffer->overlays->root;
 }
 
 /* Functions for accessing a character or byte,
@@ -1363,27 +1375,39 @@ buffer_window_count (struct buffer *b)
 
 /* Overlays */
 
-/* Return the marker that stands for where OV starts in the buffer.  */
-
-#define OVERLAY_START(OV) XOVERLAY (OV)->start
-
-/* Return the marker that stands for where OV ends in the buffer.  */
+/* Return the buffer overlay OV is in, or NULL if it has been
+   deleted.  */
 
-#define OVERLAY_END(OV) XOVERLAY (OV)->end
+INLINE struct buffer *
+OVERLAY_BUFFER (Lisp_Object ov)
+{
+  return XOVERLAY (ov)->buffer;
+}
 
-/* Return the plist of overlay OV.  */
+/* Return the position where OV starts in its buffer, or -1 if it has
+   been deleted.  */
 
-#define OVERLAY_PLIST(OV) XOVERLAY (OV)->plist
+INLINE ptrdiff_t
+OVERLAY_START (Lisp_Object ov)
+{
+  struct Lisp_Overlay *o = XOVERLAY (ov);
+  return o->buffer ? itree_node_begin (o->interval) : -1;
+}
 
-/* Return the actual buffer position for the marker P.
-   We assume you know which buffer it's pointing into.  */
+/* Return the position where OV ends in its buffer, or -1 if it has
+   been deleted.  */
 
 INLINE ptrdiff_t
-OVERLAY_POSITION (Lisp_Object p)
+OVERLAY_END (Lisp_Object ov)
 {
-  return marker_position (p);
+  struct Lisp_Overlay *o = XOVERLAY (ov);
+  return o->buffer ? itree_node_end (o->interval) : -1;
 }
 
+/* Return the plist of overlay OV.  */
+
+#define OVERLAY_PLIST(OV) XOVERLAY (OV)->plist
+
 
 /***********************************************************************
 			Buffer-local Variables
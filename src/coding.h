@@ -709,6 +709,7 @@ #define UTF_16_LOW_SURROGATE_P(val) \
 extern void encode_coding_object (struct coding_system *,
                                   Lisp_Object, ptrdiff_t, ptrdiff_t,
                                   ptrdiff_t, ptrdiff_t, Lisp_Object);
+extern bool encode_coding_verbatim_p (struct coding_system *);
 /* Defined in this file.  */
 INLINE int surrogates_to_codepoint (int, int);
 
@@ -2333,7 +2333,10 @@ DEFUN ("aset", Faset, Saset, 3, 3, 0,
 
       int new_bytes = CHAR_STRING (c, p0);
       if (prev_bytes != new_bytes)
-	p1 = resize_string_data (array, idxval_byte, prev_bytes, new_bytes);
+	{
+	  invalidate_string_char_byte_cache (array, idxval_byte);
+	  p1 = resize_string_data (array, idxval_byte, prev_bytes, new_bytes);
+	}
 
       do
 	*p1++ = *p0++;
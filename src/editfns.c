@@ -262,42 +262,19 @@ DEFUN ("mark-marker", Fmark_marker, Smark_marker, 0, 0, 0,
 overlays_around (EMACS_INT pos, Lisp_Object *vec, ptrdiff_t len)
 {
   ptrdiff_t idx = 0;
+  struct itree_iterator it;
+  struct itree_node *node;
 
-  for (struct Lisp_Overlay *tail = current_buffer->overlays_before;
-       tail; tail = tail->next)
-    {
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-      Lisp_Object end = OVERLAY_END (overlay);
-      ptrdiff_t endpos = OVERLAY_POSITION (end);
-      if (endpos < pos)
-	  break;
-      Lisp_Object start = OVERLAY_START (overlay);
-      ptrdiff_t startpos = OVERLAY_POSITION (start);
-      if (startpos <= pos)
-	{
-	  if (idx < len)
-	    vec[idx] = overlay;
-	  /* Keep counting overlays even if we can't return them all.  */
-	  idx++;
-	}
-    }
+  if (! current_buffer->overlays)
+    return 0;
 
-  for (struct Lisp_Overlay *tail = current_buffer->overlays_after;
-       tail; tail = tail->next)
+  itree_iterator_start (&it, current_buffer->overlays, pos, pos);
+  while ((node = itree_iterator_next (&it)))
     {
-      Lisp_Object overlay = make_lisp_ptr (tail, Lisp_Vectorlike);
-      Lisp_Object start = OVERLAY_START (overlay);
-      ptrdiff_t startpos = OVERLAY_POSITION (start);
-      if (pos < startpos)
-	break;
-      Lisp_Object end = OVERLAY_END (overlay);
-      ptrdiff_t endpos = OVERLAY_POSITION (end);
-      if (pos <= endpos)
-	{
-	  if (idx < len)
-	    vec[idx] = overlay;
-	  idx++;
-	}
+      if (idx < len)
+	vec[idx] = node->data;
+      /* Keep counting overlays even if we can't return them all.  */
+      idx++;
     }
 
   return idx;
@@ -360,11 +337,9 @@ DEFUN ("get-pos-property", Fget_pos_property, Sget_pos_property, 2, 3, 0,
 	  if (!NILP (tem))
 	    {
 	      /* Check the overlay is indeed active at point.  */
-	      Lisp_Object start = OVERLAY_START (ol), finish = OVERLAY_END (ol);
-	      if ((OVERLAY_POSITION (start) == posn
-		   && XMARKER (start)->insertion_type == 1)
-		  || (OVERLAY_POSITION (finish) == posn
-		      && XMARKER (finish)->insertion_type == 0))
+	      struct itree_node *node = XOVERLAY (ol)->interval;
+	      if ((OVERLAY_START (ol) == posn && node->front_advance)
+		  || (OVERLAY_END (ol) == posn && ! node->rear_advance))
 		; /* The overlay will not cover a char inserted at point.  */
 	      else
 		{
@@ -4403,7 +4378,10 @@ DEFUN ("transpose-regions", Ftranspose_regions, Stranspose_regions, 4, 5,
       transpose_markers (start1, end1, start2, end2,
 			 start1_byte, start1_byte + len1_byte,
 			 start2_byte, start2_byte + len2_byte);
-      fix_start_end_in_overlays (start1, end2);
+      transpose_overlays (start1, end1, start2, end2);
+      /* The characters between START1 and END2 moved, so the byte
+	 positions cached for them are wrong now.  */
+      forget_byte_positions (start1, end2, false);
     }
   else
     {
@@ -1534,7 +1534,8 @@ process_quit_flag (void)
    If quit-flag is set to `kill-emacs' the SIGINT handler has received
    a request to exit Emacs when it is safe to do.
 
-   When not quitting, process any pending signals.  */
+   When not quitting, process any pending signals, and report any
+   file that was truncated while buffer text was mapped from it.  */
 
 void
 maybe_quit (void)
@@ -1543,6 +1544,8 @@ maybe_quit (void)
     process_quit_flag ();
   else if (pending_signals)
     process_pending_signals ();
+  if (mapped_text_truncated && NILP (Vinhibit_quit))
+    report_mapped_text_truncation ();
 }
 
 DEFUN ("signal", Fsignal, Ssignal, 2, 2, 0,
@@ -3554,7 +3554,6 @@ decide_coding_unwind (Lisp_Object unwind_data)
      So move markers that set-auto-coding might have created to BEG,
      just in case.  */
   adjust_markers_for_delete (BEG, BEG_BYTE, Z, Z_BYTE);
-  adjust_overlays_for_delete (BEG, Z - BEG);
   set_buffer_intervals (current_buffer, NULL);
   TEMP_SET_PT_BOTH (BEG, BEG_BYTE);
 
@@ -3717,6 +3716,27 @@ maybe_move_gap (struct buffer *b)
     }
 }
 
+/* The current buffer is empty and unibyte, and the TOTAL bytes of the
+   regular file open on FD are about to be read into it.  If the file
+   is large enough and needs no decoding, map it into memory instead,
+   with its bytes at the start of the gap as if they had been read
+   there.  Return true if that was done.  */
+
+static bool
+maybe_map_file (int fd, ptrdiff_t total)
+{
+  struct coding_system coding;
+
+  if (! (FIXNATP (Vlarge_file_mapping_threshold)
+	 && XFIXNAT (Vlarge_file_mapping_threshold) <= total
+	 && CODING_SYSTEM_P (Vcoding_system_for_read)))
+    return false;
+  setup_coding_system (raw_text_coding_system (Vcoding_system_for_read),
+		       &coding);
+  return (! CODING_MAY_REQUIRE_DECODING (&coding)
+	  && map_buffer_text (current_buffer, fd, total));
+}
+
 /* FIXME: insert-file-contents should be split with the top-level moved to
    Elisp and only the core kept in C.  */
 
@@ -3767,6 +3787,7 @@ because (1) it preserves some marker positions and (2) it puts less data
   bool set_coding_system = false;
   Lisp_Object coding_system;
   bool read_quit = false;
+  bool mapped;
   /* If the undo log only contains the insertion, there's no point
      keeping it.  It's typically when we first fill a file-buffer.  */
   bool empty_undo_list_p
@@ -3990,8 +4011,7 @@ because (1) it preserves some marker positions and (2) it puts less data
 		  bset_read_only (buf, Qnil);
 		  bset_filename (buf, Qnil);
 		  bset_undo_list (buf, Qt);
-		  eassert (buf->overlays_before == NULL);
-		  eassert (buf->overlays_after == NULL);
+		  eassert (!buf->overlays || !buf->overlays->root);
 
 		  set_buffer_internal (buf);
 		  Ferase_buffer ();
@@ -4424,6 +4444,13 @@ because (1) it preserves some marker positions and (2) it puts less data
       prepare_to_modify_buffer (PT, PT, NULL);
     }
 
+  /* Map a large file into an empty buffer rather than reading it, if
+     it needs no conversion.  */
+  mapped = (! not_regular && NILP (replace) && beg_offset == 0
+	    && BEG == Z
+	    && NILP (BVAR (current_buffer, enable_multibyte_characters))
+	    && maybe_map_file (fd, total));
+
   move_gap_both (PT, PT_BYTE);
   if (GAP_SIZE < total)
     make_gap (total - GAP_SIZE);
@@ -4443,6 +4470,10 @@ because (1) it preserves some marker positions and (2) it puts less data
   /* Total bytes inserted.  */
   inserted = 0;
 
+  /* A mapped file is already at the start of the gap.  */
+  if (mapped)
+    how_much = inserted = total;
+
   /* Here, we don't do code conversion in the loop.  It is done by
      decode_coding_gap after all data are read into the buffer.  */
   {
@@ -5160,6 +5191,11 @@ write_region (Lisp_Object start, Lisp_Object end, Lisp_Object filename,
   mode = auto_saving ? auto_save_mode_bits : 0666;
 #endif
 
+  /* Truncating or writing a file that a buffer maps would change the
+     text of that buffer, so copy it first.  */
+  if (open_and_close_file ? stat (fn, &st) == 0 : fstat (desc, &st) == 0)
+    copy_mapped_file_text (st.st_dev, st.st_ino);
+
   if (open_and_close_file)
     {
       desc = emacs_open (fn, open_flags, mode);
@@ -5509,6 +5545,37 @@ a_write (int desc, Lisp_Object string, ptrdiff_t pos,
   return 1;
 }
 
+/* Return true if the text of the current buffer from START_BYTE to
+   END_BYTE contains a byte that may start an eight-bit raw byte
+   character, which encodes differently in UTF-8.  */
+
+static bool
+raw_8_bit_bytes_p (ptrdiff_t start_byte, ptrdiff_t end_byte)
+{
+  ptrdiff_t gpt_byte = clip_to_bounds (start_byte, GPT_BYTE, end_byte);
+  unsigned char *p1 = BYTE_POS_ADDR (start_byte);
+  unsigned char *p2 = BYTE_POS_ADDR (gpt_byte);
+  ptrdiff_t n1 = gpt_byte - start_byte, n2 = end_byte - gpt_byte;
+
+  return (memchr (p1, 0xC0, n1) || memchr (p1, 0xC1, n1)
+	  || memchr (p2, 0xC0, n2) || memchr (p2, 0xC1, n2));
+}
+
+/* Write the text of the current buffer from START_BYTE to END_BYTE
+   into descriptor DESC as it is, taking it from both sides of the gap
+   at once.  Return true if successful.  */
+
+static bool
+e_write_bytes (int desc, ptrdiff_t start_byte, ptrdiff_t end_byte)
+{
+  ptrdiff_t gpt_byte = clip_to_bounds (start_byte, GPT_BYTE, end_byte);
+
+  return (emacs_write2_quit (desc, BYTE_POS_ADDR (start_byte),
+			     gpt_byte - start_byte,
+			     BYTE_POS_ADDR (gpt_byte), end_byte - gpt_byte)
+	  == end_byte - start_byte);
+}
+
 /* Maximum number of characters that the next
    function encodes per one loop iteration.  */
 
@@ -5532,6 +5599,20 @@ e_write (int desc, Lisp_Object string, ptrdiff_t start, ptrdiff_t end,
   /* We used to have a code for handling selective display here.  But,
      now it is handled within encode_coding.  */
 
+  /* Buffer text that encodes as itself needs no conversion at all,
+     however large it is.  */
+  if (NILP (string))
+    {
+      ptrdiff_t start_byte = CHAR_TO_BYTE (start);
+      ptrdiff_t end_byte = CHAR_TO_BYTE (end);
+
+      coding->src_multibyte = (end - start) < (end_byte - start_byte);
+      if (! CODING_REQUIRE_ENCODING (coding)
+	  || (encode_coding_verbatim_p (coding)
+	      && ! raw_8_bit_bytes_p (start_byte, end_byte)))
+	return e_write_bytes (desc, start_byte, end_byte);
+    }
+
   while (start < end)
     {
       if (STRINGP (string))
@@ -6422,6 +6503,24 @@ do (file-exists-p FILENAME) and FILENAME is handled by HANDLER, then
 the operating system crashes.  By default, it is non-nil in batch mode.  */);
   write_region_inhibit_fsync = 0; /* See also `init_fileio' above.  */
 
+  DEFVAR_LISP ("large-file-mapping-threshold", Vlarge_file_mapping_threshold,
+	       doc: /* Size in bytes from which files read literally are mapped.
+When `insert-file-contents' inserts a whole regular file without any
+conversion into an empty unibyte buffer, as `find-file-literally'
+does, and the file is at least this large, the file is mapped into
+memory instead of being read.  Its contents are then read from disk
+only as parts of the buffer are used, for instance displayed or
+searched.  The first change to the text of the buffer, and any
+`write-region' to the file, read the whole file into memory of the
+buffer's own, as if it had not been mapped.  `buffer-text-mapped-p'
+tells whether the text of a buffer is still mapped.
+nil means never map files.
+
+If another program truncates the file while the text is mapped, the
+text past the new end of the file becomes zeros, and an error is
+signaled about it.  */);
+  Vlarge_file_mapping_threshold = Qnil;
+
   DEFVAR_BOOL ("delete-by-moving-to-trash", delete_by_moving_to_trash,
                doc: /* Specifies whether to use the system's trash can.
 When non-nil, certain file deletion commands use the function
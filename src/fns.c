@@ -42,8 +42,6 @@ Copyright (C) 1985-1987, 1993-1995, 1997-2020 Free Software Foundation,
 # define gnutls_rnd w32_gnutls_rnd
 #endif
 
-static void sort_vector_copy (Lisp_Object, ptrdiff_t,
-			      Lisp_Object *restrict, Lisp_Object *restrict);
 enum equal_kind { EQUAL_NO_QUIT, EQUAL_PLAIN, EQUAL_INCLUDING_PROPERTIES };
 static bool internal_equal (Lisp_Object, Lisp_Object,
 			    enum equal_kind, int, Lisp_Object);
@@ -885,14 +883,143 @@ concat (ptrdiff_t nargs, Lisp_Object *args,
   return val;
 }
 
-static Lisp_Object string_char_byte_cache_string;
-static ptrdiff_t string_char_byte_cache_charpos;
-static ptrdiff_t string_char_byte_cache_bytepos;
+/* Cache of recent conversions between character and byte positions
+   in multibyte strings.  Each entry remembers the last position
+   converted in its string.  An entry for a long string also gets an
+   index of the byte position of every STRING_INDEX_INTERVAL'th
+   character, built the first time a conversion would otherwise have
+   to scan far, after which no conversion in that string scans more
+   than STRING_INDEX_INTERVAL characters.  */
+
+enum
+  {
+    /* Number of strings cached.  */
+    STRING_CACHE_SIZE = 8,
+
+    /* Number of characters between index entries.  */
+    STRING_INDEX_INTERVAL = 128,
+
+    /* Index a string once a conversion would need to scan at least
+       this many characters or bytes.  */
+    STRING_INDEX_MIN_SCAN = 8 * STRING_INDEX_INTERVAL
+  };
+
+struct string_char_byte_cache
+{
+  /* The string, or nil if the entry is unused.  */
+  Lisp_Object string;
+
+  /* The last position converted.  */
+  ptrdiff_t charpos, bytepos;
+
+  /* If non-null, INDEX[I] is the byte position of character number
+     I * STRING_INDEX_INTERVAL, for 0 <= I < NINDEX.  */
+  ptrdiff_t *index;
+  ptrdiff_t nindex;
+
+  /* When the entry was last used.  */
+  unsigned long tick;
+};
+
+static struct string_char_byte_cache string_char_byte_cache[STRING_CACHE_SIZE];
+static unsigned long string_char_byte_cache_tick;
+
+static void
+release_string_char_byte_cache (struct string_char_byte_cache *c)
+{
+  xfree (c->index);
+  c->index = NULL;
+  c->nindex = 0;
+  c->string = Qnil;
+  c->tick = 0;
+}
 
 void
 clear_string_char_byte_cache (void)
 {
-  string_char_byte_cache_string = Qnil;
+  for (int i = 0; i < STRING_CACHE_SIZE; i++)
+    release_string_char_byte_cache (&string_char_byte_cache[i]);
+}
+
+/* Forget the cached positions in STRING after byte position BYTEPOS,
+   because the byte lengths of the characters there are changing.  */
+
+void
+invalidate_string_char_byte_cache (Lisp_Object string, ptrdiff_t bytepos)
+{
+  for (int i = 0; i < STRING_CACHE_SIZE; i++)
+    {
+      struct string_char_byte_cache *c = &string_char_byte_cache[i];
+      if (EQ (c->string, string))
+	{
+	  xfree (c->index);
+	  c->index = NULL;
+	  c->nindex = 0;
+	  if (bytepos < c->bytepos)
+	    c->charpos = c->bytepos = 0;
+	}
+    }
+}
+
+/* Remove the strings that garbage collection is about to free from
+   the cache.  This must be done before strings are unmarked.  */
+
+void
+sweep_string_char_byte_cache (void)
+{
+  for (int i = 0; i < STRING_CACHE_SIZE; i++)
+    {
+      struct string_char_byte_cache *c = &string_char_byte_cache[i];
+      if (!NILP (c->string) && !survives_gc_p (c->string))
+	release_string_char_byte_cache (c);
+    }
+}
+
+/* Return the cache entry for STRING, reusing the least recently used
+   entry if STRING has none.  */
+
+static struct string_char_byte_cache *
+string_char_byte_cache_entry (Lisp_Object string)
+{
+  struct string_char_byte_cache *c, *lru = string_char_byte_cache;
+
+  for (c = string_char_byte_cache;
+       c < string_char_byte_cache + STRING_CACHE_SIZE; c++)
+    {
+      if (EQ (c->string, string))
+	goto found;
+      if (c->tick < lru->tick)
+	lru = c;
+    }
+
+  c = lru;
+  release_string_char_byte_cache (c);
+  c->string = string;
+  c->charpos = c->bytepos = 0;
+
+ found:
+  c->tick = ++string_char_byte_cache_tick;
+  return c;
+}
+
+/* Build the index for the string of the cache entry C.  */
+
+static void
+index_string_positions (struct string_char_byte_cache *c)
+{
+  ptrdiff_t n = SCHARS (c->string) / STRING_INDEX_INTERVAL + 1;
+  ptrdiff_t *index = xnmalloc (n, sizeof *index);
+  unsigned char const *start = SDATA (c->string), *p = start;
+
+  index[0] = 0;
+  for (ptrdiff_t i = 1; i < n; i++)
+    {
+      for (int j = 0; j < STRING_INDEX_INTERVAL; j++)
+	p += BYTES_BY_CHAR_HEAD (*p);
+      index[i] = p - start;
+    }
+  c->index = index;
+  c->nindex = n;
 }
 
 /* Return the byte index corresponding to CHAR_INDEX in STRING.  */
@@ -910,20 +1037,37 @@ string_char_to_byte (Lisp_Object string, ptrdiff_t char_index)
   if (best_above == best_above_byte)
     return char_index;
 
-  if (EQ (string, string_char_byte_cache_string))
+  struct string_char_byte_cache *c = string_char_byte_cache_entry (string);
+
+  if (!c->index
+      && STRING_INDEX_MIN_SCAN <= min (min (char_index,
+					    best_above - char_index),
+				       eabs (char_index - c->charpos)))
+    index_string_positions (c);
+
+  if (c->index)
     {
-      if (string_char_byte_cache_charpos < char_index)
-	{
-	  best_below = string_char_byte_cache_charpos;
-	  best_below_byte = string_char_byte_cache_bytepos;
-	}
-      else
+      ptrdiff_t i = char_index / STRING_INDEX_INTERVAL;
+      best_below = i * STRING_INDEX_INTERVAL;
+      best_below_byte = c->index[i];
+      if (i + 1 < c->nindex)
 	{
-	  best_above = string_char_byte_cache_charpos;
-	  best_above_byte = string_char_byte_cache_bytepos;
+	  best_above = best_below + STRING_INDEX_INTERVAL;
+	  best_above_byte = c->index[i + 1];
 	}
     }
 
+  if (best_below <= c->charpos && c->charpos <= char_index)
+    {
+      best_below = c->charpos;
+      best_below_byte = c->bytepos;
+    }
+  else if (char_index < c->charpos && c->charpos < best_above)
+    {
+      best_above = c->charpos;
+      best_above_byte = c->bytepos;
+    }
+
   if (char_index - best_below < best_above - char_index)
     {
       unsigned char *p = SDATA (string) + best_below_byte;
@@ -948,13 +1092,12 @@ string_char_to_byte (Lisp_Object string, ptrdiff_t char_index)
       i_byte = p - SDATA (string);
     }
 
-  string_char_byte_cache_bytepos = i_byte;
-  string_char_byte_cache_charpos = char_index;
-  string_char_byte_cache_string = string;
+  c->bytepos = i_byte;
+  c->charpos = char_index;
 
   return i_byte;
 }
-
+
 /* Return the character index corresponding to BYTE_INDEX in STRING.  */
 
 ptrdiff_t
@@ -970,20 +1113,46 @@ string_byte_to_char (Lisp_Object string, ptrdiff_t byte_index)
   if (best_above == best_above_byte)
     return byte_index;
 
-  if (EQ (string, string_char_byte_cache_string))
+  struct string_char_byte_cache *c = string_char_byte_cache_entry (string);
+
+  if (!c->index
+      && STRING_INDEX_MIN_SCAN <= min (min (byte_index,
+					    best_above_byte - byte_index),
+				       eabs (byte_index - c->bytepos)))
+    index_string_positions (c);
+
+  if (c->index)
     {
-      if (string_char_byte_cache_bytepos < byte_index)
+      /* Find the last index entry at or before BYTE_INDEX.  */
+      ptrdiff_t lo = 0, hi = c->nindex;
+      while (1 < hi - lo)
 	{
-	  best_below = string_char_byte_cache_charpos;
-	  best_below_byte = string_char_byte_cache_bytepos;
+	  ptrdiff_t mid = lo + ((hi - lo) >> 1);
+	  if (c->index[mid] <= byte_index)
+	    lo = mid;
+	  else
+	    hi = mid;
 	}
-      else
+      best_below = lo * STRING_INDEX_INTERVAL;
+      best_below_byte = c->index[lo];
+      if (hi < c->nindex)
 	{
-	  best_above = string_char_byte_cache_charpos;
-	  best_above_byte = string_char_byte_cache_bytepos;
+	  best_above = hi * STRING_INDEX_INTERVAL;
+	  best_above_byte = c->index[hi];
 	}
     }
 
+  if (best_below_byte <= c->bytepos && c->bytepos <= byte_index)
+    {
+      best_below = c->charpos;
+      best_below_byte = c->bytepos;
+    }
+  else if (byte_index < c->bytepos && c->bytepos < best_above_byte)
+    {
+      best_above = c->charpos;
+      best_above_byte = c->bytepos;
+    }
+
   if (byte_index - best_below_byte < best_above_byte - byte_index)
     {
       unsigned char *p = SDATA (string) + best_below_byte;
@@ -1012,13 +1181,12 @@ string_byte_to_char (Lisp_Object string, ptrdiff_t byte_index)
       i_byte = p - SDATA (string);
     }
 
-  string_char_byte_cache_bytepos = i_byte;
-  string_char_byte_cache_charpos = i;
-  string_char_byte_cache_string = string;
+  c->bytepos = i_byte;
+  c->charpos = i;
 
   return i;
 }
-
+
 /* Convert STRING to a multibyte string.  */
 
 static Lisp_Object
@@ -1960,21 +2128,38 @@ DEFUN ("reverse", Freverse, Sreverse, 1, 1, 0,
   return new;
 }
 
-/* Sort LIST using PREDICATE, preserving original order of elements
-   considered as equal.  */
+/* Sort LIST using PREDICATE and KEYFUNC, preserving original order of
+   elements considered as equal.  The elements are sorted in a vector
+   and stored back into the cars of LIST, whose conses keep their
+   order.  */
 
 static Lisp_Object
-sort_list (Lisp_Object list, Lisp_Object predicate)
+sort_list (Lisp_Object list, Lisp_Object predicate, Lisp_Object keyfunc)
 {
   ptrdiff_t length = list_length (list);
   if (length < 2)
     return list;
 
-  Lisp_Object tem = Fnthcdr (make_fixnum (length / 2 - 1), list);
-  Lisp_Object back = Fcdr (tem);
-  Fsetcdr (tem, Qnil);
-
-  return merge (Fsort (list, predicate), Fsort (back, predicate), predicate);
+  Lisp_Object *elts;
+  USE_SAFE_ALLOCA;
+  SAFE_ALLOCA_LISP (elts, length);
+  Lisp_Object tail = list;
+  for (ptrdiff_t i = 0; i < length; i++)
+    {
+      elts[i] = XCAR (tail);
+      tail = XCDR (tail);
+    }
+  tim_sort (predicate, keyfunc, elts, length);
+  tail = list;
+  for (ptrdiff_t i = 0; i < length; i++)
+    {
+      /* PREDICATE or KEYFUNC may have cut the list short.  */
+      CHECK_CONS (tail);
+      XSETCAR (tail, elts[i]);
+      tail = XCDR (tail);
+    }
+  SAFE_FREE ();
+  return list;
 }
 
 /* Using PRED to compare, return whether A and B are in order.
@@ -1985,110 +2170,34 @@ inorder (Lisp_Object pred, Lisp_Object a, Lisp_Object b)
   return NILP (call2 (pred, b, a));
 }
 
-/* Using PRED to compare, merge from ALEN-length A and BLEN-length B
-   into DEST.  Argument arrays must be nonempty and must not overlap,
-   except that B might be the last part of DEST.  */
-static void
-merge_vectors (Lisp_Object pred,
-	       ptrdiff_t alen, Lisp_Object const a[restrict VLA_ELEMS (alen)],
-	       ptrdiff_t blen, Lisp_Object const b[VLA_ELEMS (blen)],
-	       Lisp_Object dest[VLA_ELEMS (alen + blen)])
-{
-  eassume (0 < alen && 0 < blen);
-  Lisp_Object const *alim = a + alen;
-  Lisp_Object const *blim = b + blen;
-
-  while (true)
-    {
-      if (inorder (pred, a[0], b[0]))
-	{
-	  *dest++ = *a++;
-	  if (a == alim)
-	    {
-	      if (dest != b)
-		memcpy (dest, b, (blim - b) * sizeof *dest);
-	      return;
-	    }
-	}
-      else
-	{
-	  *dest++ = *b++;
-	  if (b == blim)
-	    {
-	      memcpy (dest, a, (alim - a) * sizeof *dest);
-	      return;
-	    }
-	}
-    }
-}
-
-/* Using PRED to compare, sort LEN-length VEC in place, using TMP for
-   temporary storage.  LEN must be at least 2.  */
-static void
-sort_vector_inplace (Lisp_Object pred, ptrdiff_t len,
-		     Lisp_Object vec[restrict VLA_ELEMS (len)],
-		     Lisp_Object tmp[restrict VLA_ELEMS (len >> 1)])
-{
-  eassume (2 <= len);
-  ptrdiff_t halflen = len >> 1;
-  sort_vector_copy (pred, halflen, vec, tmp);
-  if (1 < len - halflen)
-    sort_vector_inplace (pred, len - halflen, vec + halflen, vec);
-  merge_vectors (pred, halflen, tmp, len - halflen, vec + halflen, vec);
-}
-
-/* Using PRED to compare, sort from LEN-length SRC into DST.
-   Len must be positive.  */
-static void
-sort_vector_copy (Lisp_Object pred, ptrdiff_t len,
-		  Lisp_Object src[restrict VLA_ELEMS (len)],
-		  Lisp_Object dest[restrict VLA_ELEMS (len)])
-{
-  eassume (0 < len);
-  ptrdiff_t halflen = len >> 1;
-  if (halflen < 1)
-    dest[0] = src[0];
-  else
-    {
-      if (1 < halflen)
-	sort_vector_inplace (pred, halflen, src, dest);
-      if (1 < len - halflen)
-	sort_vector_inplace (pred, len - halflen, src + halflen, dest);
-      merge_vectors (pred, halflen, src, len - halflen, src + halflen, dest);
-    }
-}
-
-/* Sort VECTOR in place using PREDICATE, preserving original order of
-   elements considered as equal.  */
+/* Sort VECTOR in place using PREDICATE and KEYFUNC, preserving
+   original order of elements considered as equal.  */
 
 static void
-sort_vector (Lisp_Object vector, Lisp_Object predicate)
+sort_vector (Lisp_Object vector, Lisp_Object predicate, Lisp_Object keyfunc)
 {
-  ptrdiff_t len = ASIZE (vector);
-  if (len < 2)
-    return;
-  ptrdiff_t halflen = len >> 1;
-  Lisp_Object *tmp;
-  USE_SAFE_ALLOCA;
-  SAFE_ALLOCA_LISP (tmp, halflen);
-  for (ptrdiff_t i = 0; i < halflen; i++)
-    tmp[i] = make_fixnum (0);
-  sort_vector_inplace (predicate, len, XVECTOR (vector)->contents, tmp);
-  SAFE_FREE ();
+  tim_sort (predicate, keyfunc, XVECTOR (vector)->contents, ASIZE (vector));
 }
 
-DEFUN ("sort", Fsort, Ssort, 2, 2, 0,
+DEFUN ("sort", Fsort, Ssort, 2, 3, 0,
        doc: /* Sort SEQ, stably, comparing elements using PREDICATE.
 Returns the sorted sequence.  SEQ should be a list or vector.  SEQ is
 modified by side effects.  PREDICATE is called with two elements of
 SEQ, and should return non-nil if the first element should sort before
-the second.  */)
-  (Lisp_Object seq, Lisp_Object predicate)
+the second.
+
+If KEY is non-nil, it should be a function of one argument.  It is
+called once on each element of SEQ, and PREDICATE then compares the
+values it returned instead of the elements themselves.
+
+The sort is faster when SEQ is already partly in order, and when
+PREDICATE is `<', `>' or `string<'.  */)
+  (Lisp_Object seq, Lisp_Object predicate, Lisp_Object key)
 {
   if (CONSP (seq))
-    seq = sort_list (seq, predicate);
+    seq = sort_list (seq, predicate, key);
   else if (VECTORP (seq))
-    sort_vector (seq, predicate);
+    sort_vector (seq, predicate, key);
   else if (!NILP (seq))
     wrong_type_argument (Qlist_or_vector_p, seq);
   return seq;
@@ -2427,10 +2536,9 @@ internal_equal (Lisp_Object o1, Lisp_Object o2, enum equal_kind equal_kind,
 	  return mpz_cmp (*xbignum_val (o1), *xbignum_val (o2)) == 0;
 	if (OVERLAYP (o1))
 	  {
-	    if (!internal_equal (OVERLAY_START (o1), OVERLAY_START (o2),
-				 equal_kind, depth + 1, ht)
-		|| !internal_equal (OVERLAY_END (o1), OVERLAY_END (o2),
-				    equal_kind, depth + 1, ht))
+	    if (OVERLAY_BUFFER (o1) != OVERLAY_BUFFER (o2)
+		|| OVERLAY_START (o1) != OVERLAY_START (o2)
+		|| OVERLAY_END (o1) != OVERLAY_END (o2))
 	      return false;
 	    o1 = XOVERLAY (o1)->plist;
 	    o2 = XOVERLAY (o2)->plist;
@@ -2534,6 +2642,7 @@ DEFUN ("fillarray", Ffillarray, Sfillarray, 2, 2, 0,
 	      if (INT_MULTIPLY_WRAPV (size, len, &product)
 		  || product != size_byte)
 		error ("Attempt to change byte length of a string");
+	      invalidate_string_char_byte_cache (array, 0);
 	      for (idx = 0; idx < size_byte; idx++)
 		*p++ = str[idx % len];
 	    }
@@ -4710,8 +4819,10 @@ sxhash_obj (Lisp_Object obj, int depth)
 	  return sxhash_bool_vector (obj);
 	else if (pvec_type == PVEC_OVERLAY)
 	  {
-	    EMACS_UINT hash = sxhash_obj (OVERLAY_START (obj), depth);
-	    hash = sxhash_combine (hash, sxhash_obj (OVERLAY_END (obj), depth));
+	    EMACS_UINT hash
+	      = sxhash_combine ((intptr_t) OVERLAY_BUFFER (obj),
+				OVERLAY_START (obj));
+	    hash = sxhash_combine (hash, OVERLAY_END (obj));
 	    hash = sxhash_combine (hash, sxhash_obj (XOVERLAY (obj)->plist, depth));
 	    return SXHASH_REDUCE (hash);
 	  }
@@ -5533,8 +5644,7 @@ syms_of_fns (void)
   Voverriding_plist_environment = Qnil;
   DEFSYM (Qoverriding_plist_environment, "overriding-plist-environment");
 
-  staticpro (&string_char_byte_cache_string);
-  string_char_byte_cache_string = Qnil;
+  clear_string_char_byte_cache ();
 
   require_nesting_list = Qnil;
   staticpro (&require_nesting_list);
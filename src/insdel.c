@@ -234,7 +234,7 @@ adjust_suspend_auto_hscroll (ptrdiff_t from, ptrdiff_t to)
 }
 
 
-/* Adjust all markers for a deletion
+/* Adjust all markers and overlays for a deletion
    whose range in bytes is FROM_BYTE to TO_BYTE.
    The range in charpos is FROM to TO.
 
@@ -268,23 +268,27 @@ adjust_markers_for_delete (ptrdiff_t from, ptrdiff_t from_byte,
 	  m->bytepos = from_byte;
 	}
     }
+
+  adjust_charpos_index_for_delete (from, to, to_byte - from_byte);
+  adjust_line_index (from, to, 0);
+  adjust_overlays_for_delete (from, to - from);
 }
 
 
-/* Adjust markers for an insertion that stretches from FROM / FROM_BYTE
-   to TO / TO_BYTE.  We have to relocate the charpos of every marker
-   that points after the insertion (but not their bytepos).
+/* Adjust markers and overlays for an insertion that stretches from
+   FROM / FROM_BYTE to TO / TO_BYTE.  We have to relocate the charpos
+   of every marker that points after the insertion (but not their
+   bytepos).
 
    When a marker points at the insertion point,
    we advance it if either its insertion-type is t
-   or BEFORE_MARKERS is true.  */
+   or BEFORE_MARKERS is true.  Overlay ends follow the same rule.  */
 
 static void
 adjust_markers_for_insert (ptrdiff_t from, ptrdiff_t from_byte,
 			   ptrdiff_t to, ptrdiff_t to_byte, bool before_markers)
 {
   struct Lisp_Marker *m;
-  bool adjusted = 0;
   ptrdiff_t nchars = to - from;
   ptrdiff_t nbytes = to_byte - from_byte;
 
@@ -300,8 +304,6 @@ adjust_markers_for_insert (ptrdiff_t from, ptrdiff_t from_byte,
 	    {
 	      m->bytepos = to_byte;
 	      m->charpos = to;
-	      if (m->insertion_type)
-		adjusted = 1;
 	    }
 	}
       else if (m->bytepos > from_byte)
@@ -311,14 +313,9 @@ adjust_markers_for_insert (ptrdiff_t from, ptrdiff_t from_byte,
 	}
     }
 
-  /* Adjusting only markers whose insertion-type is t may result in
-     - disordered start and end in overlays, and
-     - disordered overlays in the slot `overlays_before' of current_buffer.  */
-  if (adjusted)
-    {
-      fix_start_end_in_overlays (from, to);
-      fix_overlays_before (current_buffer, from, to);
-    }
+  adjust_charpos_index_for_insert (from, nchars, nbytes);
+  adjust_line_index (from, from, nchars);
+  adjust_overlays_for_insert (from, to - from, before_markers);
 }
 
 /* Adjust point for an insertion of NBYTES bytes, which are NCHARS characters.
@@ -339,10 +336,10 @@ adjust_point (ptrdiff_t nchars, ptrdiff_t nbytes)
   eassert (PT_BYTE >= PT && PT_BYTE - PT <= ZV_BYTE - ZV);
 }
 
-/* Adjust markers for a replacement of a text at FROM (FROM_BYTE) of
-   length OLD_CHARS (OLD_BYTES) to a new text of length NEW_CHARS
-   (NEW_BYTES).  It is assumed that OLD_CHARS > 0, i.e., this is not
-   an insertion.  */
+/* Adjust markers and overlays for a replacement of a text at FROM
+   (FROM_BYTE) of length OLD_CHARS (OLD_BYTES) to a new text of length
+   NEW_CHARS (NEW_BYTES).  It is assumed that OLD_CHARS > 0, i.e.,
+   this is not an insertion.  */
 
 static void
 adjust_markers_for_replace (ptrdiff_t from, ptrdiff_t from_byte,
@@ -369,6 +366,16 @@ adjust_markers_for_replace (ptrdiff_t from, ptrdiff_t from_byte,
 	}
     }
 
+  adjust_line_index (from, from + old_chars, new_chars);
+
+  /* Move the checkpoints and overlays the same way: first push
+     everything after the old text past the new text, then collapse the
+     old text.  */
+  adjust_charpos_index_for_insert (from + old_chars, new_chars, new_bytes);
+  adjust_charpos_index_for_delete (from, from + old_chars, old_bytes);
+  adjust_overlays_for_insert (from + old_chars, new_chars, true);
+  adjust_overlays_for_delete (from, old_chars);
+
   check_markers ();
 }
 
@@ -441,7 +448,7 @@ adjust_markers_bytepos (ptrdiff_t from, ptrdiff_t from_byte,
     }
 
   /* Make sure cached charpos/bytepos is invalid.  */
-  clear_charpos_cache (current_buffer);
+  forget_byte_positions (from, to, to_z);
 }
 
 
@@ -929,7 +936,6 @@ insert_1_both (const char *string,
   if (Z - GPT < END_UNCHANGED)
     END_UNCHANGED = Z - GPT;
 
-  adjust_overlays_for_insert (PT, nchars);
   adjust_markers_for_insert (PT, PT_BYTE,
 			     PT + nchars, PT_BYTE + nbytes,
 			     before_markers);
@@ -1055,7 +1061,6 @@ insert_from_string_1 (Lisp_Object string, ptrdiff_t pos, ptrdiff_t pos_byte,
   if (Z - GPT < END_UNCHANGED)
     END_UNCHANGED = Z - GPT;
 
-  adjust_overlays_for_insert (PT, nchars);
   adjust_markers_for_insert (PT, PT_BYTE, PT + nchars,
 			     PT_BYTE + outgoing_nbytes,
 			     before_markers);
@@ -1126,7 +1131,6 @@ insert_from_gap (ptrdiff_t nchars, ptrdiff_t nbytes, bool text_at_gap_tail)
 
   insert_from_gap_1 (nchars, nbytes, text_at_gap_tail);
 
-  adjust_overlays_for_insert (ins_charpos, nchars);
   adjust_markers_for_insert (ins_charpos, ins_bytepos,
 			     ins_charpos + nchars, ins_bytepos + nbytes, 0);
 
@@ -1143,6 +1147,45 @@ insert_from_gap (ptrdiff_t nchars, ptrdiff_t nbytes, bool text_at_gap_tail)
   check_markers ();
 }
 
+/* Insert before markers the NCHARS chars which occupy NBYTES bytes
+   at GPT_ADDR, where the gap must be at point.  Unlike
+   insert_from_gap, this is a complete insertion except for the call
+   to prepare_to_modify_buffer, which the caller must have made before
+   putting the text in the gap.  NCHARS can be zero, to balance that
+   call when nothing is inserted after all.  */
+
+void
+insert_from_gap_before_markers (ptrdiff_t nchars, ptrdiff_t nbytes)
+{
+  ptrdiff_t opoint = PT, opoint_byte = PT_BYTE;
+
+  eassert (GPT == PT);
+  if (nchars > 0)
+    {
+      record_insert (PT, nchars);
+      modiff_incr (&MODIFF);
+      CHARS_MODIFF = MODIFF;
+
+      insert_from_gap_1 (nchars, nbytes, false);
+
+      /* The insert may have been in the unchanged region.  */
+      if (Z - GPT < END_UNCHANGED)
+	END_UNCHANGED = Z - GPT;
+
+      adjust_markers_for_insert (opoint, opoint_byte, opoint + nchars,
+				 opoint_byte + nbytes, true);
+      offset_intervals (current_buffer, opoint, nchars);
+      graft_intervals_into_buffer (NULL, opoint, nchars, current_buffer,
+				   false);
+      adjust_point (nchars, nbytes);
+      check_markers ();
+    }
+
+  signal_after_change (opoint, 0, nchars);
+  if (nchars > 0)
+    update_compositions (opoint, PT, CHECK_BORDER);
+}
+
 /* Insert text from BUF, NCHARS characters starting at CHARPOS, into the
    current buffer.  If the text in BUF has properties, they are absorbed
    into the current buffer.
@@ -1268,7 +1311,6 @@ insert_from_buffer_1 (struct buffer *buf,
   if (Z - GPT < END_UNCHANGED)
     END_UNCHANGED = Z - GPT;
 
-  adjust_overlays_for_insert (PT, nchars);
   adjust_markers_for_insert (PT, PT_BYTE, PT + nchars,
 			     PT_BYTE + outgoing_nbytes,
 			     0);
@@ -1333,11 +1375,6 @@ adjust_after_replace (ptrdiff_t from, ptrdiff_t from_byte,
     record_delete (from, prev_text, false);
   record_insert (from, len);
 
-  if (len > nchars_del)
-    adjust_overlays_for_insert (from, len - nchars_del);
-  else if (len < nchars_del)
-    adjust_overlays_for_delete (from, nchars_del - len);
-
   offset_intervals (current_buffer, from, len - nchars_del);
 
   if (from < PT)
@@ -1521,11 +1558,6 @@ replace_range (ptrdiff_t from, ptrdiff_t to, Lisp_Object new,
 			      from_byte + outgoing_insbytes, 1);
     }
 
-  /* Adjust the overlay center as needed.  This must be done after
-     adjusting the markers that bound the overlays.  */
-  adjust_overlays_for_delete (from, nchars_del);
-  adjust_overlays_for_insert (from, inschars);
-
   offset_intervals (current_buffer, from, inschars - nchars_del);
 
   /* Get the intervals for the part of the string we are inserting--
@@ -1652,14 +1684,6 @@ replace_range_2 (ptrdiff_t from, ptrdiff_t from_byte,
 	}
     }
 
-  /* Adjust the overlay center as needed.  This must be done after
-     adjusting the markers that bound the overlays.  */
-  if (nchars_del != inschars)
-    {
-      adjust_overlays_for_insert (from, inschars);
-      adjust_overlays_for_delete (from + inschars, nchars_del);
-    }
-
   offset_intervals (current_buffer, from, inschars - nchars_del);
 
   /* Relocate point as if it were a marker.  */
@@ -1862,10 +1886,6 @@ del_range_2 (ptrdiff_t from, ptrdiff_t from_byte,
 
   offset_intervals (current_buffer, from, - nchars_del);
 
-  /* Adjust the overlay center as needed.  This must be done after
-     adjusting the markers that bound the overlays.  */
-  adjust_overlays_for_delete (from, nchars_del);
-
   GAP_SIZE += nbytes_del;
   ZV_BYTE -= nbytes_del;
   Z_BYTE -= nbytes_del;
@@ -1902,6 +1922,7 @@ del_range_2 (ptrdiff_t from, ptrdiff_t from_byte,
 modify_text (ptrdiff_t start, ptrdiff_t end)
 {
   prepare_to_modify_buffer (start, end, NULL);
+  adjust_line_index (start, end, end - start);
 
   BUF_COMPUTE_UNCHANGED (current_buffer, start - 1, end);
   if (MODIFF <= SAVE_MODIFF)
@@ -2015,6 +2036,10 @@ prepare_to_modify_buffer (ptrdiff_t start, ptrdiff_t end,
 			  ptrdiff_t *preserve_ptr)
 {
   prepare_to_modify_buffer_1 (start, end, preserve_ptr);
+  /* Copy text mapped from a file before changing it, so that the
+     file can later be written from the buffer.  */
+  if (current_buffer->text->mapped_size)
+    enlarge_buffer_text (current_buffer, 0);
   invalidate_buffer_caches (current_buffer, start, end);
 }
 
@@ -1827,8 +1827,8 @@ adjust_for_invis_intang (ptrdiff_t pos, ptrdiff_t test_offs, ptrdiff_t adj,
 	     == (test_offs == 0 ? 1 : -1))
 	  /* Invisible property is from an overlay.  */
 	  : (test_offs == 0
-	     ? XMARKER (OVERLAY_START (invis_overlay))->insertion_type == 0
-	     : XMARKER (OVERLAY_END (invis_overlay))->insertion_type == 1)))
+	     ? ! XOVERLAY (invis_overlay)->interval->front_advance
+	     : XOVERLAY (invis_overlay)->interval->rear_advance)))
     pos += adj;
 
   return pos;
@@ -0,0 +1,718 @@
+/* Interval trees for overlays.
+
+Copyright (C) 2020 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* The overlays of a buffer are kept in a red-black tree ordered by
+   their start, augmented with the largest end in each subtree (see
+   itree.h).  This makes adding, removing and finding the overlays at
+   a position take logarithmic time, plus the time to visit the
+   overlays actually found.
+
+   Adjusting the overlays for an insertion or a deletion of text also
+   takes logarithmic time, plus the time to visit the overlays that
+   contain the changed text: the subtrees lying entirely after the
+   change are shifted by adding to their offset, instead of visiting
+   each of their nodes.  The shifts are applied lazily whenever a node
+   is visited from the root, so that every function here that walks
+   down the tree sees exact positions.  */
+
+#include <config.h>
+
+#include "itree.h"
+
+/* Apply the pending offset of NODE to NODE itself and hand it down to
+   its children.  The offsets of the ancestors of NODE must already
+   have been applied.  */
+
+static void
+itree_inherit_offset (struct itree_node *node)
+{
+  ptrdiff_t offset = node->offset;
+
+  if (offset == 0)
+    return;
+  node->begin += offset;
+  node->end += offset;
+  node->limit += offset;
+  if (node->left)
+    node->left->offset += offset;
+  if (node->right)
+    node->right->offset += offset;
+  node->offset = 0;
+}
+
+/* Apply the pending offsets of NODE and of all its ancestors.  */
+
+static void
+itree_inherit_path (struct itree_node *node)
+{
+  struct itree_node *path[ITREE_MAX_HEIGHT];
+  int depth = 0;
+
+  for (; node; node = node->parent)
+    {
+      eassert (depth < ITREE_MAX_HEIGHT);
+      path[depth++] = node;
+    }
+  while (depth > 0)
+    itree_inherit_offset (path[--depth]);
+}
+
+/* Return the largest end in the subtree of NODE, computed from the
+   limits of its children.  */
+
+static ptrdiff_t
+itree_newlimit (struct itree_node *node)
+{
+  ptrdiff_t limit = node->end;
+
+  if (node->left)
+    limit = max (limit, node->left->limit + node->left->offset);
+  if (node->right)
+    limit = max (limit, node->right->limit + node->right->offset);
+  return limit;
+}
+
+/* Recompute the limits of NODE and of all its ancestors.  */
+
+static void
+itree_update_limits (struct itree_node *node)
+{
+  for (; node; node = node->parent)
+    node->limit = itree_newlimit (node);
+}
+
+void
+itree_init (struct itree_tree *tree)
+{
+  tree->root = NULL;
+  tree->size = 0;
+}
+
+/* Initialize NODE as a node for the overlay DATA, not in any tree.  */
+
+void
+itree_node_init (struct itree_node *node, bool front_advance,
+		 bool rear_advance, Lisp_Object data)
+{
+  node->parent = node->left = node->right = NULL;
+  node->begin = node->end = node->limit = 0;
+  node->offset = 0;
+  node->data = data;
+  node->red = false;
+  node->front_advance = front_advance;
+  node->rear_advance = rear_advance;
+}
+
+/* Return the start of NODE, taking the offsets of its ancestors into
+   account.  */
+
+ptrdiff_t
+itree_node_begin (struct itree_node *node)
+{
+  ptrdiff_t begin = node->begin;
+
+  for (; node; node = node->parent)
+    begin += node->offset;
+  return begin;
+}
+
+/* Return the end of NODE, taking the offsets of its ancestors into
+   account.  */
+
+ptrdiff_t
+itree_node_end (struct itree_node *node)
+{
+  ptrdiff_t end = node->end;
+
+  for (; node; node = node->parent)
+    end += node->offset;
+  return end;
+}
+
+
+/* Rebalancing.  */
+
+static void
+itree_rotate_left (struct itree_tree *tree, struct itree_node *node)
+{
+  struct itree_node *right = node->right;
+
+  itree_inherit_offset (node);
+  itree_inherit_offset (right);
+
+  node->right = right->left;
+  if (right->left)
+    right->left->parent = node;
+  right->parent = node->parent;
+  if (!node->parent)
+    tree->root = right;
+  else if (node == node->parent->left)
+    node->parent->left = right;
+  else
+    node->parent->right = right;
+  right->left = node;
+  node->parent = right;
+
+  node->limit = itree_newlimit (node);
+  right->limit = itree_newlimit (right);
+}
+
+static void
+itree_rotate_right (struct itree_tree *tree, struct itree_node *node)
+{
+  struct itree_node *left = node->left;
+
+  itree_inherit_offset (node);
+  itree_inherit_offset (left);
+
+  node->left = left->right;
+  if (left->right)
+    left->right->parent = node;
+  left->parent = node->parent;
+  if (!node->parent)
+    tree->root = left;
+  else if (node == node->parent->right)
+    node->parent->right = left;
+  else
+    node->parent->left = left;
+  left->right = node;
+  node->parent = left;
+
+  node->limit = itree_newlimit (node);
+  left->limit = itree_newlimit (left);
+}
+
+static bool
+itree_red_p (struct itree_node *node)
+{
+  return node && node->red;
+}
+
+/* Restore the red-black properties after inserting NODE.  */
+
+static void
+itree_insert_fix (struct itree_tree *tree, struct itree_node *node)
+{
+  while (itree_red_p (node->parent))
+    {
+      struct itree_node *parent = node->parent;
+      struct itree_node *grandparent = parent->parent;
+
+      if (parent == grandparent->left)
+	{
+	  struct itree_node *uncle = grandparent->right;
+
+	  if (itree_red_p (uncle))
+	    {
+	      parent->red = false;
+	      uncle->red = false;
+	      grandparent->red = true;
+	      node = grandparent;
+	    }
+	  else
+	    {
+	      if (node == parent->right)
+		{
+		  node = parent;
+		  itree_rotate_left (tree, node);
+		  parent = node->parent;
+		}
+	      parent->red = false;
+	      grandparent->red = true;
+	      itree_rotate_right (tree, grandparent);
+	    }
+	}
+      else
+	{
+	  struct itree_node *uncle = grandparent->left;
+
+	  if (itree_red_p (uncle))
+	    {
+	      parent->red = false;
+	      uncle->red = false;
+	      grandparent->red = true;
+	      node = grandparent;
+	    }
+	  else
+	    {
+	      if (node == parent->left)
+		{
+		  node = parent;
+		  itree_rotate_right (tree, node);
+		  parent = node->parent;
+		}
+	      parent->red = false;
+	      grandparent->red = true;
+	      itree_rotate_left (tree, grandparent);
+	    }
+	}
+    }
+  tree->root->red = false;
+}
+
+/* Restore the red-black properties after removing a black node, whose
+   place was taken by NODE (possibly null) as a child of PARENT.  */
+
+static void
+itree_remove_fix (struct itree_tree *tree, struct itree_node *node,
+		  struct itree_node *parent)
+{
+  while (parent && !itree_red_p (node))
+    {
+      if (node == parent->left)
+	{
+	  struct itree_node *other = parent->right;
+
+	  if (other->red)
+	    {
+	      other->red = false;
+	      parent->red = true;
+	      itree_rotate_left (tree, parent);
+	      other = parent->right;
+	    }
+	  if (!itree_red_p (other->left) && !itree_red_p (other->right))
+	    {
+	      other->red = true;
+	      node = parent;
+	      parent = node->parent;
+	    }
+	  else
+	    {
+	      if (!itree_red_p (other->right))
+		{
+		  other->left->red = false;
+		  other->red = true;
+		  itree_rotate_right (tree, other);
+		  other = parent->right;
+		}
+	      other->red = parent->red;
+	      parent->red = false;
+	      other->right->red = false;
+	      itree_rotate_left (tree, parent);
+	      node = tree->root;
+	      parent = NULL;
+	    }
+	}
+      else
+	{
+	  struct itree_node *other = parent->left;
+
+	  if (other->red)
+	    {
+	      other->red = false;
+	      parent->red = true;
+	      itree_rotate_right (tree, parent);
+	      other = parent->left;
+	    }
+	  if (!itree_red_p (other->right) && !itree_red_p (other->left))
+	    {
+	      other->red = true;
+	      node = parent;
+	      parent = node->parent;
+	    }
+	  else
+	    {
+	      if (!itree_red_p (other->left))
+		{
+		  other->right->red = false;
+		  other->red = true;
+		  itree_rotate_left (tree, other);
+		  other = parent->left;
+		}
+	      other->red = parent->red;
+	      parent->red = false;
+	      other->left->red = false;
+	      itree_rotate_right (tree, parent);
+	      node = tree->root;
+	      parent = NULL;
+	    }
+	}
+    }
+  if (node)
+    node->red = false;
+}
+
+
+/* Insertion and removal.  */
+
+/* Insert NODE into TREE as the interval from BEGIN to END.  */
+
+void
+itree_insert (struct itree_tree *tree, struct itree_node *node,
+	      ptrdiff_t begin, ptrdiff_t end)
+{
+  struct itree_node *parent = NULL;
+  struct itree_node *child = tree->root;
+
+  eassert (begin <= end && !node->parent && node != tree->root);
+
+  while (child)
+    {
+      itree_inherit_offset (child);
+      child->limit = max (child->limit, end);
+      parent = child;
+      child = begin < child->begin ? child->left : child->right;
+    }
+
+  node->parent = parent;
+  node->left = node->right = NULL;
+  node->begin = begin;
+  node->end = end;
+  node->limit = end;
+  node->offset = 0;
+  node->red = true;
+  if (!parent)
+    tree->root = node;
+  else if (begin < parent->begin)
+    parent->left = node;
+  else
+    parent->right = node;
+  tree->size++;
+
+  itree_insert_fix (tree, node);
+}
+
+/* Replace DEST with SOURCE, which may be null, as a child of DEST's
+   parent.  */
+
+static void
+itree_transplant (struct itree_tree *tree, struct itree_node *source,
+		  struct itree_node *dest)
+{
+  if (!dest->parent)
+    tree->root = source;
+  else if (dest == dest->parent->left)
+    dest->parent->left = source;
+  else
+    dest->parent->right = source;
+  if (source)
+    source->parent = dest->parent;
+}
+
+/* Remove NODE from TREE.  Its BEGIN and END fields keep its last
+   positions.  */
+
+void
+itree_remove (struct itree_tree *tree, struct itree_node *node)
+{
+  struct itree_node *child, *parent;
+  bool removed_red;
+
+  itree_inherit_path (node);
+
+  if (!node->left || !node->right)
+    {
+      child = node->left ? node->left : node->right;
+      parent = node->parent;
+      removed_red = node->red;
+      itree_transplant (tree, child, node);
+    }
+  else
+    {
+      /* Replace NODE by its successor.  */
+      struct itree_node *next = node->right;
+
+      itree_inherit_offset (next);
+      while (next->left)
+	{
+	  next = next->left;
+	  itree_inherit_offset (next);
+	}
+      child = next->right;
+      removed_red = next->red;
+      if (next->parent == node)
+	parent = next;
+      else
+	{
+	  parent = next->parent;
+	  itree_transplant (tree, next->right, next);
+	  next->right = node->right;
+	  next->right->parent = next;
+	}
+      itree_transplant (tree, next, node);
+      next->left = node->left;
+      next->left->parent = next;
+      next->red = node->red;
+    }
+
+  itree_update_limits (parent);
+  if (!removed_red)
+    itree_remove_fix (tree, child, parent);
+
+  node->parent = node->left = node->right = NULL;
+  node->limit = node->end;
+  tree->size--;
+}
+
+
+/* Adjusting for changes in the text.  */
+
+static void
+itree_insert_gap_1 (struct itree_node *node, ptrdiff_t pos,
+		    ptrdiff_t length, bool before_markers)
+{
+  if (!node)
+    return;
+  itree_inherit_offset (node);
+  if (node->limit < pos)
+    return;
+
+  bool shift_begin = node->begin > pos || (before_markers
+					   && node->begin == pos);
+
+  /* If NODE moves, so does every node after it.  */
+  if (!shift_begin)
+    itree_insert_gap_1 (node->right, pos, length, before_markers);
+  else if (node->right)
+    node->right->offset += length;
+  itree_insert_gap_1 (node->left, pos, length, before_markers);
+
+  if (shift_begin)
+    node->begin += length;
+  if (node->end > pos
+      || (node->end == pos && (before_markers || node->rear_advance)))
+    node->end += length;
+  node->limit = itree_newlimit (node);
+}
+
+/* Adjust the nodes of TREE for the insertion of LENGTH characters at
+   POS.  An interval starting at POS is pushed forward if it has
+   front_advance, unless that would put its start after its end; an
+   interval ending at POS is extended if it has rear_advance.  If
+   BEFORE_MARKERS, all the intervals starting or ending at POS are
+   moved, as markers are by `insert-before-markers'.  */
+
+void
+itree_insert_gap (struct itree_tree *tree, ptrdiff_t pos, ptrdiff_t length,
+		  bool before_markers)
+{
+  struct itree_node **moving = NULL;
+  ptrdiff_t nmoving = 0, size = 0;
+
+  if (!tree->root || length <= 0)
+    return;
+
+  /* The nodes starting at POS that advance would pass the ones that
+     don't, which can be anywhere in the tree relative to them.  Take
+     them out of the tree and reinsert them in the right place.  */
+  if (!before_markers)
+    {
+      struct itree_iterator it;
+      struct itree_node *node;
+
+      itree_iterator_start (&it, tree, pos, pos);
+      while ((node = itree_iterator_next (&it)))
+	if (node->begin == pos && node->front_advance
+	    && (node->begin != node->end || node->rear_advance))
+	  {
+	    if (nmoving == size)
+	      moving = xpalloc (moving, &size, 1, -1, sizeof *moving);
+	    moving[nmoving++] = node;
+	  }
+      for (ptrdiff_t i = 0; i < nmoving; i++)
+	itree_remove (tree, moving[i]);
+    }
+
+  itree_insert_gap_1 (tree->root, pos, length, before_markers);
+
+  for (ptrdiff_t i = 0; i < nmoving; i++)
+    itree_insert (tree, moving[i], pos + length, moving[i]->end + length);
+  xfree (moving);
+}
+
+static void
+itree_delete_gap_1 (struct itree_node *node, ptrdiff_t pos, ptrdiff_t length)
+{
+  if (!node)
+    return;
+  itree_inherit_offset (node);
+  if (node->limit <= pos)
+    return;
+
+  if (node->begin >= pos + length)
+    {
+      if (node->right)
+	node->right->offset -= length;
+    }
+  else
+    itree_delete_gap_1 (node->right, pos, length);
+  itree_delete_gap_1 (node->left, pos, length);
+
+  if (node->begin > pos)
+    node->begin = max (pos, node->begin - length);
+  if (node->end > pos)
+    node->end = max (pos, node->end - length);
+  node->limit = itree_newlimit (node);
+}
+
+/* Adjust the nodes of TREE for the deletion of LENGTH characters at
+   POS.  Intervals inside the deleted text shrink to POS.  */
+
+void
+itree_delete_gap (struct itree_tree *tree, ptrdiff_t pos, ptrdiff_t length)
+{
+  if (length > 0)
+    itree_delete_gap_1 (tree->root, pos, length);
+}
+
+static void
+itree_map_positions_1 (struct itree_node *node, ptrdiff_t (*fn) (ptrdiff_t))
+{
+  if (!node)
+    return;
+  itree_inherit_offset (node);
+  itree_map_positions_1 (node->left, fn);
+  itree_map_positions_1 (node->right, fn);
+  node->begin = fn (node->begin);
+  node->end = fn (node->end);
+  node->limit = itree_newlimit (node);
+}
+
+/* Replace each position in TREE by the value of FN for it.  FN must
+   be monotonic, so that the nodes stay in order.  */
+
+void
+itree_map_positions (struct itree_tree *tree, ptrdiff_t (*fn) (ptrdiff_t))
+{
+  itree_map_positions_1 (tree->root, fn);
+}
+
+
+/* Queries.  */
+
+static ptrdiff_t
+itree_next_boundary_1 (struct itree_node *node, ptrdiff_t pos,
+		       ptrdiff_t best)
+{
+  while (node)
+    {
+      itree_inherit_offset (node);
+      if (node->limit <= pos)
+	break;
+      if (node->begin > pos)
+	{
+	  /* The nodes after this one start no earlier than it.  */
+	  best = min (best, node->begin);
+	  node = node->left;
+	}
+      else
+	{
+	  if (node->end > pos)
+	    best = min (best, node->end);
+	  best = itree_next_boundary_1 (node->left, pos, best);
+	  node = node->right;
+	}
+    }
+  return best;
+}
+
+/* Return the first start or end of an interval in TREE after POS, or
+   LIMIT if there is none before it.  */
+
+ptrdiff_t
+itree_next_boundary (struct itree_tree *tree, ptrdiff_t pos, ptrdiff_t limit)
+{
+  return itree_next_boundary_1 (tree->root, pos, limit);
+}
+
+static ptrdiff_t
+itree_previous_boundary_1 (struct itree_node *node, ptrdiff_t pos,
+			   ptrdiff_t best)
+{
+  while (node)
+    {
+      itree_inherit_offset (node);
+      if (node->begin < pos)
+	{
+	  best = max (best, node->begin);
+	  if (node->end < pos)
+	    best = max (best, node->end);
+	  best = itree_previous_boundary_1 (node->right, pos, best);
+	  /* The nodes before this one can only contribute their ends.  */
+	  if (!node->left || node->left->limit + node->left->offset <= best)
+	    break;
+	}
+      node = node->left;
+    }
+  return best;
+}
+
+/* Return the last start or end of an interval in TREE before POS, or
+   LIMIT if there is none after it.  */
+
+ptrdiff_t
+itree_previous_boundary (struct itree_tree *tree, ptrdiff_t pos,
+			 ptrdiff_t limit)
+{
+  return itree_previous_boundary_1 (tree->root, pos, limit);
+}
+
+
+/* Iteration.  */
+
+/* Push NODE and its chain of left children onto the stack of IT,
+   leaving out the subtrees that end before the range of IT.  */
+
+static void
+itree_iterator_descend (struct itree_iterator *it, struct itree_node *node)
+{
+  for (; node; node = node->left)
+    {
+      itree_inherit_offset (node);
+      if (node->limit < it->begin)
+	break;
+      eassert (it->depth < ITREE_MAX_HEIGHT);
+      it->stack[it->depth++] = node;
+    }
+}
+
+/* Start iterating over the nodes of TREE that intersect the range
+   from BEGIN to END, both included.  */
+
+void
+itree_iterator_start (struct itree_iterator *it, struct itree_tree *tree,
+		      ptrdiff_t begin, ptrdiff_t end)
+{
+  it->depth = 0;
+  it->begin = begin;
+  it->end = end;
+  itree_iterator_descend (it, tree->root);
+}
+
+/* Return the next node of IT, or NULL if there are no more.  */
+
+struct itree_node *
+itree_iterator_next (struct itree_iterator *it)
+{
+  while (it->depth > 0)
+    {
+      struct itree_node *node = it->stack[--it->depth];
+
+      /* The nodes that remain start no earlier than this one.  */
+      if (node->begin > it->end)
+	{
+	  it->depth = 0;
+	  break;
+	}
+      itree_iterator_descend (it, node->right);
+      if (node->end >= it->begin)
+	return node;
+    }
+  return NULL;
+}
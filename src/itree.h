@@ -0,0 +1,113 @@
+/* Interval trees for overlays.
+
+Copyright (C) 2020 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
+
+#ifndef EMACS_ITREE_H
+#define EMACS_ITREE_H
+
+#include <config.h>
+
+#include "lisp.h"
+
+/* A node of an interval tree: a red-black tree ordered by the start
+   of the intervals, where each node also records the largest end of
+   any interval in its subtree.
+
+   Text insertions and deletions shift the positions of all the
+   intervals after them.  To do that in logarithmic time, a shift can
+   be recorded in OFFSET instead of being applied right away; it then
+   applies to the node itself and to its whole subtree, and is pushed
+   down to the children the next time the node is visited.  Thus the
+   BEGIN, END and LIMIT fields of a node are only accurate after
+   adding the offsets of all its ancestors; use itree_node_begin and
+   itree_node_end to read them from outside.  */
+
+struct itree_node
+{
+  struct itree_node *parent;
+  struct itree_node *left;
+  struct itree_node *right;
+
+  /* The interval runs from BEGIN to END.  */
+  ptrdiff_t begin;
+  ptrdiff_t end;
+
+  /* The largest END in this subtree.  */
+  ptrdiff_t limit;
+
+  /* Shift still to be applied to this node and its subtree.  */
+  ptrdiff_t offset;
+
+  /* The overlay this node belongs to.  */
+  Lisp_Object data;
+
+  bool_bf red : 1;
+
+  /* Whether text inserted at BEGIN goes before the interval, and
+     whether text inserted at END goes inside it; these are the
+     insertion types of the overlay's start and end.  */
+  bool_bf front_advance : 1;
+  bool_bf rear_advance : 1;
+};
+
+struct itree_tree
+{
+  struct itree_node *root;
+
+  /* Number of nodes in the tree.  */
+  intmax_t size;
+};
+
+/* Twice the binary logarithm of the largest possible number of nodes
+   bounds the height of a red-black tree.  */
+enum { ITREE_MAX_HEIGHT = 2 * CHAR_BIT * sizeof (ptrdiff_t) };
+
+/* An iterator over the nodes intersecting the range [BEGIN, END],
+   which returns them in order of their start.  The tree must not be
+   modified while an iterator is in use, but the positions of the
+   returned nodes can be read directly from their BEGIN and END
+   fields.  */
+
+struct itree_iterator
+{
+  struct itree_node *stack[ITREE_MAX_HEIGHT];
+  int depth;
+  ptrdiff_t begin;
+  ptrdiff_t end;
+};
+
+extern void itree_init (struct itree_tree *);
+extern void itree_node_init (struct itree_node *, bool, bool, Lisp_Object);
+extern ptrdiff_t itree_node_begin (struct itree_node *);
+extern ptrdiff_t itree_node_end (struct itree_node *);
+extern void itree_insert (struct itree_tree *, struct itree_node *,
+			  ptrdiff_t, ptrdiff_t);
+extern void itree_remove (struct itree_tree *, struct itree_node *);
+extern void itree_insert_gap (struct itree_tree *, ptrdiff_t, ptrdiff_t, bool);
+extern void itree_delete_gap (struct itree_tree *, ptrdiff_t, ptrdiff_t);
+extern void itree_map_positions (struct itree_tree *,
+				 ptrdiff_t (*) (ptrdiff_t));
+extern ptrdiff_t itree_next_boundary (struct itree_tree *, ptrdiff_t,
+				      ptrdiff_t);
+extern ptrdiff_t itree_previous_boundary (struct itree_tree *, ptrdiff_t,
+					  ptrdiff_t);
+extern void itree_iterator_start (struct itree_iterator *,
+				  struct itree_tree *, ptrdiff_t, ptrdiff_t);
+extern struct itree_node *itree_iterator_next (struct itree_iterator *);
+
+#endif /* EMACS_ITREE_H */
@@ -1647,8 +1647,8 @@ adjust_point_for_property (ptrdiff_t last_pt, bool modified)
 	  && display_prop_intangible_p (val, overlay, PT, PT_BYTE)
 	  && (!OVERLAYP (overlay)
 	      ? get_property_and_range (PT, Qdisplay, &val, &beg, &end, Qnil)
-	      : (beg = OVERLAY_POSITION (OVERLAY_START (overlay)),
-		 end = OVERLAY_POSITION (OVERLAY_END (overlay))))
+	      : (beg = OVERLAY_START (overlay),
+		 end = OVERLAY_END (overlay)))
 	  && (beg < PT /* && end > PT   <- It's always the case.  */
 	      || (beg <= PT && STRINGP (val) && SCHARS (val) == 0)))
 	{
@@ -2749,6 +2749,25 @@ read_char (int commandflag, Lisp_Object map,
       /* If there is still no input available, ask for GC.  */
       if (!detect_input_pending_run_timers (0))
 	maybe_gc ();
+
+      /* If the next collection would take longer than
+	 `gc-pause-budget', do it now, once the user has paused for a
+	 while, rather than in the middle of a later command.  */
+      if (gc_idle_collection_due_p ()
+	  && !detect_input_pending_run_timers (0))
+	{
+	  Lisp_Object tem0;
+	  ptrdiff_t count1 = SPECPDL_INDEX ();
+	  save_getcjmp (save_jump);
+	  record_unwind_protect_ptr (restore_getcjmp, save_jump);
+	  restore_getcjmp (local_getcjmp);
+	  tem0 = sit_for (make_fixnum (1), 1, 1);
+	  unbind_to (count1, Qnil);
+
+	  if (EQ (tem0, Qt)
+	      && ! CONSP (Vunread_command_events))
+	    Fgarbage_collect ();
+	}
     }
 
   /* Notify the caller if an autosave hook, or a timer, sentinel or
@@ -3558,7 +3558,7 @@ DEFUN ("apropos-internal", Fapropos_internal, Sapropos_internal, 1, 2, 0,
   apropos_predicate = predicate;
   apropos_accumulate = Qnil;
   map_obarray (Vobarray, apropos_accum, regexp);
-  tem = Fsort (apropos_accumulate, Qstring_lessp);
+  tem = Fsort (apropos_accumulate, Qstring_lessp, Qnil);
   apropos_accumulate = Qnil;
   apropos_predicate = Qnil;
   return tem;
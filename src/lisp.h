@@ -837,6 +837,11 @@ #define XUNTAG(a, type, ctype) ((ctype *) \
       /* True if pointed to from purespace and hence can't be GC'd.  */
       bool_bf pinned : 1;
 
+      /* Hash code of the symbol's name, truncated to 32 bits.  Valid
+	 only if the symbol is interned; oblookup compares it before
+	 the name itself.  */
+      uint_least32_t name_hash;
+
       /* The symbol's name, as a Lisp string.  */
       Lisp_Object name;
 
@@ -2506,26 +2511,17 @@ SXHASH_REDUCE (EMACS_UINT x)
   ptrdiff_t bytepos;
 } GCALIGNED_STRUCT;
 
-/* START and END are markers in the overlay's buffer, and
-   PLIST is the overlay's property list.  */
+/* PLIST is the overlay's property list.  BUFFER is the buffer the
+   overlay is in, or null if it has been deleted.  INTERVAL is the
+   overlay's node in the interval tree of BUFFER's overlays, which
+   holds its positions and the insertion types of its ends; it stays
+   allocated while the overlay is not in any buffer.  */
 struct Lisp_Overlay
-/* An overlay's real data content is:
-   - plist
-   - buffer (really there are two buffer pointers, one per marker,
-     and both points to the same buffer)
-   - insertion type of both ends (per-marker fields)
-   - start & start byte (of start marker)
-   - end & end byte (of end marker)
-   - next (singly linked list of overlays)
-   - next fields of start and end markers (singly linked list of markers).
-   I.e. 9words plus 2 bits, 3words of which are for external linked lists.
-*/
   {
     union vectorlike_header header;
-    Lisp_Object start;
-    Lisp_Object end;
     Lisp_Object plist;
-    struct Lisp_Overlay *next;
+    struct buffer *buffer;
+    struct itree_node *interval;
   } GCALIGNED_STRUCT;
 
 struct Lisp_Misc_Ptr
@@ -3661,12 +3657,17 @@ #define CONS_TO_INTEGER(cons, type, var)				\
 extern Lisp_Object assq_no_quit (Lisp_Object, Lisp_Object);
 extern Lisp_Object assoc_no_quit (Lisp_Object, Lisp_Object);
 extern void clear_string_char_byte_cache (void);
+extern void invalidate_string_char_byte_cache (Lisp_Object, ptrdiff_t);
+extern void sweep_string_char_byte_cache (void);
 extern ptrdiff_t string_char_to_byte (Lisp_Object, ptrdiff_t);
 extern ptrdiff_t string_byte_to_char (Lisp_Object, ptrdiff_t);
 extern Lisp_Object string_to_multibyte (Lisp_Object);
 extern Lisp_Object string_make_unibyte (Lisp_Object);
 extern void syms_of_fns (void);
 
+/* Defined in sort.c.  */
+extern void tim_sort (Lisp_Object, Lisp_Object, Lisp_Object *, ptrdiff_t);
+
 /* Defined in floatfns.c.  */
 verify (FLT_RADIX == 2 || FLT_RADIX == 16);
 enum { LOG2_FLT_RADIX = FLT_RADIX == 2 ? 1 : 4 };
@@ -3712,6 +3713,7 @@ verify (FLT_RADIX == 2 || FLT_RADIX == 16);
 			   bool, bool, bool);
 extern void insert_from_gap_1 (ptrdiff_t, ptrdiff_t, bool text_at_gap_tail);
 extern void insert_from_gap (ptrdiff_t, ptrdiff_t, bool text_at_gap_tail);
+extern void insert_from_gap_before_markers (ptrdiff_t, ptrdiff_t);
 extern void insert_from_string (Lisp_Object, ptrdiff_t, ptrdiff_t,
 				ptrdiff_t, ptrdiff_t, bool);
 extern void insert_from_buffer (struct buffer *, ptrdiff_t, ptrdiff_t, bool);
@@ -3820,6 +3822,7 @@ flush_stack_call_func (void (*func) (void *arg), void *arg)
 
 extern void garbage_collect (void);
 extern void maybe_garbage_collect (void);
+extern bool gc_idle_collection_due_p (void);
 extern const char *pending_malloc_warning;
 extern Lisp_Object zero_vector;
 extern EMACS_INT consing_until_gc;
@@ -3997,10 +4000,35 @@ #define ALLOCATE_ZEROED_PSEUDOVECTOR(type, field, tag)		       \
 				   VECSIZE (type), tag))
 
 extern bool gc_in_progress;
+
+/* Phases of a garbage collection, as reported by `gc-statistics' and
+   the CPU profiler.  GC_PHASE_NONE covers whatever is not part of any
+   other phase, and is also the phase outside of GC.  */
+enum gc_phase
+  {
+    GC_PHASE_NONE,
+    GC_PHASE_MARK,
+    GC_PHASE_MARK_STACK,
+    GC_PHASE_FONT_CACHES,
+    GC_PHASE_UNDO_LISTS,
+    GC_PHASE_FINALIZERS,
+    GC_PHASE_WEAK_TABLES,
+    GC_PHASE_SWEEP_STRINGS,
+    GC_PHASE_COMPACT_STRINGS,
+    GC_PHASE_SWEEP_CONSES_AND_FLOATS,
+    GC_PHASE_SWEEP_INTERVALS,
+    GC_PHASE_SWEEP_SYMBOLS,
+    GC_PHASE_SWEEP_MISCS,
+    GC_PHASE_SWEEP_BUFFERS,
+    GC_PHASE_SWEEP_VECTORS,
+    GC_PHASE_COUNT
+  };
+extern enum gc_phase gc_current_phase;
+extern Lisp_Object gc_phase_symbol (enum gc_phase);
 extern Lisp_Object make_float (double);
 extern void display_malloc_warning (void);
 extern ptrdiff_t inhibit_garbage_collection (void);
-extern Lisp_Object build_overlay (Lisp_Object, Lisp_Object, Lisp_Object);
+extern Lisp_Object build_overlay (bool, bool, Lisp_Object);
 extern void free_cons (struct Lisp_Cons *);
 extern void init_alloc_once (void);
 extern void init_alloc (void);
@@ -4262,14 +4290,17 @@ XMODULE_FUNCTION (Lisp_Object o)
 extern bool mouse_face_overlay_overlaps (Lisp_Object);
 extern Lisp_Object disable_line_numbers_overlay_at_eob (void);
 extern AVOID nsberror (Lisp_Object);
-extern void adjust_overlays_for_insert (ptrdiff_t, ptrdiff_t);
+extern void adjust_overlays_for_insert (ptrdiff_t, ptrdiff_t, bool);
 extern void adjust_overlays_for_delete (ptrdiff_t, ptrdiff_t);
-extern void fix_start_end_in_overlays (ptrdiff_t, ptrdiff_t);
+extern void transpose_overlays (ptrdiff_t, ptrdiff_t, ptrdiff_t, ptrdiff_t);
 extern void report_overlay_modification (Lisp_Object, Lisp_Object, bool,
                                          Lisp_Object, Lisp_Object, Lisp_Object);
 extern bool overlay_touches_p (ptrdiff_t);
 extern Lisp_Object other_buffer_safely (Lisp_Object);
 extern Lisp_Object get_truename_buffer (Lisp_Object);
+extern bool volatile mapped_text_truncated;
+extern bool handle_mapped_text_fault (void *);
+extern void report_mapped_text_truncation (void);
 extern void init_buffer_once (void);
 extern void init_buffer (void);
 extern void syms_of_buffer (void);
@@ -4280,6 +4311,9 @@ XMODULE_FUNCTION (Lisp_Object o)
 extern ptrdiff_t marker_position (Lisp_Object);
 extern ptrdiff_t marker_byte_position (Lisp_Object);
 extern void clear_charpos_cache (struct buffer *);
+extern void adjust_charpos_index_for_insert (ptrdiff_t, ptrdiff_t, ptrdiff_t);
+extern void adjust_charpos_index_for_delete (ptrdiff_t, ptrdiff_t, ptrdiff_t);
+extern void forget_byte_positions (ptrdiff_t, ptrdiff_t, bool);
 extern ptrdiff_t buf_charpos_to_bytepos (struct buffer *, ptrdiff_t);
 extern ptrdiff_t buf_bytepos_to_charpos (struct buffer *, ptrdiff_t);
 extern void detach_marker (Lisp_Object);
@@ -4318,6 +4352,7 @@ XMODULE_FUNCTION (Lisp_Object o)
 
 /* Defined in search.c.  */
 extern void shrink_regexp_cache (void);
+extern void mark_regexp_cache (void);
 extern void restore_search_regs (void);
 extern void update_search_regs (ptrdiff_t oldstart,
                                 ptrdiff_t oldend, ptrdiff_t newend);
@@ -4341,6 +4376,12 @@ fast_string_match_ignore_case (Lisp_Object regexp, Lisp_Object string)
 						  ptrdiff_t);
 extern ptrdiff_t fast_looking_at (Lisp_Object, ptrdiff_t, ptrdiff_t,
                                   ptrdiff_t, ptrdiff_t, Lisp_Object);
+/* The distance between the checkpoints of the line index, in
+   characters, and the number of newlines worth looking for with it.  */
+enum { LINE_INDEX_INTERVAL = 16384, LINE_INDEX_MIN_COUNT = 256 };
+extern void clear_line_index (struct buffer *);
+extern void adjust_line_index (ptrdiff_t, ptrdiff_t, ptrdiff_t);
+extern ptrdiff_t buf_charpos_to_line (struct buffer *, ptrdiff_t);
 extern ptrdiff_t find_newline (ptrdiff_t, ptrdiff_t, ptrdiff_t, ptrdiff_t,
 			       ptrdiff_t, ptrdiff_t *, ptrdiff_t *, bool);
 extern void scan_newline (ptrdiff_t, ptrdiff_t, ptrdiff_t, ptrdiff_t,
@@ -4606,6 +4647,8 @@ maybe_disable_address_randomization (int argc, char **argv)
 extern ptrdiff_t emacs_write (int, void const *, ptrdiff_t);
 extern ptrdiff_t emacs_write_sig (int, void const *, ptrdiff_t);
 extern ptrdiff_t emacs_write_quit (int, void const *, ptrdiff_t);
+extern ptrdiff_t emacs_write2_quit (int, void const *, ptrdiff_t,
+				   void const *, ptrdiff_t);
 extern void emacs_perror (char const *);
 extern int renameat_noreplace (int, char const *, int, char const *);
 extern int str_collate (Lisp_Object, Lisp_Object, Lisp_Object, Lisp_Object);
@@ -4733,6 +4776,10 @@ maybe_disable_address_randomization (int argc, char **argv)
 /* Defined in profiler.c.  */
 extern bool profiler_memory_running;
 extern void malloc_probe (size_t);
+extern bool profiler_allocation_running;
+extern void allocation_probe (Lisp_Object, Lisp_Object, INTERVAL, size_t);
+extern void allocation_check_survivors (void);
+extern void allocation_record_survivors (void);
 extern void syms_of_profiler (void);
 
 
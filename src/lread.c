@@ -4107,6 +4107,9 @@ intern_sym (Lisp_Object sym, Lisp_Object obarray, Lisp_Object index)
       SET_SYMBOL_VAL (XSYMBOL (sym), sym);
     }
 
+  Lisp_Object name = SYMBOL_NAME (sym);
+  XSYMBOL (sym)->u.s.name_hash = hash_string (SSDATA (name), SBYTES (name));
+
   ptr = aref_addr (obarray, XFIXNUM (index));
   set_symbol_next (sym, SYMBOLP (*ptr) ? XSYMBOL (*ptr) : NULL);
   *ptr = sym;
@@ -4296,20 +4299,26 @@ DEFUN ("unintern", Funintern, Sunintern, 1, 2, 0,
    If there is no such symbol, return the integer bucket number of
    where the symbol would be if it were present.
 
-   Also store the bucket number in oblookup_last_bucket_number.  */
+   Also store the bucket number in oblookup_last_bucket_number.
+
+   Each interned symbol records the hash code of its name, so that the
+   names of the other symbols in the bucket need not be looked at.  */
 
 Lisp_Object
 oblookup (Lisp_Object obarray, register const char *ptr, ptrdiff_t size, ptrdiff_t size_byte)
 {
   size_t hash;
   size_t obsize;
+  uint_least32_t name_hash;
   register Lisp_Object tail;
   Lisp_Object bucket, tem;
 
   obarray = check_obarray (obarray);
   /* This is sometimes needed in the middle of GC.  */
   obsize = gc_asize (obarray);
-  hash = hash_string (ptr, size_byte) % obsize;
+  hash = hash_string (ptr, size_byte);
+  name_hash = hash;
+  hash %= obsize;
   bucket = AREF (obarray, hash);
   oblookup_last_bucket_number = hash;
   if (EQ (bucket, make_fixnum (0)))
@@ -4319,7 +4328,8 @@ oblookup (Lisp_Object obarray, register const char *ptr, ptrdiff_t size, ptrdiff
   else
     for (tail = bucket; ; XSETSYMBOL (tail, XSYMBOL (tail)->u.s.next))
       {
-	if (SBYTES (SYMBOL_NAME (tail)) == size_byte
+	if (XSYMBOL (tail)->u.s.name_hash == name_hash
+	    && SBYTES (SYMBOL_NAME (tail)) == size_byte
 	    && SCHARS (SYMBOL_NAME (tail)) == size
 	    && !memcmp (SDATA (SYMBOL_NAME (tail)), ptr, size_byte))
 	  return tail;
@@ -4368,7 +4378,10 @@ DEFUN ("mapatoms", Fmapatoms, Smapatoms, 1, 2, 0,
   return Qnil;
 }
 
-#define OBARRAY_SIZE 15121
+/* The size of the initial obarray.  A dumped Emacs has well over
+   30000 symbols, and more are interned as packages are loaded, so
+   this keeps the buckets short.  */
+#define OBARRAY_SIZE 65521
 
 void
 init_obarray_once (void)
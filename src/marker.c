@@ -69,19 +69,239 @@ #define byte_char_debug_check(b, charpos, bytepos) do { } while (0)
 
 #endif /* MARKER_DEBUG */
 
+/* Each buffer text can have an index of checkpoints, positions whose
+   byte position is known, about CHARPOS_INDEX_INTERVAL characters
+   apart.  The conversions below add checkpoints as they scan the text,
+   so that later conversions never have to scan far.
+
+   Like the text itself, the checkpoints are kept in an array with a
+   gap.  Those before the gap hold absolute positions, while those
+   after it hold their distance from the end of the text.  Thus an
+   insertion or deletion only needs to move the gap to where it
+   happens, and to drop the checkpoints in deleted text; the positions
+   after it then take care of themselves.  The index also records
+   where it thinks the text ends, so that a change made without
+   telling it is noticed, and the index discarded.  */
+
+enum
+  {
+    /* Number of characters between checkpoints.  */
+    CHARPOS_INDEX_INTERVAL = 1024
+  };
+
+struct charpos_checkpoint
+{
+  ptrdiff_t charpos, bytepos;
+};
+
+struct charpos_index
+{
+  /* The end of the text.  */
+  ptrdiff_t z, z_byte;
+
+  /* The checkpoints, in order of position.  CHECKPOINTS has room for
+     SIZE of them; the first NBEFORE are before the gap and the last
+     NAFTER are after it.  */
+  struct charpos_checkpoint *checkpoints;
+  ptrdiff_t size, nbefore, nafter;
+};
+
+/* Return the checkpoint index of B, or NULL if it has none.  */
+
+static struct charpos_index *
+charpos_index (struct buffer *b)
+{
+  struct charpos_index *x = b->text->charpos_index;
+
+  if (x && (x->z != BUF_Z (b) || x->z_byte != BUF_Z_BYTE (b)))
+    {
+      /* The text was changed behind our back.  */
+      xfree (x->checkpoints);
+      xfree (x);
+      x = b->text->charpos_index = NULL;
+    }
+  return x;
+}
+
+/* Return checkpoint number I of X.  */
+
+static struct charpos_checkpoint
+charpos_checkpoint (struct charpos_index *x, ptrdiff_t i)
+{
+  if (i < x->nbefore)
+    return x->checkpoints[i];
+
+  struct charpos_checkpoint *c
+    = &x->checkpoints[x->size - x->nafter + (i - x->nbefore)];
+  return (struct charpos_checkpoint) { x->z - c->charpos,
+				       x->z_byte - c->bytepos };
+}
+
+/* Return the number of checkpoints of X at or before POS, which is a
+   byte position if BYTE is true and a character position otherwise.  */
+
+static ptrdiff_t
+search_charpos_index (struct charpos_index *x, ptrdiff_t pos, bool byte)
+{
+  ptrdiff_t lo = 0, hi = x->nbefore + x->nafter;
+
+  while (lo < hi)
+    {
+      ptrdiff_t mid = lo + (hi - lo) / 2;
+      struct charpos_checkpoint c = charpos_checkpoint (x, mid);
+
+      if ((byte ? c.bytepos : c.charpos) <= pos)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  return lo;
+}
+
+/* Move the gap of X so that the checkpoints before it are those at or
+   before CHARPOS.  */
+
+static void
+move_charpos_index_gap (struct charpos_index *x, ptrdiff_t charpos)
+{
+  struct charpos_checkpoint *v = x->checkpoints;
+
+  while (x->nbefore > 0 && v[x->nbefore - 1].charpos > charpos)
+    {
+      struct charpos_checkpoint c = v[--x->nbefore];
+      struct charpos_checkpoint *d = &v[x->size - ++x->nafter];
+      d->charpos = x->z - c.charpos;
+      d->bytepos = x->z_byte - c.bytepos;
+    }
+
+  while (x->nafter > 0 && x->z - v[x->size - x->nafter].charpos <= charpos)
+    {
+      struct charpos_checkpoint c = v[x->size - x->nafter--];
+      struct charpos_checkpoint *d = &v[x->nbefore++];
+      d->charpos = x->z - c.charpos;
+      d->bytepos = x->z_byte - c.bytepos;
+    }
+}
+
+/* Add a checkpoint at CHARPOS and BYTEPOS to B, making an index for it
+   if needed.  */
+
+static void
+add_checkpoint (struct buffer *b, ptrdiff_t charpos, ptrdiff_t bytepos)
+{
+  struct charpos_index *x = charpos_index (b);
+
+  if (!x)
+    {
+      x = xzalloc (sizeof *x);
+      x->z = BUF_Z (b);
+      x->z_byte = BUF_Z_BYTE (b);
+      b->text->charpos_index = x;
+    }
+
+  move_charpos_index_gap (x, charpos - 1);
+  if (x->nbefore + x->nafter == x->size)
+    {
+      ptrdiff_t old_size = x->size;
+      x->checkpoints = xpalloc (x->checkpoints, &x->size, 1, -1,
+				sizeof *x->checkpoints);
+      memmove (x->checkpoints + x->size - x->nafter,
+	       x->checkpoints + old_size - x->nafter,
+	       x->nafter * sizeof *x->checkpoints);
+    }
+  x->checkpoints[x->nbefore++]
+    = (struct charpos_checkpoint) { charpos, bytepos };
+}
+
+/* Forget the positions cached for B, including its checkpoints.  */
+
 void
 clear_charpos_cache (struct buffer *b)
 {
   if (cached_buffer == b)
     cached_buffer = 0;
+
+  struct charpos_index *x = b->text->charpos_index;
+  if (x)
+    {
+      xfree (x->checkpoints);
+      xfree (x);
+      b->text->charpos_index = NULL;
+    }
+}
+
+/* Adjust the checkpoints of the current buffer for the insertion of
+   NCHARS characters, NBYTES bytes long, at FROM.  */
+
+void
+adjust_charpos_index_for_insert (ptrdiff_t from, ptrdiff_t nchars,
+				 ptrdiff_t nbytes)
+{
+  struct charpos_index *x = current_buffer->text->charpos_index;
+
+  if (x)
+    {
+      move_charpos_index_gap (x, from);
+      x->z += nchars;
+      x->z_byte += nbytes;
+    }
+}
+
+/* Adjust the checkpoints of the current buffer for the deletion of the
+   text from FROM to TO, which is NBYTES bytes long.  */
+
+void
+adjust_charpos_index_for_delete (ptrdiff_t from, ptrdiff_t to,
+				 ptrdiff_t nbytes)
+{
+  struct charpos_index *x = current_buffer->text->charpos_index;
+
+  if (x && from < to)
+    {
+      /* Drop the checkpoints after FROM up to TO, which becomes FROM.  */
+      move_charpos_index_gap (x, from);
+      while (x->nafter > 0
+	     && x->z - x->checkpoints[x->size - x->nafter].charpos <= to)
+	x->nafter--;
+      x->z -= to - from;
+      x->z_byte -= nbytes;
+    }
+}
+
+/* Forget the byte positions cached for the current buffer after FROM
+   and up to TO, or up to the end of the text if TO_Z, because the
+   characters there changed their byte lengths.  */
+
+void
+forget_byte_positions (ptrdiff_t from, ptrdiff_t to, bool to_z)
+{
+  struct charpos_index *x = current_buffer->text->charpos_index;
+
+  if (cached_buffer == current_buffer)
+    cached_buffer = 0;
+
+  if (x)
+    {
+      move_charpos_index_gap (x, from);
+      while (x->nafter > 0
+	     && (to_z
+		 || x->z - x->checkpoints[x->size - x->nafter].charpos <= to))
+	x->nafter--;
+      if (to_z)
+	{
+	  x->z = Z;
+	  x->z_byte = Z_BYTE;
+	}
+    }
 }
 
 /* Converting between character positions and byte positions.  */
 
 /* There are several places in the buffer where we know
    the correspondence: BEG, BEGV, PT, GPT, ZV and Z,
-   and everywhere there is a marker.  So we find the one of these places
-   that is closest to the specified position, and scan from there.  */
+   at the checkpoints, and everywhere there is a marker.  So we find
+   the one of these places that is closest to the specified position,
+   and scan from there.  */
 
 /* This macro is a subroutine of buf_charpos_to_bytepos.
    Note that it is desirable that BYTEPOS is not evaluated
@@ -196,7 +416,30 @@ buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
   if (b == cached_buffer && BUF_MODIFF (b) == cached_modiff)
     CONSIDER (cached_charpos, cached_bytepos);
 
-  for (tail = BUF_MARKERS (b); tail; tail = tail->next)
+  /* Consider the checkpoints on either side of CHARPOS.  */
+  struct charpos_index *x = charpos_index (b);
+  if (x)
+    {
+      ptrdiff_t i = search_charpos_index (x, charpos, false);
+      struct charpos_checkpoint c;
+
+      if (i > 0)
+	{
+	  c = charpos_checkpoint (x, i - 1);
+	  CONSIDER (c.charpos, c.bytepos);
+	}
+      if (i < x->nbefore + x->nafter)
+	{
+	  c = charpos_checkpoint (x, i);
+	  CONSIDER (c.charpos, c.bytepos);
+	}
+    }
+
+  /* The markers are only worth looking at if there are no checkpoints
+     near CHARPOS yet.  */
+  for (tail = (best_above - best_below > 2 * CHARPOS_INDEX_INTERVAL
+	       ? BUF_MARKERS (b) : NULL);
+       tail; tail = tail->next)
     {
       CONSIDER (tail->charpos, tail->bytepos);
 
@@ -216,20 +459,23 @@ buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
 
   if (charpos - best_below < best_above - charpos)
     {
-      bool record = charpos - best_below > 5000;
+      /* If this position is quite far from the nearest known position,
+	 add checkpoints along the way.  */
+      ptrdiff_t checkpoint = (charpos - best_below < CHARPOS_INDEX_INTERVAL
+			      ? PTRDIFF_MAX
+			      : best_below + CHARPOS_INDEX_INTERVAL);
 
       while (best_below != charpos)
 	{
 	  best_below++;
 	  best_below_byte += buf_next_char_len (b, best_below_byte);
+	  if (best_below == checkpoint)
+	    {
+	      add_checkpoint (b, best_below, best_below_byte);
+	      checkpoint += CHARPOS_INDEX_INTERVAL;
+	    }
 	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.  */
-      if (record)
-	build_marker (b, best_below, best_below_byte);
-
       byte_char_debug_check (b, best_below, best_below_byte);
 
       cached_buffer = b;
@@ -241,20 +487,21 @@ buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
     }
   else
     {
-      bool record = best_above - charpos > 5000;
+      ptrdiff_t checkpoint = (best_above - charpos < CHARPOS_INDEX_INTERVAL
+			      ? PTRDIFF_MIN
+			      : best_above - CHARPOS_INDEX_INTERVAL);
 
       while (best_above != charpos)
 	{
 	  best_above--;
 	  best_above_byte -= buf_prev_char_len (b, best_above_byte);
+	  if (best_above == checkpoint)
+	    {
+	      add_checkpoint (b, best_above, best_above_byte);
+	      checkpoint -= CHARPOS_INDEX_INTERVAL;
+	    }
 	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.  */
-      if (record)
-	build_marker (b, best_above, best_above_byte);
-
       byte_char_debug_check (b, best_above, best_above_byte);
 
       cached_buffer = b;
@@ -347,7 +594,30 @@ buf_bytepos_to_charpos (struct buffer *b, ptrdiff_t bytepos)
   if (b == cached_buffer && BUF_MODIFF (b) == cached_modiff)
     CONSIDER (cached_bytepos, cached_charpos);
 
-  for (tail = BUF_MARKERS (b); tail; tail = tail->next)
+  /* Consider the checkpoints on either side of BYTEPOS.  */
+  struct charpos_index *x = charpos_index (b);
+  if (x)
+    {
+      ptrdiff_t i = search_charpos_index (x, bytepos, true);
+      struct charpos_checkpoint c;
+
+      if (i > 0)
+	{
+	  c = charpos_checkpoint (x, i - 1);
+	  CONSIDER (c.bytepos, c.charpos);
+	}
+      if (i < x->nbefore + x->nafter)
+	{
+	  c = charpos_checkpoint (x, i);
+	  CONSIDER (c.bytepos, c.charpos);
+	}
+    }
+
+  /* The markers are only worth looking at if there are no checkpoints
+     near BYTEPOS yet.  */
+  for (tail = (best_above - best_below > 2 * CHARPOS_INDEX_INTERVAL
+	       ? BUF_MARKERS (b) : NULL);
+       tail; tail = tail->next)
     {
       CONSIDER (tail->bytepos, tail->charpos);
 
@@ -367,22 +637,23 @@ buf_bytepos_to_charpos (struct buffer *b, ptrdiff_t bytepos)
 
   if (bytepos - best_below_byte < best_above_byte - bytepos)
     {
-      bool record = bytepos - best_below_byte > 5000;
+      /* If this position is quite far from the nearest known position,
+	 add checkpoints along the way.  */
+      ptrdiff_t checkpoint
+	= (bytepos - best_below_byte < CHARPOS_INDEX_INTERVAL
+	   ? PTRDIFF_MAX : best_below + CHARPOS_INDEX_INTERVAL);
 
       while (best_below_byte < bytepos)
 	{
 	  best_below++;
 	  best_below_byte += buf_next_char_len (b, best_below_byte);
+	  if (best_below == checkpoint)
+	    {
+	      add_checkpoint (b, best_below, best_below_byte);
+	      checkpoint += CHARPOS_INDEX_INTERVAL;
+	    }
 	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.
-	 But don't do it if BUF_MARKERS is nil;
-	 that is a signal from Fset_buffer_multibyte.  */
-      if (record && BUF_MARKERS (b))
-	build_marker (b, best_below, best_below_byte);
-
       byte_char_debug_check (b, best_below, best_below_byte);
 
       cached_buffer = b;
@@ -394,22 +665,21 @@ buf_bytepos_to_charpos (struct buffer *b, ptrdiff_t bytepos)
     }
   else
     {
-      bool record = best_above_byte - bytepos > 5000;
+      ptrdiff_t checkpoint
+	= (best_above_byte - bytepos < CHARPOS_INDEX_INTERVAL
+	   ? PTRDIFF_MIN : best_above - CHARPOS_INDEX_INTERVAL);
 
       while (best_above_byte > bytepos)
 	{
 	  best_above--;
 	  best_above_byte -= buf_prev_char_len (b, best_above_byte);
+	  if (best_above == checkpoint)
+	    {
+	      add_checkpoint (b, best_above, best_above_byte);
+	      checkpoint -= CHARPOS_INDEX_INTERVAL;
+	    }
 	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.
-	 But don't do it if BUF_MARKERS is nil;
-	 that is a signal from Fset_buffer_multibyte.  */
-      if (record && BUF_MARKERS (b))
-	build_marker (b, best_above, best_above_byte);
-
       byte_char_debug_check (b, best_above, best_above_byte);
 
       cached_buffer = b;
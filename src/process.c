@@ -243,6 +243,10 @@ #define READ_OUTPUT_DELAY_INCREMENT (TIMESPEC_RESOLUTION / 100)
 #define READ_OUTPUT_DELAY_MAX       (READ_OUTPUT_DELAY_INCREMENT * 5)
 #define READ_OUTPUT_DELAY_MAX_MAX   (READ_OUTPUT_DELAY_INCREMENT * 7)
 
+/* Number of bytes that Emacs first tries to read from a process at a
+   time; see read_process_output.  */
+enum { READ_OUTPUT_CHUNK_MIN = 4096 };
+
 /* Number of processes which have a non-zero read_output_delay,
    and therefore might be delayed for adaptive read buffering.  */
 
@@ -252,7 +256,15 @@ #define READ_OUTPUT_DELAY_MAX_MAX   (READ_OUTPUT_DELAY_INCREMENT * 7)
 
 static bool process_output_skip;
 
+/* Number of processes with batched output not yet passed to their
+   filters.  */
+
+static int num_batched_processes;
+
 static void start_process_unwind (Lisp_Object);
+static void flush_process_output (struct Lisp_Process *,
+				  struct coding_system *);
+static struct timespec flush_due_process_output (struct Lisp_Process *);
 static void create_process (Lisp_Object, char **, Lisp_Object);
 #ifdef USABLE_SIGIO
 static bool keyboard_bit_set (fd_set *);
@@ -864,6 +876,9 @@ make_process (Lisp_Object name)
   p->outfd = -1;
   for (int i = 0; i < PROCESS_OPEN_FDS; i++)
     p->open_fd[i] = -1;
+  p->read_output_max = clip_to_bounds (1, read_process_output_max,
+				       INT_MAX / 2);
+  p->readmax = min (READ_OUTPUT_CHUNK_MIN, p->read_output_max);
 
 #ifdef HAVE_GNUTLS
   verify (GNUTLS_STAGE_EMPTY == 0);
@@ -1440,6 +1455,82 @@ DEFUN ("process-query-on-exit-flag",
   return (XPROCESS (process)->kill_without_query ? Qnil : Qt);
 }
 
+DEFUN ("set-process-output-batching", Fset_process_output_batching,
+       Sset_process_output_batching, 2, 3, 0,
+       doc: /* Make PROCESS pass its output to its filter in batches.
+If BYTES is a positive integer, read all the output of PROCESS that is
+available, up to about BYTES bytes, and then call the filter of
+PROCESS once with all of it, instead of once for each chunk read.
+This saves time when PROCESS produces a lot of output in small pieces.
+
+Optional argument DELAY is the number of seconds to wait for more
+output before calling the filter, as long as less than BYTES bytes
+were read; it defaults to zero.  The filter is called with any
+batched output when `accept-process-output' returns after waiting for
+PROCESS, and when the output of PROCESS ends.
+
+If BYTES is nil or zero, call the filter whenever output is read.
+Return BYTES.  */)
+  (Lisp_Object process, Lisp_Object bytes, Lisp_Object delay)
+{
+  struct Lisp_Process *p;
+
+  CHECK_PROCESS (process);
+  p = XPROCESS (process);
+  if (!NILP (bytes))
+    CHECK_FIXNAT (bytes);
+  if (!NILP (delay))
+    {
+      CHECK_NUMBER (delay);
+      if (! (XFLOATINT (delay) >= 0))
+	args_out_of_range (delay, make_number (0));
+    }
+
+  p->batch_max = NILP (bytes) ? 0 : min (XFIXNAT (bytes), INT_MAX / 2);
+  p->batch_delay = (NILP (delay) ? make_timespec (0, 0)
+		    : dtotimespec (XFLOATINT (delay)));
+
+  /* Pass on any batched output soon.  */
+  if (p->batch_max == 0 && p->batch_bytes > 0)
+    p->batch_due = current_timespec ();
+
+  return bytes;
+}
+
+DEFUN ("process-output-batching", Fprocess_output_batching,
+       Sprocess_output_batching, 1, 1, 0,
+       doc: /* Return how the output of PROCESS is batched.
+The value is nil if PROCESS passes its output to its filter as soon as
+it is read, and a cons (BYTES . DELAY) otherwise, where BYTES and
+DELAY are as in `set-process-output-batching'.  */)
+  (Lisp_Object process)
+{
+  struct Lisp_Process *p;
+
+  CHECK_PROCESS (process);
+  p = XPROCESS (process);
+  if (p->batch_max == 0)
+    return Qnil;
+  return Fcons (make_number (p->batch_max),
+		make_float (timespectod (p->batch_delay)));
+}
+
+DEFUN ("process-output-statistics", Fprocess_output_statistics,
+       Sprocess_output_statistics, 1, 1, 0,
+       doc: /* Return statistics about the output of PROCESS.
+The value is a cons (BYTES . CALLS), where BYTES is the number of
+bytes of output read from PROCESS so far, and CALLS is the number of
+times its filter has been called with that output.  */)
+  (Lisp_Object process)
+{
+  struct Lisp_Process *p;
+
+  CHECK_PROCESS (process);
+  p = XPROCESS (process);
+  return Fcons (INT_TO_INTEGER (p->nbytes_read),
+		INT_TO_INTEGER (p->filter_calls));
+}
+
 DEFUN ("process-contact", Fprocess_contact, Sprocess_contact,
        1, 2, 0,
        doc: /* Return the contact info of PROCESS; t for a real child.
@@ -4546,6 +4637,12 @@ deactivate_process (Lisp_Object proc)
       p->read_output_skip = 0;
     }
 
+  if (p->batch_bytes > 0)
+    num_batched_processes--;
+  xfree (p->batch);
+  p->batch = NULL;
+  p->batch_size = p->batch_bytes = 0;
+
   /* Beware SIGCHLD hereabouts.  */
 
   for (i = 0; i < PROCESS_OPEN_FDS; i++)
@@ -5008,7 +5105,7 @@ wait_reading_process_output (intmax_t time_limit, int nsecs, int read_kbd,
   bool no_avail;
   int xerrno;
   Lisp_Object proc;
-  struct timespec timeout, end_time, timer_delay;
+  struct timespec timeout, end_time, timer_delay, batch_delay;
   struct timespec got_output_end_time = invalid_timespec ();
   enum { MINIMUM = -1, TIMEOUT, INFINITY } wait;
   int got_some_output = -1;
@@ -5175,6 +5272,12 @@ wait_reading_process_output (intmax_t time_limit, int nsecs, int read_kbd,
               wait_reading_process_output_1 ();
         }
 
+      /* Pass batched process output that is due to the filters.  */
+      batch_delay = (NILP (wait_for_cell)
+		     ? flush_due_process_output (just_wait_proc ? wait_proc
+						 : NULL)
+		     : invalid_timespec ());
+
       /* Cause C-g and alarm signals to take immediate action,
 	 and cause input available signals to zero out timeout.
 
@@ -5366,6 +5469,11 @@ wait_reading_process_output (intmax_t time_limit, int nsecs, int read_kbd,
 	  else
 	    got_output_end_time = invalid_timespec ();
 
+	  /* Wake up when batched process output is due.  */
+	  if (timespec_valid_p (batch_delay)
+	      && timespec_cmp (batch_delay, timeout) < 0)
+	    timeout = batch_delay;
+
 	  /* NOW can become inaccurate if time can pass during pselect.  */
 	  if (timeout.tv_sec > 0 || timeout.tv_nsec > 0)
 	    now = invalid_timespec ();
@@ -5776,6 +5884,12 @@ wait_reading_process_output (intmax_t time_limit, int nsecs, int read_kbd,
 	}			/* End for each file descriptor.  */
     }				/* End while exit conditions not met.  */
 
+  /* The caller may expect the filter to have seen the output.  */
+  if (wait_proc && 0 < wait_proc->batch_bytes && 0 <= wait_proc->infd
+      && !EQ (wait_proc->filter, Qt))
+    flush_process_output (wait_proc,
+			  proc_decode_coding_system[wait_proc->infd]);
+
   unbind_to (count, Qnil);
 
   /* If calling from keyboard input, do not quit
@@ -5809,16 +5923,274 @@ read_process_output_error_handler (Lisp_Object error_val)
   return Qt;
 }
 
-static void
+static ssize_t
 read_and_dispose_of_process_output (struct Lisp_Process *p, char *chars,
 				    ssize_t nbytes,
 				    struct coding_system *coding);
 
+/* Return true if the output of process P from CHANNEL, decoded by
+   CODING, can be read right into the gap of P's buffer: P has the
+   default filter and a live unibyte buffer, and its output needs no
+   decoding.  */
+
+static bool
+process_output_to_buffer_p (struct Lisp_Process *p, int channel,
+			    struct coding_system *coding)
+{
+  return (EQ (p->filter, Qinternal_default_process_filter)
+	  && BUFFERP (p->buffer) && BUFFER_LIVE_P (XBUFFER (p->buffer))
+	  && NILP (BVAR (XBUFFER (p->buffer), enable_multibyte_characters))
+	  && ! CODING_MAY_REQUIRE_DECODING (coding)
+	  && p->decoding_carryover == 0
+	  && proc_buffered_char[channel] < 0
+#ifdef DATAGRAM_SOCKETS
+	  && ! DATAGRAM_CHAN_P (channel)
+#endif
+	  );
+}
+
+/* Read at most NBYTES bytes of output of process P into BUF.  */
+
+static ssize_t
+read_process_channel (struct Lisp_Process *p, char *buf, ptrdiff_t nbytes)
+{
+  ssize_t nread;
+#ifdef HAVE_GNUTLS
+  if (p->gnutls_p && p->gnutls_state)
+    nread = emacs_gnutls_read (p, buf, nbytes);
+  else
+#endif
+    nread = emacs_read (p->infd, buf, nbytes);
+  if (nread > 0)
+    p->nbytes_read += nread;
+  return nread;
+}
+
+/* Adjust the way output of process P is read after a read of NBYTES
+   bytes, when READMAX bytes were asked for.  */
+
+static void
+adapt_process_read (struct Lisp_Process *p, ssize_t nbytes,
+		    ptrdiff_t readmax)
+{
+  if (nbytes <= 0)
+    return;
+
+  if (p->adaptive_read_buffering)
+    {
+      int delay = p->read_output_delay;
+      if (nbytes < 256)
+	{
+	  if (delay < READ_OUTPUT_DELAY_MAX_MAX)
+	    {
+	      if (delay == 0)
+		process_output_delay_count++;
+	      delay += READ_OUTPUT_DELAY_INCREMENT * 2;
+	    }
+	}
+      else if (delay > 0 && nbytes == readmax)
+	{
+	  delay -= READ_OUTPUT_DELAY_INCREMENT;
+	  if (delay == 0)
+	    process_output_delay_count--;
+	}
+      p->read_output_delay = delay;
+      if (delay)
+	{
+	  p->read_output_skip = 1;
+	  process_output_skip = 1;
+	}
+    }
+
+  /* Read in larger chunks while the process fills them, up to
+     `read-process-output-max', and in smaller ones again once it
+     slows down.  */
+  if (nbytes == readmax)
+    p->readmax = min (2 * p->readmax, p->read_output_max);
+  else if (nbytes < readmax / 8 && READ_OUTPUT_CHUNK_MIN < p->readmax)
+    p->readmax = max (p->readmax / 2, READ_OUTPUT_CHUNK_MIN);
+}
+
+/* The storage for the batched output of process P, which
+   flush_process_output detaches from P while the filter runs.  */
+
+struct process_batch
+{
+  struct Lisp_Process *p;
+  char *batch;
+  ptrdiff_t size;
+};
+
+static void
+restore_process_batch (void *ptr)
+{
+  struct process_batch *b = ptr;
+
+  /* Keep the storage for the next batch, unless the filter read more
+     output of P into new storage, or P is gone.  */
+  if (!b->p->batch && 0 <= b->p->infd)
+    {
+      b->p->batch = b->batch;
+      b->p->batch_size = b->size;
+    }
+  else
+    xfree (b->batch);
+}
+
+/* Pass the output of process P batched so far, decoded by CODING, to
+   the filter of P.  */
+
+static void
+flush_process_output (struct Lisp_Process *p, struct coding_system *coding)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  ptrdiff_t room = sizeof coding->carryover;
+  int carryover = p->decoding_carryover;
+  ptrdiff_t nbytes = carryover + p->batch_bytes;
+  Lisp_Object odeactivate = Vdeactivate_mark;
+  struct process_batch b;
+  char *chars;
+
+  if (nbytes == 0)
+    return;
+  if (p->batch_bytes > 0)
+    num_batched_processes--;
+  else if (p->batch_size < room)
+    p->batch = xpalloc (p->batch, &p->batch_size,
+			room - p->batch_size, -1, 1);
+
+  /* Put the carryover just before the batch, and detach the batch,
+     in case the filter reads more output of P.  */
+  b.p = p;
+  b.batch = p->batch;
+  b.size = p->batch_size;
+  chars = b.batch + room - carryover;
+  memcpy (chars, SDATA (p->decoding_buf), carryover);
+  p->batch = NULL;
+  p->batch_size = p->batch_bytes = 0;
+  p->decoding_carryover = 0;
+  record_unwind_protect_ptr (restore_process_batch, &b);
+
+  record_unwind_current_buffer ();
+  read_and_dispose_of_process_output (p, chars, nbytes, coding);
+  Vdeactivate_mark = odeactivate;
+  unbind_to (count, Qnil);
+}
+
+/* Read the output of process P from CHANNEL, as read_process_output
+   does, but add it to the batched output of P.  Pass the batch to the
+   filter of P, decoded by CODING, only when it is full or due, or
+   when the output of P ends.  */
+
+static int
+read_process_output_batch (struct Lisp_Process *p, int channel,
+			   struct coding_system *coding)
+{
+  ptrdiff_t room = sizeof coding->carryover;
+  ptrdiff_t total = 0;
+  ssize_t nbytes;
+  int read_errno;
+
+  /* Read as much output as is available, up to BATCH_MAX bytes.  */
+  do
+    {
+      ptrdiff_t readmax = p->readmax;
+      ptrdiff_t needed = room + p->batch_bytes + readmax;
+      if (p->batch_size < needed)
+	p->batch = xpalloc (p->batch, &p->batch_size,
+			    needed - p->batch_size, -1, 1);
+      char *buf = p->batch + room + p->batch_bytes;
+      bool buffered = proc_buffered_char[channel] >= 0;
+      if (buffered)
+	{
+	  buf[0] = proc_buffered_char[channel];
+	  proc_buffered_char[channel] = -1;
+	}
+      nbytes = read_process_channel (p, buf + buffered, readmax - buffered);
+      adapt_process_read (p, nbytes, readmax - buffered);
+      nbytes += buffered;
+      nbytes += buffered && nbytes <= 0;
+      if (nbytes <= 0)
+	break;
+
+      if (p->batch_bytes == 0)
+	{
+	  num_batched_processes++;
+	  p->batch_due = timespec_add (current_timespec (), p->batch_delay);
+	}
+      p->batch_bytes += nbytes;
+      total += nbytes;
+
+      /* A short read means that there is no more output for now.  */
+      if (nbytes < readmax)
+	break;
+    }
+  while (p->batch_bytes < p->batch_max);
+
+  read_errno = errno;
+  if (total == 0 && nbytes == 0
+      && ! (coding->mode & CODING_MODE_LAST_BLOCK))
+    {
+      /* At the end of the output, decode what is left as the
+	 normal path does.  */
+      coding->mode |= CODING_MODE_LAST_BLOCK;
+      total = p->decoding_carryover + p->batch_bytes;
+      flush_process_output (p, coding);
+    }
+  else if (p->batch_bytes > 0
+	   && (p->batch_max <= p->batch_bytes
+	       || nbytes == 0
+	       || (nbytes < 0 && !would_block (read_errno))
+	       || timespec_cmp (p->batch_due, current_timespec ()) <= 0))
+    flush_process_output (p, coding);
+  errno = read_errno;
+  return total > 0 ? total : nbytes;
+}
+
+/* Pass the batched output of processes to their filters once it is
+   due; the output of just WAIT_PROC if it is non-null.  Return the
+   time until more batched output is due, or an invalid timespec if
+   none is batched.  */
+
+static struct timespec
+flush_due_process_output (struct Lisp_Process *wait_proc)
+{
+  struct timespec delay = invalid_timespec ();
+  struct timespec now;
+  Lisp_Object tail, proc;
+
+  if (num_batched_processes == 0)
+    return delay;
+
+  now = current_timespec ();
+  FOR_EACH_PROCESS (tail, proc)
+    {
+      struct Lisp_Process *p = XPROCESS (proc);
+
+      if (p->batch_bytes == 0 || (wait_proc && p != wait_proc)
+	  /* Don't pass output to a stopped process, or to one locked
+	     to a different thread.  */
+	  || EQ (p->filter, Qt)
+	  || (!NILP (p->thread) && !EQ (p->thread, Fcurrent_thread ())))
+	continue;
+      if (timespec_cmp (p->batch_due, now) <= 0)
+	flush_process_output (p, proc_decode_coding_system[p->infd]);
+      else
+	{
+	  struct timespec d = timespec_sub (p->batch_due, now);
+	  if (!timespec_valid_p (delay) || timespec_cmp (d, delay) < 0)
+	    delay = d;
+	}
+    }
+  return delay;
+}
+
 /* Read pending output from the process channel,
    starting with our buffered-ahead character if we have one.
    Yield number of decoded characters read.
 
-   This function reads at most 4096 characters.
+   This function reads at most as many bytes as the process's current
+   chunk size, which grows while the process produces a lot of output.
    If you want to read all available subprocess output,
    you must call it repeatedly until it returns zero.
 
@@ -5832,11 +6204,50 @@ read_process_output (Lisp_Object proc, int channel)
   struct Lisp_Process *p = XPROCESS (proc);
   struct coding_system *coding = proc_decode_coding_system[channel];
   int carryover = p->decoding_carryover;
-  enum { readmax = 4096 };
+  ptrdiff_t readmax = p->readmax;
   ptrdiff_t count = SPECPDL_INDEX ();
   Lisp_Object odeactivate;
-  char chars[sizeof coding->carryover + readmax];
+  char *chars;
+  USE_SAFE_ALLOCA;
 
+  if ((0 < p->batch_max || 0 < p->batch_bytes)
+#ifdef DATAGRAM_SOCKETS
+      /* Keep datagrams apart.  */
+      && ! DATAGRAM_CHAN_P (channel)
+#endif
+      )
+    return read_process_output_batch (p, channel, coding);
+
+  /* Output that the default filter inserts as it is can be read
+     straight into the buffer, saving a copy.  */
+  if (process_output_to_buffer_p (p, channel, coding))
+    {
+      /* Read one byte first, so that the buffer is not touched and no
+	 filter call is counted unless there is output.  The byte is
+	 buffered, and read by whichever way the rest is read.  */
+      unsigned char c;
+      nbytes = read_process_channel (p, (char *) &c, 1);
+      if (nbytes <= 0)
+	return nbytes;
+      proc_buffered_char[channel] = c;
+
+      odeactivate = Vdeactivate_mark;
+      record_unwind_current_buffer ();
+      nbytes = read_and_dispose_of_process_output (p, NULL, readmax, coding);
+      Vdeactivate_mark = odeactivate;
+      int read_errno = errno;
+      unbind_to (count, Qnil);
+      errno = read_errno;
+      if (nbytes != PTRDIFF_MIN)
+	{
+	  adapt_process_read (p, nbytes, readmax);
+	  return nbytes;
+	}
+      /* Inserting failed before reading anything.  Read the output
+	 as usual, so that it is not lost.  */
+    }
+
+  chars = SAFE_ALLOCA (sizeof coding->carryover + readmax);
   if (carryover)
     /* See the comment above.  */
     memcpy (chars, SDATA (p->decoding_buf), carryover);
@@ -5848,6 +6259,8 @@ read_process_output (Lisp_Object proc, int channel)
       socklen_t len = datagram_address[channel].len;
       nbytes = recvfrom (channel, chars + carryover, readmax,
 			 0, datagram_address[channel].sa, &len);
+      if (nbytes > 0)
+	p->nbytes_read += nbytes;
     }
   else
 #endif
@@ -5858,39 +6271,9 @@ read_process_output (Lisp_Object proc, int channel)
 	  chars[carryover] = proc_buffered_char[channel];
 	  proc_buffered_char[channel] = -1;
 	}
-#ifdef HAVE_GNUTLS
-      if (p->gnutls_p && p->gnutls_state)
-	nbytes = emacs_gnutls_read (p, chars + carryover + buffered,
-				    readmax - buffered);
-      else
-#endif
-	nbytes = emacs_read (channel, chars + carryover + buffered,
-			     readmax - buffered);
-      if (nbytes > 0 && p->adaptive_read_buffering)
-	{
-	  int delay = p->read_output_delay;
-	  if (nbytes < 256)
-	    {
-	      if (delay < READ_OUTPUT_DELAY_MAX_MAX)
-		{
-		  if (delay == 0)
-		    process_output_delay_count++;
-		  delay += READ_OUTPUT_DELAY_INCREMENT * 2;
-		}
-	    }
-	  else if (delay > 0 && nbytes == readmax - buffered)
-	    {
-	      delay -= READ_OUTPUT_DELAY_INCREMENT;
-	      if (delay == 0)
-		process_output_delay_count--;
-	    }
-	  p->read_output_delay = delay;
-	  if (delay)
-	    {
-	      p->read_output_skip = 1;
-	      process_output_skip = 1;
-	    }
-	}
+      nbytes = read_process_channel (p, chars + carryover + buffered,
+				     readmax - buffered);
+      adapt_process_read (p, nbytes, readmax - buffered);
       nbytes += buffered;
       nbytes += buffered && nbytes <= 0;
     }
@@ -5902,7 +6285,10 @@ read_process_output (Lisp_Object proc, int channel)
   if (nbytes <= 0)
     {
       if (nbytes < 0 || coding->mode & CODING_MODE_LAST_BLOCK)
-	return nbytes;
+	{
+	  SAFE_FREE ();
+	  return nbytes;
+	}
       coding->mode |= CODING_MODE_LAST_BLOCK;
     }
 
@@ -5920,11 +6306,46 @@ read_process_output (Lisp_Object proc, int channel)
   /* Handling the process output should not deactivate the mark.  */
   Vdeactivate_mark = odeactivate;
 
+  SAFE_FREE ();
   unbind_to (count, Qnil);
   return nbytes;
 }
 
-static void
+/* State of reading process output right into a buffer, for
+   read_process_output_to_buffer.  */
+
+union read_to_buffer
+{
+  struct
+  {
+    struct Lisp_Process *p;
+    ptrdiff_t readmax;
+    ssize_t nbytes;
+    int read_errno;
+  } s;
+  GCALIGNED_UNION_MEMBER
+};
+verify (GCALIGNED (union read_to_buffer));
+
+static void insert_process_output (struct Lisp_Process *, Lisp_Object,
+				   union read_to_buffer *);
+
+static Lisp_Object
+read_process_output_to_buffer (Lisp_Object state)
+{
+  union read_to_buffer *data = XFIXNUMPTR (state);
+  insert_process_output (data->s.p, Qnil, data);
+  return Qnil;
+}
+
+/* Pass the NBYTES bytes of output of process P at CHARS, which are to
+   be decoded with CODING, to the process filter.  If CHARS is null,
+   instead read at most NBYTES bytes of output right into P's buffer,
+   as the default filter would insert them, and return the number of
+   bytes read, or PTRDIFF_MIN if nothing was read because of an
+   error.  */
+
+static ssize_t
 read_and_dispose_of_process_output (struct Lisp_Process *p, char *chars,
 				    ssize_t nbytes,
 				    struct coding_system *coding)
@@ -5933,6 +6354,7 @@ read_and_dispose_of_process_output (struct Lisp_Process *p, char *chars,
   Lisp_Object text;
   bool outer_running_asynch_code = running_asynch_code;
   int waiting = waiting_for_user_input_p;
+  int read_errno = 0;
 
 #if 0
   Lisp_Object obuffer, okeymap;
@@ -5963,6 +6385,23 @@ read_and_dispose_of_process_output (struct Lisp_Process *p, char *chars,
      save the match data in a special nonrecursive fashion.  */
   running_asynch_code = 1;
 
+  if (!chars)
+    {
+      union read_to_buffer data = {{p, nbytes, PTRDIFF_MIN, 0}};
+      Vlast_coding_system_used = CODING_ID_NAME (coding->id);
+      internal_condition_case_1 (read_process_output_to_buffer,
+				 make_pointer_integer (&data),
+				 !NILP (Vdebug_on_error) ? Qnil : Qerror,
+				 read_process_output_error_handler);
+      nbytes = data.s.nbytes;
+      read_errno = data.s.read_errno;
+      /* If nothing was read, the caller reads the output the usual
+	 way, and counts the filter call then.  */
+      if (nbytes != PTRDIFF_MIN)
+	p->filter_calls++;
+      goto done;
+    }
+
   decode_coding_c_string (coding, (unsigned char *) chars, nbytes, Qt);
   text = coding->dst_object;
   Vlast_coding_system_used = CODING_ID_NAME (coding->id);
@@ -6001,14 +6440,18 @@ read_and_dispose_of_process_output (struct Lisp_Process *p, char *chars,
       p->decoding_carryover = coding->carryover_bytes;
     }
   if (SBYTES (text) > 0)
-    /* FIXME: It's wrong to wrap or not based on debug-on-error, and
-       sometimes it's simply wrong to wrap (e.g. when called from
-       accept-process-output).  */
-    internal_condition_case_1 (read_process_output_call,
-			       list3 (outstream, make_lisp_proc (p), text),
-			       !NILP (Vdebug_on_error) ? Qnil : Qerror,
-			       read_process_output_error_handler);
+    {
+      p->filter_calls++;
+      /* FIXME: It's wrong to wrap or not based on debug-on-error, and
+	 sometimes it's simply wrong to wrap (e.g. when called from
+	 accept-process-output).  */
+      internal_condition_case_1 (read_process_output_call,
+				 list3 (outstream, make_lisp_proc (p), text),
+				 !NILP (Vdebug_on_error) ? Qnil : Qerror,
+				 read_process_output_error_handler);
+    }
 
+ done:
   /* If we saved the match data nonrecursively, restore it now.  */
   restore_search_regs ();
   running_asynch_code = outer_running_asynch_code;
@@ -6028,6 +6471,11 @@ read_and_dispose_of_process_output (struct Lisp_Process *p, char *chars,
        cause trouble (for example it would make sit_for return).  */
     if (waiting_for_user_input_p == -1)
       record_asynch_buffer_change ();
+
+  /* Let the caller see why reading failed.  */
+  if (!chars)
+    errno = read_errno;
+  return nbytes;
 }
 
 DEFUN ("internal-default-process-filter", Finternal_default_process_filter,
@@ -6037,12 +6485,22 @@ DEFUN ("internal-default-process-filter", Finternal_default_process_filter,
 Otherwise it discards the output.  */)
   (Lisp_Object proc, Lisp_Object text)
 {
-  struct Lisp_Process *p;
-  ptrdiff_t opoint;
-
   CHECK_PROCESS (proc);
-  p = XPROCESS (proc);
   CHECK_STRING (text);
+  insert_process_output (XPROCESS (proc), text, NULL);
+  return Qnil;
+}
+
+/* Insert TEXT, output of process P, into P's buffer as the default
+   filter does.  If TEXT is nil, read the output from P right into the
+   buffer instead, as described by DATA; see
+   read_and_dispose_of_process_output.  */
+
+static void
+insert_process_output (struct Lisp_Process *p, Lisp_Object text,
+		       union read_to_buffer *data)
+{
+  ptrdiff_t opoint;
 
   if (!NILP (p->buffer) && BUFFER_LIVE_P (XBUFFER (p->buffer)))
     {
@@ -6078,16 +6536,50 @@ DEFUN ("internal-default-process-filter", Finternal_default_process_filter,
       if (! (BEGV <= PT && PT <= ZV))
 	Fwiden ();
 
-      /* Adjust the multibyteness of TEXT to that of the buffer.  */
-      if (NILP (BVAR (current_buffer, enable_multibyte_characters))
-	  != ! STRING_MULTIBYTE (text))
-	text = (STRING_MULTIBYTE (text)
-		? Fstring_as_unibyte (text)
-		: Fstring_to_multibyte (text));
-      /* Insert before markers in case we are inserting where
-	 the buffer's mark is, and the user's next command is Meta-y.  */
-      insert_from_string_before_markers (text, 0, 0,
-					 SCHARS (text), SBYTES (text), 0);
+      if (STRINGP (text))
+	{
+	  /* Adjust the multibyteness of TEXT to that of the buffer.  */
+	  if (NILP (BVAR (current_buffer, enable_multibyte_characters))
+	      != ! STRING_MULTIBYTE (text))
+	    text = (STRING_MULTIBYTE (text)
+		    ? Fstring_as_unibyte (text)
+		    : Fstring_to_multibyte (text));
+	  /* Insert before markers in case we are inserting where
+	     the buffer's mark is, and the user's next command is
+	     Meta-y.  */
+	  insert_from_string_before_markers (text, 0, 0,
+					     SCHARS (text), SBYTES (text), 0);
+	}
+      else
+	{
+	  /* Read the output into the gap at point, after running the
+	     hooks that might move the gap, and insert it there.  The
+	     first byte was already read into proc_buffered_char.  */
+	  ptrdiff_t nbytes = 0;
+	  prepare_to_modify_buffer (PT, PT, NULL);
+	  if (NILP (BVAR (current_buffer, enable_multibyte_characters))
+	      /* The hooks may have read the byte themselves.  */
+	      && proc_buffered_char[p->infd] >= 0)
+	    {
+	      move_gap_both (PT, PT_BYTE);
+	      if (GAP_SIZE < data->s.readmax)
+		make_gap (data->s.readmax - GAP_SIZE);
+	      *GPT_ADDR = proc_buffered_char[p->infd];
+	      proc_buffered_char[p->infd] = -1;
+	      nbytes = read_process_channel (p, (char *) GPT_ADDR + 1,
+					     data->s.readmax - 1);
+	      data->s.read_errno = errno;
+	      nbytes = 1 + max (nbytes, 0);
+	      data->s.nbytes = nbytes;
+	    }
+	  /* If the hooks made the buffer multibyte or read the output,
+	     nothing was read here; the caller reads any more output the
+	     usual way.  The gap need not be at point then.  */
+	  if (nbytes > 0)
+	    insert_from_gap_before_markers (nbytes, nbytes);
+	  else
+	    signal_after_change (PT, 0, 0);
+	}
 
       /* Make sure the process marker's position is valid when the
 	 process buffer is changed in the signal_after_change above.
@@ -6125,7 +6617,6 @@ DEFUN ("internal-default-process-filter", Finternal_default_process_filter,
       bset_read_only (current_buffer, old_read_only);
       SET_PT_BOTH (opoint, opoint_byte);
     }
-  return Qnil;
 }
 
 /* Sending data to subprocess.  */
@@ -8207,6 +8698,16 @@ syms_of_process (void)
 The variable takes effect when `start-process' is called.  */);
   Vprocess_adaptive_read_buffering = Qt;
 
+  DEFVAR_INT ("read-process-output-max", read_process_output_max,
+	      doc: /* Maximum number of bytes to read from a subprocess at a time.
+Emacs first reads up to 4096 bytes at a time from a subprocess, and
+reads twice as much each time a read fills the whole chunk, up to this
+limit, so that processes that produce a lot of output are read in
+fewer and larger chunks.  The variable takes effect when a process is
+created, so it can be bound around the call that creates a process to
+set the limit for that process.  */);
+  read_process_output_max = 65536;
+
   DEFVAR_LISP ("interrupt-process-functions", Vinterrupt_process_functions,
 	       doc: /* List of functions to be called for `interrupt-process'.
 The arguments of the functions are the same as for `interrupt-process'.
@@ -8240,6 +8741,9 @@ syms_of_process (void)
   defsubr (&Sset_process_inherit_coding_system_flag);
   defsubr (&Sset_process_query_on_exit_flag);
   defsubr (&Sprocess_query_on_exit_flag);
+  defsubr (&Sset_process_output_batching);
+  defsubr (&Sprocess_output_batching);
+  defsubr (&Sprocess_output_statistics);
   defsubr (&Sprocess_contact);
   defsubr (&Sprocess_plist);
   defsubr (&Sset_process_plist);
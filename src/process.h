@@ -129,6 +129,8 @@ #define EMACS_PROCESS_H
     int infd;
     /* Byte-count modulo (UINTMAX_MAX + 1) for process output read from `infd'.  */
     uintmax_t nbytes_read;
+    /* Number of times the filter was called with output read from `infd'.  */
+    uintmax_t filter_calls;
     /* Descriptor by which we write to this process.  */
     int outfd;
     /* Descriptors that were created for this process and that need
@@ -147,6 +149,23 @@ #define EMACS_PROCESS_H
        time.  Value is nanoseconds to delay reading output from
        this process.  Range is 0 .. 50 * 1000 * 1000.  */
     int read_output_delay;
+    /* Number of bytes to try to read from the process at a time, and
+       the most it can grow to.  See read_process_output.  */
+    int readmax;
+    int read_output_max;
+    /* If the output of this process is batched, the number of bytes
+       to read before calling the filter, and how long to wait for
+       that many at most; see `set-process-output-batching'.
+       BATCH_MAX is zero if output is not batched.  */
+    int batch_max;
+    struct timespec batch_delay;
+    /* Output read but not yet passed to the filter: BATCH_BYTES bytes
+       at BATCH, after room for decoding carryover.  BATCH has room
+       for BATCH_SIZE bytes in all.  The output is due at BATCH_DUE.  */
+    char *batch;
+    ptrdiff_t batch_size;
+    ptrdiff_t batch_bytes;
+    struct timespec batch_due;
     /* Should we delay reading output from this process.
        Initialized from `Vprocess_adaptive_read_buffering'.
        0 = nil, 1 = t, 2 = other.  */
@@ -19,6 +19,7 @@ Copyright (C) 2012-2020 Free Software Foundation, Inc.
 
 #include <config.h>
 #include "lisp.h"
+#include "intervals.h"
 #include "syssignal.h"
 #include "systime.h"
 #include "pdumper.h"
@@ -143,23 +144,28 @@ make_log (void)
       }
 }
 
-/* Record the current backtrace in LOG.  COUNT is the weight of this
-   current backtrace: interrupt counts for CPU, and the allocation
-   size for memory.  */
+/* Return the "working memory" vector of LOG, into which the next
+   backtrace is to be stored, making room for it if the log is full.  */
 
-static void
-record_backtrace (log_t *log, EMACS_INT count)
+static Lisp_Object
+log_working_vector (log_t *log)
 {
   if (log->next_free < 0)
     /* FIXME: transfer the evicted counts to a special entry rather
        than dropping them on the floor.  */
     evict_lower_half (log);
-  ptrdiff_t index = log->next_free;
+  eassert (EQ (Qunbound, HASH_KEY (log, log->next_free)));
+  return HASH_VALUE (log, log->next_free);
+}
 
-  /* Get a "working memory" vector.  */
-  Lisp_Object backtrace = HASH_VALUE (log, index);
-  eassert (EQ (Qunbound, HASH_KEY (log, index)));
-  get_backtrace (backtrace);
+/* Add COUNT to the entry of LOG for BACKTRACE, which must be the
+   working vector returned by log_working_vector.  Return the key
+   under which COUNT was recorded.  */
+
+static Lisp_Object
+record_log_entry (log_t *log, Lisp_Object backtrace, EMACS_INT count)
+{
+  ptrdiff_t index = log->next_free;
 
   { /* We basically do a `gethash+puthash' here, except that we have to be
        careful to avoid memory allocation since we're in a signal
@@ -172,6 +178,7 @@ record_backtrace (log_t *log, EMACS_INT count)
 	EMACS_INT old_val = XFIXNUM (HASH_VALUE (log, j));
 	EMACS_INT new_val = saturated_add (old_val, count);
 	set_hash_value_slot (log, j, make_fixnum (new_val));
+	return HASH_KEY (log, j);
       }
     else
       { /* BEWARE!  hash_put in general can allocate memory.
@@ -196,9 +203,22 @@ record_backtrace (log_t *log, EMACS_INT count)
 	   take longer until we get a chance to run the Elisp code, so
 	   there's more risk that the table will get full before we
 	   get there.  */
+	return backtrace;
       }
   }
 }
+
+/* Record the current backtrace in LOG.  COUNT is the weight of this
+   current backtrace: interrupt counts for CPU, and the allocation
+   size for memory.  */
+
+static void
+record_backtrace (log_t *log, EMACS_INT count)
+{
+  Lisp_Object backtrace = log_working_vector (log);
+  get_backtrace (backtrace);
+  record_log_entry (log, backtrace, count);
+}
 
 /* Sampling profiler.  */
 
@@ -224,8 +244,8 @@ record_backtrace (log_t *log, EMACS_INT count)
 /* Hash-table log of CPU profiler.  */
 static Lisp_Object cpu_log;
 
-/* Separate counter for the time spent in the GC.  */
-static EMACS_INT cpu_gc_count;
+/* Separate counters for the time spent in each phase of the GC.  */
+static EMACS_INT cpu_gc_count[GC_PHASE_COUNT];
 
 /* The current sampling interval in nanoseconds.  */
 static EMACS_INT current_sampling_interval;
@@ -242,7 +262,8 @@ handle_profiler_signal (int signal)
        not expect the ARRAY_MARK_FLAG to be set.  We could try and
        harden the hash-table code, but it doesn't seem worth the
        effort.  */
-    cpu_gc_count = saturated_add (cpu_gc_count, 1);
+    cpu_gc_count[gc_current_phase]
+      = saturated_add (cpu_gc_count[gc_current_phase], 1);
   else
     {
       EMACS_INT count = 1;
@@ -345,7 +366,7 @@ DEFUN ("profiler-cpu-start", Fprofiler_cpu_start, Sprofiler_cpu_start,
 
   if (NILP (cpu_log))
     {
-      cpu_gc_count = 0;
+      memset (cpu_gc_count, 0, sizeof cpu_gc_count);
       cpu_log = make_log ();
     }
 
@@ -415,6 +436,9 @@ DEFUN ("profiler-cpu-log", Fprofiler_cpu_log, Sprofiler_cpu_log,
 The log is a hash-table mapping backtraces to counters which represent
 the amount of time spent at those points.  Every backtrace is a vector
 of functions, where the last few elements may be nil.
+Time spent in the garbage collector is counted under `Automatic GC',
+and split by the phase of the collection, such as `gc-mark', as if
+each phase were a function called from it.
 Before returning, a new log is allocated for future samples.  */)
   (void)
 {
@@ -424,9 +448,14 @@ DEFUN ("profiler-cpu-log", Fprofiler_cpu_log, Sprofiler_cpu_log,
      pre-allocated keys anymore.  So we have to allocate a new one.  */
   cpu_log = profiler_cpu_running ? make_log () : Qnil;
   Fputhash (make_vector (1, QAutomatic_GC),
-	    make_fixnum (cpu_gc_count),
+	    make_fixnum (cpu_gc_count[GC_PHASE_NONE]),
 	    result);
-  cpu_gc_count = 0;
+  for (int phase = GC_PHASE_NONE + 1; phase < GC_PHASE_COUNT; phase++)
+    if (cpu_gc_count[phase])
+      Fputhash (CALLN (Fvector, gc_phase_symbol (phase), QAutomatic_GC),
+		make_fixnum (cpu_gc_count[phase]),
+		result);
+  memset (cpu_gc_count, 0, sizeof cpu_gc_count);
   return result;
 }
 #endif /* PROFILER_CPU_SUPPORT */
@@ -509,6 +538,203 @@ malloc_probe (size_t size)
   record_backtrace (XHASH_TABLE (memory_log), min (size, MOST_POSITIVE_FIXNUM));
 }
 
+/* Allocation profiler.  */
+
+/* True if allocation profiler is running.  */
+bool profiler_allocation_running;
+
+/* Logs of the bytes allocated, and of those that survived the next
+   GC, by backtrace and type of object.  */
+static Lisp_Object allocation_log;
+static Lisp_Object survival_log;
+
+/* Bytes left to allocate before the next sample is taken.  */
+static EMACS_INT allocation_countdown;
+
+/* Objects sampled since the last GC, whose survival of the next GC
+   remains to be recorded.  BACKTRACE is the key under which the
+   sample is recorded in allocation_log.  Intervals are not Lisp
+   objects, and are recorded in INTERVAL instead of OBJECT.  */
+struct allocation_sample
+{
+  Lisp_Object object;
+  INTERVAL interval;
+  Lisp_Object backtrace;
+  EMACS_INT bytes;
+  bool survived;
+};
+static struct allocation_sample *allocation_samples;
+static ptrdiff_t allocation_samples_used, allocation_samples_size;
+
+DEFUN ("profiler-allocation-start", Fprofiler_allocation_start,
+       Sprofiler_allocation_start, 0, 0, 0,
+       doc: /* Start/restart the allocation profiler.
+The allocation profiler takes a sample of the call-stack about every
+`profiler-allocation-sampling-interval' bytes of Lisp objects
+allocated, and records the type of the object allocated there and
+whether it survives the next garbage collection.
+See also `profiler-log-size' and `profiler-max-stack-depth'.  */)
+  (void)
+{
+  if (profiler_allocation_running)
+    error ("Allocation profiler is already running");
+
+  if (NILP (allocation_log))
+    {
+      allocation_log = make_log ();
+      survival_log = make_log ();
+      allocation_samples_used = 0;
+    }
+
+  allocation_countdown = max (profiler_allocation_sampling_interval, 1);
+  profiler_allocation_running = true;
+
+  return Qt;
+}
+
+DEFUN ("profiler-allocation-stop",
+       Fprofiler_allocation_stop, Sprofiler_allocation_stop,
+       0, 0, 0,
+       doc: /* Stop the allocation profiler.  The profiler log is not affected.
+Return non-nil if the profiler was running.  */)
+  (void)
+{
+  if (!profiler_allocation_running)
+    return Qnil;
+  profiler_allocation_running = false;
+  return Qt;
+}
+
+DEFUN ("profiler-allocation-running-p",
+       Fprofiler_allocation_running_p, Sprofiler_allocation_running_p,
+       0, 0, 0,
+       doc: /* Return non-nil if allocation profiler is running.  */)
+  (void)
+{
+  return profiler_allocation_running ? Qt : Qnil;
+}
+
+DEFUN ("profiler-allocation-log",
+       Fprofiler_allocation_log, Sprofiler_allocation_log,
+       0, 0, 0,
+       doc: /* Return the current allocation profiler log.
+The value has the form (ALLOCATED . SURVIVED), where ALLOCATED and
+SURVIVED are hash-tables mapping backtraces to the number of bytes of
+objects allocated at those points, and of those objects that survived
+the garbage collection following their allocation, respectively.
+Every backtrace is a vector whose first element is the type of object
+allocated, such as `cons', `string' or `hash-table', as returned by
+`type-of', or `interval' for text property intervals; it is followed
+by the functions of the call-stack, where the last few elements may
+be nil.  Objects allocated since the last garbage collection do not
+contribute to SURVIVED.
+Before returning, a new log is allocated for future samples.  */)
+  (void)
+{
+  Lisp_Object result = Fcons (allocation_log, survival_log);
+  /* Here we're making the logs visible to Elisp, so it's not safe any
+     more for our use afterwards since we can't rely on their special
+     pre-allocated keys anymore.  So we have to allocate new ones.  */
+  allocation_log = profiler_allocation_running ? make_log () : Qnil;
+  survival_log = profiler_allocation_running ? make_log () : Qnil;
+  allocation_samples_used = 0;
+  return NILP (XCAR (result)) ? Qnil : result;
+}
+
+/* Record that the current backtrace allocated SIZE bytes for OBJECT,
+   or for INTERVAL if that is not null, whose type is TYPE.  Only one
+   allocation in every `profiler-allocation-sampling-interval' bytes
+   is actually recorded, weighted by the bytes since the last one.  */
+void
+allocation_probe (Lisp_Object type, Lisp_Object object, INTERVAL interval,
+		  size_t size)
+{
+  allocation_countdown -= min (size, MOST_POSITIVE_FIXNUM);
+  if (0 < allocation_countdown)
+    return;
+
+  EMACS_INT interval_bytes = max (profiler_allocation_sampling_interval, 1);
+  EMACS_INT bytes = min (interval_bytes - allocation_countdown,
+			 MOST_POSITIVE_FIXNUM);
+  allocation_countdown = interval_bytes;
+
+  log_t *log = XHASH_TABLE (allocation_log);
+  if (log->next_free < 0)
+    /* The keys of pending samples may be evicted below.  */
+    allocation_samples_used = 0;
+
+  /* Record TYPE as if it were the innermost function called.  */
+  Lisp_Object backtrace = log_working_vector (log);
+  get_backtrace (backtrace);
+  ptrdiff_t depth = ASIZE (backtrace);
+  if (depth == 0)
+    return;
+  for (ptrdiff_t i = depth - 1; 0 < i; i--)
+    ASET (backtrace, i, AREF (backtrace, i - 1));
+  ASET (backtrace, 0, type);
+  backtrace = record_log_entry (log, backtrace, bytes);
+
+  /* Remember the object, to see whether it survives the next GC.  */
+  if (allocation_samples_used == allocation_samples_size)
+    {
+      if (profiler_log_size <= allocation_samples_size)
+	return;
+      allocation_samples
+	= xpalloc (allocation_samples, &allocation_samples_size, 1,
+		   profiler_log_size, sizeof *allocation_samples);
+    }
+  struct allocation_sample *sample
+    = &allocation_samples[allocation_samples_used++];
+  sample->object = object;
+  sample->interval = interval;
+  sample->backtrace = backtrace;
+  sample->bytes = bytes;
+  sample->survived = false;
+}
+
+/* Note which of the sampled objects are still live.  This is called
+   by the GC after everything is marked and before anything is swept,
+   so it must not touch the logs.  */
+void
+allocation_check_survivors (void)
+{
+  for (ptrdiff_t i = 0; i < allocation_samples_used; i++)
+    {
+      struct allocation_sample *sample = &allocation_samples[i];
+      sample->survived = (sample->interval
+			  ? sample->interval->gcmarkbit
+			  : survives_gc_p (sample->object));
+    }
+}
+
+/* Record the sampled objects that survived the GC that just finished
+   in survival_log, and forget all samples.  */
+void
+allocation_record_survivors (void)
+{
+  if (!HASH_TABLE_P (survival_log))
+    {
+      allocation_samples_used = 0;
+      return;
+    }
+
+  log_t *log = XHASH_TABLE (survival_log);
+  for (ptrdiff_t i = 0; i < allocation_samples_used; i++)
+    {
+      struct allocation_sample *sample = &allocation_samples[i];
+      if (!sample->survived)
+	continue;
+      Lisp_Object backtrace = log_working_vector (log);
+      ptrdiff_t depth = ASIZE (backtrace);
+      ptrdiff_t sample_depth = ASIZE (sample->backtrace);
+      for (ptrdiff_t j = 0; j < depth; j++)
+	ASET (backtrace, j,
+	      j < sample_depth ? AREF (sample->backtrace, j) : Qnil);
+      record_log_entry (log, backtrace, sample->bytes);
+    }
+  allocation_samples_used = 0;
+}
+
 DEFUN ("function-equal", Ffunction_equal, Sfunction_equal, 2, 2, 0,
        doc: /* Return non-nil if F1 and F2 come from the same source.
 Used to determine if different closures are just different instances of
@@ -606,6 +832,24 @@ syms_of_profiler (void)
   defsubr (&Sprofiler_memory_running_p);
   defsubr (&Sprofiler_memory_log);
 
+  DEFVAR_INT ("profiler-allocation-sampling-interval",
+	      profiler_allocation_sampling_interval,
+	      doc: /* Number of bytes of Lisp objects allocated between samples.
+This is used by the allocation profiler; see `profiler-allocation-start'.
+Smaller values give more precise logs, at the cost of slowing down
+allocation more.  */);
+  profiler_allocation_sampling_interval = 16 * 1024;
+
+  profiler_allocation_running = false;
+  allocation_log = Qnil;
+  staticpro (&allocation_log);
+  survival_log = Qnil;
+  staticpro (&survival_log);
+  defsubr (&Sprofiler_allocation_start);
+  defsubr (&Sprofiler_allocation_stop);
+  defsubr (&Sprofiler_allocation_running_p);
+  defsubr (&Sprofiler_allocation_log);
+
   pdumper_do_now_and_after_load (syms_of_profiler_for_pdumper);
 }
 
@@ -618,6 +862,8 @@ syms_of_profiler_for_pdumper (void)
       cpu_log = Qnil;
 #endif
       memory_log = Qnil;
+      allocation_log = Qnil;
+      survival_log = Qnil;
     }
   else
     {
@@ -625,6 +871,8 @@ syms_of_profiler_for_pdumper (void)
       eassert (NILP (cpu_log));
 #endif
       eassert (NILP (memory_log));
+      eassert (NILP (allocation_log));
+      eassert (NILP (survival_log));
     }
 
 }
@@ -28,6 +28,7 @@
 #include "regex-emacs.h"
 
 #include <stdlib.h>
+#include <flexmember.h>
 
 #include "character.h"
 #include "buffer.h"
@@ -878,6 +879,10 @@ #define INIT_FAILURE_ALLOC 20
    with the process stack limit.  */
 ptrdiff_t emacs_re_max_failures = 40000;
 
+/* The number of failure points pushed so far by all matches, for the
+   regexp profiler in search.c.  It wraps around.  */
+EMACS_UINT emacs_re_failure_points_pushed;
+
 union fail_stack_elt
 {
   re_char *pointer;
@@ -1059,6 +1064,7 @@ #define PUSH_FAILURE_POINT(pattern, string_place)			\
 do {									\
   char *destination;							\
   DEBUG_STATEMENT (nfailure_points_pushed++);				\
+  emacs_re_failure_points_pushed++;					\
   DEBUG_PRINT ("\nPUSH_FAILURE_POINT:\n");				\
   DEBUG_PRINT ("  Before push, next avail: %td\n", fail_stack.avail);	\
   DEBUG_PRINT ("			size: %td\n", fail_stack.size);	\
@@ -1157,6 +1163,9 @@ #define REG_UNSET(e) ((e) == NULL)
 static bool at_begline_loc_p (re_char *pattern, re_char *p);
 static bool at_endline_loc_p (re_char *p, re_char *pend);
 static re_char *skip_one_char (re_char *p);
+static bool execute_charset (re_char **pp, int c, int corig, bool unibyte);
+static bool dfa_eligible_p (re_char *p, re_char *pend);
+static void analyze_literal (struct re_pattern_buffer *bufp);
 static int analyze_first (re_char *p, re_char *pend,
 			  char *fastmap, bool multibyte);
 
@@ -1766,6 +1775,8 @@ regex_compile (re_char *pattern, ptrdiff_t size,
   /* Initialize the pattern buffer.  */
   bufp->fastmap_accurate = false;
   bufp->used_syntax = false;
+  bufp->dfa_eligible = false;
+  re_free_dfa (bufp);
 
   /* Set 'used' to zero, so that if we return an error, the pattern
      printer (for debugging) will think there's no pattern.  We reset it
@@ -2650,6 +2661,8 @@ regex_compile (re_char *pattern, ptrdiff_t size,
 
   /* Success; set the length of the buffer.  */
   bufp->used = b - bufp->buffer;
+  bufp->dfa_eligible = dfa_eligible_p (bufp->buffer, b);
+  analyze_literal (bufp);
 
 #ifdef REGEX_EMACS_DEBUG
   if (regex_emacs_debug > 0)
@@ -3121,6 +3134,275 @@ re_compile_fastmap (struct re_pattern_buffer *bufp)
 			    fastmap, RE_MULTIBYTE_P (bufp));
   bufp->can_be_null = (analysis != 0);
 } /* re_compile_fastmap */
+
+/* Return true if no match of the compiled pattern from P to PEND can
+   contain a newline, when TRANSLATE is the translation table and
+   MULTIBYTE says whether the pattern is multibyte.  */
+
+static bool
+single_line_p (re_char *p, re_char *pend, Lisp_Object translate,
+	       bool multibyte)
+{
+  if (TRANSLATE ('\n') != '\n')
+    return false;
+
+  while (p < pend)
+    switch (*p)
+      {
+      case exactn:
+	{
+	  re_char *end = p + 2 + p[1];
+	  for (p += 2; p < end; )
+	    {
+	      int len;
+	      if (RE_STRING_CHAR_AND_LENGTH (p, len, multibyte) == '\n')
+		return false;
+	      p += len;
+	    }
+	}
+	break;
+
+      case charset:
+      case charset_not:
+	if (execute_charset (&p, '\n', '\n', true))
+	  return false;
+	break;
+
+      case syntaxspec:
+      case notsyntaxspec:
+      case categoryspec:
+      case notcategoryspec:
+	return false;
+
+      case start_memory:
+      case stop_memory:
+      case duplicate:
+	p += 2;
+	break;
+
+      case jump:
+      case on_failure_jump:
+      case on_failure_keep_string_jump:
+      case on_failure_jump_loop:
+      case on_failure_jump_nastyloop:
+      case on_failure_jump_smart:
+	p += 3;
+	break;
+
+      case succeed_n:
+      case jump_n:
+      case set_number_at:
+	p += 5;
+	break;
+
+      case no_op:
+      case succeed:
+      case anychar:
+      case begline:
+      case endline:
+      case begbuf:
+      case endbuf:
+      case wordbeg:
+      case wordend:
+      case wordbound:
+      case notwordbound:
+      case symbeg:
+      case symend:
+      case at_dot:
+	p++;
+	break;
+
+      default:
+	return false;
+      }
+
+  return true;
+}
+
+/* Return the byte other than C that TRANSLATE maps to C, or C itself
+   if there is none.  Return -1 if C is not ASCII, or if more than one
+   other character, or a non-ASCII one, maps to C, as the letters that
+   case folding equates with a dotted or dotless i do.  Like the
+   Boyer-Moore search of search.c, this relies on the table of case
+   equivalences that 'set-case-table' puts in the canonicalize table.  */
+
+static int
+literal_alternative (Lisp_Object translate, int c)
+{
+  if (NILP (translate))
+    return c;
+  if (! (ASCII_CHAR_P (c) && CHAR_TABLE_P (translate)
+	 && RE_TRANSLATE (translate, c) == c))
+    return -1;
+
+  struct Lisp_Char_Table *tbl = XCHAR_TABLE (translate);
+  if (CHAR_TABLE_EXTRA_SLOTS (tbl) < 3 || !CHAR_TABLE_P (tbl->extras[2]))
+    return -1;
+  Lisp_Object eqv = tbl->extras[2];
+  int alt = RE_TRANSLATE (eqv, c);
+  if (alt == c)
+    return c;
+  if (! (ASCII_CHAR_P (alt) && RE_TRANSLATE (eqv, alt) == c
+	 && RE_TRANSLATE (translate, alt) == c))
+    return -1;
+  return alt;
+}
+
+/* Find the longest string that every match of the pattern compiled
+   in BUFP contains, so that 're_search_2' can look for it before it
+   tries to match, and set the 'literal' fields and 'single_line' of
+   BUFP.
+
+   Only the instructions that every match goes through are examined:
+   the walk skips optional and repeated parts, and stops at the first
+   alternative.  */
+
+static void
+analyze_literal (struct re_pattern_buffer *bufp)
+{
+  re_char *p = bufp->buffer;
+  re_char *pend = p + bufp->used;
+  Lisp_Object translate = bufp->translate;
+  bool multibyte = RE_MULTIBYTE_P (bufp);
+
+  /* The distance in bytes from the start of a match to P, or -1 if it
+     varies, and whether the text up to P is ASCII.  */
+  ptrdiff_t offset = 0;
+  bool ascii = true;
+
+  bufp->single_line = single_line_p (p, pend, translate, multibyte);
+  bufp->literal_len = 0;
+  bufp->literal_offset = -1;
+
+  while (p < pend)
+    {
+      re_char *p0 = p;
+      int mcnt;
+
+      switch (*p++)
+	{
+	case no_op:
+	case begline:
+	case endline:
+	case begbuf:
+	case endbuf:
+	case wordbeg:
+	case wordend:
+	case wordbound:
+	case notwordbound:
+	case symbeg:
+	case symend:
+	case at_dot:
+	  break;
+
+	case start_memory:
+	case stop_memory:
+	  p++;
+	  break;
+
+	case exactn:
+	  {
+	    re_char *end = p + 1 + *p;
+
+	    /* Split the string into runs of characters that match only
+	       the same bytes, give or take case.  */
+	    for (p++; p < end; )
+	      {
+		re_char *start = p;
+		unsigned char alt[RE_LITERAL_MAX];
+		bool run_ascii = true;
+		int len = 0;
+
+		while (p < end)
+		  {
+		    int c = RE_STRING_CHAR_AND_LENGTH (p, len, multibyte);
+		    int a = literal_alternative (translate, c);
+		    if (a < 0)
+		      break;
+		    for (int i = 0; i < len; i++)
+		      if (p - start + i < RE_LITERAL_MAX)
+			alt[p - start + i] = len == 1 ? a : p[i];
+		    run_ascii &= ASCII_CHAR_P (c);
+		    p += len;
+		  }
+
+		ptrdiff_t n = min (p - start, RE_LITERAL_MAX);
+		if (n > bufp->literal_len)
+		  {
+		    bufp->literal_len = n;
+		    bufp->literal_offset = offset;
+		    bufp->literal_ascii = run_ascii && (offset < 0 || ascii);
+		    memcpy (bufp->literal, start, n);
+		    memcpy (bufp->literal_alt, alt, n);
+		    bufp->literal_folded = memcmp (start, alt, n) != 0;
+		  }
+
+		if (offset >= 0)
+		  offset += p - start;
+		ascii &= run_ascii;
+
+		/* Skip a character that matches text of another length.  */
+		if (p < end)
+		  {
+		    p += len;
+		    offset = -1;
+		  }
+	      }
+	  }
+	  break;
+
+	case anychar:
+	case charset:
+	case charset_not:
+	case syntaxspec:
+	case notsyntaxspec:
+	case categoryspec:
+	case notcategoryspec:
+	  p = skip_one_char (p0);
+	  offset = -1;
+	  break;
+
+	case duplicate:
+	  p++;
+	  offset = -1;
+	  break;
+
+	case jump:
+	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
+	  if (mcnt < 0)
+	    return;
+	  p += mcnt;
+	  break;
+
+	case on_failure_jump:
+	case on_failure_keep_string_jump:
+	case on_failure_jump_loop:
+	case on_failure_jump_nastyloop:
+	case on_failure_jump_smart:
+	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
+	  if (mcnt > 0)
+	    {
+	      /* The instructions up to the destination are optional,
+		 unless they are an alternative, which ends with a jump
+		 past the next one.  */
+	      re_char *dest = p + mcnt;
+	      if (mcnt >= 3 && dest[-3] == jump)
+		{
+		  int jmp;
+		  EXTRACT_NUMBER (jmp, dest - 2);
+		  if (jmp > 0)
+		    return;
+		}
+	      p = dest;
+	    }
+	  offset = -1;
+	  break;
+
+	default:
+	  return;
+	}
+    }
+}
 
 /* Set REGS to hold NUM_REGS registers, storing them in STARTS and
    ENDS.  Subsequent matches using PATTERN_BUFFER and REGS will use
@@ -3171,6 +3453,828 @@ re_search (struct re_pattern_buffer *bufp, const char *string, ptrdiff_t size,
 #define POS_ADDR_VSTRING(POS)					\
   (((POS) >= size1 ? string2 - size1 : string1) + (POS))
 
+/* DFA matching.
+
+   A pattern that has no back references, no intervals and no tests of
+   syntax, categories or point can be run as a finite automaton, whose
+   states are the sets of places in the compiled pattern that the
+   backtracking matcher could be at after reading the text so far.
+   The states and their transitions are built lazily, as the searched
+   text needs them, and are kept with the pattern, so that once built
+   they cost a table lookup per character.
+
+   The automaton only tells where a match can start and end: it knows
+   nothing about registers, and it does not choose among the matches
+   the way the backtracking matcher does.  're_search_2' uses it to
+   skip the places where no match can start, and then calls
+   're_match_2_internal' to do the actual matching, unless its caller
+   only wants to know where a match starts.  In particular,
+   a search that fails costs a single pass over the text, however
+   much backtracking the pattern would need.  */
+
+/* The kinds of nodes of the automaton.  */
+enum re_dfa_kind
+  {
+    DFA_CHAR,			/* One character of an exactn.  */
+    DFA_ANY,			/* anychar.  */
+    DFA_SET,			/* charset or charset_not.  */
+    DFA_EMPTY,			/* Go on to NEXT.  */
+    DFA_SPLIT,			/* Go on to both NEXT and ALT.  */
+    DFA_BEGLINE,
+    DFA_ENDLINE,
+    DFA_BEGBUF,
+    DFA_ENDBUF,
+    DFA_MATCH			/* The end of the pattern.  */
+  };
+
+/* A node of the automaton, for an instruction of the compiled
+   pattern, or for a character of an exactn.  */
+struct re_dfa_node
+{
+  enum re_dfa_kind kind;
+
+  /* For DFA_CHAR, the character as it appears in the pattern; for
+     DFA_SET, the offset of the instruction in the compiled pattern.  */
+  int arg;
+
+  /* The nodes that follow this one.  */
+  int next, alt;
+};
+
+/* What precedes or follows a place in the text, as far as line and
+   buffer boundaries are concerned.  */
+enum { DFA_OTHER, DFA_NEWLINE, DFA_EDGE };
+
+struct re_dfa_state
+{
+  /* The next state in the same bucket of the hash table.  */
+  struct re_dfa_state *hash_next;
+
+  /* The state that each character below 256 leads to, or NULL if it
+     is not known yet.  */
+  struct re_dfa_state *trans[1 << BYTEWIDTH];
+
+  /* This state with the start of the pattern added, or NULL if it is
+     not known yet.  */
+  struct re_dfa_state *restart;
+
+  /* For each of DFA_OTHER, DFA_NEWLINE and DFA_EDGE following, 1 if a
+     match can end here, 0 if not, and -1 if it is not known yet.  */
+  signed char accepts[3];
+
+  /* What precedes this state in the text.  */
+  unsigned char prev;
+
+  /* The nodes the matcher can be at, in increasing order.  These are
+     the nodes reached right after a character was matched, and the
+     nodes that can be reached from there without matching a character
+     are found as needed, since they depend on what follows.  */
+  int nnodes;
+  int nodes[FLEXIBLE_ARRAY_MEMBER];
+};
+
+/* The number of buckets of the hash table of states, and the number of
+   bytes of states after which the automaton gives up on a pattern.
+   Each state takes a little more than 1 << BYTEWIDTH pointers, so
+   this allows about 120 states.  */
+enum { RE_DFA_HASH_SIZE = 1024, RE_DFA_MAX_SIZE = 256 * 1024 };
+
+struct re_dfa
+{
+  /* Whether the automaton is for a multibyte target.  */
+  bool target_multibyte;
+
+  /* The nodes.  Node 0 is the start of the pattern.  */
+  int nnodes;
+  struct re_dfa_node *node;
+
+  /* The states, hashed on their nodes, and the bytes they take.  */
+  ptrdiff_t size;
+  struct re_dfa_state *table[RE_DFA_HASH_SIZE];
+
+  /* The states at the start of the pattern, indexed by what precedes
+     them.  */
+  struct re_dfa_state *initial[3];
+
+  /* Work space: the nodes reached so far are those whose MARK is
+     GENERATION.  STACK has room for 3 * NNODES nodes, and WORK and
+     KERNEL for NNODES nodes each.  */
+  unsigned *mark;
+  unsigned generation;
+  int *stack, *work, *kernel;
+};
+
+/* Return a pointer past the instruction at P, or NULL if a DFA cannot
+   run it.  */
+static re_char *
+dfa_skip_instruction (re_char *p)
+{
+  switch (*p)
+    {
+    case exactn:
+    case anychar:
+    case charset:
+    case charset_not:
+      return skip_one_char (p);
+
+    case start_memory:
+    case stop_memory:
+      return p + 2;
+
+    case jump:
+    case on_failure_jump:
+    case on_failure_keep_string_jump:
+    case on_failure_jump_loop:
+    case on_failure_jump_nastyloop:
+    case on_failure_jump_smart:
+      return p + 3;
+
+    case no_op:
+    case succeed:
+    case begline:
+    case endline:
+    case begbuf:
+    case endbuf:
+      return p + 1;
+
+    default:
+      return NULL;
+    }
+}
+
+/* Return true if the compiled pattern from P to PEND can be run by a
+   DFA.  */
+static bool
+dfa_eligible_p (re_char *p, re_char *pend)
+{
+  while (p && p < pend)
+    p = dfa_skip_instruction (p);
+  return p != NULL;
+}
+
+/* Build the nodes of a DFA for the pattern compiled in BUFP, with no
+   states yet.  */
+static struct re_dfa *
+build_dfa (struct re_pattern_buffer *bufp)
+{
+  re_char *pattern = bufp->buffer;
+  re_char *pend = pattern + bufp->used;
+  bool multibyte = RE_MULTIBYTE_P (bufp);
+  int *node_at = xnmalloc (bufp->used + 1, sizeof *node_at);
+  re_char *p;
+  int n = 0;
+
+  /* Number the nodes in the order of the instructions.  */
+  for (ptrdiff_t i = 0; i <= bufp->used; i++)
+    node_at[i] = -1;
+  for (p = pattern; p < pend; )
+    {
+      node_at[p - pattern] = n;
+      if (*p == exactn)
+	{
+	  re_char *q = p + 2;
+	  for (p = q + p[1]; q < p; n++)
+	    q += multibyte ? BYTES_BY_CHAR_HEAD (*q) : 1;
+	}
+      else
+	{
+	  p = dfa_skip_instruction (p);
+	  n++;
+	}
+    }
+  node_at[pend - pattern] = n++;
+
+  struct re_dfa *dfa = xzalloc (sizeof *dfa);
+  dfa->target_multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+  dfa->nnodes = n;
+  dfa->node = xnmalloc (n, sizeof *dfa->node);
+  dfa->mark = xzalloc (n * sizeof *dfa->mark);
+  dfa->stack = xnmalloc (n, 3 * sizeof *dfa->stack);
+  dfa->work = xnmalloc (n, sizeof *dfa->work);
+  dfa->kernel = xnmalloc (n, sizeof *dfa->kernel);
+
+  for (p = pattern; p < pend; )
+    {
+      int i = node_at[p - pattern];
+      struct re_dfa_node *node = &dfa->node[i];
+      re_char *q;
+      int mcnt;
+
+      node->next = i + 1;
+      switch (*p)
+	{
+	case exactn:
+	  for (q = p + 2, p = q + p[1]; q < p; node++)
+	    {
+	      int len;
+	      node->kind = DFA_CHAR;
+	      node->arg = RE_STRING_CHAR_AND_LENGTH (q, len, multibyte);
+	      node->next = ++i;
+	      q += len;
+	    }
+	  break;
+
+	case anychar:
+	  node->kind = DFA_ANY;
+	  p++;
+	  break;
+
+	case charset:
+	case charset_not:
+	  node->kind = DFA_SET;
+	  node->arg = p - pattern;
+	  p = skip_one_char (p);
+	  break;
+
+	case jump:
+	case on_failure_jump:
+	case on_failure_keep_string_jump:
+	case on_failure_jump_loop:
+	case on_failure_jump_nastyloop:
+	case on_failure_jump_smart:
+	  EXTRACT_NUMBER (mcnt, p + 1);
+	  q = p + 3 + mcnt;
+	  /* When 'on_failure_jump_smart' turns itself into
+	     'on_failure_keep_string_jump', the jump at the end of the
+	     loop is changed to skip it.  Jump to it all the same, so
+	     that the automaton can leave the loop after any number of
+	     iterations, as the matcher does when the loop fails.  */
+	  if (*p == jump && q - pattern >= 3
+	      && node_at[q - 3 - pattern] >= 0
+	      && q[-3] == on_failure_keep_string_jump)
+	    q -= 3;
+	  eassert (node_at[q - pattern] >= 0);
+	  if (*p == jump)
+	    {
+	      node->kind = DFA_EMPTY;
+	      node->next = node_at[q - pattern];
+	    }
+	  else
+	    {
+	      node->kind = DFA_SPLIT;
+	      node->alt = node_at[q - pattern];
+	    }
+	  p += 3;
+	  break;
+
+	case start_memory:
+	case stop_memory:
+	  node->kind = DFA_EMPTY;
+	  p += 2;
+	  break;
+
+	case no_op:
+	  node->kind = DFA_EMPTY;
+	  p++;
+	  break;
+
+	case succeed:
+	  node->kind = DFA_MATCH;
+	  p++;
+	  break;
+
+	case begline:
+	case endline:
+	case begbuf:
+	case endbuf:
+	  node->kind = (*p == begline ? DFA_BEGLINE
+			: *p == endline ? DFA_ENDLINE
+			: *p == begbuf ? DFA_BEGBUF : DFA_ENDBUF);
+	  p++;
+	  break;
+
+	default:
+	  emacs_abort ();
+	}
+    }
+  dfa->node[n - 1].kind = DFA_MATCH;
+
+  xfree (node_at);
+  return dfa;
+}
+
+/* Free the DFA of BUFP, if any.  */
+void
+re_free_dfa (struct re_pattern_buffer *bufp)
+{
+  struct re_dfa *dfa = bufp->dfa;
+
+  if (!dfa)
+    return;
+  for (int i = 0; i < RE_DFA_HASH_SIZE; i++)
+    for (struct re_dfa_state *s = dfa->table[i], *next; s; s = next)
+      {
+	next = s->hash_next;
+	xfree (s);
+      }
+  xfree (dfa->node);
+  xfree (dfa->mark);
+  xfree (dfa->stack);
+  xfree (dfa->work);
+  xfree (dfa->kernel);
+  xfree (dfa);
+  bufp->dfa = NULL;
+}
+
+/* Give up on running the pattern in BUFP as a DFA.  */
+static void
+give_up_dfa (struct re_pattern_buffer *bufp)
+{
+  re_free_dfa (bufp);
+  bufp->dfa_eligible = false;
+}
+
+/* Start a new set of marked nodes in DFA, and return its generation.  */
+static unsigned
+dfa_new_generation (struct re_dfa *dfa)
+{
+  if (++dfa->generation == 0)
+    {
+      memset (dfa->mark, 0, dfa->nnodes * sizeof *dfa->mark);
+      dfa->generation = 1;
+    }
+  return dfa->generation;
+}
+
+/* Return the state of DFA with the NNODES nodes in NODES, which must
+   be in increasing order, preceded by PREV.  Make it if needed, but
+   return NULL if that would make too many states.  */
+static struct re_dfa_state *
+dfa_state (struct re_dfa *dfa, int const *nodes, int nnodes, int prev)
+{
+  EMACS_UINT hash = prev;
+  for (int i = 0; i < nnodes; i++)
+    hash = sxhash_combine (hash, nodes[i]);
+
+  struct re_dfa_state **bucket = &dfa->table[hash % RE_DFA_HASH_SIZE];
+  struct re_dfa_state *s;
+  for (s = *bucket; s; s = s->hash_next)
+    if (s->prev == prev && s->nnodes == nnodes
+	&& memcmp (s->nodes, nodes, nnodes * sizeof *nodes) == 0)
+      return s;
+
+  ptrdiff_t size = FLEXSIZEOF (struct re_dfa_state, nodes,
+			       nnodes * sizeof *nodes);
+  if (RE_DFA_MAX_SIZE - dfa->size < size)
+    return NULL;
+  s = xzalloc (size);
+  memset (s->accepts, -1, sizeof s->accepts);
+  s->prev = prev;
+  s->nnodes = nnodes;
+  memcpy (s->nodes, nodes, nnodes * sizeof *nodes);
+  s->hash_next = *bucket;
+  *bucket = s;
+  dfa->size += size;
+  return s;
+}
+
+/* Store in DFA->work the nodes that match a character and that can be
+   reached from STATE without matching any, when NEXT is what follows;
+   store their number in *NWORK.  Return true if the end of the pattern
+   can be reached.  */
+static bool
+dfa_closure (struct re_dfa *dfa, struct re_dfa_state *state, int next,
+	     int *nwork)
+{
+  unsigned generation = dfa_new_generation (dfa);
+  bool matched = false;
+  int sp = 0, nw = 0;
+
+  for (int i = state->nnodes; 0 < i; )
+    dfa->stack[sp++] = state->nodes[--i];
+  while (0 < sp)
+    {
+      int i = dfa->stack[--sp];
+      struct re_dfa_node *node = &dfa->node[i];
+
+      if (dfa->mark[i] == generation)
+	continue;
+      dfa->mark[i] = generation;
+      switch (node->kind)
+	{
+	case DFA_CHAR:
+	case DFA_ANY:
+	case DFA_SET:
+	  dfa->work[nw++] = i;
+	  break;
+
+	case DFA_MATCH:
+	  matched = true;
+	  break;
+
+	case DFA_SPLIT:
+	  dfa->stack[sp++] = node->alt;
+	  FALLTHROUGH;
+	case DFA_EMPTY:
+	  dfa->stack[sp++] = node->next;
+	  break;
+
+	case DFA_BEGLINE:
+	  if (state->prev != DFA_OTHER)
+	    dfa->stack[sp++] = node->next;
+	  break;
+
+	case DFA_ENDLINE:
+	  if (next != DFA_OTHER)
+	    dfa->stack[sp++] = node->next;
+	  break;
+
+	case DFA_BEGBUF:
+	  if (state->prev == DFA_EDGE)
+	    dfa->stack[sp++] = node->next;
+	  break;
+
+	case DFA_ENDBUF:
+	  if (next == DFA_EDGE)
+	    dfa->stack[sp++] = node->next;
+	  break;
+	}
+    }
+
+  *nwork = nw;
+  return matched;
+}
+
+/* Return true if NODE of the DFA for BUFP matches the character C
+   of the target, as 're_match_2_internal' would.  Set *SYNTAX if the
+   answer depends on the syntax table.  */
+static bool
+dfa_node_matches (struct re_pattern_buffer *bufp, struct re_dfa_node *node,
+		  int c, bool *syntax)
+{
+  Lisp_Object translate = bufp->translate;
+  bool multibyte = RE_MULTIBYTE_P (bufp);
+  bool target_multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+
+  switch (node->kind)
+    {
+    case DFA_CHAR:
+      {
+	int pat_ch = node->arg, buf_ch;
+
+	if (target_multibyte)
+	  return TRANSLATE (c) == (multibyte ? pat_ch
+				   : RE_CHAR_TO_MULTIBYTE (pat_ch));
+	if (multibyte)
+	  pat_ch = RE_CHAR_TO_UNIBYTE (pat_ch);
+	buf_ch = RE_CHAR_TO_MULTIBYTE (c);
+	if (! CHAR_BYTE8_P (buf_ch))
+	  {
+	    buf_ch = TRANSLATE (buf_ch);
+	    buf_ch = RE_CHAR_TO_UNIBYTE (buf_ch);
+	    if (buf_ch < 0)
+	      buf_ch = c;
+	  }
+	else
+	  buf_ch = c;
+	return buf_ch == pat_ch;
+      }
+
+    case DFA_ANY:
+      return TRANSLATE (c) != '\n';
+
+    case DFA_SET:
+      {
+	re_char *p = bufp->buffer + node->arg;
+	bool unibyte_char = false;
+	int c1;
+
+	if (target_multibyte)
+	  {
+	    c1 = TRANSLATE (c);
+	    int c2 = RE_CHAR_TO_UNIBYTE (c1);
+	    if (c2 >= 0)
+	      {
+		unibyte_char = true;
+		c1 = c2;
+	      }
+	  }
+	else
+	  {
+	    c1 = c;
+	    int c2 = RE_CHAR_TO_MULTIBYTE (c);
+	    if (! CHAR_BYTE8_P (c2))
+	      {
+		c2 = TRANSLATE (c2);
+		c2 = RE_CHAR_TO_UNIBYTE (c2);
+		if (c2 >= 0)
+		  {
+		    unibyte_char = true;
+		    c1 = c2;
+		  }
+	      }
+	    else
+	      unibyte_char = true;
+	  }
+
+	if (!(unibyte_char && c1 < (1 << BYTEWIDTH))
+	    && CHARSET_RANGE_TABLE_EXISTS_P (p)
+	    && (CHARSET_RANGE_TABLE_BITS (p) & ~BIT_MULTIBYTE) != 0)
+	  *syntax = true;
+	return execute_charset (&p, c1, c, unibyte_char);
+      }
+
+    default:
+      abort ();
+    }
+}
+
+static int
+compare_dfa_nodes (void const *a, void const *b)
+{
+  int const *x = a, *y = b;
+  return (*x > *y) - (*x < *y);
+}
+
+/* Return the state that STATE of the DFA for BUFP leads to on the
+   character C, or NULL if there are too many states.  */
+static struct re_dfa_state *
+dfa_step (struct re_pattern_buffer *bufp, struct re_dfa_state *state, int c)
+{
+  struct re_dfa *dfa = bufp->dfa;
+  int context = c == '\n' ? DFA_NEWLINE : DFA_OTHER;
+  bool syntax = false;
+  int nwork, nkernel = 0;
+
+  dfa_closure (dfa, state, context, &nwork);
+  unsigned generation = dfa_new_generation (dfa);
+  for (int i = 0; i < nwork; i++)
+    {
+      struct re_dfa_node *node = &dfa->node[dfa->work[i]];
+      if (dfa->mark[node->next] != generation
+	  && dfa_node_matches (bufp, node, c, &syntax))
+	{
+	  dfa->mark[node->next] = generation;
+	  dfa->kernel[nkernel++] = node->next;
+	}
+    }
+  qsort (dfa->kernel, nkernel, sizeof *dfa->kernel, compare_dfa_nodes);
+
+  struct re_dfa_state *next = dfa_state (dfa, dfa->kernel, nkernel, context);
+  /* Character classes that look at the syntax table can give another
+     answer the next time.  */
+  if (c < (1 << BYTEWIDTH) && !syntax)
+    state->trans[c] = next;
+  return next;
+}
+
+/* Return STATE of DFA with the start of the pattern added, or NULL if
+   there are too many states.  */
+static struct re_dfa_state *
+dfa_restart (struct re_dfa *dfa, struct re_dfa_state *state)
+{
+  if (!state->restart)
+    {
+      if (state->nnodes > 0 && state->nodes[0] == 0)
+	state->restart = state;
+      else
+	{
+	  dfa->kernel[0] = 0;
+	  memcpy (dfa->kernel + 1, state->nodes,
+		  state->nnodes * sizeof *state->nodes);
+	  state->restart = dfa_state (dfa, dfa->kernel, state->nnodes + 1,
+				      state->prev);
+	}
+    }
+  return state->restart;
+}
+
+/* Return true if the fastmap of BUFP allows a match to start with the
+   character at D of the target, as in 're_search_2'.  */
+static bool
+dfa_fastmap_p (struct re_pattern_buffer *bufp, re_char *d)
+{
+  Lisp_Object translate = bufp->translate;
+  int buf_ch = *d;
+
+  if (RE_TARGET_MULTIBYTE_P (bufp))
+    buf_ch = CHAR_LEADING_CODE (TRANSLATE (STRING_CHAR (d)));
+  else
+    {
+      int ch = RE_CHAR_TO_MULTIBYTE (buf_ch);
+      int translated = TRANSLATE (ch);
+      if (translated != ch
+	  && (ch = RE_CHAR_TO_UNIBYTE (translated)) >= 0)
+	buf_ch = ch;
+    }
+  return bufp->fastmap[buf_ch];
+}
+
+/* Run the DFA for BUFP over the virtual concatenation of STRING1 and
+   STRING2, looking for a match that starts at POS, or at any character
+   boundary from POS to RESTART_LIMIT if that is not less than POS.  Do
+   not consider matching past STOP.  Return where the first such match
+   to end does so, -1 if there is none, and -2 if the DFA gave up.  */
+static ptrdiff_t
+dfa_scan (struct re_pattern_buffer *bufp,
+	  re_char *string1, ptrdiff_t size1,
+	  re_char *string2, ptrdiff_t size2,
+	  ptrdiff_t pos, ptrdiff_t restart_limit, ptrdiff_t stop)
+{
+  struct re_dfa *dfa = bufp->dfa;
+  bool multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+  ptrdiff_t total_size = size1 + size2;
+  int prev = (pos == 0 ? DFA_EDGE
+	      : *POS_ADDR_VSTRING (pos - 1) == '\n' ? DFA_NEWLINE : DFA_OTHER);
+  bool skip = bufp->fastmap && !bufp->can_be_null;
+  struct re_dfa_state *state = NULL;
+  unsigned short quit_count = 0;
+
+  for (;;)
+    {
+      if (!state)
+	{
+	  /* Start over, at the start of the pattern.  */
+	  state = dfa->initial[prev];
+	  if (!state)
+	    {
+	      dfa->kernel[0] = 0;
+	      state = dfa->initial[prev] = dfa_state (dfa, dfa->kernel, 1,
+						      prev);
+	      if (!state)
+		return -2;
+	    }
+	}
+
+      /* While only the start of the pattern is left, skip quickly
+	 over characters that cannot start a match.  */
+      if (skip && state->nnodes == 1 && state->nodes[0] == 0)
+	{
+	  ptrdiff_t pos0 = pos, limit = min (stop, restart_limit);
+	  while (pos < limit)
+	    {
+	      re_char *d = POS_ADDR_VSTRING (pos), *d0 = d;
+	      re_char *dlim = d + ((pos < size1 ? min (limit, size1) : limit)
+				   - pos);
+	      if (NILP (bufp->translate))
+		while (d < dlim && !bufp->fastmap[*d])
+		  d += multibyte ? BYTES_BY_CHAR_HEAD (*d) : 1;
+	      else
+		while (d < dlim && !dfa_fastmap_p (bufp, d))
+		  d += multibyte ? BYTES_BY_CHAR_HEAD (*d) : 1;
+	      pos += d - d0;
+	      if (d < dlim)
+		break;
+	    }
+	  if (pos != pos0)
+	    {
+	      prev = (*POS_ADDR_VSTRING (pos - 1) == '\n'
+		      ? DFA_NEWLINE : DFA_OTHER);
+	      state = NULL;
+	      continue;
+	    }
+	}
+
+      re_char *d = pos < total_size ? POS_ADDR_VSTRING (pos) : NULL;
+      int next = !d ? DFA_EDGE : *d == '\n' ? DFA_NEWLINE : DFA_OTHER;
+
+      if (state->accepts[next] < 0)
+	{
+	  int nwork;
+	  state->accepts[next] = dfa_closure (dfa, state, next, &nwork);
+	}
+      if (state->accepts[next])
+	return pos;
+      if (pos >= stop || (state->nnodes == 0 && restart_limit <= pos))
+	return -1;
+
+      int len;
+      int c = RE_STRING_CHAR_AND_LENGTH (d, len, multibyte);
+      struct re_dfa_state *s
+	= c < (1 << BYTEWIDTH) ? state->trans[c] : NULL;
+      if (!s)
+	s = dfa_step (bufp, state, c);
+      pos += len;
+      if (s && pos <= restart_limit)
+	s = dfa_restart (dfa, s);
+      if (!s)
+	return -2;
+      state = s;
+
+      if (++quit_count == 0)
+	maybe_quit ();
+    }
+}
+
+/* Literal search.
+
+   're_search_2' looks for the string that 'analyze_literal' found in
+   every match before it tries to match, so that it can skip the text
+   where no match can start, and give up early if the string does not
+   occur at all.  */
+
+/* Store in SHIFT how far the search for the literal of BUFP can move
+   past each byte at the end of a place where it does not occur.  */
+static void
+literal_shift_table (struct re_pattern_buffer *bufp,
+		     unsigned char shift[1 << BYTEWIDTH])
+{
+  int len = bufp->literal_len;
+
+  memset (shift, len, 1 << BYTEWIDTH);
+  for (int i = 0; i < len - 1; i++)
+    shift[bufp->literal[i]] = shift[bufp->literal_alt[i]] = len - 1 - i;
+}
+
+/* Return a pointer to the first occurrence of the literal of BUFP in
+   the N bytes at TEXT, or NULL if there is none.  SHIFT is the table
+   made by 'literal_shift_table', needed only if the literal is
+   folded.  */
+static re_char *
+literal_in (struct re_pattern_buffer *bufp, unsigned char const *shift,
+	    re_char *text, ptrdiff_t n)
+{
+  int len = bufp->literal_len;
+  re_char *lit = bufp->literal;
+  re_char *alt = bufp->literal_alt;
+
+  if (!bufp->literal_folded)
+    return memmem (text, n, lit, len);
+
+  /* Horspool's simplification of Boyer-Moore, with two bytes that can
+     match each byte of the literal.  */
+  for (ptrdiff_t i = len - 1; i < n; i += shift[text[i]])
+    {
+      re_char *d = text + i - (len - 1);
+      int j = len - 1;
+      while (j >= 0 && (d[j] == lit[j] || d[j] == alt[j]))
+	j--;
+      if (j < 0)
+	return d;
+    }
+  return NULL;
+}
+
+/* Return the position of the first occurrence of the literal of BUFP
+   that starts at or after FROM and ends at or before LIMIT in the
+   virtual concatenation of STRING1 and STRING2, or -1 if there is
+   none.  SHIFT is as for 'literal_in'.  */
+static ptrdiff_t
+search_literal (struct re_pattern_buffer *bufp, unsigned char const *shift,
+		re_char *string1, ptrdiff_t size1, re_char *string2,
+		ptrdiff_t from, ptrdiff_t limit)
+{
+  int len = bufp->literal_len;
+  re_char *found;
+
+  if (limit - from < len)
+    return -1;
+
+  if (from < size1)
+    {
+      found = literal_in (bufp, shift, string1 + from,
+			  min (size1, limit) - from);
+      if (found)
+	return found - string1;
+
+      /* Look for an occurrence that straddles the two strings.  */
+      for (ptrdiff_t pos = max (from, size1 - len + 1);
+	   pos < size1 && pos + len <= limit; pos++)
+	{
+	  int i;
+	  for (i = 0; i < len; i++)
+	    {
+	      re_char *d = POS_ADDR_VSTRING (pos + i);
+	      if (*d != bufp->literal[i] && *d != bufp->literal_alt[i])
+		break;
+	    }
+	  if (i == len)
+	    return pos;
+	}
+
+      from = size1;
+      if (limit - from < len)
+	return -1;
+    }
+
+  found = literal_in (bufp, shift, string2 + (from - size1), limit - from);
+  return found ? found - string2 + size1 : -1;
+}
+
+/* Return the position after the last newline from FROM to TO in the
+   virtual concatenation of STRING1 and STRING2, or FROM if there is
+   none.  */
+static ptrdiff_t
+after_last_newline (re_char *string1, ptrdiff_t size1, re_char *string2,
+		    ptrdiff_t from, ptrdiff_t to)
+{
+  if (to > size1)
+    {
+      ptrdiff_t start = max (from, size1);
+      re_char *nl = memrchr (string2 + (start - size1), '\n', to - start);
+      if (nl)
+	return nl - string2 + size1 + 1;
+      to = start;
+    }
+  if (from < to)
+    {
+      re_char *nl = memrchr (string1 + from, '\n', to - from);
+      if (nl)
+	return nl - string1 + 1;
+    }
+  return from;
+}
+
 /* Using the compiled pattern in BUFP->buffer, first tries to match the
    virtual concatenation of STRING1 and STRING2, starting first at index
    STARTPOS, then at STARTPOS + 1, and so on.
@@ -3254,9 +4358,74 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, ptrdiff_t size1,
     SETUP_SYNTAX_TABLE_FOR_OBJECT (re_match_object, charpos, 1);
   }
 
+  /* If the pattern can be run as a DFA, a forward search first makes
+     sure that there is a match at all, and every search uses the DFA
+     to skip the places where no match can start.  */
+  bool use_dfa = bufp->dfa_eligible;
+  if (use_dfa)
+    {
+      if (bufp->dfa && bufp->dfa->target_multibyte != multibyte)
+	re_free_dfa (bufp);
+      if (!bufp->dfa)
+	bufp->dfa = build_dfa (bufp);
+    }
+
+  /* A forward search skips to the places where the literal that every
+     match contains allows a match to start.  LITERAL_POS is the
+     position of the next occurrence of the literal, and LITERAL_START
+     is the first place where a match with that occurrence can start.  */
+  bool use_literal = (range > 0 && bufp->literal_len > 0
+		      && (multibyte == RE_MULTIBYTE_P (bufp)
+			  || bufp->literal_ascii));
+  ptrdiff_t literal_skip = max (bufp->literal_offset, 0);
+  ptrdiff_t literal_pos = -1, literal_start = 0;
+  unsigned char literal_shift[1 << BYTEWIDTH];
+  if (use_literal && bufp->literal_folded)
+    literal_shift_table (bufp, literal_shift);
+
+  /* The DFA need not make sure that there is a match if the literal
+     confines the matches to the lines that contain it.  */
+  bool dfa_search = range > 0 && !(use_literal && bufp->single_line);
+
   /* Loop through the string, looking for a place to start matching.  */
   for (;;)
     {
+      if (use_literal)
+	{
+	  if (startpos + literal_skip > literal_pos)
+	    {
+	      literal_pos = search_literal (bufp, literal_shift,
+					    string1, size1, string2,
+					    startpos + literal_skip, stop);
+	      if (literal_pos < 0)
+		return -1;
+	      if (bufp->literal_offset >= 0)
+		literal_start = literal_pos - bufp->literal_offset;
+	      else if (bufp->single_line)
+		literal_start = after_last_newline (string1, size1, string2,
+						    startpos, literal_pos);
+	      else
+		literal_start = startpos;
+	    }
+	  if (startpos < literal_start)
+	    {
+	      range -= literal_start - startpos;
+	      if (range < 0)
+		return -1;
+	      startpos = literal_start;
+
+	      /* The text before the literal may not match, and then
+		 may not even start with a character.  */
+	      while (multibyte && startpos < total_size
+		     && !CHAR_HEAD_P (*POS_ADDR_VSTRING (startpos)))
+		{
+		  if (--range < 0)
+		    return -1;
+		  startpos++;
+		}
+	    }
+	}
+
       /* If the pattern is anchored,
 	 skip quickly past places we cannot match.
 	 Don't bother to treat startpos == 0 specially
@@ -3369,6 +4538,37 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, ptrdiff_t size1,
 	  && !bufp->can_be_null)
 	return -1;
 
+      if (use_dfa && dfa_search)
+	{
+	  dfa_search = false;
+	  val = dfa_scan (bufp, string1, size1, string2, size2,
+			  startpos, startpos + range, stop);
+	  if (val == -1)
+	    return -1;
+	  if (val == -2)
+	    {
+	      give_up_dfa (bufp);
+	      use_dfa = false;
+	    }
+	}
+
+      if (use_dfa)
+	{
+	  val = dfa_scan (bufp, string1, size1, string2, size2,
+			  startpos, -1, stop);
+	  if (val == -1)
+	    goto advance;
+	  if (val == -2)
+	    {
+	      give_up_dfa (bufp);
+	      use_dfa = false;
+	    }
+	  /* Without registers to fill in, that a match starts here is
+	     all there is to know.  */
+	  else if (!regs)
+	    return startpos;
+	}
+
       val = re_match_2_internal (bufp, string1, size1, string2, size2,
 				 startpos, regs, stop);
 
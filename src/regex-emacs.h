@@ -52,9 +52,16 @@ #define EMACS_REGEX_H 1
 /* Roughly the maximum number of failure points on the stack.  */
 extern ptrdiff_t emacs_re_max_failures;
 
+/* The number of failure points pushed so far by all matches.  */
+extern EMACS_UINT emacs_re_failure_points_pushed;
+
 /* Amount of memory that we can safely stack allocate.  */
 extern ptrdiff_t emacs_re_safe_alloca;
 
+/* The most bytes of a literal string that 're_search_2' looks for
+   before it tries to match.  */
+enum { RE_LITERAL_MAX = 32 };
+
 /* This data structure represents a compiled pattern.  Before calling
    the pattern compiler, the fields 'buffer', 'allocated', 'fastmap',
    and 'translate' can be set.  After the pattern has been
@@ -118,6 +125,38 @@ #define EMACS_REGEX_H 1
   /* If true, multi-byte form in the target of match should be
      recognized as a multibyte character.  */
   bool_bf target_multibyte : 1;
+
+  /* If true, the pattern has no back references, intervals, or tests
+     of syntax, categories or point, so 're_search_2' can find out
+     where matches are with a DFA.  */
+  bool_bf dfa_eligible : 1;
+
+  /* If true, no match of this pattern can contain a newline.  */
+  bool_bf single_line : 1;
+
+  /* If true, 'literal' is ASCII, and so is the text that precedes it
+     in a match if 'literal_offset' is known.  */
+  bool_bf literal_ascii : 1;
+
+  /* If true, some byte of 'literal_alt' differs from 'literal'.  */
+  bool_bf literal_folded : 1;
+
+  /* The number of bytes in 'literal', or 0 if no literal string is
+     known to be part of every match.  */
+  unsigned char literal_len;
+
+  /* The distance in bytes from the start of every match to 'literal',
+     or -1 if it varies.  */
+  ptrdiff_t literal_offset;
+
+  /* A string of bytes that every match contains, and for each of
+     them, the other byte that 'translate' maps to it, or the same
+     byte if there is none.  */
+  unsigned char literal[RE_LITERAL_MAX];
+  unsigned char literal_alt[RE_LITERAL_MAX];
+
+  /* The DFA for this pattern, built lazily by 're_search_2', or NULL.  */
+  struct re_dfa *dfa;
 };
 
 /* Declarations for routines.  */
@@ -178,6 +217,9 @@ #define EMACS_REGEX_H 1
 			      ptrdiff_t num_regs,
 			      ptrdiff_t *starts, ptrdiff_t *ends);
 
+/* Free the DFA of BUFFER, if any.  It is rebuilt when needed.  */
+extern void re_free_dfa (struct re_pattern_buffer *buffer);
+
 /* Character classes.  */
 typedef enum { RECC_ERROR = 0,
 	       RECC_ALNUM, RECC_ALPHA, RECC_WORD,
@@ -21,6 +21,12 @@ Copyright (C) 1985-1987, 1993-1994, 1997-1999, 2001-2020 Free Software
 
 #include <config.h>
 
+#ifdef __AVX2__
+# include <immintrin.h>
+#elif defined __SSE2__
+# include <emmintrin.h>
+#endif
+
 #include "lisp.h"
 #include "character.h"
 #include "buffer.h"
@@ -29,17 +35,20 @@ Copyright (C) 1985-1987, 1993-1994, 1997-1999, 2001-2020 Free Software
 #include "region-cache.h"
 #include "blockinput.h"
 #include "intervals.h"
-#include "pdumper.h"
+#include "systime.h"
 
 #include "regex-emacs.h"
 
-#define REGEXP_CACHE_SIZE 20
-
 /* If the regexp is non-nil, then the buffer contains the compiled form
    of that regexp, suitable for searching.  */
 struct regexp_cache
 {
-  struct regexp_cache *next;
+  /* The entries that were used more and less recently than this one.  */
+  struct regexp_cache *prev, *next;
+  /* The next entry in the same bucket of regexp_cache_table.  */
+  struct regexp_cache *hash_next;
+  /* The hash code of the regexp, if non-nil.  */
+  EMACS_UINT hash;
   Lisp_Object regexp, f_whitespace_regexp;
   /* Syntax table for which the regexp applies.  We need this because
      of character classes.  If this is t, then the compiled pattern is valid
@@ -51,15 +60,54 @@ #define REGEXP_CACHE_SIZE 20
   bool posix;
   /* True means we're inside a buffer match.  */
   bool busy;
+  /* The index of the regexp's profile in regexp_profiles, or -1 if it
+     has not been looked up yet.  */
+  ptrdiff_t profile;
+};
+
+/* The entries of the cache, most recently used first.  There are at
+   most regexp_cache_size of them, unless more are busy.  */
+static struct regexp_cache *searchbuf_head, *searchbuf_tail;
+static EMACS_INT regexp_cache_count;
+
+/* The entries whose regexp is non-nil, by the hash code of the
+   regexp.  The number of buckets is a power of 2, and at least
+   regexp_cache_count.  */
+static struct regexp_cache **regexp_cache_table;
+static ptrdiff_t regexp_cache_table_size;
+
+/* The number of times a regexp was found in the cache, and the number
+   of times it had to be compiled.  */
+static EMACS_INT regexp_cache_hits, regexp_cache_misses;
+
+/* What the regexp profiler knows about a regexp: the number of
+   searches and matches that used it, the number of bytes from where
+   they started to where they matched or gave up, the number of
+   failure points they pushed, and the time they took.  */
+struct regexp_profile
+{
+  EMACS_INT searches, bytes;
+  EMACS_UINT pushes;
+  struct timespec time;
 };
 
-/* The instances of that struct.  */
-static struct regexp_cache searchbufs[REGEXP_CACHE_SIZE];
+/* The profiles of the regexps used since profiling started, and a
+   hash table from each of the regexps to the index of its profile,
+   or nil if there are none.  */
+static struct regexp_profile *regexp_profiles;
+static ptrdiff_t regexp_profiles_used, regexp_profiles_size;
+static Lisp_Object regexp_profile_table;
 
-/* The head of the linked list; points to the most recently used buffer.  */
-static struct regexp_cache *searchbuf_head;
+/* The state of the profiler when a search or match started.  */
+struct regexp_profile_start
+{
+  bool profiling;
+  EMACS_UINT pushes;
+  struct timespec time;
+};
 
 static void set_search_regs (ptrdiff_t, ptrdiff_t);
+static void mark_keyword_matchers (void);
 static void save_search_regs (void);
 static EMACS_INT simple_search (EMACS_INT, unsigned char *, ptrdiff_t,
 				ptrdiff_t, Lisp_Object, ptrdiff_t, ptrdiff_t,
@@ -134,7 +182,7 @@ compile_pattern_1 (struct regexp_cache *cp, Lisp_Object pattern,
 }
 
 /* Shrink each compiled regexp buffer in the cache
-   to the size actually used right now.
+   to the size actually used right now, and free its DFA.
    This is called from garbage collection.  */
 
 void
@@ -143,29 +191,149 @@ shrink_regexp_cache (void)
   struct regexp_cache *cp;
 
   for (cp = searchbuf_head; cp != 0; cp = cp->next)
-    if (!cp->busy)
+    if (!cp->busy && cp->buf.allocated > 0)
       {
         cp->buf.allocated = cp->buf.used;
         cp->buf.buffer = xrealloc (cp->buf.buffer, cp->buf.used);
+        re_free_dfa (&cp->buf);
       }
 }
 
+/* Mark the Lisp objects that the regexp cache, the regexp profiler
+   and the cache of keyword automata refer to.  This is called from
+   garbage collection.  */
+
+void
+mark_regexp_cache (void)
+{
+  for (struct regexp_cache *cp = searchbuf_head; cp; cp = cp->next)
+    {
+      mark_object (cp->regexp);
+      mark_object (cp->f_whitespace_regexp);
+      mark_object (cp->syntax_table);
+      mark_object (cp->buf.translate);
+    }
+  mark_object (regexp_profile_table);
+  mark_keyword_matchers ();
+}
+
+/* Remove CP from the hash table of the regexp cache, if it is there,
+   and set its regexp to nil.  */
+
+static void
+unhash_regexp_cache_entry (struct regexp_cache *cp)
+{
+  if (!NILP (cp->regexp))
+    {
+      struct regexp_cache **p
+	= &regexp_cache_table[cp->hash & (regexp_cache_table_size - 1)];
+      while (*p != cp)
+	p = &(*p)->hash_next;
+      *p = cp->hash_next;
+      cp->regexp = Qnil;
+    }
+}
+
+/* Remove CP from the regexp cache and free it.  */
+
+static void
+free_regexp_cache_entry (struct regexp_cache *cp)
+{
+  eassert (!cp->busy);
+  unhash_regexp_cache_entry (cp);
+  if (cp->prev)
+    cp->prev->next = cp->next;
+  else
+    searchbuf_head = cp->next;
+  if (cp->next)
+    cp->next->prev = cp->prev;
+  else
+    searchbuf_tail = cp->prev;
+  regexp_cache_count--;
+  re_free_dfa (&cp->buf);
+  xfree (cp->buf.buffer);
+  xfree (cp);
+}
+
 /* Clear the regexp cache w.r.t. a particular syntax table,
-   because it was changed.
-   There is no danger of memory leak here because re_compile_pattern
-   automagically manages the memory in each re_pattern_buffer struct,
-   based on its `allocated' and `buffer' values.  */
+   because it was changed.  */
 void
 clear_regexp_cache (void)
 {
-  int i;
+  struct regexp_cache *cp, *next;
 
-  for (i = 0; i < REGEXP_CACHE_SIZE; ++i)
-    /* It's tempting to compare with the syntax-table we've actually changed,
-       but it's not sufficient because char-table inheritance means that
-       modifying one syntax-table can change others at the same time.  */
-    if (!searchbufs[i].busy && !EQ (searchbufs[i].syntax_table, Qt))
-      searchbufs[i].regexp = Qnil;
+  for (cp = searchbuf_head; cp; cp = next)
+    {
+      next = cp->next;
+      /* It's tempting to compare with the syntax-table we've actually
+	 changed, but it's not sufficient because char-table inheritance
+	 means that modifying one syntax-table can change others at the
+	 same time.  */
+      if (!cp->busy && !EQ (cp->syntax_table, Qt))
+	free_regexp_cache_entry (cp);
+    }
+}
+
+/* Return an entry of the regexp cache to compile a pattern into, with
+   a nil regexp: a new entry if the cache is not full, or else the
+   least recently used entry that is not busy.  First free the least
+   recently used entries that do not fit in regexp-cache-size, which
+   may have been made smaller.  */
+
+static struct regexp_cache *
+regexp_cache_entry (void)
+{
+  EMACS_INT size = max (regexp_cache_size, 1);
+  struct regexp_cache *cp, *prev;
+
+  for (cp = searchbuf_tail; cp && regexp_cache_count > size; cp = prev)
+    {
+      prev = cp->prev;
+      if (!cp->busy)
+	free_regexp_cache_entry (cp);
+    }
+
+  if (regexp_cache_count == size)
+    for (cp = searchbuf_tail; cp; cp = cp->prev)
+      if (!cp->busy)
+	{
+	  unhash_regexp_cache_entry (cp);
+	  return cp;
+	}
+
+  /* Make the hash table big enough for one more entry.  */
+  if (regexp_cache_count == regexp_cache_table_size)
+    {
+      ptrdiff_t old_size = regexp_cache_table_size;
+      struct regexp_cache **old_table = regexp_cache_table;
+
+      regexp_cache_table_size = max (2 * old_size, 64);
+      regexp_cache_table = xzalloc (regexp_cache_table_size
+				    * sizeof *regexp_cache_table);
+      for (ptrdiff_t i = 0; i < old_size; i++)
+	for (struct regexp_cache *p = old_table[i], *next; p; p = next)
+	  {
+	    struct regexp_cache **bucket
+	      = &regexp_cache_table[p->hash & (regexp_cache_table_size - 1)];
+	    next = p->hash_next;
+	    p->hash_next = *bucket;
+	    *bucket = p;
+	  }
+      xfree (old_table);
+    }
+
+  cp = xzalloc (sizeof *cp);
+  cp->regexp = cp->f_whitespace_regexp = cp->syntax_table = Qnil;
+  cp->buf.translate = Qnil;
+  cp->buf.fastmap = cp->fastmap;
+  cp->prev = searchbuf_tail;
+  if (searchbuf_tail)
+    searchbuf_tail->next = cp;
+  else
+    searchbuf_head = cp;
+  searchbuf_tail = cp;
+  regexp_cache_count++;
+  return cp;
 }
 
 static void
@@ -198,24 +366,19 @@ freeze_pattern (struct regexp_cache *searchbuf)
 compile_pattern (Lisp_Object pattern, struct re_registers *regp,
 		 Lisp_Object translate, bool posix, bool multibyte)
 {
-  struct regexp_cache *cp, **cpp, **lru_nonbusy;
-
-  for (cpp = &searchbuf_head, lru_nonbusy = NULL; ; cpp = &cp->next)
-    {
-      cp = *cpp;
-      if (!cp->busy)
-        lru_nonbusy = cpp;
-      /* Entries are initialized to nil, and may be set to nil by
-	 compile_pattern_1 if the pattern isn't valid.  Don't apply
-	 string accessors in those cases.  However, compile_pattern_1
-	 is only applied to the cache entry we pick here to reuse.  So
-	 nil should never appear before a non-nil entry.  */
-      if (NILP (cp->regexp))
-	goto compile_it;
-      if (SCHARS (cp->regexp) == SCHARS (pattern)
-          && !cp->busy
+  EMACS_UINT hash = sxhash_combine (hash_string (SSDATA (pattern),
+						   SBYTES (pattern)),
+				     2 * STRING_MULTIBYTE (pattern) + posix);
+  struct regexp_cache *cp = NULL;
+
+  if (regexp_cache_table)
+    for (cp = regexp_cache_table[hash & (regexp_cache_table_size - 1)];
+	 cp; cp = cp->hash_next)
+      if (cp->hash == hash
+	  && !cp->busy
+	  && SBYTES (cp->regexp) == SBYTES (pattern)
 	  && STRING_MULTIBYTE (cp->regexp) == STRING_MULTIBYTE (pattern)
-	  && !NILP (Fstring_equal (cp->regexp, pattern))
+	  && !memcmp (SDATA (cp->regexp), SDATA (pattern), SBYTES (pattern))
 	  && EQ (cp->buf.translate, translate)
 	  && cp->posix == posix
 	  && (EQ (cp->syntax_table, Qt)
@@ -224,27 +387,38 @@ compile_pattern (Lisp_Object pattern, struct re_registers *regp,
 	  && cp->buf.charset_unibyte == charset_unibyte)
 	break;
 
-      /* If we're at the end of the cache, compile into the last
-	 (least recently used) non-busy cell in the cache.  */
-      if (cp->next == 0)
-	{
-          if (!lru_nonbusy)
-            error ("Too much matching reentrancy");
-          cpp = lru_nonbusy;
-          cp = *cpp;
-	compile_it:
-          eassert (!cp->busy);
-	  compile_pattern_1 (cp, pattern, translate, posix);
-	  break;
-	}
+  if (cp)
+    regexp_cache_hits++;
+  else
+    {
+      struct regexp_cache **bucket;
+
+      regexp_cache_misses++;
+      cp = regexp_cache_entry ();
+      eassert (!cp->busy);
+      compile_pattern_1 (cp, pattern, translate, posix);
+      cp->hash = hash;
+      cp->profile = -1;
+      bucket = &regexp_cache_table[hash & (regexp_cache_table_size - 1)];
+      cp->hash_next = *bucket;
+      *bucket = cp;
     }
 
-  /* When we get here, cp (aka *cpp) contains the compiled pattern,
-     either because we found it in the cache or because we just compiled it.
+  /* When we get here, cp contains the compiled pattern, either
+     because we found it in the cache or because we just compiled it.
      Move it to the front of the queue to mark it as most recently used.  */
-  *cpp = cp->next;
-  cp->next = searchbuf_head;
-  searchbuf_head = cp;
+  if (cp != searchbuf_head)
+    {
+      cp->prev->next = cp->next;
+      if (cp->next)
+	cp->next->prev = cp->prev;
+      else
+	searchbuf_tail = cp->prev;
+      cp->prev = NULL;
+      cp->next = searchbuf_head;
+      searchbuf_head->prev = cp;
+      searchbuf_head = cp;
+    }
 
   /* Advise the searching functions about the space we have allocated
      for register data.  */
@@ -258,6 +432,68 @@ compile_pattern (Lisp_Object pattern, struct re_registers *regp,
 }
 
 
+/* Return the index in regexp_profiles of the profile of REGEXP,
+   making a new one if there is none.  */
+
+static ptrdiff_t
+regexp_profile_index (Lisp_Object regexp)
+{
+  if (NILP (regexp_profile_table))
+    regexp_profile_table = CALLN (Fmake_hash_table, QCtest, Qequal);
+
+  struct Lisp_Hash_Table *h = XHASH_TABLE (regexp_profile_table);
+  Lisp_Object hash;
+  ptrdiff_t i = hash_lookup (h, regexp, &hash);
+  if (i >= 0)
+    return XFIXNUM (HASH_VALUE (h, i));
+
+  if (regexp_profiles_used == regexp_profiles_size)
+    regexp_profiles = xpalloc (regexp_profiles, &regexp_profiles_size,
+			       1, -1, sizeof *regexp_profiles);
+  regexp_profiles[regexp_profiles_used]
+    = (struct regexp_profile) { .time = make_timespec (0, 0) };
+  hash_put (h, regexp, make_fixnum (regexp_profiles_used), hash);
+  return regexp_profiles_used++;
+}
+
+/* Record in *START the state of the profiler before a search or
+   match.  This costs next to nothing unless regexp-profiling is
+   non-nil.  */
+
+static void
+regexp_profile_start (struct regexp_profile_start *start)
+{
+  start->profiling = regexp_profiling;
+  if (start->profiling)
+    {
+      start->pushes = emacs_re_failure_points_pushed;
+      start->time = current_timespec ();
+    }
+}
+
+/* Add a search or match with the regexp of CP, which started when the
+   profiler was in the state START, and went through BYTES bytes, to
+   the profile of the regexp.  */
+
+static void
+regexp_profile_end (struct regexp_cache *cp,
+		    struct regexp_profile_start const *start,
+		    ptrdiff_t bytes)
+{
+  if (start->profiling)
+    {
+      struct timespec now = current_timespec ();
+      if (cp->profile < 0)
+	cp->profile = regexp_profile_index (cp->regexp);
+
+      struct regexp_profile *p = &regexp_profiles[cp->profile];
+      p->searches++;
+      p->bytes += bytes;
+      p->pushes += emacs_re_failure_points_pushed - start->pushes;
+      p->time = timespec_add (p->time, timespec_sub (now, start->time));
+    }
+}
+
 static Lisp_Object
 looking_at_1 (Lisp_Object string, bool posix)
 {
@@ -313,10 +549,13 @@ looking_at_1 (Lisp_Object string, bool posix)
   freeze_buffer_relocation ();
   freeze_pattern (cache_entry);
   re_match_object = Qnil;
+  struct regexp_profile_start profile_start;
+  regexp_profile_start (&profile_start);
   i = re_match_2 (&cache_entry->buf, (char *) p1, s1, (char *) p2, s2,
 		  PT_BYTE - BEGV_BYTE,
 		  preserve_match_data ? &search_regs : NULL,
 		  ZV_BYTE - BEGV_BYTE);
+  regexp_profile_end (cache_entry, &profile_start, max (i, 0));
 
   if (i == -2)
     {
@@ -398,19 +637,27 @@ string_match_1 (Lisp_Object regexp, Lisp_Object string, Lisp_Object start,
   set_char_table_extras (BVAR (current_buffer, case_canon_table), 2,
 			 BVAR (current_buffer, case_eqv_table));
 
-  bufp = &compile_pattern (regexp,
-                           (NILP (Vinhibit_changing_match_data)
-                            ? &search_regs : NULL),
-                           (!NILP (BVAR (current_buffer, case_fold_search))
-                            ? BVAR (current_buffer, case_canon_table) : Qnil),
-                           posix,
-                           STRING_MULTIBYTE (string))->buf;
+  struct regexp_cache *cache_entry
+    = compile_pattern (regexp,
+		       (NILP (Vinhibit_changing_match_data)
+			? &search_regs : NULL),
+		       (!NILP (BVAR (current_buffer, case_fold_search))
+			? BVAR (current_buffer, case_canon_table) : Qnil),
+		       posix,
+		       STRING_MULTIBYTE (string));
+  bufp = &cache_entry->buf;
   re_match_object = string;
+  struct regexp_profile_start profile_start;
+  regexp_profile_start (&profile_start);
   val = re_search (bufp, SSDATA (string),
 		   SBYTES (string), pos_byte,
 		   SBYTES (string) - pos_byte,
 		   (NILP (Vinhibit_changing_match_data)
 		    ? &search_regs : NULL));
+  regexp_profile_end (cache_entry, &profile_start,
+		      (val < 0 ? SBYTES (string)
+		       : NILP (Vinhibit_changing_match_data)
+		       ? search_regs.end[0] : val) - pos_byte);
 
   /* Set last_thing_searched only when match data is changed.  */
   if (NILP (Vinhibit_changing_match_data))
@@ -472,12 +719,17 @@ fast_string_match_internal (Lisp_Object regexp, Lisp_Object string,
   ptrdiff_t val;
   struct re_pattern_buffer *bufp;
 
-  bufp = &compile_pattern (regexp, 0, table,
-                           0, STRING_MULTIBYTE (string))->buf;
+  struct regexp_cache *cache_entry
+    = compile_pattern (regexp, 0, table, 0, STRING_MULTIBYTE (string));
+  bufp = &cache_entry->buf;
   re_match_object = string;
+  struct regexp_profile_start profile_start;
+  regexp_profile_start (&profile_start);
   val = re_search (bufp, SSDATA (string),
 		   SBYTES (string), 0,
 		   SBYTES (string), 0);
+  regexp_profile_end (cache_entry, &profile_start,
+		      val < 0 ? SBYTES (string) : val);
   return val;
 }
 
@@ -494,11 +746,14 @@ fast_c_string_match_ignore_case (Lisp_Object regexp,
   struct re_pattern_buffer *bufp;
 
   regexp = string_make_unibyte (regexp);
-  bufp = &compile_pattern (regexp, 0,
-                           Vascii_canon_table, 0,
-                           0)->buf;
+  struct regexp_cache *cache_entry
+    = compile_pattern (regexp, 0, Vascii_canon_table, 0, 0);
+  bufp = &cache_entry->buf;
   re_match_object = Qt;
+  struct regexp_profile_start profile_start;
+  regexp_profile_start (&profile_start);
   val = re_search (bufp, string, len, 0, len, 0);
+  regexp_profile_end (cache_entry, &profile_start, val < 0 ? len : val);
   return val;
 }
 
@@ -561,8 +816,11 @@ fast_looking_at (Lisp_Object regexp, ptrdiff_t pos, ptrdiff_t pos_byte,
   freeze_buffer_relocation ();
   freeze_pattern (cache_entry);
   re_match_object = STRINGP (string) ? string : Qnil;
+  struct regexp_profile_start profile_start;
+  regexp_profile_start (&profile_start);
   len = re_match_2 (&cache_entry->buf, (char *) p1, s1, (char *) p2, s2,
 		    pos_byte, NULL, limit_byte);
+  regexp_profile_end (cache_entry, &profile_start, max (len, 0));
 
   unbind_to (count, Qnil);
   return len;
@@ -619,6 +877,521 @@ newline_cache_on_off (struct buffer *buf)
     }
 }
 
+
+/* Counting newlines.  */
+
+/* When looking for at least NEWLINE_BLOCK_MIN_COUNT newlines, it pays
+   to count the newlines in whole blocks of NEWLINE_BLOCK_SIZE bytes
+   first, and to skip the blocks that have too few of them.  */
+enum { NEWLINE_BLOCK_SIZE = 2048, NEWLINE_BLOCK_MIN_COUNT = 32 };
+
+/* Return the number of newlines in the N bytes at P.
+
+   This compares many bytes at a time with a newline, adding up the
+   matches in each byte of an accumulator, which is summed up before
+   any of its bytes can overflow.  */
+
+static ptrdiff_t
+count_newline_bytes (unsigned char const *p, ptrdiff_t n)
+{
+  unsigned char const *lim = p + n;
+  ptrdiff_t count = 0;
+
+#if defined __AVX2__
+  __m256i const newlines = _mm256_set1_epi8 ('\n');
+  __m256i const zero = _mm256_setzero_si256 ();
+  while (lim - p >= 32)
+    {
+      __m256i acc = zero;
+      for (int i = 0; i < UCHAR_MAX && lim - p >= 32; i++, p += 32)
+	{
+	  __m256i v = _mm256_loadu_si256 ((__m256i const *) p);
+	  acc = _mm256_sub_epi8 (acc, _mm256_cmpeq_epi8 (v, newlines));
+	}
+      __m256i sums = _mm256_sad_epu8 (acc, zero);
+      __m128i sum = _mm_add_epi64 (_mm256_castsi256_si128 (sums),
+				   _mm256_extracti128_si256 (sums, 1));
+      count += (_mm_cvtsi128_si32 (sum)
+		+ _mm_cvtsi128_si32 (_mm_unpackhi_epi64 (sum, sum)));
+    }
+#elif defined __SSE2__
+  __m128i const newlines = _mm_set1_epi8 ('\n');
+  __m128i const zero = _mm_setzero_si128 ();
+  while (lim - p >= 16)
+    {
+      __m128i acc = zero;
+      for (int i = 0; i < UCHAR_MAX && lim - p >= 16; i++, p += 16)
+	{
+	  __m128i v = _mm_loadu_si128 ((__m128i const *) p);
+	  acc = _mm_sub_epi8 (acc, _mm_cmpeq_epi8 (v, newlines));
+	}
+      __m128i sum = _mm_sad_epu8 (acc, zero);
+      count += (_mm_cvtsi128_si32 (sum)
+		+ _mm_cvtsi128_si32 (_mm_unpackhi_epi64 (sum, sum)));
+    }
+#else
+  /* Work a word at a time.  */
+  int const wordsize = sizeof (size_t);
+  size_t const ones = SIZE_MAX / UCHAR_MAX;
+  size_t const highs = ones << (CHAR_BIT - 1);
+  while (lim - p >= wordsize)
+    {
+      size_t acc = 0;
+      for (int i = 0; i < UCHAR_MAX && lim - p >= wordsize; i++, p += wordsize)
+	{
+	  size_t w;
+	  memcpy (&w, p, sizeof w);
+	  w ^= ones * '\n';
+	  /* Now the high bit of each byte is clear only if the byte was
+	     a newline.  */
+	  w |= (w & ~highs) + ~highs;
+	  acc += (~w & highs) >> (CHAR_BIT - 1);
+	}
+      for (int i = 0; i < wordsize; i++)
+	count += (acc >> (i * CHAR_BIT)) & UCHAR_MAX;
+    }
+#endif
+
+  for (; p < lim; p++)
+    count += *p == '\n';
+  return count;
+}
+
+
+/* The line index: remembering how many newlines come before positions
+   of the text.
+
+   Each buffer text can have an index of checkpoints about
+   LINE_INDEX_INTERVAL characters apart, each recording the number of
+   newlines before it, so that counting lines never needs to scan from
+   the beginning of the text.  As with the checkpoints for byte
+   positions in marker.c, they are kept in an array with a gap.  Those
+   before the gap hold their position and the number of newlines before
+   it; those after it hold their distance from the end of the text and
+   the number of newlines after them.  Either is unaffected by changes
+   to the text on the other side of the checkpoint, so a change only
+   needs to move the gap to where it happens, and to forget how many
+   newlines there are in the gap.  That number is counted again the
+   next time the index is used.  */
+
+struct line_checkpoint
+{
+  ptrdiff_t charpos, nlines;
+};
+
+struct line_index
+{
+  /* The end of the text.  */
+  ptrdiff_t z;
+
+  /* The number of newlines between the last checkpoint before the gap,
+     or the beginning of the text, and the first checkpoint after it,
+     or the end of the text; -1 if unknown.  */
+  ptrdiff_t gap_nlines;
+
+  /* The checkpoints, in order of position.  CHECKPOINTS has room for
+     SIZE of them; the first NBEFORE are before the gap and the last
+     NAFTER are after it.  */
+  struct line_checkpoint *checkpoints;
+  ptrdiff_t size, nbefore, nafter;
+};
+
+/* Return the number of newlines in B between FROM_BYTE and TO_BYTE.  */
+
+static ptrdiff_t
+count_newlines (struct buffer *b, ptrdiff_t from_byte, ptrdiff_t to_byte)
+{
+  ptrdiff_t count = 0;
+
+  while (from_byte < to_byte)
+    {
+      ptrdiff_t ceiling_byte = to_byte;
+      if (from_byte < BUF_GPT_BYTE (b))
+	ceiling_byte = min (ceiling_byte, BUF_GPT_BYTE (b));
+
+      count += count_newline_bytes (BUF_BYTE_ADDRESS (b, from_byte),
+				     ceiling_byte - from_byte);
+      from_byte = ceiling_byte;
+    }
+  return count;
+}
+
+/* Return the number of newlines in B between FROM and TO.  */
+
+static ptrdiff_t
+count_newlines_between (struct buffer *b, ptrdiff_t from, ptrdiff_t to)
+{
+  return count_newlines (b, buf_charpos_to_bytepos (b, from),
+			 buf_charpos_to_bytepos (b, to));
+}
+
+/* Return the byte position in B after the COUNTth newline after
+   FROM_BYTE, which must come before TO_BYTE.  */
+
+static ptrdiff_t
+find_nth_newline (struct buffer *b, ptrdiff_t from_byte, ptrdiff_t to_byte,
+		  ptrdiff_t count)
+{
+  while (from_byte < to_byte)
+    {
+      ptrdiff_t ceiling_byte = to_byte;
+      if (from_byte < BUF_GPT_BYTE (b))
+	ceiling_byte = min (ceiling_byte, BUF_GPT_BYTE (b));
+
+      unsigned char *base = BUF_BYTE_ADDRESS (b, from_byte);
+      unsigned char *p = base, *lim = base + (ceiling_byte - from_byte);
+
+      while (lim - p > NEWLINE_BLOCK_SIZE)
+	{
+	  ptrdiff_t n = count_newline_bytes (p, NEWLINE_BLOCK_SIZE);
+	  if (n >= count)
+	    break;
+	  count -= n;
+	  p += NEWLINE_BLOCK_SIZE;
+	}
+
+      while ((p = memchr (p, '\n', lim - p)))
+	{
+	  p++;
+	  if (--count == 0)
+	    return from_byte + (p - base);
+	}
+      from_byte = ceiling_byte;
+    }
+  emacs_abort ();
+}
+
+/* Forget the line index of B.  */
+
+void
+clear_line_index (struct buffer *b)
+{
+  struct line_index *x = b->text->line_index;
+
+  if (x)
+    {
+      xfree (x->checkpoints);
+      xfree (x);
+      b->text->line_index = NULL;
+    }
+}
+
+/* Return the number of newlines in the text of X.  */
+
+static ptrdiff_t
+line_index_nlines (struct line_index *x)
+{
+  struct line_checkpoint *v = x->checkpoints;
+
+  eassert (x->gap_nlines >= 0);
+  return ((x->nbefore > 0 ? v[x->nbefore - 1].nlines : 0)
+	  + x->gap_nlines
+	  + (x->nafter > 0 ? v[x->size - x->nafter].nlines : 0));
+}
+
+/* Return the line index of B, making one if needed, with the number of
+   newlines in its gap known.  */
+
+static struct line_index *
+line_index (struct buffer *b)
+{
+  struct line_index *x = b->text->line_index;
+
+  if (x && x->z != BUF_Z (b))
+    {
+      /* The text was changed behind our back.  */
+      clear_line_index (b);
+      x = NULL;
+    }
+
+  if (!x)
+    {
+      x = xzalloc (sizeof *x);
+      x->z = BUF_Z (b);
+      x->gap_nlines = -1;
+      b->text->line_index = x;
+    }
+
+  if (x->gap_nlines < 0)
+    {
+      struct line_checkpoint *v = x->checkpoints;
+      ptrdiff_t from = (x->nbefore > 0 ? v[x->nbefore - 1].charpos
+			: BUF_BEG (b));
+      ptrdiff_t to = (x->nafter > 0 ? x->z - v[x->size - x->nafter].charpos
+		      : x->z);
+      x->gap_nlines = count_newlines_between (b, from, to);
+    }
+
+  return x;
+}
+
+/* Return checkpoint number I of X.  */
+
+static struct line_checkpoint
+line_checkpoint (struct line_index *x, ptrdiff_t i)
+{
+  if (i < x->nbefore)
+    return x->checkpoints[i];
+
+  struct line_checkpoint *c
+    = &x->checkpoints[x->size - x->nafter + (i - x->nbefore)];
+  return (struct line_checkpoint) { x->z - c->charpos,
+				    line_index_nlines (x) - c->nlines };
+}
+
+/* Return the number of checkpoints of X at or before POS if LINES is
+   false, or the number of those with fewer than POS newlines before
+   them if LINES is true.  */
+
+static ptrdiff_t
+search_line_index (struct line_index *x, ptrdiff_t pos, bool lines)
+{
+  ptrdiff_t lo = 0, hi = x->nbefore + x->nafter;
+
+  while (lo < hi)
+    {
+      ptrdiff_t mid = lo + (hi - lo) / 2;
+      struct line_checkpoint c = line_checkpoint (x, mid);
+
+      if (lines ? c.nlines < pos : c.charpos <= pos)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  return lo;
+}
+
+/* Move the gap of X so that the checkpoints before it are those at or
+   before CHARPOS.  If the number of newlines in the gap is unknown,
+   the checkpoints that the gap moves over are dropped instead.  */
+
+static void
+move_line_index_gap (struct line_index *x, ptrdiff_t charpos)
+{
+  struct line_checkpoint *v = x->checkpoints;
+
+  while (x->nbefore > 0 && v[x->nbefore - 1].charpos > charpos)
+    {
+      struct line_checkpoint c = v[--x->nbefore];
+
+      if (x->gap_nlines >= 0)
+	{
+	  ptrdiff_t prev = x->nbefore > 0 ? v[x->nbefore - 1].nlines : 0;
+	  ptrdiff_t next = x->nafter > 0 ? v[x->size - x->nafter].nlines : 0;
+	  struct line_checkpoint *d = &v[x->size - ++x->nafter];
+	  d->charpos = x->z - c.charpos;
+	  d->nlines = x->gap_nlines + next;
+	  x->gap_nlines = c.nlines - prev;
+	}
+    }
+
+  while (x->nafter > 0 && x->z - v[x->size - x->nafter].charpos <= charpos)
+    {
+      struct line_checkpoint c = v[x->size - x->nafter--];
+
+      if (x->gap_nlines >= 0)
+	{
+	  ptrdiff_t prev = x->nbefore > 0 ? v[x->nbefore - 1].nlines : 0;
+	  ptrdiff_t next = x->nafter > 0 ? v[x->size - x->nafter].nlines : 0;
+	  struct line_checkpoint *d = &v[x->nbefore++];
+	  d->charpos = x->z - c.charpos;
+	  d->nlines = prev + x->gap_nlines;
+	  x->gap_nlines = c.nlines - next;
+	}
+    }
+}
+
+/* Add a checkpoint at CHARPOS, with NLINES newlines before it, to X.
+   There must be no checkpoint at CHARPOS yet.  */
+
+static void
+add_line_checkpoint (struct line_index *x, ptrdiff_t charpos,
+		     ptrdiff_t nlines)
+{
+  eassert (x->gap_nlines >= 0);
+  move_line_index_gap (x, charpos - 1);
+  if (x->nbefore + x->nafter == x->size)
+    {
+      ptrdiff_t old_size = x->size;
+      x->checkpoints = xpalloc (x->checkpoints, &x->size, 1, -1,
+				sizeof *x->checkpoints);
+      memmove (x->checkpoints + x->size - x->nafter,
+	       x->checkpoints + old_size - x->nafter,
+	       x->nafter * sizeof *x->checkpoints);
+    }
+
+  struct line_checkpoint *v = x->checkpoints;
+  x->gap_nlines -= nlines - (x->nbefore > 0 ? v[x->nbefore - 1].nlines : 0);
+  v[x->nbefore++] = (struct line_checkpoint) { charpos, nlines };
+}
+
+/* Adjust the line index of the current buffer for a change of the
+   text from FROM to TO, which is replaced by text NCHARS long.  This
+   drops the checkpoints after FROM up to TO.  */
+
+void
+adjust_line_index (ptrdiff_t from, ptrdiff_t to, ptrdiff_t nchars)
+{
+  struct line_index *x = current_buffer->text->line_index;
+
+  if (x)
+    {
+      move_line_index_gap (x, from);
+      while (x->nafter > 0
+	     && x->z - x->checkpoints[x->size - x->nafter].charpos <= to)
+	x->nafter--;
+      x->z += nchars - (to - from);
+      x->gap_nlines = -1;
+    }
+}
+
+/* Return the number of newlines in B before CHARPOS, disregarding any
+   narrowing.  */
+
+ptrdiff_t
+buf_charpos_to_line (struct buffer *b, ptrdiff_t charpos)
+{
+  struct line_index *x = line_index (b);
+  ptrdiff_t i = search_line_index (x, charpos, false);
+  struct line_checkpoint below
+    = (i > 0 ? line_checkpoint (x, i - 1)
+       : (struct line_checkpoint) { BUF_BEG (b), 0 });
+  struct line_checkpoint above
+    = (i < x->nbefore + x->nafter ? line_checkpoint (x, i)
+       : (struct line_checkpoint) { BUF_Z (b), line_index_nlines (x) });
+
+  /* Count from the nearer checkpoint, leaving new ones behind.  */
+  if (charpos - below.charpos <= above.charpos - charpos)
+    {
+      while (charpos - below.charpos > LINE_INDEX_INTERVAL)
+	{
+	  ptrdiff_t next = below.charpos + LINE_INDEX_INTERVAL;
+	  below.nlines += count_newlines_between (b, below.charpos, next);
+	  below.charpos = next;
+	  add_line_checkpoint (x, below.charpos, below.nlines);
+	}
+      return below.nlines + count_newlines_between (b, below.charpos, charpos);
+    }
+  else
+    {
+      while (above.charpos - charpos > LINE_INDEX_INTERVAL)
+	{
+	  ptrdiff_t next = above.charpos - LINE_INDEX_INTERVAL;
+	  above.nlines -= count_newlines_between (b, next, above.charpos);
+	  above.charpos = next;
+	  add_line_checkpoint (x, above.charpos, above.nlines);
+	}
+      return above.nlines - count_newlines_between (b, charpos, above.charpos);
+    }
+}
+
+/* Return the position in B after its NLINESth newline, or its
+   beginning if NLINES is zero.  B must have at least NLINES newlines.  */
+
+static ptrdiff_t
+buf_line_to_charpos (struct buffer *b, ptrdiff_t nlines)
+{
+  if (nlines == 0)
+    return BUF_BEG (b);
+
+  struct line_index *x = line_index (b);
+  ptrdiff_t i = search_line_index (x, nlines, true);
+  struct line_checkpoint below
+    = (i > 0 ? line_checkpoint (x, i - 1)
+       : (struct line_checkpoint) { BUF_BEG (b), 0 });
+  struct line_checkpoint above
+    = (i < x->nbefore + x->nafter ? line_checkpoint (x, i)
+       : (struct line_checkpoint) { BUF_Z (b), line_index_nlines (x) });
+
+  eassert (below.nlines < nlines && nlines <= above.nlines);
+
+  /* Narrow down the stretch of text to scan, leaving checkpoints
+     behind.  */
+  while (above.charpos - below.charpos > LINE_INDEX_INTERVAL)
+    {
+      struct line_checkpoint c;
+      c.charpos = below.charpos + LINE_INDEX_INTERVAL;
+      c.nlines = below.nlines + count_newlines_between (b, below.charpos,
+							c.charpos);
+      add_line_checkpoint (x, c.charpos, c.nlines);
+      if (c.nlines < nlines)
+	below = c;
+      else
+	above = c;
+    }
+
+  ptrdiff_t bytepos
+    = find_nth_newline (b, buf_charpos_to_bytepos (b, below.charpos),
+			buf_charpos_to_bytepos (b, above.charpos),
+			nlines - below.nlines);
+  return buf_bytepos_to_charpos (b, bytepos);
+}
+
+/* Like find_newline, but use the line index of the current buffer, and
+   don't check for quitting.  */
+
+static ptrdiff_t
+find_newline_by_index (ptrdiff_t start, ptrdiff_t end, ptrdiff_t end_byte,
+		       ptrdiff_t count, ptrdiff_t *counted, ptrdiff_t *bytepos)
+{
+  ptrdiff_t line = buf_charpos_to_line (current_buffer, start);
+  ptrdiff_t found, pos;
+
+  if (count > 0)
+    {
+      /* The newlines between START and END are numbered LINE + 1 and
+	 up.  */
+      found = buf_charpos_to_line (current_buffer, end) - line;
+      if (found < count)
+	goto not_found;
+      pos = buf_line_to_charpos (current_buffer, line + count);
+    }
+  else
+    {
+      /* The newlines between END and START are numbered LINE and
+	 down.  */
+      found = buf_charpos_to_line (current_buffer, end) - line;
+      if (found > count)
+	goto not_found;
+      pos = buf_line_to_charpos (current_buffer, line + count + 1);
+    }
+
+  if (counted)
+    *counted = count;
+  if (bytepos)
+    *bytepos = CHAR_TO_BYTE (pos);
+  return pos;
+
+ not_found:
+  if (counted)
+    *counted = found;
+  if (bytepos)
+    *bytepos = end_byte;
+  return end;
+}
+
+DEFUN ("line-number-at-pos", Fline_number_at_pos, Sline_number_at_pos,
+       0, 2, 0,
+       doc: /* Return buffer line number at position POS.
+If POS is nil, use current buffer location.
+
+If ABSOLUTE is nil, the default, counting starts
+at (point-min), so the value refers to the contents of the
+accessible portion of the (potentially narrowed) buffer.  If
+ABSOLUTE is non-nil, ignore any narrowing and return the
+absolute line number.  */)
+  (Lisp_Object pos, Lisp_Object absolute)
+{
+  ptrdiff_t beg = NILP (absolute) ? BEGV : BEG;
+  ptrdiff_t end = NILP (absolute) ? ZV : Z;
+  ptrdiff_t charpos = (NILP (pos) ? PT
+		       : clip_to_bounds (beg, fix_position (pos), end));
+
+  return make_fixnum (buf_charpos_to_line (current_buffer, charpos)
+		      - buf_charpos_to_line (current_buffer, beg) + 1);
+}
+
+
 
 /* Search for COUNT newlines between START/START_BYTE and END/END_BYTE.
 
@@ -663,6 +1436,12 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
   if (end_byte == -1)
     end_byte = CHAR_TO_BYTE (end);
 
+  /* Long scans for many newlines are cheaper with the line index.  */
+  if ((count >= LINE_INDEX_MIN_COUNT || count <= -LINE_INDEX_MIN_COUNT)
+      && eabs (end - start) > LINE_INDEX_INTERVAL)
+    return find_newline_by_index (start, end, end_byte, count, counted,
+				  bytepos);
+
   newline_cache = newline_cache_on_off (current_buffer);
   if (current_buffer->base_buffer)
     cache_buffer = current_buffer->base_buffer;
@@ -770,6 +1549,21 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
 	  ptrdiff_t base = start_byte - lim_byte;
 	  ptrdiff_t cursor, next;
 
+	  /* Without a cache to fill in, skip the blocks that have fewer
+	     newlines than we are looking for.  */
+	  if (!newline_cache && count >= NEWLINE_BLOCK_MIN_COUNT)
+	    while (-base > NEWLINE_BLOCK_SIZE)
+	      {
+		ptrdiff_t n = count_newline_bytes (lim_addr + base,
+						   NEWLINE_BLOCK_SIZE);
+		if (n >= count)
+		  break;
+		count -= n;
+		base += NEWLINE_BLOCK_SIZE;
+		if (allow_quit)
+		  maybe_quit ();
+	      }
+
 	  for (cursor = base; cursor < 0; cursor = next)
 	    {
               /* The dumb loop.  */
@@ -879,6 +1673,21 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
 	  ptrdiff_t base = start_byte - ceiling_byte;
 	  ptrdiff_t cursor, prev;
 
+	  /* Skip blocks the same way as above.  */
+	  if (!newline_cache && count <= -NEWLINE_BLOCK_MIN_COUNT)
+	    while (base > NEWLINE_BLOCK_SIZE)
+	      {
+		ptrdiff_t n
+		  = count_newline_bytes (ceiling_addr + base - NEWLINE_BLOCK_SIZE,
+					 NEWLINE_BLOCK_SIZE);
+		if (count + n >= 0)
+		  break;
+		count += n;
+		base -= NEWLINE_BLOCK_SIZE;
+		if (allow_quit)
+		  maybe_quit ();
+	      }
+
 	  for (cursor = base; 0 < cursor; cursor = prev)
             {
 	      unsigned char *nl = memrchr (ceiling_addr, '\n', cursor);
@@ -1191,13 +2000,17 @@ search_buffer_re (Lisp_Object string, ptrdiff_t pos, ptrdiff_t pos_byte,
   while (n < 0)
     {
       ptrdiff_t val;
+      struct regexp_profile_start profile_start;
 
       re_match_object = Qnil;
+      regexp_profile_start (&profile_start);
       val = re_search_2 (bufp, (char *) p1, s1, (char *) p2, s2,
                          pos_byte - BEGV_BYTE, lim_byte - pos_byte,
                          preserve_match_data ? &search_regs : &search_regs_1,
                          /* Don't allow match past current point */
                          pos_byte - BEGV_BYTE);
+      regexp_profile_end (cache_entry, &profile_start,
+			  pos_byte - (val < 0 ? lim_byte : val + BEGV_BYTE));
       if (val == -2)
         {
           unbind_to (count, Qnil);
@@ -1238,12 +2051,18 @@ search_buffer_re (Lisp_Object string, ptrdiff_t pos, ptrdiff_t pos_byte,
   while (n > 0)
     {
       ptrdiff_t val;
+      struct regexp_profile_start profile_start;
+      struct re_registers *regs
+	= preserve_match_data ? &search_regs : &search_regs_1;
 
       re_match_object = Qnil;
+      regexp_profile_start (&profile_start);
       val = re_search_2 (bufp, (char *) p1, s1, (char *) p2, s2,
                          pos_byte - BEGV_BYTE, lim_byte - pos_byte,
-                         preserve_match_data ? &search_regs : &search_regs_1,
-                         lim_byte - BEGV_BYTE);
+                         regs, lim_byte - BEGV_BYTE);
+      regexp_profile_end (cache_entry, &profile_start,
+			  (val < 0 ? lim_byte : regs->end[0] + BEGV_BYTE)
+			  - pos_byte);
       if (val == -2)
         {
           unbind_to (count, Qnil);
@@ -2330,6 +3149,515 @@ DEFUN ("posix-search-forward", Fposix_search_forward, Sposix_search_forward, 1,
   return search_command (regexp, bound, noerror, count, 1, 1, 1);
 }
 
+/* Aho-Corasick automata, which search for any of a set of strings at
+   once, for search-forward-keywords.  The automaton of a set of
+   keywords is a trie of the keywords, whose states are the prefixes
+   of keywords, plus a failure link from each state to the state of
+   the longest proper suffix of its string that is also a prefix.  It
+   works on characters, after translation, rather than on bytes, so
+   that case-equivalent characters of different lengths match.  To
+   keep the automaton small, characters are first mapped to classes,
+   which number the distinct characters of the keywords from 1; class
+   0 stands for every other character.  */
+
+struct keyword_state
+{
+  /* The transitions out of this state are EDGES through
+     EDGES + NEDGES - 1 in the edges of the automaton, in no
+     particular order.  */
+  int edges, nedges;
+  /* The state of the longest proper suffix of this state's string
+     that is a prefix of a keyword.  */
+  int fail;
+  /* The length of this state's string, in characters.  */
+  int depth;
+  /* The index of the longest keyword that is a suffix of this state's
+     string, or -1 if there is none, and its length in characters.  */
+  int match, match_len;
+};
+
+struct keyword_edge
+{
+  int class, target;
+};
+
+struct keyword_char
+{
+  int c, class;
+};
+
+struct keyword_matcher
+{
+  /* The next less recently used automaton in the cache.  */
+  struct keyword_matcher *next;
+  /* A vector of copies of the keywords, the translate table and
+     whether the automaton is for multibyte text.  */
+  Lisp_Object keywords, translate;
+  bool multibyte;
+  /* The class of each ASCII character, after translation.  */
+  int ascii[128];
+  /* The translated characters of the keywords and their classes,
+     sorted by character.  */
+  struct keyword_char *chars;
+  int nchars;
+  /* The states; state 0 is the root, for the empty string.  ROOT holds
+     the transition out of it for each class, which is 0 for classes
+     that begin no keyword.  */
+  struct keyword_state *states;
+  struct keyword_edge *edges;
+  int *root;
+};
+
+/* The number of automata kept for reuse.  */
+#define KEYWORD_CACHE_SIZE 4
+
+/* The cached automata, most recently used first.  */
+static struct keyword_matcher *keyword_matchers;
+
+static void
+mark_keyword_matchers (void)
+{
+  for (struct keyword_matcher *m = keyword_matchers; m; m = m->next)
+    {
+      mark_object (m->keywords);
+      mark_object (m->translate);
+    }
+}
+
+static void
+free_keyword_matcher (void *arg)
+{
+  struct keyword_matcher *m = arg;
+  xfree (m->chars);
+  xfree (m->states);
+  xfree (m->edges);
+  xfree (m->root);
+  xfree (m);
+}
+
+static int
+compare_keyword_chars (const void *a, const void *b)
+{
+  const struct keyword_char *x = a, *y = b;
+  return x->c < y->c ? -1 : x->c > y->c;
+}
+
+/* Return the class of the translated character C in M.  */
+
+static int
+keyword_char_class (struct keyword_matcher *m, int c)
+{
+  struct keyword_char key = { c, 0 };
+  struct keyword_char *found = bsearch (&key, m->chars, m->nchars,
+					sizeof *m->chars,
+					compare_keyword_chars);
+  return found ? found->class : 0;
+}
+
+/* Return the character at index I of the keyword STRING, as it would
+   appear in text that is multibyte if MULTIBYTE, translated by TRT.
+   Advance *I and *I_BYTE past it.  */
+
+static int
+keyword_char (Lisp_Object string, ptrdiff_t *i, ptrdiff_t *i_byte,
+	      bool multibyte, Lisp_Object trt)
+{
+  int c;
+
+  if (STRING_MULTIBYTE (string))
+    {
+      int len;
+      c = string_char_and_length (SDATA (string) + *i_byte, &len);
+      *i_byte += len;
+      if (!multibyte && !ASCII_CHAR_P (c))
+	c = CHAR_TO_BYTE8 (c);
+    }
+  else
+    {
+      c = SREF (string, *i_byte);
+      *i_byte += 1;
+      if (multibyte)
+	c = make_char_multibyte (c);
+    }
+  (*i)++;
+
+  /* In unibyte text, only ASCII characters are translated, as they
+     would be by search-forward.  */
+  if (!NILP (trt) && (multibyte || ASCII_CHAR_P (c)))
+    c = char_table_translate (trt, c);
+  return c;
+}
+
+/* Return the state that state S of M moves to on a character of class
+   CLASS.  */
+
+static int
+keyword_transition (struct keyword_matcher *m, int s, int class)
+{
+  while (s != 0)
+    {
+      struct keyword_state *st = &m->states[s];
+      for (int i = st->edges; i < st->edges + st->nedges; i++)
+	if (m->edges[i].class == class)
+	  return m->edges[i].target;
+      s = st->fail;
+    }
+  return m->root[class];
+}
+
+/* Build the automaton that searches for the strings in the vector
+   KEYWORDS, in text that is multibyte if MULTIBYTE, translating
+   characters by TRT unless it is nil.  */
+
+static struct keyword_matcher *
+make_keyword_matcher (Lisp_Object keywords, Lisp_Object trt,
+		      bool multibyte)
+{
+  ptrdiff_t nkeywords = ASIZE (keywords), total = 0;
+
+  for (ptrdiff_t k = 0; k < nkeywords; k++)
+    total += SCHARS (AREF (keywords, k));
+  if (INT_MAX - 1 < total || INT_MAX < nkeywords)
+    error ("Too many keywords");
+
+  ptrdiff_t count = SPECPDL_INDEX ();
+  struct keyword_matcher *m = xzalloc (sizeof *m);
+  record_unwind_protect_ptr (free_keyword_matcher, m);
+  m->keywords = keywords;
+  m->translate = trt;
+  m->multibyte = multibyte;
+
+  /* Translate the keywords into TEXT, and collect their distinct
+     characters.  */
+  int *text = xnmalloc (total + 1, sizeof *text);
+  record_unwind_protect_ptr (xfree, text);
+  m->chars = xnmalloc (total, sizeof *m->chars);
+  for (ptrdiff_t k = 0, n = 0; k < nkeywords; k++)
+    {
+      Lisp_Object string = AREF (keywords, k);
+      for (ptrdiff_t i = 0, i_byte = 0; i < SCHARS (string); n++)
+	text[n] = m->chars[n].c = keyword_char (string, &i, &i_byte,
+						 multibyte, trt);
+    }
+  qsort (m->chars, total, sizeof *m->chars, compare_keyword_chars);
+  for (ptrdiff_t i = 0; i < total; i++)
+    if (m->nchars == 0 || m->chars[m->nchars - 1].c != m->chars[i].c)
+      {
+	m->chars[m->nchars].c = m->chars[i].c;
+	m->chars[m->nchars].class = m->nchars + 1;
+	m->nchars++;
+      }
+  for (int c = 0; c < 128; c++)
+    m->ascii[c] = keyword_char_class (m, NILP (trt)
+				      ? c : char_table_translate (trt, c));
+
+  /* Build the trie.  While it is built, the children of a state are
+     a list linked through SIBLING, and CLASS_IN is the class of the
+     character that leads to each state.  */
+  int *first_child = xnmalloc (total + 1, 3 * sizeof *first_child);
+  int *sibling = first_child + total + 1;
+  int *class_in = sibling + total + 1;
+  record_unwind_protect_ptr (xfree, first_child);
+  m->states = xnmalloc (total + 1, sizeof *m->states);
+  m->root = xzalloc ((m->nchars + 1) * sizeof *m->root);
+  int nstates = 1;
+  m->states[0] = (struct keyword_state) { .match = -1 };
+  first_child[0] = 0;
+  for (ptrdiff_t k = 0, n = 0; k < nkeywords; k++)
+    {
+      int s = 0;
+      for (ptrdiff_t i = SCHARS (AREF (keywords, k)); 0 < i; i--, n++)
+	{
+	  int class = keyword_char_class (m, text[n]), t;
+	  if (s == 0)
+	    t = m->root[class];
+	  else
+	    for (t = first_child[s]; t && class_in[t] != class;
+		 t = sibling[t])
+	      continue;
+	  if (t == 0)
+	    {
+	      t = nstates++;
+	      m->states[t] = (struct keyword_state)
+		{ .depth = m->states[s].depth + 1, .match = -1 };
+	      first_child[t] = 0;
+	      class_in[t] = class;
+	      sibling[t] = first_child[s];
+	      first_child[s] = t;
+	      if (s == 0)
+		m->root[class] = t;
+	    }
+	  s = t;
+	}
+      if (m->states[s].match < 0)
+	{
+	  m->states[s].match = k;
+	  m->states[s].match_len = m->states[s].depth;
+	}
+    }
+
+  /* Lay out the transitions, and compute the failure links and
+     matches breadth first, so that the state a failure link leads to
+     is complete before it is used.  TEXT is no longer needed, and is
+     big enough for the queue of states.  */
+  m->edges = xnmalloc (nstates, sizeof *m->edges);
+  int *queue = text;
+  int head = 0, tail = 0, nedges = 0;
+  queue[tail++] = 0;
+  while (head < tail)
+    {
+      int s = queue[head++];
+      struct keyword_state *st = &m->states[s];
+      if (s != 0)
+	st->edges = nedges;
+      for (int t = first_child[s]; t; t = sibling[t])
+	{
+	  struct keyword_state *tt = &m->states[t];
+	  if (s != 0)
+	    {
+	      m->edges[nedges++] = (struct keyword_edge) { class_in[t], t };
+	      st->nedges++;
+	    }
+	  tt->fail = s == 0 ? 0 : keyword_transition (m, st->fail,
+						      class_in[t]);
+	  if (tt->match < 0)
+	    {
+	      tt->match = m->states[tt->fail].match;
+	      tt->match_len = m->states[tt->fail].match_len;
+	    }
+	  queue[tail++] = t;
+	}
+    }
+
+  clear_unwind_protect (count);
+  unbind_to (count, Qnil);
+  return m;
+}
+
+/* Return true if the string A is the same as B, which can be any
+   object.  */
+
+static bool
+same_keyword (Lisp_Object a, Lisp_Object b)
+{
+  return (STRINGP (b)
+	  && SCHARS (a) == SCHARS (b)
+	  && SBYTES (a) == SBYTES (b)
+	  && STRING_MULTIBYTE (a) == STRING_MULTIBYTE (b)
+	  && !memcmp (SDATA (a), SDATA (b), SBYTES (a)));
+}
+
+/* Return true if the vector COPY has the same strings as KEYWORDS, a
+   list or vector, which may have been modified since COPY was made
+   of it.  */
+
+static bool
+same_keywords (Lisp_Object copy, Lisp_Object keywords)
+{
+  ptrdiff_t n = ASIZE (copy), k;
+
+  if (VECTORP (keywords))
+    {
+      if (ASIZE (keywords) != n)
+	return false;
+      for (k = 0; k < n; k++)
+	if (!same_keyword (AREF (copy, k), AREF (keywords, k)))
+	  return false;
+      return true;
+    }
+
+  for (k = 0; k < n && CONSP (keywords); k++, keywords = XCDR (keywords))
+    if (!same_keyword (AREF (copy, k), XCAR (keywords)))
+      return false;
+  return k == n && NILP (keywords);
+}
+
+/* Return an automaton that searches for the strings in KEYWORDS, a
+   list or vector, in the current buffer, translating characters by
+   TRT unless it is nil.  Reuse a cached one if possible.  */
+
+static struct keyword_matcher *
+keyword_matcher (Lisp_Object keywords, Lisp_Object trt)
+{
+  bool multibyte = !NILP (BVAR (current_buffer, enable_multibyte_characters));
+  struct keyword_matcher *m, **mp;
+  int n = 0;
+
+  for (mp = &keyword_matchers; (m = *mp); mp = &m->next, n++)
+    if (m->multibyte == multibyte && EQ (m->translate, trt)
+	&& same_keywords (m->keywords, keywords))
+      break;
+    else if (n == KEYWORD_CACHE_SIZE - 1)
+      {
+	*mp = NULL;
+	free_keyword_matcher (m);
+	m = NULL;
+	break;
+      }
+
+  if (m)
+    *mp = m->next;
+  else
+    {
+      ptrdiff_t nkeywords = (VECTORP (keywords) ? ASIZE (keywords)
+			     : list_length (keywords));
+      Lisp_Object copy = make_nil_vector (nkeywords);
+      for (ptrdiff_t k = 0; k < nkeywords; k++)
+	{
+	  Lisp_Object string;
+	  if (VECTORP (keywords))
+	    string = AREF (keywords, k);
+	  else
+	    {
+	      string = XCAR (keywords);
+	      keywords = XCDR (keywords);
+	    }
+	  CHECK_STRING (string);
+	  ASET (copy, k, Fcopy_sequence (string));
+	}
+      m = make_keyword_matcher (copy, trt, multibyte);
+    }
+  m->next = keyword_matchers;
+  keyword_matchers = m;
+  return m;
+}
+
+/* Search the current buffer from POS to LIM_BYTE for the keywords of M.
+   Find the keyword that starts first, and of those that start at the
+   same place, the longest.  Return its index, or -1 if there is no
+   keyword, and store its start and its end into *START and *END, and
+   the byte position of its end into *END_BYTE.  */
+
+static EMACS_INT
+search_keywords (struct keyword_matcher *m, ptrdiff_t pos,
+		 ptrdiff_t pos_byte, ptrdiff_t lim_byte,
+		 ptrdiff_t *start, ptrdiff_t *end, ptrdiff_t *end_byte)
+{
+  struct keyword_state *states = m->states;
+  Lisp_Object trt = m->multibyte ? m->translate : Qnil;
+  EMACS_INT found = states[0].match;
+  unsigned short int quit_count = 0;
+  int s = 0;
+
+  *start = *end = pos;
+  *end_byte = pos_byte;
+
+  /* Scan the text before the gap, and then the text after it; a
+     character never straddles the gap.  */
+  while (pos_byte < lim_byte)
+    {
+      ptrdiff_t limit_byte = (pos_byte < GPT_BYTE ? min (lim_byte, GPT_BYTE)
+			      : lim_byte);
+      unsigned char *base = BYTE_POS_ADDR (pos_byte), *p = base;
+      unsigned char *plim = base + (limit_byte - pos_byte);
+
+      while (p < plim)
+	{
+	  int c = *p, class;
+
+	  if (ASCII_CHAR_P (c))
+	    {
+	      class = m->ascii[c];
+	      p++;
+	    }
+	  else
+	    {
+	      if (m->multibyte)
+		{
+		  int len;
+		  c = string_char_and_length (p, &len);
+		  p += len;
+		  if (!NILP (trt))
+		    c = char_table_translate (trt, c);
+		}
+	      else
+		p++;
+	      class = keyword_char_class (m, c);
+	    }
+	  pos++;
+
+	  s = class ? keyword_transition (m, s, class) : 0;
+	  if (states[s].match >= 0
+	      && (found < 0 || pos - states[s].match_len <= *start))
+	    {
+	      found = states[s].match;
+	      *start = pos - states[s].match_len;
+	      *end = pos;
+	      *end_byte = pos_byte + (p - base);
+	    }
+	  else if (found >= 0 && pos - states[s].depth > *start)
+	    /* No keyword that ends later can start this early.  */
+	    return found;
+
+	  rarely_quit (++quit_count);
+	}
+      pos_byte = limit_byte;
+    }
+
+  return found;
+}
+
+DEFUN ("search-forward-keywords", Fsearch_forward_keywords,
+       Ssearch_forward_keywords, 1, 3, 0,
+       doc: /* Search forward from point for any of the strings in KEYWORDS.
+KEYWORDS is a list or vector of strings.  Set point to the end of the
+occurrence found, and return the index in KEYWORDS of the string found.
+The occurrence found is the one that starts first; of the strings that
+occur at that place, it is the longest, and of equal strings, the first.
+An optional second argument bounds the search; it is a buffer position.
+  The match found must not end after that position.  A value of nil
+  means search to the end of the accessible portion of the buffer.
+Optional third argument, if t, means if fail just return nil (no error).
+  If not nil and not t, move to limit of search and return nil.
+
+This finds the same occurrences as searching for the regexp that
+`regexp-opt' makes of KEYWORDS with `posix-search-forward', but it is
+much faster when there are many keywords, because it looks at each
+character of the buffer only once.
+
+Search case-sensitivity is determined by the value of the variable
+`case-fold-search', which see.
+
+See also the functions `match-beginning', `match-end' and `replace-match'.  */)
+  (Lisp_Object keywords, Lisp_Object bound, Lisp_Object noerror)
+{
+  ptrdiff_t lim, lim_byte, start, end, end_byte;
+
+  if (NILP (bound))
+    lim = ZV, lim_byte = ZV_BYTE;
+  else
+    {
+      lim = fix_position (bound);
+      if (lim < PT)
+	error ("Invalid search bound (wrong side of point)");
+      if (lim > ZV)
+	lim = ZV, lim_byte = ZV_BYTE;
+      else
+	lim_byte = CHAR_TO_BYTE (lim);
+    }
+
+  struct keyword_matcher *m
+    = keyword_matcher (keywords,
+		       (!NILP (BVAR (current_buffer, case_fold_search))
+			? BVAR (current_buffer, case_canon_table)
+			: Qnil));
+  EMACS_INT found = search_keywords (m, PT, PT_BYTE, lim_byte,
+				     &start, &end, &end_byte);
+  if (found < 0)
+    {
+      if (NILP (noerror))
+	xsignal1 (Qsearch_failed, keywords);
+      if (!EQ (noerror, Qt))
+	SET_PT_BOTH (lim, lim_byte);
+      return Qnil;
+    }
+
+  ptrdiff_t start_byte = CHAR_TO_BYTE (start);
+  set_search_regs (start_byte, end_byte - start_byte);
+  SET_PT_BOTH (end, end_byte);
+  return make_fixnum (found);
+}
+
 DEFUN ("replace-match", Freplace_match, Sreplace_match, 1, 5, 0,
        doc: /* Replace text matched by last search with NEWTEXT.
 Leave point at the end of the replacement text.
@@ -3317,19 +4645,94 @@ DEFUN ("newline-cache-check", Fnewline_cache_check, Snewline_cache_check,
   return val;
 }
 
+DEFUN ("regexp-cache-statistics", Fregexp_cache_statistics,
+       Sregexp_cache_statistics, 0, 0, 0,
+       doc: /* Return statistics about the cache of compiled regexps.
+The value is a list (HITS MISSES ENTRIES), where HITS is the number of
+times a search or match found its regexp already compiled in the
+cache, MISSES is the number of times it had to compile the regexp, and
+ENTRIES is the number of compiled regexps in the cache now.
+See also `regexp-cache-size'.  */)
+  (void)
+{
+  return list3 (INT_TO_INTEGER (regexp_cache_hits),
+		INT_TO_INTEGER (regexp_cache_misses),
+		make_fixnum (regexp_cache_count));
+}
 
-static void syms_of_search_for_pdumper (void);
+struct regexp_profile_entry
+{
+  Lisp_Object regexp;
+  struct regexp_profile *profile;
+};
 
-void
-syms_of_search (void)
+static int
+compare_regexp_profiles (const void *a, const void *b)
+{
+  struct regexp_profile_entry const *x = a, *y = b;
+  return timespec_cmp (y->profile->time, x->profile->time);
+}
+
+DEFUN ("regexp-profile", Fregexp_profile, Sregexp_profile, 0, 0, 0,
+       doc: /* Return what the regexp profiler recorded.
+The value is a list with an element (REGEXP SEARCHES BYTES PUSHES TIME)
+for each regexp that was searched for or matched while
+`regexp-profiling' was non-nil, since `clear-regexp-profile' was last
+called.  SEARCHES is the number of searches and matches, BYTES is the
+number of bytes from where they started to where their matches ended
+or they gave up, PUSHES is the number of failure points the matcher
+pushed, which is how often it had to be ready to backtrack, and TIME
+is the time they took, in seconds.  The list is sorted by decreasing
+TIME.  */)
+  (void)
 {
-  for (int i = 0; i < REGEXP_CACHE_SIZE; ++i)
+  if (NILP (regexp_profile_table))
+    return Qnil;
+
+  struct Lisp_Hash_Table *h = XHASH_TABLE (regexp_profile_table);
+  struct regexp_profile_entry *v;
+  ptrdiff_t n = 0;
+  USE_SAFE_ALLOCA;
+  SAFE_NALLOCA (v, 1, h->count);
+  for (ptrdiff_t i = 0; i < HASH_TABLE_SIZE (h); i++)
     {
-      staticpro (&searchbufs[i].regexp);
-      staticpro (&searchbufs[i].f_whitespace_regexp);
-      staticpro (&searchbufs[i].syntax_table);
+      Lisp_Object key = HASH_KEY (h, i);
+      if (!EQ (key, Qunbound))
+	v[n++] = (struct regexp_profile_entry)
+	  { key, &regexp_profiles[XFIXNUM (HASH_VALUE (h, i))] };
     }
+  qsort (v, n, sizeof *v, compare_regexp_profiles);
 
+  Lisp_Object result = Qnil;
+  while (0 < n)
+    {
+      struct regexp_profile *p = v[--n].profile;
+      result = Fcons (list5 (v[n].regexp, make_int (p->searches),
+			     make_int (p->bytes), make_uint (p->pushes),
+			     make_float (timespectod (p->time))),
+		      result);
+    }
+  SAFE_FREE ();
+  return result;
+}
+
+DEFUN ("clear-regexp-profile", Fclear_regexp_profile,
+       Sclear_regexp_profile, 0, 0, 0,
+       doc: /* Discard what the regexp profiler recorded.
+See `regexp-profile'.  */)
+  (void)
+{
+  regexp_profile_table = Qnil;
+  regexp_profiles_used = 0;
+  for (struct regexp_cache *cp = searchbuf_head; cp; cp = cp->next)
+    cp->profile = -1;
+  return Qnil;
+}
+
+
+void
+syms_of_search (void)
+{
   /* Error condition used for failing searches.  */
   DEFSYM (Qsearch_failed, "search-failed");
 
@@ -3377,6 +4780,23 @@ syms_of_search (void)
 is to bind it with `let' around a small expression.  */);
   Vinhibit_changing_match_data = Qnil;
 
+  DEFVAR_INT ("regexp-cache-size", regexp_cache_size,
+	      doc: /* Number of compiled regexps that searches keep for reuse.
+Searching for a regexp that is not in the cache compiles it, and
+replaces the regexp in the cache that was used least recently, when
+the cache is full.  The cache also depends on the case table, the
+syntax table and `search-spaces-regexp' that were in effect when the
+regexp was compiled.  */);
+  regexp_cache_size = 100;
+
+  DEFVAR_BOOL ("regexp-profiling", regexp_profiling,
+	       doc: /* Non-nil means record statistics of regexp searches.
+For each regexp, Emacs records how many times it was searched for or
+matched, how much text that went through, how much the matcher had to
+backtrack and how long it took.  The function `regexp-profile' returns
+what was recorded.  Recording makes searches slower.  */);
+  regexp_profiling = false;
+
   defsubr (&Slooking_at);
   defsubr (&Sposix_looking_at);
   defsubr (&Sstring_match);
@@ -3386,6 +4806,7 @@ syms_of_search (void)
   defsubr (&Sre_search_forward);
   defsubr (&Sre_search_backward);
   defsubr (&Sposix_search_forward);
+  defsubr (&Ssearch_forward_keywords);
   defsubr (&Sposix_search_backward);
   defsubr (&Sreplace_match);
   defsubr (&Smatch_beginning);
@@ -3394,23 +4815,8 @@ syms_of_search (void)
   defsubr (&Sset_match_data);
   defsubr (&Sregexp_quote);
   defsubr (&Snewline_cache_check);
-
-  pdumper_do_now_and_after_load (syms_of_search_for_pdumper);
-}
-
-static void
-syms_of_search_for_pdumper (void)
-{
-  for (int i = 0; i < REGEXP_CACHE_SIZE; ++i)
-    {
-      searchbufs[i].buf.allocated = 100;
-      searchbufs[i].buf.buffer = xmalloc (100);
-      searchbufs[i].buf.fastmap = searchbufs[i].fastmap;
-      searchbufs[i].regexp = Qnil;
-      searchbufs[i].f_whitespace_regexp = Qnil;
-      searchbufs[i].busy = false;
-      searchbufs[i].syntax_table = Qnil;
-      searchbufs[i].next = (i == REGEXP_CACHE_SIZE-1 ? 0 : &searchbufs[i+1]);
-    }
-  searchbuf_head = &searchbufs[0];
+  defsubr (&Sline_number_at_pos);
+  defsubr (&Sregexp_cache_statistics);
+  defsubr (&Sregexp_profile);
+  defsubr (&Sclear_regexp_profile);
 }
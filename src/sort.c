@@ -0,0 +1,703 @@
+/* Timsort for sequences.
+
+Copyright (C) 2020 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* This is an adaptive, stable merge sort after Tim Peters' listsort
+   for Python (see listsort.txt in the CPython sources for the
+   details).  It finds the runs already present in its input, extends
+   short ones with a binary insertion sort, and merges them in an
+   order that keeps the merges balanced, galloping through stretches
+   of one run that all sort before the next element of the other.
+   Input that is already sorted, or sorted in reverse, is handled in
+   linear time.
+
+   The elements being sorted are kept in a work array, so that the
+   sequence is left untouched if the predicate exits nonlocally.  When
+   there is a key function, each element of the work array is a pair
+   of the key and the original element, and the pairs are moved
+   together.  */
+
+#include <config.h>
+
+#include "lisp.h"
+
+/* Predicates that are compared without calling them through funcall.  */
+enum sort_predicate
+  {
+    SORT_PREDICATE_CALL,
+    SORT_PREDICATE_LESS,
+    SORT_PREDICATE_GREATER,
+    SORT_PREDICATE_STRING_LESSP
+  };
+
+/* The largest number of pending runs.  Run lengths grow at least as
+   fast as the Fibonacci numbers, so this is plenty for any array
+   that fits in memory.  */
+enum { MAX_PENDING_RUNS = 85 };
+
+/* When galloping finds this many elements in a row from one run, keep
+   galloping.  */
+enum { MIN_GALLOP = 7 };
+
+struct sort_run
+{
+  Lisp_Object *base;
+  ptrdiff_t len;
+};
+
+struct sort_state
+{
+  /* The predicate, and how to call it.  */
+  Lisp_Object predicate;
+  enum sort_predicate kind;
+
+  /* Number of Lisp_Objects per element: 1, or 2 if each element is a
+     key followed by the original element.  */
+  ptrdiff_t width;
+
+  /* Temporary storage for merges, with room for half of the elements.  */
+  Lisp_Object *tmp;
+
+  /* Current galloping threshold; see merge_lo.  */
+  ptrdiff_t min_gallop;
+
+  /* The stack of runs waiting to be merged.  */
+  ptrdiff_t nruns;
+  struct sort_run runs[MAX_PENDING_RUNS];
+};
+
+/* Return how PREDICATE can be called.  */
+
+static enum sort_predicate
+classify_predicate (Lisp_Object predicate)
+{
+  Lisp_Object fn = indirect_function (predicate);
+  if (SUBRP (fn))
+    {
+      struct Lisp_Subr *subr = XSUBR (fn);
+      if (subr->max_args == MANY && subr->function.aMANY == Flss)
+	return SORT_PREDICATE_LESS;
+      if (subr->max_args == MANY && subr->function.aMANY == Fgtr)
+	return SORT_PREDICATE_GREATER;
+      if (subr->max_args == 2 && subr->function.a2 == Fstring_lessp)
+	return SORT_PREDICATE_STRING_LESSP;
+    }
+  return SORT_PREDICATE_CALL;
+}
+
+/* Return true if the key A sorts before the key B.  */
+
+static bool
+sort_less (struct sort_state *s, Lisp_Object a, Lisp_Object b)
+{
+  switch (s->kind)
+    {
+    case SORT_PREDICATE_LESS:
+      if (FIXNUMP (a) && FIXNUMP (b))
+	return XFIXNUM (a) < XFIXNUM (b);
+      return !NILP (arithcompare (a, b, ARITH_LESS));
+
+    case SORT_PREDICATE_GREATER:
+      if (FIXNUMP (a) && FIXNUMP (b))
+	return XFIXNUM (a) > XFIXNUM (b);
+      return !NILP (arithcompare (a, b, ARITH_GRTR));
+
+    case SORT_PREDICATE_STRING_LESSP:
+      return !NILP (Fstring_lessp (a, b));
+
+    default:
+      return !NILP (call2 (s->predicate, a, b));
+    }
+}
+
+/* Return a pointer to element I of the elements at P.  */
+
+static Lisp_Object *
+elt_at (struct sort_state const *s, Lisp_Object *p, ptrdiff_t i)
+{
+  return p + i * s->width;
+}
+
+/* Copy N elements from SRC to DST, which must not overlap.  */
+
+static void
+copy_elts (struct sort_state const *s, Lisp_Object *dst,
+	   Lisp_Object const *src, ptrdiff_t n)
+{
+  memcpy (dst, src, n * s->width * word_size);
+}
+
+/* Copy N elements from SRC to DST, which may overlap.  */
+
+static void
+move_elts (struct sort_state const *s, Lisp_Object *dst,
+	   Lisp_Object const *src, ptrdiff_t n)
+{
+  memmove (dst, src, n * s->width * word_size);
+}
+
+/* Reverse the N elements at LO.  */
+
+static void
+reverse_elts (struct sort_state const *s, Lisp_Object *lo, ptrdiff_t n)
+{
+  Lisp_Object *hi = elt_at (s, lo, n - 1);
+  for (; lo < hi; lo += s->width, hi -= s->width)
+    for (ptrdiff_t j = 0; j < s->width; j++)
+      {
+	Lisp_Object t = lo[j];
+	lo[j] = hi[j];
+	hi[j] = t;
+      }
+}
+
+/* Sort the N elements at LO with a binary insertion sort, given that
+   the first START of them are already sorted.  */
+
+static void
+binary_sort (struct sort_state *s, Lisp_Object *lo, ptrdiff_t n,
+	     ptrdiff_t start)
+{
+  Lisp_Object pivot[2];
+
+  for (; start < n; start++)
+    {
+      copy_elts (s, pivot, elt_at (s, lo, start), 1);
+
+      /* Find the first element greater than the pivot.  Elements
+	 equal to it stay before it, which keeps the sort stable.  */
+      ptrdiff_t l = 0, r = start;
+      while (l < r)
+	{
+	  ptrdiff_t m = l + ((r - l) >> 1);
+	  if (sort_less (s, pivot[0], *elt_at (s, lo, m)))
+	    r = m;
+	  else
+	    l = m + 1;
+	}
+      move_elts (s, elt_at (s, lo, l + 1), elt_at (s, lo, l), start - l);
+      copy_elts (s, elt_at (s, lo, l), pivot, 1);
+    }
+}
+
+/* Return the length of the run at the start of the N elements at LO,
+   N > 0.  A strictly descending run is reversed in place; it must be
+   strict so that reversing it keeps the sort stable.  */
+
+static ptrdiff_t
+count_run (struct sort_state *s, Lisp_Object *lo, ptrdiff_t n)
+{
+  if (n == 1)
+    return 1;
+
+  ptrdiff_t i = 2;
+  if (sort_less (s, *elt_at (s, lo, 1), *lo))
+    {
+      while (i < n && sort_less (s, *elt_at (s, lo, i), *elt_at (s, lo, i - 1)))
+	i++;
+      reverse_elts (s, lo, i);
+    }
+  else
+    while (i < n && !sort_less (s, *elt_at (s, lo, i), *elt_at (s, lo, i - 1)))
+      i++;
+  return i;
+}
+
+/* Return the position at which KEY belongs among the N sorted elements
+   at A, to the left of any elements equal to it.  Start the search at
+   element HINT.  */
+
+static ptrdiff_t
+gallop_left (struct sort_state *s, Lisp_Object key, Lisp_Object *a,
+	     ptrdiff_t n, ptrdiff_t hint)
+{
+  ptrdiff_t lastofs = 0, ofs = 1;
+
+  if (sort_less (s, *elt_at (s, a, hint), key))
+    {
+      /* Gallop right, until a[hint + lastofs] < key <= a[hint + ofs].  */
+      ptrdiff_t maxofs = n - hint;
+      while (ofs < maxofs
+	     && sort_less (s, *elt_at (s, a, hint + ofs), key))
+	{
+	  lastofs = ofs;
+	  ofs = (ofs << 1) + 1;
+	}
+      ofs = min (ofs, maxofs);
+      lastofs += hint;
+      ofs += hint;
+    }
+  else
+    {
+      /* Gallop left, until a[hint - ofs] < key <= a[hint - lastofs].  */
+      ptrdiff_t maxofs = hint + 1;
+      while (ofs < maxofs
+	     && !sort_less (s, *elt_at (s, a, hint - ofs), key))
+	{
+	  lastofs = ofs;
+	  ofs = (ofs << 1) + 1;
+	}
+      ofs = min (ofs, maxofs);
+      ptrdiff_t k = lastofs;
+      lastofs = hint - ofs;
+      ofs = hint - k;
+    }
+
+  /* Now a[lastofs] < key <= a[ofs]; binary search in between.  */
+  lastofs++;
+  while (lastofs < ofs)
+    {
+      ptrdiff_t m = lastofs + ((ofs - lastofs) >> 1);
+      if (sort_less (s, *elt_at (s, a, m), key))
+	lastofs = m + 1;
+      else
+	ofs = m;
+    }
+  return ofs;
+}
+
+/* Like gallop_left, but return the position to the right of any
+   elements equal to KEY.  */
+
+static ptrdiff_t
+gallop_right (struct sort_state *s, Lisp_Object key, Lisp_Object *a,
+	      ptrdiff_t n, ptrdiff_t hint)
+{
+  ptrdiff_t lastofs = 0, ofs = 1;
+
+  if (sort_less (s, key, *elt_at (s, a, hint)))
+    {
+      /* Gallop left, until a[hint - ofs] <= key < a[hint - lastofs].  */
+      ptrdiff_t maxofs = hint + 1;
+      while (ofs < maxofs
+	     && sort_less (s, key, *elt_at (s, a, hint - ofs)))
+	{
+	  lastofs = ofs;
+	  ofs = (ofs << 1) + 1;
+	}
+      ofs = min (ofs, maxofs);
+      ptrdiff_t k = lastofs;
+      lastofs = hint - ofs;
+      ofs = hint - k;
+    }
+  else
+    {
+      /* Gallop right, until a[hint + lastofs] <= key < a[hint + ofs].  */
+      ptrdiff_t maxofs = n - hint;
+      while (ofs < maxofs
+	     && !sort_less (s, key, *elt_at (s, a, hint + ofs)))
+	{
+	  lastofs = ofs;
+	  ofs = (ofs << 1) + 1;
+	}
+      ofs = min (ofs, maxofs);
+      lastofs += hint;
+      ofs += hint;
+    }
+
+  /* Now a[lastofs] <= key < a[ofs]; binary search in between.  */
+  lastofs++;
+  while (lastofs < ofs)
+    {
+      ptrdiff_t m = lastofs + ((ofs - lastofs) >> 1);
+      if (sort_less (s, key, *elt_at (s, a, m)))
+	ofs = m;
+      else
+	lastofs = m + 1;
+    }
+  return ofs;
+}
+
+/* Merge the NA elements at PA with the NB elements following them at
+   PB, where 0 < NA <= NB.  The first element of PB must sort before
+   the first of PA, and the last element of PA after all of PB.  Copy
+   the shorter run PA to temporary storage and merge left to right.  */
+
+static void
+merge_lo (struct sort_state *s, Lisp_Object *pa, ptrdiff_t na,
+	  Lisp_Object *pb, ptrdiff_t nb)
+{
+  ptrdiff_t w = s->width;
+  ptrdiff_t min_gallop = s->min_gallop;
+  Lisp_Object *dest = pa;
+
+  copy_elts (s, s->tmp, pa, na);
+  pa = s->tmp;
+
+  copy_elts (s, dest, pb, 1);
+  dest += w, pb += w, nb--;
+  if (nb == 0)
+    goto succeed;
+  if (na == 1)
+    goto copy_b;
+
+  while (true)
+    {
+      ptrdiff_t acount = 0, bcount = 0;
+
+      /* Merge one element at a time until one run wins often enough
+	 that galloping looks worthwhile.  */
+      while (true)
+	{
+	  if (sort_less (s, *pb, *pa))
+	    {
+	      copy_elts (s, dest, pb, 1);
+	      dest += w, pb += w, nb--;
+	      bcount++, acount = 0;
+	      if (nb == 0)
+		goto succeed;
+	      if (bcount >= min_gallop)
+		break;
+	    }
+	  else
+	    {
+	      copy_elts (s, dest, pa, 1);
+	      dest += w, pa += w, na--;
+	      acount++, bcount = 0;
+	      if (na == 1)
+		goto copy_b;
+	      if (acount >= min_gallop)
+		break;
+	    }
+	}
+
+      /* Gallop, until neither run wins MIN_GALLOP times in a row.  */
+      min_gallop++;
+      do
+	{
+	  min_gallop -= min_gallop > 1;
+	  s->min_gallop = min_gallop;
+
+	  ptrdiff_t k = gallop_right (s, *pb, pa, na, 0);
+	  acount = k;
+	  if (k)
+	    {
+	      copy_elts (s, dest, pa, k);
+	      dest += k * w, pa += k * w, na -= k;
+	      if (na == 1)
+		goto copy_b;
+	      /* This can happen only if the predicate is inconsistent.  */
+	      if (na == 0)
+		goto succeed;
+	    }
+	  copy_elts (s, dest, pb, 1);
+	  dest += w, pb += w, nb--;
+	  if (nb == 0)
+	    goto succeed;
+
+	  k = gallop_left (s, *pa, pb, nb, 0);
+	  bcount = k;
+	  if (k)
+	    {
+	      move_elts (s, dest, pb, k);
+	      dest += k * w, pb += k * w, nb -= k;
+	      if (nb == 0)
+		goto succeed;
+	    }
+	  copy_elts (s, dest, pa, 1);
+	  dest += w, pa += w, na--;
+	  if (na == 1)
+	    goto copy_b;
+	}
+      while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+      min_gallop++;
+      s->min_gallop = min_gallop;
+    }
+
+ succeed:
+  if (na)
+    copy_elts (s, dest, pa, na);
+  return;
+
+ copy_b:
+  /* The last element of PA belongs at the end of the merge.  */
+  move_elts (s, dest, pb, nb);
+  copy_elts (s, dest + nb * w, pa, 1);
+}
+
+/* Like merge_lo, but for NA >= NB: copy the shorter run PB to
+   temporary storage and merge right to left.  */
+
+static void
+merge_hi (struct sort_state *s, Lisp_Object *pa, ptrdiff_t na,
+	  Lisp_Object *pb, ptrdiff_t nb)
+{
+  ptrdiff_t w = s->width;
+  ptrdiff_t min_gallop = s->min_gallop;
+  Lisp_Object *dest = pb + (nb - 1) * w;
+  Lisp_Object *basea = pa;
+  Lisp_Object *baseb = s->tmp;
+
+  copy_elts (s, baseb, pb, nb);
+  pb = baseb + (nb - 1) * w;
+  pa += (na - 1) * w;
+
+  copy_elts (s, dest, pa, 1);
+  dest -= w, pa -= w, na--;
+  if (na == 0)
+    goto succeed;
+  if (nb == 1)
+    goto copy_a;
+
+  while (true)
+    {
+      ptrdiff_t acount = 0, bcount = 0;
+
+      while (true)
+	{
+	  if (sort_less (s, *pb, *pa))
+	    {
+	      copy_elts (s, dest, pa, 1);
+	      dest -= w, pa -= w, na--;
+	      acount++, bcount = 0;
+	      if (na == 0)
+		goto succeed;
+	      if (acount >= min_gallop)
+		break;
+	    }
+	  else
+	    {
+	      copy_elts (s, dest, pb, 1);
+	      dest -= w, pb -= w, nb--;
+	      bcount++, acount = 0;
+	      if (nb == 1)
+		goto copy_a;
+	      if (bcount >= min_gallop)
+		break;
+	    }
+	}
+
+      min_gallop++;
+      do
+	{
+	  min_gallop -= min_gallop > 1;
+	  s->min_gallop = min_gallop;
+
+	  ptrdiff_t k = na - gallop_right (s, *pb, basea, na, na - 1);
+	  acount = k;
+	  if (k)
+	    {
+	      dest -= k * w, pa -= k * w, na -= k;
+	      move_elts (s, dest + w, pa + w, k);
+	      if (na == 0)
+		goto succeed;
+	    }
+	  copy_elts (s, dest, pb, 1);
+	  dest -= w, pb -= w, nb--;
+	  if (nb == 1)
+	    goto copy_a;
+
+	  k = nb - gallop_left (s, *pa, baseb, nb, nb - 1);
+	  bcount = k;
+	  if (k)
+	    {
+	      dest -= k * w, pb -= k * w, nb -= k;
+	      copy_elts (s, dest + w, pb + w, k);
+	      if (nb == 1)
+		goto copy_a;
+	      /* This can happen only if the predicate is inconsistent.  */
+	      if (nb == 0)
+		goto succeed;
+	    }
+	  copy_elts (s, dest, pa, 1);
+	  dest -= w, pa -= w, na--;
+	  if (na == 0)
+	    goto succeed;
+	}
+      while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+      min_gallop++;
+      s->min_gallop = min_gallop;
+    }
+
+ succeed:
+  if (nb)
+    copy_elts (s, dest - (nb - 1) * w, baseb, nb);
+  return;
+
+ copy_a:
+  /* The first element of PB belongs at the start of the merge.  */
+  dest -= na * w, pa -= na * w;
+  move_elts (s, dest + w, pa + w, na);
+  copy_elts (s, dest, pb, 1);
+}
+
+/* Merge the pending runs I and I + 1.  I must be the second or third
+   run from the top of the stack.  */
+
+static void
+merge_at (struct sort_state *s, ptrdiff_t i)
+{
+  Lisp_Object *pa = s->runs[i].base;
+  ptrdiff_t na = s->runs[i].len;
+  Lisp_Object *pb = s->runs[i + 1].base;
+  ptrdiff_t nb = s->runs[i + 1].len;
+
+  s->runs[i].len = na + nb;
+  if (i == s->nruns - 3)
+    s->runs[i + 1] = s->runs[i + 2];
+  s->nruns--;
+
+  /* Elements of A that sort before the first of B are already in
+     place, and so are elements of B that sort after the last of A.  */
+  ptrdiff_t k = gallop_right (s, *pb, pa, na, 0);
+  pa = elt_at (s, pa, k);
+  na -= k;
+  if (na == 0)
+    return;
+  nb = gallop_left (s, *elt_at (s, pa, na - 1), pb, nb, nb - 1);
+  if (nb == 0)
+    return;
+
+  if (na <= nb)
+    merge_lo (s, pa, na, pb, nb);
+  else
+    merge_hi (s, pa, na, pb, nb);
+}
+
+/* Merge pending runs until the lengths of the runs on the stack
+   satisfy len[-3] > len[-2] + len[-1] and len[-2] > len[-1], which
+   keeps the merges balanced.  */
+
+static void
+merge_collapse (struct sort_state *s)
+{
+  struct sort_run *r = s->runs;
+
+  while (1 < s->nruns)
+    {
+      ptrdiff_t n = s->nruns - 2;
+      if ((0 < n && r[n - 1].len <= r[n].len + r[n + 1].len)
+	  || (1 < n && r[n - 2].len <= r[n - 1].len + r[n].len))
+	{
+	  if (r[n - 1].len < r[n + 1].len)
+	    n--;
+	  merge_at (s, n);
+	}
+      else if (r[n].len <= r[n + 1].len)
+	merge_at (s, n);
+      else
+	break;
+    }
+}
+
+/* Merge all pending runs into one.  */
+
+static void
+merge_force_collapse (struct sort_state *s)
+{
+  struct sort_run *r = s->runs;
+
+  while (1 < s->nruns)
+    {
+      ptrdiff_t n = s->nruns - 2;
+      if (0 < n && r[n - 1].len < r[n + 1].len)
+	n--;
+      merge_at (s, n);
+    }
+}
+
+/* Return the minimum length of a run for sorting N elements: N itself
+   if that is small, else a number between 32 and 64 such that N
+   divided by it is a power of two or slightly less.  */
+
+static ptrdiff_t
+merge_compute_minrun (ptrdiff_t n)
+{
+  ptrdiff_t r = 0;
+  while (64 <= n)
+    {
+      r |= n & 1;
+      n >>= 1;
+    }
+  return n + r;
+}
+
+/* Sort the LENGTH elements of SEQ stably using PREDICATE.  If KEYFUNC
+   is non-nil, call it once on each element and compare the results
+   instead of the elements.  */
+
+void
+tim_sort (Lisp_Object predicate, Lisp_Object keyfunc,
+	  Lisp_Object *seq, ptrdiff_t length)
+{
+  if (length < 2)
+    return;
+
+  struct sort_state s;
+  s.predicate = predicate;
+  s.kind = classify_predicate (predicate);
+  s.width = NILP (keyfunc) ? 1 : 2;
+  s.min_gallop = MIN_GALLOP;
+  s.nruns = 0;
+
+  USE_SAFE_ALLOCA;
+  Lisp_Object *work;
+  ptrdiff_t tmp_len = (length / 2 + 1) * s.width;
+  SAFE_ALLOCA_LISP (work, length * s.width);
+  SAFE_ALLOCA_LISP (s.tmp, tmp_len);
+  for (ptrdiff_t i = 0; i < tmp_len; i++)
+    s.tmp[i] = Qnil;
+
+  if (NILP (keyfunc))
+    memcpy (work, seq, length * word_size);
+  else
+    {
+      /* Fill in all the elements before calling KEYFUNC, which may
+	 GC.  */
+      for (ptrdiff_t i = 0; i < length; i++)
+	{
+	  work[2 * i] = Qnil;
+	  work[2 * i + 1] = seq[i];
+	}
+      for (ptrdiff_t i = 0; i < length; i++)
+	work[2 * i] = call1 (keyfunc, work[2 * i + 1]);
+    }
+
+  /* Find the runs, extending short ones to MINRUN, and merge them.  */
+  ptrdiff_t minrun = merge_compute_minrun (length);
+  Lisp_Object *lo = work;
+  ptrdiff_t remaining = length;
+  do
+    {
+      ptrdiff_t n = count_run (&s, lo, remaining);
+      if (n < minrun)
+	{
+	  ptrdiff_t force = min (remaining, minrun);
+	  binary_sort (&s, lo, force, n);
+	  n = force;
+	}
+      eassert (s.nruns < MAX_PENDING_RUNS);
+      s.runs[s.nruns].base = lo;
+      s.runs[s.nruns].len = n;
+      s.nruns++;
+      merge_collapse (&s);
+      lo = elt_at (&s, lo, n);
+      remaining -= n;
+    }
+  while (remaining);
+  merge_force_collapse (&s);
+  eassert (s.nruns == 1 && s.runs[0].len == length);
+
+  if (NILP (keyfunc))
+    memcpy (seq, work, length * word_size);
+  else
+    for (ptrdiff_t i = 0; i < length; i++)
+      seq[i] = work[2 * i + 1];
+
+  SAFE_FREE ();
+}
@@ -93,6 +93,10 @@ #define STDERR_FILENO fileno(GetStdHandle(STD_ERROR_HANDLE))
 #include <sys/file.h>
 #include <fcntl.h>
 
+#ifdef HAVE_WRITEV
+# include <sys/uio.h>
+#endif
+
 #include "syssignal.h"
 #include "systime.h"
 #include "systty.h"
@@ -1803,6 +1807,19 @@ deliver_fatal_thread_signal (int sig)
   deliver_thread_signal (sig, handle_fatal_signal);
 }
 
+#ifdef SIGBUS
+
+/* Handle a bus error, which is fatal unless it comes from using buffer
+   text mapped from a file that has been truncated since.  */
+
+static void
+handle_sigbus (int sig, siginfo_t *siginfo, void *arg)
+{
+  if (! (siginfo && handle_mapped_text_fault (siginfo->si_addr)))
+    deliver_fatal_thread_signal (sig);
+}
+#endif
+
 static AVOID
 handle_arith_signal (int sig)
 {
@@ -2186,7 +2203,10 @@ init_signals (void)
   sigaction (SIGEMT, &thread_fatal_action, 0);
 #endif
 #ifdef SIGBUS
-  sigaction (SIGBUS, &thread_fatal_action, 0);
+  sigfillset (&action.sa_mask);
+  action.sa_sigaction = handle_sigbus;
+  action.sa_flags = SA_SIGINFO | emacs_sigaction_flags ();
+  sigaction (SIGBUS, &action, 0);
 #endif
   if (!init_sigsegv ())
     sigaction (SIGSEGV, &thread_fatal_action, 0);
@@ -2726,6 +2746,60 @@ emacs_write_quit (int fd, void const *buf, ptrdiff_t nbyte)
   return emacs_full_write (fd, buf, nbyte, 1);
 }
 
+/* Write to FD the NBYTE1 bytes at BUF1 followed by the NBYTE2 bytes
+   at BUF2, as if by two calls to emacs_write_quit, but with a single
+   system call where possible.  Return the total number of bytes
+   written; if this is less than NBYTE1 + NBYTE2, set errno to a value
+   other than EINTR.  */
+ptrdiff_t
+emacs_write2_quit (int fd, void const *buf1, ptrdiff_t nbyte1,
+		   void const *buf2, ptrdiff_t nbyte2)
+{
+  ptrdiff_t bytes_written = 0, n;
+
+#ifdef HAVE_WRITEV
+  while (0 < nbyte1 && 0 < nbyte2)
+    {
+      struct iovec iov[2];
+      iov[0].iov_base = (void *) buf1;
+      iov[0].iov_len = min (nbyte1, MAX_RW_COUNT);
+      iov[1].iov_base = (void *) buf2;
+      iov[1].iov_len = min (nbyte2, MAX_RW_COUNT - iov[0].iov_len);
+      n = writev (fd, iov, 2);
+
+      if (n < 0)
+	{
+	  if (errno != EINTR)
+	    return bytes_written;
+	  maybe_quit ();
+	  if (pending_signals)
+	    process_pending_signals ();
+	}
+      else
+	{
+	  bytes_written += n;
+	  if (n < nbyte1)
+	    {
+	      buf1 = (char const *) buf1 + n;
+	      nbyte1 -= n;
+	    }
+	  else
+	    {
+	      buf2 = (char const *) buf2 + (n - nbyte1);
+	      nbyte2 -= n - nbyte1;
+	      nbyte1 = 0;
+	    }
+	}
+    }
+#endif
+
+  n = emacs_full_write (fd, buf1, nbyte1, 1);
+  bytes_written += n;
+  if (n < nbyte1)
+    return bytes_written;
+  return bytes_written + emacs_full_write (fd, buf2, nbyte2, 1);
+}
+
 /* Write a diagnostic to standard error that contains MESSAGE and a
    string derived from errno.  Preserve errno.  Do not buffer stderr.
    Do not process quits or pending signals if interrupted.  */
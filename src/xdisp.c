@@ -3998,11 +3998,7 @@ next_overlay_change (ptrdiff_t pos)
      use its ending point instead.  */
   for (i = 0; i < noverlays; ++i)
     {
-      Lisp_Object oend;
-      ptrdiff_t oendpos;
-
-      oend = OVERLAY_END (overlays[i]);
-      oendpos = OVERLAY_POSITION (oend);
+      ptrdiff_t oendpos = OVERLAY_END (overlays[i]);
       endpos = min (endpos, oendpos);
     }
 
@@ -5448,7 +5444,7 @@ handle_single_display_spec (struct it *it, Lisp_Object spec, Lisp_Object object,
 	 overlay's display string/image twice.  */
       if (!NILP (overlay))
 	{
-	  ptrdiff_t ovendpos = OVERLAY_POSITION (OVERLAY_END (overlay));
+	  ptrdiff_t ovendpos = OVERLAY_END (overlay);
 
 	  /* Some borderline-sane Lisp might call us with the current
 	     buffer narrowed so that overlay-end is outside the
@@ -6196,87 +6192,50 @@ #define RECORD_OVERLAY_STRING(OVERLAY, STRING, AFTER_P)			\
     }									\
   while (false)
 
-  /* Process overlay before the overlay center.  */
-  for (struct Lisp_Overlay *ov = current_buffer->overlays_before;
-       ov; ov = ov->next)
+  /* Process the overlays that start or end at CHARPOS.  */
+  if (current_buffer->overlays)
     {
-      Lisp_Object overlay = make_lisp_ptr (ov, Lisp_Vectorlike);
-      eassert (OVERLAYP (overlay));
-      ptrdiff_t start = OVERLAY_POSITION (OVERLAY_START (overlay));
-      ptrdiff_t end = OVERLAY_POSITION (OVERLAY_END (overlay));
-
-      if (end < charpos)
-	break;
-
-      /* Skip this overlay if it doesn't start or end at IT's current
-	 position.  */
-      if (end != charpos && start != charpos)
-	continue;
-
-      /* Skip this overlay if it doesn't apply to IT->w.  */
-      Lisp_Object window = Foverlay_get (overlay, Qwindow);
-      if (WINDOWP (window) && XWINDOW (window) != it->w)
-	continue;
+      struct itree_iterator iter;
+      struct itree_node *node;
 
-      /* If the text ``under'' the overlay is invisible, both before-
-	 and after-strings from this overlay are visible; start and
-	 end position are indistinguishable.  */
-      Lisp_Object invisible = Foverlay_get (overlay, Qinvisible);
-      int invis = TEXT_PROP_MEANS_INVISIBLE (invisible);
-
-      /* If overlay has a non-empty before-string, record it.  */
-      Lisp_Object str;
-      if ((start == charpos || (end == charpos && invis != 0))
-	  && (str = Foverlay_get (overlay, Qbefore_string), STRINGP (str))
-	  && SCHARS (str))
-	RECORD_OVERLAY_STRING (overlay, str, false);
-
-      /* If overlay has a non-empty after-string, record it.  */
-      if ((end == charpos || (start == charpos && invis != 0))
-	  && (str = Foverlay_get (overlay, Qafter_string), STRINGP (str))
-	  && SCHARS (str))
-	RECORD_OVERLAY_STRING (overlay, str, true);
-    }
-
-  /* Process overlays after the overlay center.  */
-  for (struct Lisp_Overlay *ov = current_buffer->overlays_after;
-       ov; ov = ov->next)
-    {
-      Lisp_Object overlay = make_lisp_ptr (ov, Lisp_Vectorlike);
-      eassert (OVERLAYP (overlay));
-      ptrdiff_t start = OVERLAY_POSITION (OVERLAY_START (overlay));
-      ptrdiff_t end = OVERLAY_POSITION (OVERLAY_END (overlay));
-
-      if (start > charpos)
-	break;
+      itree_iterator_start (&iter, current_buffer->overlays,
+			    charpos, charpos);
+      while ((node = itree_iterator_next (&iter)))
+	{
+	  Lisp_Object overlay = node->data;
+	  eassert (OVERLAYP (overlay));
+	  ptrdiff_t start = node->begin;
+	  ptrdiff_t end = node->end;
 
-      /* Skip this overlay if it doesn't start or end at IT's current
-	 position.  */
-      if (end != charpos && start != charpos)
-	continue;
+	  /* Skip this overlay if it doesn't start or end at IT's current
+	     position.  */
+	  if (end != charpos && start != charpos)
+	    continue;
 
-      /* Skip this overlay if it doesn't apply to IT->w.  */
-      Lisp_Object window = Foverlay_get (overlay, Qwindow);
-      if (WINDOWP (window) && XWINDOW (window) != it->w)
-	continue;
+	  /* Skip this overlay if it doesn't apply to IT->w.  */
+	  Lisp_Object window = Foverlay_get (overlay, Qwindow);
+	  if (WINDOWP (window) && XWINDOW (window) != it->w)
+	    continue;
 
-      /* If the text ``under'' the overlay is invisible, it has a zero
-	 dimension, and both before- and after-strings apply.  */
-      Lisp_Object invisible = Foverlay_get (overlay, Qinvisible);
-      int invis = TEXT_PROP_MEANS_INVISIBLE (invisible);
+	  /* If the text ``under'' the overlay is invisible, both before-
+	     and after-strings from this overlay are visible; start and
+	     end position are indistinguishable.  */
+	  Lisp_Object invisible = Foverlay_get (overlay, Qinvisible);
+	  int invis = TEXT_PROP_MEANS_INVISIBLE (invisible);
 
-      /* If overlay has a non-empty before-string, record it.  */
-      Lisp_Object str;
-      if ((start == charpos || (end == charpos && invis != 0))
-	  && (str = Foverlay_get (overlay, Qbefore_string), STRINGP (str))
-	  && SCHARS (str))
-	RECORD_OVERLAY_STRING (overlay, str, false);
+	  /* If overlay has a non-empty before-string, record it.  */
+	  Lisp_Object str;
+	  if ((start == charpos || (end == charpos && invis != 0))
+	      && (str = Foverlay_get (overlay, Qbefore_string), STRINGP (str))
+	      && SCHARS (str))
+	    RECORD_OVERLAY_STRING (overlay, str, false);
 
-      /* If overlay has a non-empty after-string, record it.  */
-      if ((end == charpos || (start == charpos && invis != 0))
-	  && (str = Foverlay_get (overlay, Qafter_string), STRINGP (str))
-	  && SCHARS (str))
-	RECORD_OVERLAY_STRING (overlay, str, true);
+	  /* If overlay has a non-empty after-string, record it.  */
+	  if ((end == charpos || (start == charpos && invis != 0))
+	      && (str = Foverlay_get (overlay, Qafter_string), STRINGP (str))
+	      && SCHARS (str))
+	    RECORD_OVERLAY_STRING (overlay, str, true);
+	}
     }
 
 #undef RECORD_OVERLAY_STRING
@@ -6848,7 +6807,7 @@ back_to_previous_visible_line_start (struct it *it)
 	    && !NILP (val = get_char_property_and_overlay
 		      (make_fixnum (pos), Qdisplay, Qnil, &overlay))
 	    && (OVERLAYP (overlay)
-		? (beg = OVERLAY_POSITION (OVERLAY_START (overlay)))
+		? (beg = OVERLAY_START (overlay))
 		: get_property_and_range (pos, Qdisplay, &val, &beg, &end, Qnil)))
 	  {
 	    RESTORE_IT (it, it, it2data);
@@ -10006,7 +9965,6 @@ move_it_to (struct it *it, ptrdiff_t to_charpos, int to_x, int to_y, int to_vpos
 	}
 
       /* Reset/increment for the next run.  */
-      recenter_overlay_lists (current_buffer, IT_CHARPOS (*it));
       it->current_x = line_start_x;
       line_start_x = 0;
       it->hpos = 0;
@@ -22677,6 +22635,24 @@ find_row_edges (struct it *it, struct glyph_row *row,
 display_count_lines_logically (ptrdiff_t start_byte, ptrdiff_t limit_byte,
 			       ptrdiff_t count, ptrdiff_t *byte_pos_ptr)
 {
+  /* Long stretches of text are counted faster by the line index,
+     which also disregards the narrowing.  But it can only count all
+     the newlines there, so COUNT must not stop the count earlier.  */
+  if (limit_byte - start_byte > LINE_INDEX_INTERVAL
+      && (NILP (BVAR (current_buffer, selective_display))
+	  || FIXNUMP (BVAR (current_buffer, selective_display))))
+    {
+      ptrdiff_t start = BYTE_TO_CHAR (start_byte);
+      ptrdiff_t limit = BYTE_TO_CHAR (limit_byte);
+
+      if (count >= limit - start)
+	{
+	  *byte_pos_ptr = limit_byte;
+	  return (buf_charpos_to_line (current_buffer, limit)
+		  - buf_charpos_to_line (current_buffer, start));
+	}
+    }
+
   if (!display_line_numbers_widen || (BEGV == BEG && ZV == Z))
     return display_count_lines (start_byte, limit_byte, count, byte_pos_ptr);
 
@@ -23130,13 +23106,6 @@ display_line (struct it *it, int cursor_vpos)
   it->tab_offset = 0;
   it->line_number_produced_p = false;
 
-  /* Arrange the overlays nicely for our purposes.  Usually, we call
-     display_line on only one line at a time, in which case this
-     can't really hurt too much, or we call it on lines which appear
-     one after another in the buffer, in which case all calls to
-     recenter_overlay_lists but the first will be pretty cheap.  */
-  recenter_overlay_lists (current_buffer, IT_CHARPOS (*it));
-
   /* If we are going to display the cursor's line, account for the
      hscroll of that line.  We subtract the window's min_hscroll,
      because that was already accounted for in init_iterator.  */
@@ -33392,7 +33361,7 @@ note_mouse_highlight (struct frame *f, int x, int y)
 	  || (!hlinfo->mouse_face_hidden
 	      && OVERLAYP (hlinfo->mouse_face_overlay)
 	      /* It's possible the overlay was deleted (Bug#35273).  */
-              && XMARKER (OVERLAY_START (hlinfo->mouse_face_overlay))->buffer
+              && OVERLAY_BUFFER (hlinfo->mouse_face_overlay)
               && mouse_face_overlay_overlaps (hlinfo->mouse_face_overlay)))
 	{
 	  /* Find the highest priority overlay with a mouse-face.  */
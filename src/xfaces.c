@@ -6296,7 +6296,6 @@ face_at_buffer_position (struct window *w, ptrdiff_t pos,
     {
       for (prop = Qnil, i = noverlays - 1; i >= 0 && NILP (prop); --i)
 	{
-	  Lisp_Object oend;
 	  ptrdiff_t oendpos;
 
 	  prop = Foverlay_get (overlay_vec[i], propname);
@@ -6309,8 +6308,7 @@ face_at_buffer_position (struct window *w, ptrdiff_t pos,
 	      merge_face_ref (w, f, prop, attrs, true, NULL, attr_filter);
 	    }
 
-	  oend = OVERLAY_END (overlay_vec[i]);
-	  oendpos = OVERLAY_POSITION (oend);
+	  oendpos = OVERLAY_END (overlay_vec[i]);
 	  if (oendpos < endpos)
 	    endpos = oendpos;
 	}
@@ -6319,7 +6317,6 @@ face_at_buffer_position (struct window *w, ptrdiff_t pos,
     {
       for (i = 0; i < noverlays; i++)
 	{
-	  Lisp_Object oend;
 	  ptrdiff_t oendpos;
 
 	  prop = Foverlay_get (overlay_vec[i], propname);
@@ -6327,8 +6324,7 @@ face_at_buffer_position (struct window *w, ptrdiff_t pos,
 	  if (!NILP (prop))
 	    merge_face_ref (w, f, prop, attrs, true, NULL, attr_filter);
 
-	  oend = OVERLAY_END (overlay_vec[i]);
-	  oendpos = OVERLAY_POSITION (oend);
+	  oendpos = OVERLAY_END (overlay_vec[i]);
 	  if (oendpos < endpos)
 	    endpos = oendpos;
 	}
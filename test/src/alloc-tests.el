@@ -58,3 +58,68 @@ aset-nbytes-change
     (dolist (c (list 10003 ?b 128 ?c ?d (max-char) ?e))
       (aset s 0 c)
       (should (equal s (make-string 1 c))))))
+
+(ert-deftest garbage-collect-young-counts ()
+  (garbage-collect)
+  (let ((live (make-list 10000 nil))
+        last)
+    ;; Only the last of these conses is still reachable at the next
+    ;; collection; using it makes sure that they are all allocated.
+    (dotimes (i 10000)
+      (setq last (cons i nil)))
+    (let ((stats (garbage-collect)))
+      (dolist (kind '(conses floats strings))
+        (let ((entry (assq kind stats)))
+          (should (= (length entry) 6))
+          (should (natnump (nth 4 entry)))
+          (should (natnump (nth 5 entry)))))
+      (should (<= 10000 (nth 4 (assq 'conses stats))))
+      (should (<= 9000 (nth 5 (assq 'conses stats)))))
+    (should (= (length live) 10000))
+    (should (equal last '(9999)))))
+
+(ert-deftest garbage-collect-sweep-threads ()
+  (let* ((gc-sweep-threads 3)
+         (keep (mapcar #'float (number-sequence 1 200000))))
+    ;; Make garbage interleaved with the live data, then collect it.
+    (dotimes (i 200000)
+      (cons (float i) nil))
+    (garbage-collect)
+    (dotimes (i 200000)
+      (push (float i) keep))
+    (should (= (length keep) 400000))
+    (should (= (apply #'+ keep)
+               (+ (* 0.5 200000 200001) (* 0.5 199999 200000))))))
+
+(ert-deftest gc-statistics ()
+  (garbage-collect)
+  (let ((stats (car (gc-statistics))))
+    (should (= (length stats) 4))
+    (should (<= 0 (nth 1 stats)))
+    (should (assq 'gc-mark (nth 2 stats)))
+    (should (assq 'gc-sweep-conses-and-floats (nth 2 stats)))
+    (should (cl-every (lambda (p) (<= 0 (cdr p))) (nth 2 stats)))
+    (should (natnump (alist-get 'conses (nth 3 stats))))
+    (should (<= (length (gc-statistics)) 64))))
+
+
+;;; The following is for benchmark testing of the conservative scan of
+;;; the C stack, not for regression testing.
+
+(defun alloc-tests--gc-at-depth (depth)
+  "Return the time of 20 garbage collections, run DEPTH calls deep."
+  (if (zerop depth)
+      (car (benchmark-run 20 (garbage-collect)))
+    ;; Keep some live objects in each frame, as real code does.
+    (let ((obj (list depth (number-to-string depth))))
+      (prog1 (alloc-tests--gc-at-depth (1- depth))
+        (ignore obj)))))
+
+(defun benchmark-mark-stack ()
+  "Compare garbage collection times with a shallow and a deep C stack.
+The difference is the cost of scanning the deep stack."
+  (interactive)
+  (let ((max-lisp-eval-depth 20000)
+        (max-specpdl-size 40000))
+    (dolist (depth '(0 100 1000 5000))
+      (message "Depth %d: %fs" depth (alloc-tests--gc-at-depth depth)))))
@@ -1083,6 +1083,33 @@ test-make-indirect-buffer-1
         (when (buffer-live-p indirect)
           (kill-buffer indirect))))))
 
+;; Check that editing the text of an indirect buffer moves the overlays
+;; of its base buffer, and the other way around.
+(ert-deftest test-make-indirect-buffer-2 ()
+  (with-temp-buffer
+    (insert "0123456789")
+    (let ((base-ov (make-overlay 3 6))
+          (indirect (make-indirect-buffer (current-buffer) "indirect"))
+          indirect-ov)
+      (unwind-protect
+          (progn
+            (with-current-buffer indirect
+              (setq indirect-ov (make-overlay 4 8))
+              (goto-char 2)
+              (insert "ab"))
+            (should (equal (list (overlay-start base-ov) (overlay-end base-ov))
+                           '(5 8)))
+            (should (equal (list (overlay-start indirect-ov)
+                                 (overlay-end indirect-ov))
+                           '(6 10)))
+            (delete-region 1 7)
+            (should (equal (list (overlay-start base-ov) (overlay-end base-ov))
+                           '(1 2)))
+            (should (equal (list (overlay-start indirect-ov)
+                                 (overlay-end indirect-ov))
+                           '(1 4))))
+        (kill-buffer indirect)))))
+
 
 
 ;; +==========================================================================+
@@ -1328,10 +1355,63 @@ buffer-multibyte-overlong-sequences
           (set-buffer-multibyte t)
           (buffer-string)))))))
 
+;; Check that transpose-regions moves overlays along with the text, as
+;; it does markers.
+(ert-deftest test-overlay-transpose-regions ()
+  (with-temp-buffer
+    (insert "abcXYZdefg")
+    (let ((ov1 (make-overlay 2 3))
+          (ov2 (make-overlay 7 9))
+          (ov3 (make-overlay 4 6))
+          (ov4 (make-overlay 1 11)))
+      (transpose-regions 1 4 7 11)
+      (should (equal (buffer-string) "defgXYZabc"))
+      (should (equal (list (overlay-start ov1) (overlay-end ov1)) '(9 10)))
+      (should (equal (list (overlay-start ov2) (overlay-end ov2)) '(1 3)))
+      (should (equal (list (overlay-start ov3) (overlay-end ov3)) '(5 7)))
+      (should (equal (list (overlay-start ov4) (overlay-end ov4)) '(8 11)))
+      (transpose-regions 1 4 7 11 t)
+      (should (equal (list (overlay-start ov1) (overlay-end ov1)) '(9 10))))))
+
+;; Check the overlay boundaries found in a buffer with many overlays.
+(ert-deftest test-overlay-change-many ()
+  (with-temp-buffer
+    (insert (make-string 1000 ?x))
+    (dotimes (i 300)
+      (make-overlay (1+ (* 3 i)) (+ 3 (* 3 i))))
+    (should (= (next-overlay-change 500) 501))
+    (should (= (next-overlay-change 501) 502))
+    (should (= (previous-overlay-change 500) 499))
+    (should (= (next-overlay-change 900) (point-max)))
+    (should (= (previous-overlay-change 1000) 900))
+    (should (= (length (overlays-at 500)) 1))
+    (should (= (length (overlays-in 500 510)) 4))
+    (should (= (length (car (overlay-lists))) 300))))
+
 ;; https://debbugs.gnu.org/33492
 (ert-deftest buffer-tests-buffer-local-variables-undo ()
   "Test that `buffer-undo-list' appears in `buffer-local-variables'."
   (with-temp-buffer
     (should (assq 'buffer-undo-list (buffer-local-variables)))))
 
+;;; The following is for benchmark testing of overlays, not for
+;;; regression testing.
+
+(defun benchmark-overlays (&optional n)
+  "Return the time to make, query and edit around N overlays.
+N defaults to 100000."
+  (or n (setq n 100000))
+  (with-temp-buffer
+    (insert (make-string (* 2 n) ?x))
+    (benchmark-run 1
+      (dotimes (i n)
+        (make-overlay (1+ (* 2 i)) (+ 3 (* 2 i))))
+      (dotimes (i 1000)
+        (overlays-at (1+ (* i (/ n 500))))
+        (next-overlay-change (1+ (* i (/ n 500)))))
+      (dotimes (i 1000)
+        (goto-char (1+ (* i (/ n 500))))
+        (insert "y")
+        (delete-char -1)))))
+
 ;;; buffer-tests.el ends here
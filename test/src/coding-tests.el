@@ -375,6 +375,38 @@ benchmark-decoder
 			 (with-temp-buffer (insert-file-contents (car file))))))
 	  (insert (format "%s: %s\n" (car file) result)))))))
 
+(defun benchmark-utf-8-decoding (&optional n)
+  "Return the times to decode N bytes of UTF-8 text of various kinds.
+N defaults to 10000000.  The value is an alist mapping the kind of
+text, ASCII, mixed ASCII and CJK, CJK only, or ASCII with invalid
+bytes, to the result of `benchmark-run' for decoding it as a string
+and then inserting it into a buffer with `decode-coding-region'."
+  (or n (setq n 10000000))
+  (let ((gc-cons-threshold 4000000))
+    (mapcar
+     (lambda (kind)
+       (let* ((line (encode-coding-string
+                     (pcase kind
+                       ('ascii (concat (make-string 79 ?a) "\n"))
+                       ('cjk (concat (make-string 40 ?a) "\u4e2d\u6587\u5b57"
+                                     (make-string 30 ?b) "\n"))
+                       ('cjk-only (concat (make-string 26 ?\u6587) "\n"))
+                       ('invalid (concat (make-string 40 ?a) "\377\300"
+                                         (make-string 37 ?b) "\n")))
+                     'utf-8-unix))
+              (bytes (apply #'concat
+                            (make-list (/ n (length line)) line))))
+         (cons kind
+               (benchmark-run 1
+                 (decode-coding-string bytes 'utf-8-unix)
+                 (with-temp-buffer
+                   (set-buffer-multibyte nil)
+                   (insert bytes)
+                   (set-buffer-multibyte t)
+                   (decode-coding-region (point-min) (point-max)
+                                         'utf-8-unix))))))
+     '(ascii cjk cjk-only invalid))))
+
 (ert-deftest coding-nocopy-trivial ()
   "Check that the NOCOPY parameter works for the trivial coding system."
   (let ((s "abc"))
@@ -429,6 +461,50 @@ coding-check-coding-systems-region
                  '((iso-latin-1 3) (us-ascii 1 3))))
   (should-error (check-coding-systems-region "å" nil '(bad-coding-system))))
 
+(ert-deftest coding-utf-8-decode-runs ()
+  "Check decoding UTF-8 with long runs of ASCII between other bytes."
+  (random "coding-utf-8-decode-runs")
+  (let ((pieces '(("\303\251" "\u00e9" "\u00e9")
+                  ("\344\270\255" "\u4e2d" "\u4e2d")
+                  ("\360\237\230\200" "\U0001F600" "\U0001F600")
+                  ("\344\270\255\346\226\207\303\251"
+                   "\u4e2d\u6587\u00e9" "\u4e2d\u6587\u00e9")
+                  ("\r\n" "\r\n" "\n")
+                  ("\r" "\r" "\r")
+                  ("\n" "\n" "\n")
+                  ("\377" "\377" "\377")
+                  ("\300\200" "\300\200" "\300\200")
+                  ("\344\270" "\344\270" "\344\270")))
+        (file (make-temp-file "coding-tests")))
+    (unwind-protect
+        ;; Try both with and without invalid bytes, which make files
+        ;; take different paths.
+        (dolist (npieces '(6 10))
+          (let (bytes unix dos)
+            (dotimes (_ 300)
+              (let ((ascii (make-string (1+ (random 70)) ?a))
+                    (piece (nth (random npieces) pieces)))
+                (push (concat ascii (nth 0 piece)) bytes)
+                (push (concat ascii (string-to-multibyte (nth 1 piece))) unix)
+                (push (concat ascii (string-to-multibyte (nth 2 piece))) dos)))
+            (setq bytes (apply #'concat "z" (nreverse bytes))
+                  unix (apply #'concat "z" (nreverse unix))
+                  dos (apply #'concat "z" (nreverse dos)))
+            (should (equal (decode-coding-string bytes 'utf-8-unix) unix))
+            (should (equal (decode-coding-string bytes 'utf-8-dos) dos))
+            (should (equal (decode-coding-string (string-to-multibyte bytes)
+                                                 'utf-8-unix)
+                           unix))
+            (let ((coding-system-for-write 'no-conversion))
+              (write-region bytes nil file))
+            (dolist (coding '(utf-8-unix utf-8-dos))
+              (with-temp-buffer
+                (let ((coding-system-for-read coding))
+                  (insert-file-contents file))
+                (should (equal (buffer-string)
+                               (if (eq coding 'utf-8-unix) unix dos)))))))
+      (delete-file file))))
+
 ;; Local Variables:
 ;; byte-compile-warnings: (not obsolete)
 ;; End:
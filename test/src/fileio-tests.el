@@ -156,3 +156,101 @@ fileio-tests--circular-after-insert-file-functions
     (write-region "hello\n" nil f nil 'silent)
     (should-error (insert-file-contents f) :type 'circular-list)
     (delete-file f)))
+
+(ert-deftest fileio-tests--write-region-utf-8 ()
+  "Test writing text that may need no encoding, on both sides of the gap."
+  (let ((f (make-temp-file "fileio")))
+    (unwind-protect
+        (dolist (text (list "abc\ndef\n"
+                            "café\n中\U0001F600\n"
+                            (concat "aé\n" (string-to-multibyte "\300\377"))
+                            "\300\200\303\251\n"))
+          (dolist (coding '(utf-8-unix utf-8-dos utf-8-with-signature-unix))
+            (with-temp-buffer
+              (set-buffer-multibyte (multibyte-string-p text))
+              (insert text text)
+              ;; Put the gap in the middle of the text.
+              (goto-char (1+ (length text)))
+              (insert "x")
+              (delete-char -1)
+              (let ((coding-system-for-write coding))
+                (write-region nil nil f nil 'silent))
+              (let ((bytes (encode-coding-string (buffer-string) coding)))
+                (with-temp-buffer
+                  (set-buffer-multibyte nil)
+                  (insert-file-contents-literally f)
+                  (should (equal (buffer-string) bytes)))))))
+      (delete-file f))))
+
+(ert-deftest fileio-tests--insert-file-contents-mapped ()
+  "Test inserting a file by mapping it, and editing the result."
+  (let ((f (make-temp-file "fileio"))
+        (text (apply #'concat (make-list 2000 "abc\300\n\377"))))
+    (unwind-protect
+        (progn
+          (let ((coding-system-for-write 'no-conversion))
+            (write-region text nil f nil 'silent))
+          (with-temp-buffer
+            (set-buffer-multibyte nil)
+            (let ((large-file-mapping-threshold 0))
+              (insert-file-contents-literally f))
+            (should (equal (buffer-string) text))
+            (goto-char (point-min))
+            (should (search-forward "\377abc" nil t))
+            (insert "xyz")
+            (should-not (buffer-text-mapped-p))
+            (delete-region (point-min) 10)
+            (goto-char (point-max))
+            (insert (make-string 10000 ?z))
+            (should (equal (buffer-string)
+                           (concat "xyz" (substring text 9)
+                                   (make-string 10000 ?z)))))
+          ;; Changing the buffer does not change the file.
+          (with-temp-buffer
+            (set-buffer-multibyte nil)
+            (insert-file-contents-literally f)
+            (should (equal (buffer-string) text))))
+      (delete-file f))))
+
+(ert-deftest fileio-tests--write-region-mapped ()
+  "Test writing a file over itself while a buffer maps it."
+  (let ((f (make-temp-file "fileio"))
+        (text (apply #'concat (make-list 20000 "abc\300\n\377"))))
+    (unwind-protect
+        (let ((coding-system-for-write 'no-conversion))
+          (write-region text nil f nil 'silent)
+          (with-temp-buffer
+            (set-buffer-multibyte nil)
+            (let ((large-file-mapping-threshold 0))
+              (insert-file-contents-literally f))
+            ;; Truncating the file must not take away the text.
+            (write-region (point-min) (point-max) f nil 'silent)
+            (should-not (buffer-text-mapped-p))
+            (should (equal (buffer-string) text))
+            (write-region "x" nil f nil 'silent)
+            (should (equal (buffer-string) text))))
+      (delete-file f))))
+
+(ert-deftest fileio-tests--mapped-file-truncated ()
+  "Test truncating a file by another program while a buffer maps it."
+  (skip-unless (executable-find "truncate"))
+  (let ((f (make-temp-file "fileio"))
+        (text (apply #'concat (make-list 20000 "abc\300\n\377"))))
+    (unwind-protect
+        (let ((coding-system-for-write 'no-conversion))
+          (write-region text nil f nil 'silent)
+          (with-temp-buffer
+            (set-buffer-multibyte nil)
+            (let ((large-file-mapping-threshold 0))
+              (insert-file-contents-literally f))
+            (skip-unless (buffer-text-mapped-p))
+            (should (equal (buffer-substring 1 7) "abc\300\n\377"))
+            (should (= (call-process "truncate" nil nil nil "-s" "6" f) 0))
+            ;; The text that is gone reads as zeros, and the loss is
+            ;; reported as an error.
+            (should-error (progn
+                            (setq text (buffer-substring 100001 100007))
+                            (eval '(ignore) t)))
+            (should (equal text (make-string 6 0)))
+            (should (equal (buffer-substring 1 7) "abc\300\n\377"))))
+      (delete-file f))))
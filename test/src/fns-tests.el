@@ -166,6 +166,116 @@ fns-tests-sort
   (should (equal (should-error (sort "cba" #'<) :type 'wrong-type-argument)
                  '(wrong-type-argument list-or-vector-p "cba"))))
 
+(ert-deftest fns-tests-sort-key ()
+  (should (equal (sort (list "ccc" "a" "bb" "dd") #'< #'length)
+                 '("a" "bb" "dd" "ccc")))
+  (should (equal (sort (vector '(2 . a) '(1 . b) '(2 . c) '(1 . d)) #'< #'car)
+                 [(1 . b) (1 . d) (2 . a) (2 . c)]))
+  ;; The key function is called exactly once for each element.
+  (let ((calls 0))
+    (sort (number-sequence 1 1000)
+          #'> (lambda (x) (setq calls (1+ calls)) (% x 7)))
+    (should (= calls 1000))))
+
+(ert-deftest fns-tests-sort-list-in-place ()
+  (let* ((list (list 3 1 2))
+         (sorted (sort list #'<)))
+    (should (eq sorted list))
+    (should (equal list '(1 2 3)))))
+
+(ert-deftest fns-tests-sort-list-modified ()
+  ;; A predicate that cuts the list short must not make `sort' store
+  ;; past its end.
+  (let ((list (number-sequence 1 100)))
+    (should-error (sort list (lambda (a b)
+                               (setcdr (nthcdr 10 list) nil)
+                               (> a b)))
+                  :type 'wrong-type-argument)))
+
+(defun fns-tests--sort-check (seq pred &optional key)
+  "Check that sorting SEQ with PRED and KEY is stable.
+Compare the result with a merge sort of a list of (INDEX . ELEMENT)."
+  (let* ((n -1)
+         (indexed (mapcar (lambda (x) (cons (setq n (1+ n)) x)) seq))
+         (keyf (or key #'identity))
+         (expected
+          (mapcar #'cdr
+                  (sort indexed
+                        (lambda (a b)
+                          (let ((ka (funcall keyf (cdr a)))
+                                (kb (funcall keyf (cdr b))))
+                            (or (funcall pred ka kb)
+                                (and (not (funcall pred kb ka))
+                                     (< (car a) (car b))))))))))
+    (should (equal (append (sort (copy-sequence seq) pred key) nil)
+                   expected))))
+
+(ert-deftest fns-tests-sort-runs ()
+  (let ((n 2000))
+    ;; Ascending, descending and sawtooth input, with and without
+    ;; duplicates, exercise run detection and galloping.
+    (fns-tests--sort-check (number-sequence 1 n) #'<)
+    (fns-tests--sort-check (number-sequence n 1 -1) #'<)
+    (fns-tests--sort-check (mapcar (lambda (i) (% i 100))
+                                   (number-sequence 1 n))
+                           #'<)
+    (fns-tests--sort-check (mapcar (lambda (i) (if (< i (/ n 2)) i (- n i)))
+                                   (number-sequence 1 n))
+                           #'<)
+    (fns-tests--sort-check (vconcat (mapcar (lambda (_) (random 50))
+                                            (number-sequence 1 n)))
+                           (lambda (a b) (< a b)))
+    (fns-tests--sort-check (mapcar (lambda (_) (cons (random 10) (random 10)))
+                                   (number-sequence 1 n))
+                           #'< #'car)))
+
+(ert-deftest fns-tests-sort-fast-predicates ()
+  ;; `<', `>' and `string<' are compared without funcall, which must
+  ;; not change the results.
+  (fns-tests--sort-check (list 3 1.5 2 most-positive-fixnum
+                               (1+ most-positive-fixnum) -4 2.0 1.5)
+                         #'<)
+  (fns-tests--sort-check (list 3 1.5 2 (1+ most-positive-fixnum) -4 2.0)
+                         #'>)
+  (fns-tests--sort-check (list "b" "a" 'c "ab" "" "b") #'string<)
+  (should-error (sort (list 1 'a 2) #'<) :type 'wrong-type-argument)
+  (should (equal (sort (list 3 1 2) '<) '(1 2 3))))
+
+;; A multibyte string long enough for its character positions to be
+;; indexed.
+(defun fns-tests--multibyte-string (n)
+  (let ((chars [?a ?\N{LATIN SMALL LETTER E WITH ACUTE} ?b
+                ?\N{CJK UNIFIED IDEOGRAPH-6F22} ?c ?\N{GRINNING FACE}])
+        (v (make-vector n nil)))
+    (dotimes (i n)
+      (aset v i (aref chars (% (* i 7) (length chars)))))
+    (concat v)))
+
+(ert-deftest fns-tests-string-positions ()
+  (let* ((s1 (fns-tests--multibyte-string 20000))
+         (s2 (fns-tests--multibyte-string 30001))
+         (c1 (vconcat (mapcar #'identity s1)))
+         (c2 (vconcat (mapcar #'identity s2))))
+    ;; Alternate between the strings at random positions.
+    (dotimes (_ 2000)
+      (let ((i (random (length s1)))
+            (j (random (length s2))))
+        (should (eq (aref s1 i) (aref c1 i)))
+        (should (eq (aref s2 j) (aref c2 j)))
+        (should (equal (substring s1 i (min (length s1) (+ i 5)))
+                       (concat (substring c1 i (min (length s1) (+ i 5))))))))
+    ;; Changing the byte length of a character must not leave stale
+    ;; positions behind.
+    (dotimes (k 50)
+      (let ((i (random (length s1)))
+            (c (if (cl-oddp k) ?x ?\N{GRINNING FACE})))
+        (aset s1 i c)
+        (aset c1 i c)))
+    (dotimes (i (length s1))
+      (should (eq (aref s1 i) (aref c1 i))))
+    (let ((pos (random (length s1))))
+      (should (= (string-match "." s1 pos) pos)))))
+
 (ert-deftest fns-tests-collate-sort ()
   (skip-unless (fns-tests--collate-enabled-p))
 
@@ -892,4 +1002,46 @@ test-secure-hash
                          "23204973d0219337f81616a8069b012587cf5635f69"
                          "25f1b56c360230c19b273500ee013e030601bf2425"))))
 
+;;; The following is for benchmark testing of `sort',
+;;; not for regression testing.
+
+(defun benchmark-sort ()
+  (let ((n 500000))
+    (dolist (input `((random . ,(lambda (_) (random n)))
+                     (sorted . ,#'identity)
+                     (reversed . ,(lambda (i) (- n i)))))
+      (let ((list (mapcar (cdr input) (number-sequence 1 n))))
+        (message "%-8s <:       %.3f s" (car input)
+                 (car (benchmark-run 1 (sort (copy-sequence list) #'<))))
+        (message "%-8s lambda:  %.3f s" (car input)
+                 (car (benchmark-run 1
+                        (sort (copy-sequence list) (lambda (a b) (< a b))))))))
+    (let ((strings (mapcar (lambda (_) (format "%x" (random n)))
+                           (number-sequence 1 n))))
+      (message "string<:          %.3f s"
+               (car (benchmark-run 1 (sort strings #'string<)))))
+    (let ((conses (mapcar (lambda (_) (cons (random n) nil))
+                          (number-sequence 1 n))))
+      (message "key car:          %.3f s"
+               (car (benchmark-run 1 (sort (copy-sequence conses) #'< #'car)))))))
+;;; The following is for benchmark testing of conversions between
+;;; character and byte positions in strings, not for regression testing.
+
+(defun benchmark-string-positions ()
+  (dolist (n '(10000 1000000 10000000))
+    (let ((s (fns-tests--multibyte-string n))
+          (s2 (fns-tests--multibyte-string n))
+          (lookups 100000))
+      (message "%8d aref:        %.3f us" n
+               (/ (* 1e6 (car (benchmark-run 1
+                                (dotimes (_ lookups)
+                                  (aref s (random n))))))
+                  lookups))
+      (message "%8d alternating: %.3f us" n
+               (/ (* 1e6 (car (benchmark-run 1
+                                (dotimes (i lookups)
+                                  (aref s i)
+                                  (aref s2 (- n i 1))))))
+                  (* 2 lookups))))))
+
 (provide 'fns-tests)
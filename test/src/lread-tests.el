@@ -190,4 +190,30 @@ lread-string-to-number-trailing-dot
 (ert-deftest lread-circular-hash ()
   (should-error (read "#s(hash-table data #0=(#0# . #0#))")))
 
+;;; The following is for benchmark testing of symbol lookup in the
+;;; obarray, not for regression testing.
+
+(defun benchmark-read-symbols ()
+  "Time reading forms made of existing and new symbols."
+  (let* ((existing (let (l) (mapatoms (lambda (s) (push s l))) l))
+         (text (with-temp-buffer
+                 (insert "(")
+                 (dolist (s existing)
+                   (prin1 s (current-buffer))
+                   (insert " "))
+                 (dotimes (i 50000)
+                   (insert (format "lread-tests--new-%d " i)))
+                 (insert ")")
+                 (buffer-string))))
+    ;; The first read interns the new symbols, the others find them.
+    (message "%d symbols: %fs" (+ (length existing) 50000)
+             (car (benchmark-run 10 (read text))))))
+
+(defun benchmark-load-elc (dir)
+  "Time loading the .elc files in DIR."
+  (let ((files (directory-files dir t "\\.elc\\'")))
+    (message "%d files: %fs" (length files)
+             (car (benchmark-run 1
+                    (dolist (f files) (load f nil t t)))))))
+
 ;;; lread-tests.el ends here
@@ -57,4 +57,70 @@ marker-goto-char-from-other-buffer
     (set-marker marker-2 marker-1)
     (should (goto-char marker-2))))
 
+(defun marker-tests--check-positions ()
+  "Check the conversions of positions in the current buffer to bytes."
+  (let ((byte 1))
+    (dotimes (i (1- (point-max)))
+      (let ((pos (1+ i)))
+        (when (zerop (% pos 97))
+          (should (= (position-bytes pos) byte))
+          (should (= (byte-to-position byte) pos))))
+      (setq byte (+ byte (string-bytes (string (char-after (1+ i)))))))))
+
+;; Check that conversions between character and byte positions stay
+;; right in a large multibyte buffer as its text is edited.
+(ert-deftest marker-position-conversions ()
+  (with-temp-buffer
+    (dotimes (i 2000)
+      (insert (if (zerop (% i 3)) "abcdefg\n" "\u00e9\u4e2d\U0001F600xy\n")))
+    (random "marker-position-conversions")
+    (marker-tests--check-positions)
+    (dotimes (_ 50)
+      (let ((pos (1+ (random (1- (point-max))))))
+        (goto-char pos)
+        (if (zerop (random 2))
+            (insert "\u00e0\u00e8x")
+          (delete-region pos (min (point-max) (+ pos (random 20)))))
+        ;; Convert far from point, to use the checkpoints.
+        (position-bytes (1+ (random (1- (point-max)))))
+        (byte-to-position (1+ (random (1- (position-bytes (point-max))))))))
+    (marker-tests--check-positions)))
+
+(ert-deftest marker-position-conversions-transpose ()
+  "Check that `transpose-regions' forgets the byte positions it changes."
+  (with-temp-buffer
+    (dotimes (_ 200)
+      (insert (make-string 50 ?a) (make-string 50 #x4e2d) "\n"))
+    (random "marker-position-conversions-transpose")
+    (dotimes (_ 20)
+      (marker-tests--check-positions)
+      ;; Swap regions of different byte lengths, with and without text
+      ;; between them.
+      (let* ((start1 (1+ (random 5000)))
+             (end1 (+ start1 (random 300)))
+             (start2 (if (zerop (random 2)) end1
+                       (+ end1 (random 300))))
+             (end2 (+ start2 (random 300))))
+        (transpose-regions start1 end1 start2 end2)))
+    (marker-tests--check-positions)))
+
+;;; The following is for benchmark testing of position conversions,
+;;; not for regression testing.
+
+(defun benchmark-position-bytes (&optional n)
+  "Return the time to convert N random positions in a large buffer.
+N defaults to 100000.  The buffer has many markers and non-ASCII
+characters throughout."
+  (or n (setq n 100000))
+  (with-temp-buffer
+    (dotimes (i 200000)
+      (insert (if (zerop (% i 2)) "abcdefghij\n" "\u00e9\u00e8\u00e0\n")))
+    (dotimes (i 1000)
+      (copy-marker (* i 1000)))
+    (let ((z (point-max)))
+      (benchmark-run 1
+        (dotimes (_ n)
+          (goto-char (1+ (random (1- z))))
+          (position-bytes (1+ (random (1- z)))))))))
+
 ;;; marker-tests.el ends here.
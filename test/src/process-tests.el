@@ -366,5 +366,77 @@ non-existent-lookup-failure
   "Check that looking up non-existent domain returns nil"
   (should (eq nil (network-lookup-address-info "emacs.invalid"))))
 
+;; Check that large output is inserted whole, whether or not it can be
+;; read right into the process buffer.
+(ert-deftest process-test-large-output ()
+  (skip-unless (executable-find "seq"))
+  (let ((expected (concat (mapconcat #'number-to-string
+                                     (number-sequence 1 100000) "\n")
+                          "\n")))
+    (dolist (multibyte '(nil t))
+      (with-temp-buffer
+        (set-buffer-multibyte multibyte)
+        (insert "start\n")
+        (let* ((changes 0)
+               (process (make-process :name "seq"
+                                      :command '("seq" "100000")
+                                      :buffer (current-buffer)
+                                      :coding 'binary
+                                      :sentinel #'ignore
+                                      :noquery t
+                                      :connection-type 'pipe)))
+          (add-hook 'after-change-functions
+                    (lambda (_beg _end _len) (setq changes (1+ changes)))
+                    nil t)
+          (goto-char (point-min))
+          (while (or (accept-process-output process)
+                     (process-live-p process)))
+          (should (equal (buffer-string) (concat "start\n" expected)))
+          (should (= (marker-position (process-mark process)) (point-max)))
+          (should (= (point) (point-min)))
+          (should (< 0 changes)))))))
+
+;; Check that batching the output of a process passes all of it to
+;; the filter in fewer calls, and that the statistics add up.
+(ert-deftest process-test-output-batching ()
+  (skip-unless (executable-find "seq"))
+  (let ((expected (concat (mapconcat #'number-to-string
+                                     (number-sequence 1 50000) "\n")
+                          "\n"))
+        (calls nil))
+    (dolist (batching '((nil) (1000000) (1000000 0.05)))
+      (let* ((output nil)
+             ;; Read small chunks, so that there are many of them.
+             (read-process-output-max 4096)
+             (process (make-process :name "seq"
+                                    :command '("seq" "50000")
+                                    :coding 'binary
+                                    :sentinel #'ignore
+                                    :noquery t
+                                    :connection-type 'pipe
+                                    :filter
+                                    (lambda (_process string)
+                                      (push string output)))))
+        (apply #'set-process-output-batching process batching)
+        (should (equal (process-output-batching process)
+                       (and (car batching)
+                            (cons (car batching)
+                                  (float (or (cadr batching) 0))))))
+        (while (or (accept-process-output process)
+                   (process-live-p process)))
+        (setq output (nreverse output))
+        (should (equal (apply #'concat output) expected))
+        (should (equal (process-output-statistics process)
+                       (cons (length expected) (length output))))
+        (push (length output) calls)))
+    (setq calls (nreverse calls))
+    ;; Without batching, there is a call for each chunk read.
+    (should (<= (/ (length expected) 4096) (nth 0 calls)))
+    (should (< (nth 2 calls) (nth 0 calls)))
+    (should-error (set-process-output-batching
+                   (make-process :name "true" :command '("true")
+                                 :noquery t)
+                   -1))))
+
 (provide 'process-tests)
 ;; process-tests.el ends here.
@@ -0,0 +1,88 @@
+;;; profiler-tests.el --- tests for src/profiler.c -*- lexical-binding: t -*-
+
+;; Copyright (C) 2020 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+(require 'cl-lib)
+(require 'profiler)
+
+(defvar profiler-tests--kept nil)
+
+(defun profiler-tests--allocate ()
+  (dotimes (i 20000)
+    (push (make-string 10 ?x) profiler-tests--kept)
+    (cons i i)))
+
+(ert-deftest profiler-allocation-log ()
+  (let ((profiler-allocation-sampling-interval 1024))
+    (setq profiler-tests--kept nil)
+    (profiler-allocation-start)
+    (unwind-protect
+        (progn
+          (profiler-tests--allocate)
+          (garbage-collect))
+      (profiler-allocation-stop))
+    (let* ((log (profiler-allocation-log))
+           (allocated (car log))
+           (survived (cdr log))
+           (types nil))
+      (should (hash-table-p allocated))
+      (should (hash-table-p survived))
+      (maphash (lambda (bt _) (cl-pushnew (aref bt 0) types)) allocated)
+      (should (memq 'cons types))
+      (should (memq 'string types))
+      ;; The strings are kept, so some of them must have survived.
+      (let ((strings 0))
+        (maphash (lambda (bt bytes)
+                   (when (eq (aref bt 0) 'string)
+                     (setq strings (+ strings bytes))))
+                 survived)
+        (should (< 0 strings))))
+    (setq profiler-tests--kept nil)))
+
+(ert-deftest profiler-allocation-report ()
+  (let ((profiler-allocation-sampling-interval 1024))
+    (setq profiler-tests--kept nil)
+    (profiler-reset)
+    (profiler-start 'alloc)
+    (unwind-protect
+        (progn
+          (profiler-tests--allocate)
+          (garbage-collect))
+      (profiler-stop))
+    (should-not (profiler-running-p))
+    (should (consp profiler-allocation-log))
+    (dolist (profile (list (profiler-allocation-profile)
+                           (profiler-survival-profile)))
+      (let ((buffer (profiler-report-setup-buffer profile)))
+        (unwind-protect
+            (with-current-buffer buffer
+              (should (string-match-p "Allocation\\|Survival"
+                                      (buffer-name)))
+              ;; The reversed call tree starts with the types allocated.
+              (profiler-report-render-reversed-calltree)
+              (goto-char (point-min))
+              (should (re-search-forward "\\_<string\\_>" nil t)))
+          (kill-buffer buffer))))
+    (profiler-reset)
+    (should-not profiler-allocation-log)
+    (setq profiler-tests--kept nil)))
+
+;;; profiler-tests.el ends here
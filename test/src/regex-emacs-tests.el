@@ -803,4 +803,101 @@ regexp-multibyte-unibyte
   (should-not (string-match "å" "\xe5"))
   (should-not (string-match "[å]" "\xe5")))
 
+(defun regex-tests--random-dfa-regexp (depth)
+  "Return a random regexp without back references, nested DEPTH deep.
+The regexp can be run as a DFA by `re-search-forward'."
+  (pcase (if (zerop depth) 0 (random 4))
+    (0 (nth (random 12) '("a" "b" "\n" "." "[ab]" "[^a]" "^" "$"
+                          "\\`" "\\'" "é" "[[:alpha:]]")))
+    (1 (concat (regex-tests--random-dfa-regexp (1- depth))
+               (regex-tests--random-dfa-regexp (1- depth))))
+    (2 (format "\\(%s\\|%s\\)"
+               (regex-tests--random-dfa-regexp (1- depth))
+               (regex-tests--random-dfa-regexp (1- depth))))
+    (_ (format "\\(?:%s\\)%s"
+               (regex-tests--random-dfa-regexp (1- depth))
+               (nth (random 6) '("*" "+" "?" "*?" "+?" "??"))))))
+
+(ert-deftest regexp-dfa-search ()
+  "Test searches for regexps without back references.
+Each search should find the first place where `looking-at' succeeds,
+with the same match data.  `string-match-p', which does not need
+the match data, should find the same place."
+  (random "regexp-dfa-search")
+  (dotimes (_ 300)
+    (let ((regexp (regex-tests--random-dfa-regexp 3))
+          (case-fold-search (zerop (random 2))))
+      (with-temp-buffer
+        (dotimes (_ (random 20))
+          (insert (nth (random 5) '("a" "b" "\n" "A" "é"))))
+        (dotimes (i (point-max))
+          (let ((pos (1+ i))
+                expected)
+            (goto-char pos)
+            (while (and (not (setq expected (and (looking-at regexp)
+                                                 (match-data t))))
+                        (not (eobp)))
+              (forward-char))
+            (goto-char pos)
+            (should (equal (and (re-search-forward regexp nil t)
+                                (match-data t))
+                           expected))
+            (should (equal (string-match-p regexp (buffer-string) i)
+                           (and expected (1- (car expected))))))))))
+  ;; This takes exponential time to fail with backtracking alone.
+  (let ((text (make-string 40 ?a)))
+    (should-not (string-match "\\(?:a\\|aa\\)*c" text))
+    (with-temp-buffer
+      (insert text)
+      (should-not (re-search-backward "\\(?:a\\|aa\\)*c" nil t)))))
+
+;; Searches look for the literal string that every match contains.
+(defun regex-tests--random-literal-regexp (depth)
+  "Return a random regexp made of literal strings, nested DEPTH deep."
+  (pcase (if (zerop depth) 0 (random 5))
+    (0 (nth (random 12) '("foo" "bar" "kit" "it" "o" "\n" "é" "x\\{2\\}"
+                          ".*" "[0-9]+" "[^o]" "^")))
+    ((or 1 2) (concat (regex-tests--random-literal-regexp (1- depth))
+                      (regex-tests--random-literal-regexp (1- depth))))
+    (3 (format "\\(%s\\|%s\\)"
+               (regex-tests--random-literal-regexp (1- depth))
+               (regex-tests--random-literal-regexp (1- depth))))
+    (_ (format "\\(%s\\)%s"
+               (regex-tests--random-literal-regexp (1- depth))
+               (nth (random 4) '("*" "?" "+?" "\\{2\\}"))))))
+
+(ert-deftest regexp-literal-search ()
+  "Test searches for regexps that contain literal strings.
+Each search should find the first place where `looking-at' succeeds
+before the bound, with the same match data, including when the case
+of a letter differs or is folded to or from a non-ASCII letter, and
+when the literal string straddles the gap."
+  (random "regexp-literal-search")
+  (dotimes (_ 300)
+    (let ((regexp (regex-tests--random-literal-regexp 3))
+          (case-fold-search (zerop (random 2))))
+      (with-temp-buffer
+        (dotimes (_ (random 15))
+          (insert (nth (random 12) '("foo" "FOO" "bar" "Bar" "kit" "\u212Ait"
+                                     "\u0130t" "o" "\n" "é" "xx" "42"))))
+        ;; Move the gap into the text.
+        (goto-char (1+ (random (point-max))))
+        (insert "x")
+        (delete-char -1)
+        (dotimes (i (point-max))
+          (let ((pos (1+ i))
+                (bound (+ 1 i (random (- (point-max) i))))
+                expected)
+            (goto-char pos)
+            (save-restriction
+              (narrow-to-region (point-min) bound)
+              (while (and (not (setq expected (and (looking-at regexp)
+                                                   (match-data t))))
+                          (not (eobp)))
+                (forward-char)))
+            (goto-char pos)
+            (should (equal (and (re-search-forward regexp bound t)
+                                (match-data t))
+                           expected))))))))
+
 ;;; regex-emacs-tests.el ends here
@@ -0,0 +1,288 @@
+;;; search-tests.el --- tests for search.c functions -*- lexical-binding: t -*-
+
+;; Copyright (C) 2020 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(ert-deftest search-line-number-at-pos ()
+  (with-temp-buffer
+    (insert "foo\nbar\n\nbaz")
+    (should (= (line-number-at-pos 1) 1))
+    (should (= (line-number-at-pos 4) 1))
+    (should (= (line-number-at-pos 5) 2))
+    (should (= (line-number-at-pos 10) 4))
+    (should (= (line-number-at-pos) 4))
+    (should (= (line-number-at-pos 100) 4))
+    (narrow-to-region 6 10)
+    (should (= (line-number-at-pos 9) 2))
+    (should (= (line-number-at-pos 9 t) 3))
+    (should (= (line-number-at-pos 1) 1))
+    (should (= (line-number-at-pos 1 t) 1))
+    (should (= (line-number-at-pos 7 t) 2))
+    (should-error (line-number-at-pos 'foo))))
+
+;; Check that line numbers and line motion stay right in a large buffer
+;; as its text is edited, which exercises the line index.
+(ert-deftest search-line-index ()
+  (with-temp-buffer
+    (dotimes (i 20000)
+      (insert (make-string (% (* i 7) 23) ?x) "\n"))
+    (let ((check
+           (lambda ()
+             (let ((line 1))
+               (goto-char (point-min))
+               (while (not (eobp))
+                 (when (zerop (% line 97))
+                   (should (= (line-number-at-pos) line))
+                   (save-excursion
+                     (goto-char (point-min))
+                     (should (= (forward-line (1- line)) 0))
+                     (should (= (line-number-at-pos) line))
+                     (should (bolp))))
+                 (forward-line 1)
+                 (setq line (1+ line)))
+               (should (= (count-lines (point-min) (point-max)) (1- line)))))))
+      (random "search-line-index")
+      (funcall check)
+      (dotimes (_ 50)
+        (let ((pos (1+ (random (1- (point-max))))))
+          (goto-char pos)
+          (pcase (random 3)
+            (0 (insert "a\nb\n\nc"))
+            (1 (delete-region pos (min (point-max) (+ pos (random 200)))))
+            (2 (subst-char-in-region pos (min (point-max) (+ pos 50))
+                                     ?\n ?y)))
+          ;; Count far from the change, to use the index.
+          (line-number-at-pos (1+ (random (1- (point-max)))))))
+      (funcall check)
+      (goto-char (point-max))
+      (forward-line (- (point-max)))
+      (should (bobp)))))
+
+;; Check that counting newlines a block at a time gives the same results
+;; as the newline cache, in text of varying density.
+(ert-deftest search-forward-line-blocks ()
+  (with-temp-buffer
+    (random "search-forward-line-blocks")
+    (dotimes (i 3000)
+      (insert (make-string (random (if (< (% i 1000) 500) 3 300)) ?x)
+              (if (zerop (random 2)) "\n" "\u00e9\n")))
+    (dotimes (_ 200)
+      (let ((pos (1+ (random (1- (point-max)))))
+            (n (- (random 400) 200))
+            results)
+        (dolist (cache '(nil t))
+          (setq cache-long-scans cache)
+          (goto-char pos)
+          (push (list (forward-line n) (point)) results))
+        (should (equal (car results) (cadr results)))))))
+
+;; Check that regexps are found in the cache, and evicted from it when
+;; it is full.
+(ert-deftest search-regexp-cache ()
+  (let* ((regexp-cache-size 5)
+         ;; Make sure that none of the regexps is cached already, as
+         ;; when the test runs again in the same session.
+         (prefix (format "search-regexp-cache-%d-%d-" (random) (random)))
+         (regexps (mapcar (lambda (i) (format "%s%d" prefix i))
+                          (number-sequence 1 10)))
+         (stats (regexp-cache-statistics)))
+    (string-match (car regexps) "")
+    (string-match (car regexps) "")
+    (let ((new (regexp-cache-statistics)))
+      (should (= (car new) (1+ (car stats))))
+      (should (= (cadr new) (1+ (cadr stats))))
+      (setq stats new))
+    (dolist (regexp (cdr regexps))
+      (string-match regexp ""))
+    (let ((new (regexp-cache-statistics)))
+      (should (= (cadr new) (+ (cadr stats) 9)))
+      (should (<= (nth 2 new) 5))
+      (setq stats new))
+    (string-match (car regexps) "")
+    (should (= (cadr (regexp-cache-statistics)) (1+ (cadr stats))))))
+
+;; Check that the regexp profiler records searches only while it is on,
+;; and how many bytes they go through.
+(ert-deftest search-regexp-profile ()
+  (clear-regexp-profile)
+  (let ((regexp "search-regexp-profile\\(a\\|ab\\)*c")
+        (string "xxsearch-regexp-profileababc"))
+    (let ((regexp-profiling t))
+      (dotimes (_ 3)
+        (should (= (string-match regexp string) 2)))
+      (with-temp-buffer
+        (insert "search-regexp-profileab")
+        (goto-char (point-min))
+        (should-not (re-search-forward regexp nil t))))
+    (string-match regexp string)
+    (let ((entry (assoc regexp (regexp-profile))))
+      (should (= (nth 1 entry) 4))
+      (should (= (nth 2 entry) (+ (* 3 (length string))
+                                  (length "search-regexp-profileab"))))
+      (should (> (nth 3 entry) 0))
+      (should (floatp (nth 4 entry))))
+    (let ((times (mapcar (lambda (entry) (nth 4 entry)) (regexp-profile))))
+      (should (equal times (sort (copy-sequence times) #'>))))
+    (clear-regexp-profile)
+    (should-not (regexp-profile))))
+
+;; Check that searching for keywords finds the leftmost, longest
+;; keyword, and what a POSIX search for the regexp of the keywords
+;; finds, across the gap and with case folding.
+(ert-deftest search-forward-keywords ()
+  (with-temp-buffer
+    (insert "xx foobar fOO bar\u00e9z")
+    (goto-char (point-min))
+    (let ((case-fold-search nil))
+      (should (= (search-forward-keywords '("bar" "foo" "foobar" "foo"))
+                 2))
+      (should (equal (match-data t) '(4 10)))
+      (should (= (search-forward-keywords ["foo" "bar\u00e9"]) 1))
+      (should (equal (match-data t) '(15 19)))
+      (should-not (search-forward-keywords '("foo") nil t))
+      (should (= (point) 19))
+      (goto-char (point-min))
+      (should-not (search-forward-keywords '("foo") 6 'move))
+      (should (= (point) 6))
+      (should-error (search-forward-keywords '("foo") 1))
+      (should-error (search-forward-keywords '("foo" 1)))
+      (should-error (search-forward-keywords '("xyz")) :type 'search-failed))
+    (let ((case-fold-search t))
+      (goto-char 8)
+      (should (= (search-forward-keywords '("foo" "BAR\u00c9")) 0))
+      (should (equal (match-data t) '(11 14)))
+      (should (= (search-forward-keywords '("foo" "BAR\u00c9")) 1))))
+  (random "search-forward-keywords")
+  (dotimes (_ 100)
+    (let ((keywords (mapcar (lambda (_)
+                              (apply #'string
+                                     (mapcar (lambda (_)
+                                               (aref "abcAB\u00e9" (random 6)))
+                                             (make-list (1+ (random 4)) nil))))
+                            (make-list (1+ (random 8)) nil)))
+          (fold (zerop (random 2))))
+      (with-temp-buffer
+        (setq case-fold-search fold)
+        (dotimes (_ 100)
+          (insert (aref "abcAB\u00e9\u00c9 " (random 8))))
+        ;; Put the gap somewhere in the middle.
+        (goto-char (1+ (random 100)))
+        (insert "x")
+        (delete-char -1)
+        (let ((regexp (regexp-opt keywords))
+              (pos (point-min)))
+          (while pos
+            (goto-char pos)
+            (let* ((found (search-forward-keywords keywords nil t))
+                   (data (match-data t)))
+              (goto-char pos)
+              (should (equal (and found data)
+                             (and (posix-search-forward regexp nil t)
+                                  (match-data t))))
+              (when found
+                (should (eq t (compare-strings (nth found keywords) nil nil
+                                               (match-string 0) nil nil
+                                               fold)))
+                ;; The first of equal keywords is found.
+                (dotimes (i found)
+                  (should-not (eq t (compare-strings
+                                     (nth i keywords) nil nil
+                                     (nth found keywords) nil nil
+                                     fold))))))
+            (setq pos (and (< pos (point-max)) (1+ pos)))))))))
+
+;;; The following is for benchmark testing of line counting, the
+;;; regexp cache and keyword search, not for regression testing.
+
+(defun benchmark-line-number-at-pos (&optional n)
+  "Return the time to find the line numbers of N random positions.
+N defaults to 10000.  The buffer is a few megabytes long, and is
+edited between the calls."
+  (or n (setq n 10000))
+  (with-temp-buffer
+    (dotimes (i 100000)
+      (insert (make-string (% i 60) ?x) "\n"))
+    (let ((z (point-max)))
+      (benchmark-run 1
+        (dotimes (i n)
+          (when (zerop (% i 10))
+            (goto-char (1+ (random (1- z))))
+            (insert "\n"))
+          (line-number-at-pos (1+ (random (1- z)))))))))
+
+(defun benchmark-forward-line (&optional n)
+  "Return the time to move over 100 lines N times in a large buffer.
+N defaults to 100000.  The newline cache is turned off, so every
+motion counts newlines."
+  (or n (setq n 100000))
+  (with-temp-buffer
+    (setq cache-long-scans nil)
+    (dotimes (i 100000)
+      (insert (make-string (% i 20) ?x) "\n"))
+    (let ((z (point-max)))
+      (benchmark-run 1
+        (dotimes (_ n)
+          (goto-char (1+ (random (1- z))))
+          (forward-line (if (zerop (random 2)) 100 -100)))))))
+
+(defun benchmark-regexp-cache (&optional n size)
+  "Return the time to match each of N regexps in turn 1000 times.
+N defaults to 50.  SIZE, if non-nil, is the value of
+`regexp-cache-size' to use; when the cache cannot hold all the
+regexps, every match compiles its regexp."
+  (or n (setq n 50))
+  (let ((regexp-cache-size (or size regexp-cache-size))
+        (regexps (mapcar (lambda (i)
+                           (format "\\_<foo%d\\(?:bar\\|baz\\)+\\_>" i))
+                         (number-sequence 1 n))))
+    (benchmark-run 1
+      (dotimes (_ 1000)
+        (dolist (regexp regexps)
+          (string-match regexp "foo1barbaz"))))))
+
+(defun benchmark-search-forward-keywords (&optional n)
+  "Return the times to find N keywords in a buffer, with and without regexps.
+N defaults to 2000.  The value is a list of the times to find all the
+keywords in a buffer of about a megabyte with `search-forward-keywords',
+and with `re-search-forward' and the regexp that `regexp-opt' makes
+of them."
+  (or n (setq n 2000))
+  (let ((word (lambda ()
+                (apply #'string (mapcar (lambda (_) (+ ?a (random 26)))
+                                        (make-list (+ 3 (random 8)) nil)))))
+        keywords)
+    (dotimes (_ n)
+      (push (funcall word) keywords))
+    (with-temp-buffer
+      (while (< (buffer-size) 1000000)
+        (insert (if (zerop (random 10))
+                    (nth (random n) keywords)
+                  (funcall word))
+                " "))
+      (let ((regexp (regexp-opt keywords)))
+        (list (benchmark-run 1
+                (goto-char (point-min))
+                (while (search-forward-keywords keywords nil t)))
+              (benchmark-run 1
+                (goto-char (point-min))
+                (while (re-search-forward regexp nil t))))))))
+
+;;; search-tests.el ends here